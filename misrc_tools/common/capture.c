@@ -61,6 +61,7 @@
 		#include <endian.h>
 	#endif
 	#include <unistd.h>
+	#include <sys/stat.h>
 	#define aligned_free(x) free(x)
 	#define sleep_ms(x) usleep(x*1000)
 #else
@@ -81,8 +82,14 @@
 #include "misrc_options.h"
 //#include "version.h"
 #include "ringbuffer.h"
+#include "pipe_writer.h"
+#include "writeback.h"
 #include "extract.h"
 #include "wave.h"
+#include "parse_time.h"
+#include "rf_container.h"
+#include "rf_decimate.h"
+#include "numcores.h"
 
 #include <hsdaoh.h>
 #include <hsdaoh_raw.h>
@@ -91,6 +98,11 @@
 #if LIBFLAC_ENABLED == 1
 #include "FLAC/metadata.h"
 #include "FLAC/stream_encoder.h"
+#include "flac_stitch.h"
+#include "flac_tune.h"
+#include "flac_fixed.h"
+#include "flac_verify.h"
+#include "md5.h"
 # if defined(FLAC_API_VERSION_CURRENT) && FLAC_API_VERSION_CURRENT >= 14
 static const char* const _FLAC_StreamEncoderSetNumThreadsStatusString[] = {
 	"FLAC__STREAM_ENCODER_SET_NUM_THREADS_OK",
@@ -103,10 +115,7 @@ static const char* const _FLAC_StreamEncoderSetNumThreadsStatusString[] = {
 
 #if LIBSOXR_ENABLED == 1
 #include <soxr.h>
-#endif
-
-#if LIBFLAC_ENABLED == 1 && defined(FLAC_API_VERSION_CURRENT) && FLAC_API_VERSION_CURRENT >= 14
-#include "numcores.h"
+static const unsigned long resample_qual_list[] = { SOXR_QQ, SOXR_LQ, SOXR_MQ, SOXR_HQ, SOXR_VHQ };
 #endif
 
 #define _FILE_OFFSET_BITS 64
@@ -134,39 +143,148 @@ typedef struct {
 	bool capture_audio_started2;
 } capture_ctx_t;
 
+#define SEGMENT_PENDING 16 // cuts a writer can be behind
+
+// outputs written by the file writer threads
+#define OUT_RF_A 0
+#define OUT_RF_B 1
+#define OUT_RAW  2
+#define OUT_AUX  3
+#define OUT_CNT  4
+
+// what the main loop does if the ringbuffer of an output is full
+#define BACKPRESSURE_BLOCK   0 // wait, the capture ringbuffer fills up instead
+#define BACKPRESSURE_DROP    1 // drop the block for this output and report the gap
+#define BACKPRESSURE_DEGRADE 2 // lower the FLAC level when the ringbuffer is 3/4 full, drop if it is full
+#define BACKPRESSURE_DEGRADE_WAIT 8 // blocks before the level is lowered again
+
+#define FLAC_FRAME_MAX (1<<16) // renumbered frame of a stream with level changes
+#define FLAC_BUILTIN_FRAMES  ((BUFFER_READ_SIZE) / 4 / FLAC_STITCH_BLOCKSIZE) // frames encoded at once
+#define FLAC_BUILTIN_THREADS 2 // default, one thread is already fast enough for 40 MSPS on current CPUs
+
+// adaptive FLAC level, the level is lowered above 3/4 ringbuffer fill and raised below 1/4
+#define FLAC_LEVELS       9
+#define FLAC_ADAPT_WAIT   32   // chunks between two level changes
+#define FLAC_ADAPT_RETRY  2048 // chunks until a level that was too slow is measured again
+#define FLAC_ADAPT_MARGIN 1.25 // a level is only used again if it encoded this much faster than real time
+
+// chunks of the MISRC container compressed at once, half of the ringbuffer at most
+#define RFC_BATCH_MAX ((BUFFER_TOTAL_SIZE) / 2 / (RFC_CHUNK_SAMPLES * 2))
 
+/* output file that can be split into segments, the file of the next
+ * segment is opened ahead of time, so the cut does not stall the writer */
 typedef struct {
 	misrc_settings_t *set;
-	ringbuffer_t rb;
+	char *name;        // name given by the user, used for the first segment
 	FILE *f;
-	int idx;
-#if LIBSOXR_ENABLED == 1
+	FILE *f_next;
+	char *name_next;
+	unsigned int idx;  // number of the current segment
+	bool split;
+} segment_file_t;
+
+/* positions in the stream of a writer where new segments start, the main
+ * loop queues them at the same sample for all outputs */
+typedef struct {
+	uint64_t pos[SEGMENT_PENDING];
+	atomic_size_t wr;
+	atomic_size_t rd;
+	uint64_t done;     // bytes of the stream processed by the writer
+	// streams that are not written by the main loop are only processed up to the
+	// position the main loop has reached, all cuts before it are queued
+	atomic_uint_fast64_t end;
+	bool gated;
+} segment_queue_t;
+
+typedef struct {
+	misrc_settings_t *set;
+	ringbuffer_t rb;
+	segment_file_t out;
+	segment_queue_t seg;
+	writeback_t wb;
+	atomic_uint_fast64_t seg_bytes; // bytes written to the current segment
+	int idx;                        // OUT_RF_A ... OUT_AUX
+	const char *name;               // for messages
+	uint64_t expected_size; // bytes of the output if the capture length is known, 0 otherwise
+	// backpressure, only used by the main loop
+	uint64_t policy;
+	uint64_t queued;        // bytes passed to the writer
+	uint64_t dropped;       // capture samples not passed to the writer
+	uint64_t gaps;
+	uint64_t gap_start;     // capture sample where the current gap started, UINT64_MAX if there is none
+	unsigned int degrade_wait;
+	// MISRC container
+	int rfc_codec;
+	int rfc_level;
+	uint32_t rfc_threads;
+	rfc_stream_t rfc_stream;
+	// resampling with the built-in decimator or libsoxr
 	conv_16to32_t conv_func;
 	double init_scale;
 	double resample_rate;
 	uint32_t resample_qual;
 	float resample_gain;
 	bool reduce_8bit;
-#endif
 #if LIBFLAC_ENABLED == 1
 	uint32_t flac_level;
 	bool flac_verify;
 	uint32_t flac_threads;
 	uint8_t flac_bits;
+	// the level can be changed during the stream, the encoder is restarted between two frames
+	bool flac_relevel;
+	atomic_uint flac_level_req;  // level requested by the main loop
+	flac_stream_t flac_stream;   // header of the current file, written by the writer
+	uint8_t *flac_frame;
+	uint64_t flac_frames;        // frames of the current file before the current encoder
+	uint64_t flac_samples;       // samples passed to the current encoder
+	bool flac_adaptive;          // the writer chooses the level up to flac_level_max
+	uint32_t flac_level_max;
+	unsigned int flac_adapt_wait;
+	unsigned int flac_adapt_hold;
+	double flac_rate[FLAC_LEVELS];             // samples/s encoded at each level, 0 if unknown
+	uint64_t flac_level_samples[FLAC_LEVELS];  // samples encoded at each level
+	// built-in encoder, the stream is written like one with level changes
+	bool flac_builtin;
+	flac_fixed_t *flac_fixed;
+	uint8_t *flac_out;           // FLAC_BUILTIN_FRAMES frames
+	size_t *flac_out_len;
+	int32_t *flac_pending;       // samples of an incomplete frame
+	size_t flac_pending_len;
+	md5_ctx_t flac_md5;
+	flac_verify_t *flac_check;   // reads the files back during the capture, NULL if disabled
 #endif
 } filewriter_ctx_t;
 
 typedef struct {
 	misrc_settings_t *set;
 	ringbuffer_t *rb;
-	FILE *f_4ch;
-	FILE *f_2ch[2];
-	FILE *f_1ch[4];
+	segment_file_t out_4ch;
+	segment_file_t out_2ch[2];
+	segment_file_t out_1ch[4];
+	segment_queue_t seg;
+	atomic_uint_fast64_t seg_bytes;
+	writeback_t wb_4ch;
+	pipe_writer_t pw_4ch;   // the 4 channel file is written straight from the ringbuffer
+	bool uring_4ch;
+	writeback_t wb_2ch[2];
+	writeback_t wb_1ch[4];
 	uint64_t total_bytes;
 	bool non_4ch;
 } audiowriter_ctx_t;
 
 static int do_exit;
+static atomic_int cut_request;
+
+#if LIBFLAC_ENABLED == 1
+// measures the speed of the FLAC levels for --rf-flac-adaptive
+static uint64_t time_ns(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+#endif
+
 static hsdaoh_dev_t *hs_dev = NULL;
 static sc_handle_t *sc_dev = NULL;
 static conv_16to32_t conv_16to32 = NULL;
@@ -325,34 +443,201 @@ static void hsdaoh_callback(hsdaoh_data_info_t *data_info)
 	}
 }
 
+static int open_file(FILE **f, char *filename, misrc_settings_t *set)
+{
+	if (strcmp(filename, "-") == 0) { // Write to stdout
+		*f = stdout;
+		return 0;
+	}
+	if (access(filename, F_OK) == 0 && !set->overwrite_files) {
+		if (!set->overwrite_cb || !set->overwrite_cb(set->overwrite_cb_ctx, filename)) return MISRC_RET_USER_ABORT;
+	}
+	*f = fopen(filename, "wb");
+	if (!(*f)) {
+		set->msg_cb(set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Failed to open %s", filename);
+		return MISRC_RET_FILE_ERROR;
+	}
+	return 0;
+}
+
+// name of segment idx, the number is inserted before the extension: name_001.flac
+static char* segment_name(const char *name, unsigned int idx)
+{
+	const char *ext = strrchr(name, '.');
+	const char *sep = strrchr(name, '/');
+	size_t n = strlen(name) + 16;
+	char *s;
+#ifdef _WIN32
+	if (strrchr(name, '\\') && (!sep || strrchr(name, '\\') > sep)) sep = strrchr(name, '\\');
+#endif
+	if (!ext || ext == name || (sep && ext <= sep + 1)) ext = name + strlen(name);
+	if ((s = malloc(n)) == NULL) return NULL;
+	snprintf(s, n, "%.*s_%03u%s", (int)(ext - name), name, idx, ext);
+	return s;
+}
+
+// open the file of the next segment ahead of the cut
+static int seg_prepare_next(segment_file_t *sf)
+{
+	if (!sf->split || sf->f == stdout) return 0;
+	if ((sf->name_next = segment_name(sf->name, sf->idx + 1)) == NULL) return MISRC_RET_MEMORY_ERROR;
+	return open_file(&sf->f_next, sf->name_next, sf->set);
+}
+
+static int seg_open(segment_file_t *sf, char *filename, misrc_settings_t *set, bool split)
+{
+	int r;
+	memset(sf, 0, sizeof(*sf));
+	sf->set = set;
+	sf->name = filename;
+	sf->split = split;
+	if ((r = open_file(&sf->f, filename, set)) != 0) return r;
+	return seg_prepare_next(sf);
+}
+
+// continue with the next segment, the current file has to be closed already
+static int seg_switch(segment_file_t *sf)
+{
+	sf->f = sf->f_next;
+	sf->f_next = NULL;
+	free(sf->name_next);
+	sf->name_next = NULL;
+	sf->idx++;
+	return seg_prepare_next(sf);
+}
+
+// the file opened for a segment that was not started anymore is removed
+static void seg_close(segment_file_t *sf)
+{
+	if (sf->f_next) {
+		fclose(sf->f_next);
+		remove(sf->name_next);
+		sf->f_next = NULL;
+	}
+	free(sf->name_next);
+	sf->name_next = NULL;
+}
+
+static void seg_queue_cut(segment_queue_t *q, uint64_t pos)
+{
+	while(atomic_load(&q->wr) - atomic_load(&q->rd) == SEGMENT_PENDING && !do_exit) sleep_ms(1);
+	q->pos[atomic_load(&q->wr) % SEGMENT_PENDING] = pos;
+	atomic_fetch_add(&q->wr, 1);
+}
+
+static bool seg_queue_empty(segment_queue_t *q)
+{
+	return atomic_load(&q->wr) == atomic_load(&q->rd);
+}
+
+// bytes of the stream that belong to the current segment, at most len
+static size_t seg_limit(segment_queue_t *q, size_t len)
+{
+	uint64_t left;
+	if (q->gated) {
+		left = atomic_load(&q->end) - q->done;
+		if (left < len) len = left;
+	}
+	if (seg_queue_empty(q)) return len;
+	left = q->pos[atomic_load(&q->rd) % SEGMENT_PENDING] - q->done;
+	return (left < len) ? left : len;
+}
+
+// returns true once if the current segment ends here
+static bool seg_cut(segment_queue_t *q)
+{
+	if (seg_queue_empty(q) || q->pos[atomic_load(&q->rd) % SEGMENT_PENDING] != q->done) return false;
+	atomic_fetch_add(&q->rd, 1);
+	return true;
+}
+
+// write a placeholder header, the size is set by audio_wave_close()
+static void audio_wave_open(segment_file_t *out, writeback_t *wb, misrc_settings_t *set)
+{
+	wave_header_t h;
+	memset(&h,0,sizeof(wave_header_t));
+	if (out->f == NULL) return;
+	if (out->f != stdout) fwrite(&h, 1, sizeof(wave_header_t), out->f);
+	wb_init(wb, out->f, set->writeback << 20);
+}
+
+static void audio_wave_close(segment_file_t *out, uint64_t total_bytes, int channels)
+{
+	wave_header_t h;
+	if (out->f == NULL || out->f == stdout) return;
+	fseek(out->f, 0, SEEK_SET);
+	create_wave_header(&h, total_bytes/12, 78125, channels, 24);
+	fwrite(&h, 1, sizeof(wave_header_t), out->f);
+	fclose(out->f);
+}
+
+static void audio_file_open(audiowriter_ctx_t *audio_ctx)
+{
+	misrc_settings_t *set = audio_ctx->set;
+	audio_ctx->total_bytes = 0;
+	audio_wave_open(&audio_ctx->out_4ch, &audio_ctx->wb_4ch, set);
+	if (audio_ctx->out_4ch.f != NULL) {
+		// behind the header, the converted 1 and 2 channel files are not in the ringbuffer and stay with stdio
+		pw_init(&audio_ctx->pw_4ch, audio_ctx->out_4ch.f, true);
+		if (set->pipe_zerocopy && pw_use_vmsplice(&audio_ctx->pw_4ch) != 0 && set->msg_cb) {
+			set->msg_cb(set->msg_cb_ctx, MISRC_MSG_WARNING, "vmsplice is not used for %s, the output is not a pipe", audio_ctx->out_4ch.name);
+		}
+		audio_ctx->uring_4ch = false;
+#if LIBURING_ENABLED == 1
+		if (set->io_uring) {
+			audio_ctx->uring_4ch = (pw_use_uring(&audio_ctx->pw_4ch) == 0);
+			if (!audio_ctx->uring_4ch && set->msg_cb) set->msg_cb(set->msg_cb_ctx, MISRC_MSG_WARNING, "io_uring is not used for %s, the output is not a regular file", audio_ctx->out_4ch.name);
+		}
+#endif
+	}
+	for (int i=0; i<2; i++) audio_wave_open(&audio_ctx->out_2ch[i], &audio_ctx->wb_2ch[i], audio_ctx->set);
+	for (int i=0; i<4; i++) audio_wave_open(&audio_ctx->out_1ch[i], &audio_ctx->wb_1ch[i], audio_ctx->set);
+}
+
+static void audio_file_close(audiowriter_ctx_t *audio_ctx)
+{
+	misrc_settings_t *set = audio_ctx->set;
+	pipe_writer_t *pw = &audio_ctx->pw_4ch;
+	if (audio_ctx->out_4ch.f != NULL) {
+		// writes in flight reference the ringbuffer
+		if (pw_close(pw, audio_ctx->rb) != 0 && set->msg_cb) {
+			set->msg_cb(set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Error writing %s: %s", audio_ctx->out_4ch.name, strerror(errno));
+		}
+#if LIBURING_ENABLED == 1
+		if (audio_ctx->uring_4ch && pw->lat_cnt > 0 && set->msg_cb) {
+			set->msg_cb(set->msg_cb_ctx, MISRC_MSG_INFO, "%s: up to %u io_uring writes in flight, write latency %.2f ms average, %.2f ms maximum",
+				audio_ctx->out_4ch.name, pw->depth_max, pw->lat_sum / 1e6 / pw->lat_cnt, pw->lat_max / 1e6);
+		}
+#endif
+	}
+	audio_wave_close(&audio_ctx->out_4ch, audio_ctx->total_bytes, 4);
+	for (int i=0; i<2; i++) audio_wave_close(&audio_ctx->out_2ch[i], audio_ctx->total_bytes, 2);
+	for (int i=0; i<4; i++) audio_wave_close(&audio_ctx->out_1ch[i], audio_ctx->total_bytes, 1);
+}
+
+// the ringbuffer behind the data the 4 channel file still references
+static void* audio_read_ptr(audiowriter_ctx_t *audio_ctx, size_t len)
+{
+	if (audio_ctx->out_4ch.f != NULL) return pw_read_ptr(&audio_ctx->pw_4ch, audio_ctx->rb, len);
+	return rb_read_ptr(audio_ctx->rb, len);
+}
+
 static int audio_file_writer(void *ctx)
 {
 	audiowriter_ctx_t *audio_ctx = ctx;
-	size_t len = BUFFER_AUDIO_READ_SIZE;
+	size_t len;
 	void *buf;
-	wave_header_t h;
 	bool convert_1ch = false;
 	bool convert_2ch = false;
 	uint8_t* buffer_1ch[4];
 	uint8_t* buffer_2ch[2];
+	int r = 0;
 #if defined(__linux__) && defined(_GNU_SOURCE)
 	pthread_setname_np(pthread_self(), "out_audio");
 #endif
-	memset(&h,0,sizeof(wave_header_t));
-	audio_ctx->total_bytes = 0;
-	if (audio_ctx->f_4ch != NULL && audio_ctx->f_4ch != stdout) fwrite(&h, 1, sizeof(wave_header_t), audio_ctx->f_4ch);
-	for (int i=0; i<2; i++) {
-		if (audio_ctx->f_2ch[i] != NULL) {
-			if (audio_ctx->f_2ch[i] != stdout) fwrite(&h, 1, sizeof(wave_header_t), audio_ctx->f_2ch[i]);
-			convert_2ch = true;
-		}
-	}
-	for (int i=0; i<4; i++) {
-		if (audio_ctx->f_1ch[i] != NULL) {
-			if (audio_ctx->f_1ch[i] != stdout) fwrite(&h, 1, sizeof(wave_header_t), audio_ctx->f_1ch[i]);
-			convert_1ch = true;
-		}
-	}
+	for (int i=0; i<2; i++) if (audio_ctx->out_2ch[i].f != NULL) convert_2ch = true;
+	for (int i=0; i<4; i++) if (audio_ctx->out_1ch[i].f != NULL) convert_1ch = true;
+	audio_file_open(audio_ctx);
 	if (convert_1ch) {
 		if ((buffer_1ch[0] = aligned_alloc(32, BUFFER_AUDIO_READ_SIZE)) == NULL) {
 			do_exit = 1;
@@ -368,146 +653,594 @@ static int audio_file_writer(void *ctx)
 		buffer_2ch[1] = buffer_2ch[0] + (BUFFER_AUDIO_READ_SIZE/2);
 	}
 	while(true) {
-		while(((buf = rb_read_ptr(audio_ctx->rb, len)) == NULL) && !do_exit) {
+		len = BUFFER_AUDIO_READ_SIZE;
+		while(((buf = audio_read_ptr(audio_ctx, len)) == NULL) && !do_exit) {
 			thrd_sleep(&(struct timespec){.tv_nsec=10000000}, NULL);
 		}
 		if (do_exit) {
-			len = audio_ctx->rb->tail - audio_ctx->rb->head;
+			len = (audio_ctx->out_4ch.f != NULL) ? pw_available(&audio_ctx->pw_4ch, audio_ctx->rb) : audio_ctx->rb->tail - audio_ctx->rb->head;
 			if (len == 0) break;
-			buf = rb_read_ptr(audio_ctx->rb, len);
+			buf = audio_read_ptr(audio_ctx, len);
+		}
+		// cuts are queued before the data behind them, all files are split at the same sample, stdout is not split
+		if (seg_cut(&audio_ctx->seg) && r == 0) {
+			audio_file_close(audio_ctx);
+			if (audio_ctx->out_4ch.f_next) r |= seg_switch(&audio_ctx->out_4ch);
+			for (int i=0; i<2; i++) if (audio_ctx->out_2ch[i].f_next) r |= seg_switch(&audio_ctx->out_2ch[i]);
+			for (int i=0; i<4; i++) if (audio_ctx->out_1ch[i].f_next) r |= seg_switch(&audio_ctx->out_1ch[i]);
+			audio_file_open(audio_ctx);
+			atomic_store(&audio_ctx->seg_bytes, 0);
+			if (r != 0) do_exit = 1;
+		}
+		len = seg_limit(&audio_ctx->seg, len);
+		if (len == 0) {
+			// the main loop has not reached this audio yet
+			thrd_sleep(&(struct timespec){.tv_nsec=1000000}, NULL);
+			continue;
 		}
-		if (audio_ctx->f_4ch != NULL) fwrite(buf, 1, len, audio_ctx->f_4ch);
 		if (convert_1ch) extract_audio_1ch_C(buf, len, buffer_1ch[0], buffer_1ch[1], buffer_1ch[2], buffer_1ch[3]);
 		if (convert_2ch) extract_audio_2ch_C(buf, len, (uint16_t*)buffer_2ch[0], (uint16_t*)buffer_2ch[1]);
-		rb_read_finished(audio_ctx->rb, len);
-		for (int i=0; i<2; i++) if (audio_ctx->f_2ch[i] != NULL) fwrite(buffer_2ch[i], 1, len/2, audio_ctx->f_2ch[i]);
-		for (int i=0; i<4; i++) if (audio_ctx->f_1ch[i] != NULL) fwrite(buffer_1ch[i], 1, len/4, audio_ctx->f_1ch[i]);
+		// the 4 channel file releases the data once it is written
+		if (audio_ctx->out_4ch.f != NULL) {
+			if (pw_write(&audio_ctx->pw_4ch, audio_ctx->rb, buf, len, len) != 0) {
+				if (audio_ctx->set->msg_cb) audio_ctx->set->msg_cb(audio_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Error writing %s: %s", audio_ctx->out_4ch.name, strerror(errno));
+				do_exit = 1;
+				break;
+			}
+			wb_written(&audio_ctx->wb_4ch, len);
+		}
+		else rb_read_finished(audio_ctx->rb, len);
+		for (int i=0; i<2; i++) if (audio_ctx->out_2ch[i].f != NULL) {
+			fwrite(buffer_2ch[i], 1, len/2, audio_ctx->out_2ch[i].f);
+			wb_written(&audio_ctx->wb_2ch[i], len/2);
+		}
+		for (int i=0; i<4; i++) if (audio_ctx->out_1ch[i].f != NULL) {
+			fwrite(buffer_1ch[i], 1, len/4, audio_ctx->out_1ch[i].f);
+			wb_written(&audio_ctx->wb_1ch[i], len/4);
+		}
+		audio_ctx->seg.done += len;
 		audio_ctx->total_bytes += len;
+		atomic_store(&audio_ctx->seg_bytes, audio_ctx->total_bytes);
+	}
+	audio_file_close(audio_ctx);
+	seg_close(&audio_ctx->out_4ch);
+	for (int i=0; i<2; i++) seg_close(&audio_ctx->out_2ch[i]);
+	for (int i=0; i<4; i++) seg_close(&audio_ctx->out_1ch[i]);
+	if (convert_1ch) aligned_free(buffer_1ch[0]);
+	if (convert_2ch) aligned_free(buffer_2ch[0]);
+	return 0;
+}
+
+// prepare writing the current RF file, returns true if io_uring is used
+static bool raw_file_open(filewriter_ctx_t *file_ctx, pipe_writer_t *pw)
+{
+	bool uring = false;
+	// resampled data is not in the ringbuffer and has to be copied to pipes
+	pw_init(pw, file_ctx->out.f, file_ctx->resample_rate==0);
+	if (file_ctx->set->pipe_zerocopy && (file_ctx->resample_rate!=0 || pw_use_vmsplice(pw) != 0) && file_ctx->set->msg_cb) {
+		file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_WARNING, "vmsplice is not used for %s, the output is not a pipe or resampled", file_ctx->name);
 	}
-	if (audio_ctx->f_4ch != NULL && audio_ctx->f_4ch != stdout) {
-		fseek(audio_ctx->f_4ch, 0, SEEK_SET);
-		create_wave_header(&h, audio_ctx->total_bytes/12, 78125, 4, 24);
-		fwrite(&h, 1, sizeof(wave_header_t), audio_ctx->f_4ch);
-		fclose(audio_ctx->f_4ch);
+	if (file_ctx->set->direct_write && pw_use_direct(pw, file_ctx->expected_size) != 0 && file_ctx->set->msg_cb) {
+		file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_WARNING, "Direct I/O is not used for %s, the output is not a regular file, resampled or not supported", file_ctx->name);
 	}
-	for (int i=0; i<2; i++) {
-		if (audio_ctx->f_2ch[i] != NULL && audio_ctx->f_2ch[i] != stdout) {
-			fseek(audio_ctx->f_2ch[i], 0, SEEK_SET);
-			create_wave_header(&h, audio_ctx->total_bytes/12, 78125, 2, 24);
-			fwrite(&h, 1, sizeof(wave_header_t), audio_ctx->f_2ch[i]);
-			fclose(audio_ctx->f_2ch[i]);
-		}
+#if LIBURING_ENABLED == 1
+	if (file_ctx->set->io_uring) {
+		uring = (pw_use_uring(pw) == 0);
+		if (!uring && file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_WARNING, "io_uring is not used for %s, the output is not a regular file or resampled", file_ctx->name);
+	}
+#endif
+	// direct I/O does not use the page cache anyway
+	wb_init(&file_ctx->wb, file_ctx->out.f, pw->direct ? 0 : file_ctx->set->writeback << 20);
+	atomic_store(&file_ctx->seg_bytes, 0);
+	return uring;
+}
+
+static void raw_file_close(filewriter_ctx_t *file_ctx, pipe_writer_t *pw, bool uring)
+{
+	// writes in flight reference the ringbuffer
+	if (pw_close(pw, &file_ctx->rb) != 0 && file_ctx->set->msg_cb) {
+		file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Error writing %s: %s", file_ctx->name, strerror(errno));
+	}
+#if LIBURING_ENABLED == 1
+	if (uring && pw->lat_cnt > 0 && file_ctx->set->msg_cb) {
+		file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_INFO, "%s: up to %u io_uring writes in flight, write latency %.2f ms average, %.2f ms maximum",
+			file_ctx->name, pw->depth_max, pw->lat_sum / 1e6 / pw->lat_cnt, pw->lat_max / 1e6);
+	}
+#else
+	(void)uring;
+#endif
+	if (file_ctx->out.f != stdout) fclose(file_ctx->out.f);
+}
+
+typedef struct {
+	rfd_t *decimator;
+#if LIBSOXR_ENABLED == 1
+	soxr_t soxr;
+#endif
+	uint8_t *buf;           // resampled 16 bit samples
+	uint8_t *buf_b;         // converted to 8 or 32 bit
+} resampler_t;
+
+/* resample 16 bit samples, or 32 bit samples for FLAC, to 16 bit with the built-in decimator if it
+   supports the sample rate, otherwise with libsoxr, returns 0 on success */
+static int resampler_init(filewriter_ctx_t *file_ctx, resampler_t *rs, bool s32)
+{
+	double gain = file_ctx->init_scale * pow(10.0, file_ctx->resample_gain/20.0);
+	memset(rs, 0, sizeof(resampler_t));
+	// the decimator may return a few samples more than the input ratio
+	rs->buf = aligned_alloc(32, BUFFER_READ_SIZE + 64);
+	rs->buf_b = aligned_alloc(32, BUFFER_READ_SIZE + 64);
+	if (!rs->buf || !rs->buf_b) {
+		if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Failed allocating resampling buffer");
+		return -1;
 	}
-	for (int i=0; i<4; i++) {
-		if (audio_ctx->f_1ch[i] != NULL && audio_ctx->f_1ch[i] != stdout) {
-			fseek(audio_ctx->f_1ch[i], 0, SEEK_SET);
-			create_wave_header(&h, audio_ctx->total_bytes/12, 78125, 1, 24);
-			fwrite(&h, 1, sizeof(wave_header_t), audio_ctx->f_1ch[i]);
-			fclose(audio_ctx->f_1ch[i]);
+#if LIBSOXR_ENABLED == 1
+	if (file_ctx->set->resample_soxr || !rfd_supported(40000.0, file_ctx->resample_rate)) {
+		soxr_error_t soxr_err;
+		soxr_io_spec_t io_spec = soxr_io_spec(s32 ? SOXR_INT32_S : SOXR_INT16_S, SOXR_INT16_S);
+		soxr_quality_spec_t qual_spec = soxr_quality_spec(resample_qual_list[file_ctx->resample_qual], 0);
+		io_spec.scale = gain;
+		rs->soxr = soxr_create(40000.0, file_ctx->resample_rate, 1, &soxr_err, &io_spec, &qual_spec, NULL);
+		if (!rs->soxr || soxr_err!=0) {
+			if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Failed allocating resampling context: %s", soxr_err);
+			return -1;
 		}
+		return 0;
+	}
+#endif
+	// the 32 bit samples of FLAC are in the same range as the 16 bit ones, libsoxr scales them by 2^-16
+	if (s32) gain /= 65536.0;
+	rs->decimator = malloc(sizeof(rfd_t));
+	if (!rs->decimator || rfd_init(rs->decimator, 40000.0, file_ctx->resample_rate, file_ctx->resample_qual, gain, 12, file_ctx->set->pad) != 0) {
+		free(rs->decimator);
+		rs->decimator = NULL;
+		if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Failed allocating resampling context");
+		return -1;
 	}
-	if (convert_1ch) aligned_free(buffer_1ch[0]);
-	if (convert_2ch) aligned_free(buffer_2ch[0]);
 	return 0;
 }
 
+/* resample n samples into rs->buf, done is set to the number of samples used,
+   returns NULL on success or the error message */
+static const char *resample(resampler_t *rs, void *buf, size_t n, bool s32, size_t *done, size_t *out_n)
+{
+#if LIBSOXR_ENABLED == 1
+	if (rs->soxr) return soxr_process(rs->soxr, &buf, n, done, &rs->buf, n, out_n);
+#endif
+	*out_n = s32 ? rfd_process_s32(rs->decimator, buf, n, (int16_t*)rs->buf) : rfd_process(rs->decimator, buf, n, (int16_t*)rs->buf);
+	*done = n;
+	return NULL;
+}
+
+static void resampler_free(resampler_t *rs)
+{
+	aligned_free(rs->buf);
+	aligned_free(rs->buf_b);
+#if LIBSOXR_ENABLED == 1
+	if (rs->soxr) soxr_delete(rs->soxr);
+#endif
+	if (rs->decimator) {
+		rfd_free(rs->decimator);
+		free(rs->decimator);
+	}
+}
 
 static int raw_file_writer(void *ctx)
 {
-	const char rfidx[] = { 'A', 'B' };
 	filewriter_ctx_t *file_ctx = ctx;
-	size_t len = BUFFER_READ_SIZE;
+	size_t len;
 	void *buf;
+	pipe_writer_t pw;
+	size_t out_len;
+	int r;
+	bool uring;
 #if defined(__linux__) && defined(_GNU_SOURCE)
-	char thread_name[] = "out_RAW_RF_X";
-	thread_name[11] = rfidx[file_ctx->idx];
+	char thread_name[16];
+	if (file_ctx->idx < 2) snprintf(thread_name, sizeof(thread_name), "out_RAW_RF_%c", 'A' + file_ctx->idx);
+	else snprintf(thread_name, sizeof(thread_name), "out_%s", file_ctx->name);
 	pthread_setname_np(pthread_self(), thread_name);
 #endif
-#if LIBSOXR_ENABLED == 1
 	/* setup resampling */
-	uint8_t *resample_buffer;
-	uint8_t *resample_buffer_b;
-	soxr_t resampler = NULL;
-	soxr_error_t soxr_err;
-	if (file_ctx->resample_rate!=0.0) {
-		soxr_io_spec_t io_spec = soxr_io_spec(SOXR_INT16_S, SOXR_INT16_S);
-		soxr_quality_spec_t qual_spec = soxr_quality_spec(file_ctx->resample_qual, 0);
-		io_spec.scale = file_ctx->init_scale;
-		io_spec.scale *= pow(10.0,file_ctx->resample_gain/20.0);
-		resample_buffer = aligned_alloc(32, BUFFER_READ_SIZE);
-		resample_buffer_b = aligned_alloc(32, BUFFER_READ_SIZE);
-		if (!resample_buffer || !resample_buffer_b) {
-			if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Failed allocating resampling buffer");
-			do_exit = 1;
-			return 0;
-		}
-		resampler = soxr_create(40000.0, file_ctx->resample_rate, 1, &soxr_err, &io_spec, &qual_spec, NULL);
-		if (!resampler || soxr_err!=0) {
-			if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Failed allocating resampling context: %s", soxr_err);
-			do_exit = 1;
-			return 0;
-		}
+	resampler_t resampler;
+	const char *resample_err;
+	if (file_ctx->resample_rate!=0.0 && resampler_init(file_ctx, &resampler, false) != 0) {
+		do_exit = 1;
+		return 0;
 	}
-#endif
+	uring = raw_file_open(file_ctx, &pw);
 	while(true) {
-		while(((buf = rb_read_ptr(&file_ctx->rb, len)) == NULL) && !do_exit) {
+		len = BUFFER_READ_SIZE;
+		while(((buf = pw_read_ptr(&pw, &file_ctx->rb, len)) == NULL) && !do_exit) {
 			//ms_sleep(10);
 			thrd_sleep(&(struct timespec){.tv_nsec=10000000}, NULL);
 		}
 		if (do_exit) {
-			len = file_ctx->rb.tail - file_ctx->rb.head;
+			len = pw_available(&pw, &file_ctx->rb);
 			if (len == 0) break;
-			buf = rb_read_ptr(&file_ctx->rb, len);
+			buf = pw_read_ptr(&pw, &file_ctx->rb, len);
+		}
+		// cuts are queued before the data behind them, the resampler continues across the cut, stdout is not split
+		if (seg_cut(&file_ctx->seg) && file_ctx->out.f_next != NULL) {
+			raw_file_close(file_ctx, &pw, uring);
+			if (seg_switch(&file_ctx->out) != 0) do_exit = 1;
+			uring = raw_file_open(file_ctx, &pw);
+			continue;
+		}
+		len = seg_limit(&file_ctx->seg, len);
+		if (file_ctx->resample_rate!=0) {
+			resample_err = resample(&resampler, buf, len>>1, false, &len, &out_len);
+			len<<=1;
+			if (resample_err != NULL) {
+				if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Error while resampling: %s", resample_err);
+				do_exit = 1;
+				return 0;
+			}
+			if (file_ctx->reduce_8bit) {
+				conv_16to8((int16_t*)resampler.buf, (int8_t*)resampler.buf_b, out_len);
+				r = pw_write(&pw, &file_ctx->rb, resampler.buf_b, out_len, len);
+			}
+			else {
+				out_len <<= 1;
+				r = pw_write(&pw, &file_ctx->rb, resampler.buf, out_len, len);
+			}
+		} else {
+			out_len = len;
+			r = pw_write(&pw, &file_ctx->rb, buf, len, len);
+		}
+		if (r != 0) {
+			if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Error writing %s: %s", file_ctx->name, strerror(errno));
+			do_exit = 1;
+			break;
+		}
+		file_ctx->seg.done += len;
+		wb_written(&file_ctx->wb, out_len);
+		atomic_fetch_add(&file_ctx->seg_bytes, out_len);
+	}
+	raw_file_close(file_ctx, &pw, uring);
+	seg_close(&file_ctx->out);
+	if (file_ctx->resample_rate!=0) resampler_free(&resampler);
+	return 0;
+}
+
+#if LIBFLAC_ENABLED == 1
+static void flac_progress_cb(const FLAC__StreamEncoder *UNUSED(encoder), FLAC__uint64 bytes_written, FLAC__uint64 UNUSED(samples_written), uint32_t UNUSED(frames_written), uint32_t UNUSED(total_frames_estimate), void *client_data)
+{
+	filewriter_ctx_t *file_ctx = client_data;
+	wb_position(&file_ctx->wb, bytes_written);
+	atomic_store(&file_ctx->seg_bytes, bytes_written);
+}
+
+// append frame number frame to a file with a header written by flac_file_open()
+static int flac_frame_write(filewriter_ctx_t *file_ctx, const uint8_t *out, size_t len, uint32_t samples, uint64_t frame)
+{
+	flac_stream_t *s = &file_ctx->flac_stream;
+	uint64_t sample = frame * FLAC_STITCH_BLOCKSIZE;
+	if (fwrite(out, 1, len, file_ctx->out.f) != len) return -1;
+	if (sample % s->seek_spacing == 0 && sample / s->seek_spacing < s->seek_points) {
+		s->seek[sample / s->seek_spacing] = (flac_seekpoint_t){ sample, s->stream_len, samples };
+	}
+	if (len < s->min_framesize || s->min_framesize == 0) s->min_framesize = len;
+	if (len > s->max_framesize) s->max_framesize = len;
+	s->stream_len += len;
+	s->total_samples = sample + samples;
+	wb_written(&file_ctx->wb, len);
+	atomic_store(&file_ctx->seg_bytes, flac_header_size(s) + s->stream_len);
+	return 0;
+}
+
+// frames of a stream with level changes, the frames of every encoder are renumbered to their position in the file
+static FLAC__StreamEncoderWriteStatus flac_write_cb(const FLAC__StreamEncoder *UNUSED(encoder), const FLAC__byte buffer[], size_t bytes, uint32_t samples, uint32_t current_frame, void *client_data)
+{
+	filewriter_ctx_t *file_ctx = client_data;
+	uint64_t frame = file_ctx->flac_frames + current_frame;
+	const uint8_t *out = buffer;
+	size_t len = bytes;
+	// the metadata of the encoders is dropped, the header is written by flac_file_open() and flac_file_close()
+	if (samples == 0) return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+	if (file_ctx->flac_frames != 0) {
+		if (bytes + 6 > FLAC_FRAME_MAX || (len = flac_frame_renumber(buffer, bytes, frame, file_ctx->flac_frame)) == 0) return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+		out = file_ctx->flac_frame;
+	}
+	if (flac_frame_write(file_ctx, out, len, samples, frame) != 0) return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+	return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+}
+
+// MD5 of the samples as little endian integers of (bits + 7) / 8 bytes, like libFLAC
+static void flac_builtin_md5(filewriter_ctx_t *file_ctx, const int32_t *buf, size_t n)
+{
+	uint8_t tmp[2 * FLAC_STITCH_BLOCKSIZE];
+	size_t part, bytes = (file_ctx->flac_bits + 7) / 8;
+	while (n > 0) {
+		part = (n < FLAC_STITCH_BLOCKSIZE) ? n : FLAC_STITCH_BLOCKSIZE;
+		if (bytes == 1) {
+			for(size_t i = 0; i < part; i++) tmp[i] = (uint8_t)buf[i];
+		}
+		else {
+			for(size_t i = 0; i < part; i++) {
+				tmp[2*i] = (uint8_t)buf[i];
+				tmp[2*i+1] = (uint8_t)(buf[i] >> 8);
+			}
+		}
+		md5_update(&file_ctx->flac_md5, tmp, part * bytes);
+		buf += part;
+		n -= part;
+	}
+}
+
+// encode complete frames (or the last frame of the stream) with the built-in encoder
+static int flac_builtin_frames(filewriter_ctx_t *file_ctx, const int32_t *buf, size_t n)
+{
+	uint64_t first = file_ctx->flac_samples / FLAC_STITCH_BLOCKSIZE;
+	size_t frames = flac_fixed_encode(file_ctx->flac_fixed, buf, n, first, file_ctx->flac_out, file_ctx->flac_out_len);
+	for(size_t i = 0; i < frames; i++) {
+		uint32_t samples = (n - i * FLAC_STITCH_BLOCKSIZE < FLAC_STITCH_BLOCKSIZE) ? n - i * FLAC_STITCH_BLOCKSIZE : FLAC_STITCH_BLOCKSIZE;
+		if (flac_frame_write(file_ctx, &file_ctx->flac_out[i * FLAC_FIXED_FRAME_MAX(file_ctx->flac_bits)], file_ctx->flac_out_len[i], samples, first + i) != 0) return -1;
+	}
+	file_ctx->flac_samples += n;
+	return 0;
+}
+
+// encode n samples with the built-in encoder, an incomplete frame is kept until more samples arrive
+static FLAC__bool flac_builtin_process(filewriter_ctx_t *file_ctx, const int32_t *buf, size_t n)
+{
+	size_t part;
+	flac_builtin_md5(file_ctx, buf, n);
+	if (file_ctx->flac_pending_len > 0) {
+		part = FLAC_STITCH_BLOCKSIZE - file_ctx->flac_pending_len;
+		if (part > n) part = n;
+		memcpy(&file_ctx->flac_pending[file_ctx->flac_pending_len], buf, part * sizeof(int32_t));
+		file_ctx->flac_pending_len += part;
+		buf += part;
+		n -= part;
+		if (file_ctx->flac_pending_len < FLAC_STITCH_BLOCKSIZE) return true;
+		if (flac_builtin_frames(file_ctx, file_ctx->flac_pending, FLAC_STITCH_BLOCKSIZE) != 0) return false;
+		file_ctx->flac_pending_len = 0;
+	}
+	while (n >= FLAC_STITCH_BLOCKSIZE) {
+		part = n - n % FLAC_STITCH_BLOCKSIZE;
+		if (part > FLAC_BUILTIN_FRAMES * FLAC_STITCH_BLOCKSIZE) part = FLAC_BUILTIN_FRAMES * FLAC_STITCH_BLOCKSIZE;
+		if (flac_builtin_frames(file_ctx, buf, part) != 0) return false;
+		buf += part;
+		n -= part;
+	}
+	memcpy(file_ctx->flac_pending, buf, n * sizeof(int32_t));
+	file_ctx->flac_pending_len = n;
+	return true;
+}
+
+// set up the encoder for the current file at the current level, the encoder is reset to its defaults by finishing the previous stream
+static int flac_encoder_init(filewriter_ctx_t *file_ctx, FLAC__StreamEncoder *encoder, uint32_t srate, FLAC__StreamMetadata **seektable)
+{
+	FLAC__bool ok = true;
+	FLAC__StreamEncoderInitStatus init_status;
+#if defined(FLAC_API_VERSION_CURRENT) && FLAC_API_VERSION_CURRENT >= 14
+	uint32_t ret;
+#endif
+
+	ok &= FLAC__stream_encoder_set_verify(encoder, file_ctx->flac_verify);
+	ok &= FLAC__stream_encoder_set_compression_level(encoder, file_ctx->flac_level);
+	ok &= FLAC__stream_encoder_set_channels(encoder, 1);
+	ok &= FLAC__stream_encoder_set_bits_per_sample(encoder, file_ctx->flac_bits);
+	ok &= FLAC__stream_encoder_set_sample_rate(encoder, srate);
+	ok &= FLAC__stream_encoder_set_total_samples_estimate(encoder, 0);
+	if (file_ctx->flac_relevel) {
+		// all levels have to use the same blocksize, the MD5 sum would only cover one encoder
+		ok &= FLAC__stream_encoder_set_blocksize(encoder, FLAC_STITCH_BLOCKSIZE);
+		ok &= FLAC__stream_encoder_set_do_md5(encoder, false);
+	}
+
+	if(!ok) {
+		if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Failed initializing FLAC encoder");
+		return -1;
+	}
+#if defined(FLAC_API_VERSION_CURRENT) && FLAC_API_VERSION_CURRENT >= 14
+	ret = FLAC__stream_encoder_set_num_threads(encoder, file_ctx->flac_threads);
+	if (ret != FLAC__STREAM_ENCODER_SET_NUM_THREADS_OK) {
+		if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Failed to set FLAC threads: %s", _FLAC_StreamEncoderSetNumThreadsStatusString[ret]);
+	}
+#endif
+	if (file_ctx->flac_relevel) {
+		init_status = FLAC__stream_encoder_init_stream(encoder, flac_write_cb, NULL, NULL, NULL, file_ctx);
+	}
+	else {
+		if((*seektable = FLAC__metadata_object_new(FLAC__METADATA_TYPE_SEEKTABLE)) == NULL
+			|| FLAC__metadata_object_seektable_template_append_spaced_points(*seektable, 1<<18, (uint64_t)1<<41) != true
+			|| FLAC__stream_encoder_set_metadata(encoder, seektable, 1) != true) {
+			if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Could not create FLAC seektable");
+			return -1;
+		}
+		// the encoder reports the bytes it has written after every frame
+		init_status = FLAC__stream_encoder_init_FILE(encoder, file_ctx->out.f, flac_progress_cb, file_ctx);
+	}
+	if(init_status != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
+		if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Failed initializing FLAC encoder: %s", FLAC__StreamEncoderInitStatusString[init_status]);
+		return -1;
+	}
+	return 0;
+}
+
+// pass the file of the current segment to the verifier, pipes and stdout cannot be read back
+static void flac_check_file(filewriter_ctx_t *file_ctx)
+{
+	char *name = NULL;
+#ifndef _WIN32
+	struct stat st;
+	if (fstat(fileno(file_ctx->out.f), &st) != 0 || !S_ISREG(st.st_mode)) {
+#else
+	if (file_ctx->out.f == stdout) {
+#endif
+		if(file_ctx->set->msg_cb && file_ctx->out.idx == 0) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_WARNING, "(%s) FLAC output is not a regular file and is not verified", file_ctx->name);
+		flac_verify_file(file_ctx->flac_check, NULL);
+		return;
+	}
+	if (file_ctx->out.idx > 0) name = segment_name(file_ctx->out.name, file_ctx->out.idx);
+	flac_verify_file(file_ctx->flac_check, (name) ? name : file_ctx->out.name);
+	free(name);
+}
+
+// start a FLAC stream in the current file
+static int flac_file_open(filewriter_ctx_t *file_ctx, FLAC__StreamEncoder *encoder, uint32_t srate, FLAC__StreamMetadata **seektable)
+{
+	wb_init(&file_ctx->wb, file_ctx->out.f, file_ctx->set->writeback << 20);
+	atomic_store(&file_ctx->seg_bytes, 0);
+	if (file_ctx->flac_check) flac_check_file(file_ctx);
+	if (file_ctx->flac_relevel || file_ctx->flac_builtin) {
+		// the header is written without the length and rewritten when the file is closed
+		flac_stream_t *s = &file_ctx->flac_stream;
+		uint64_t total = (uint64_t)1<<41;
+		uint8_t *header;
+		if (file_ctx->set->total_samples_before_exit != 0) total = (uint64_t)((double)file_ctx->set->total_samples_before_exit * srate / 40000.0) + FLAC_STITCH_BLOCKSIZE;
+		if (flac_stream_init(s, srate, file_ctx->flac_bits, total) != 0 || (header = malloc(flac_header_size(s))) == NULL) {
+			if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Could not create FLAC seektable");
+			return -1;
+		}
+		flac_write_header(s, header);
+		if (fwrite(header, 1, flac_header_size(s), file_ctx->out.f) != flac_header_size(s)) {
+			if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "(%s) Could not write FLAC header: %s", file_ctx->name, strerror(errno));
+			free(header);
+			return -1;
+		}
+		free(header);
+		wb_written(&file_ctx->wb, flac_header_size(s));
+		file_ctx->flac_frames = 0;
+		file_ctx->flac_samples = 0;
+	}
+	if (file_ctx->flac_builtin) {
+		md5_init(&file_ctx->flac_md5);
+		file_ctx->flac_pending_len = 0;
+		return 0;
+	}
+	return flac_encoder_init(file_ctx, encoder, srate, seektable);
+}
+
+// finish the FLAC stream, this also closes the file
+static int flac_file_close(filewriter_ctx_t *file_ctx, FLAC__StreamEncoder *encoder, FLAC__StreamMetadata *seektable)
+{
+	int r = 0;
+	if (file_ctx->flac_relevel || file_ctx->flac_builtin) {
+		flac_stream_t *s = &file_ctx->flac_stream;
+		uint8_t *header;
+		if (file_ctx->flac_builtin) {
+			// the last frame may be shorter
+			if (file_ctx->flac_pending_len > 0 && flac_builtin_frames(file_ctx, file_ctx->flac_pending, file_ctx->flac_pending_len) != 0) {
+				if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "(%s) Could not write FLAC frame: %s", file_ctx->name, strerror(errno));
+				r = -1;
+			}
+			md5_final(&file_ctx->flac_md5, s->md5);
+		}
+		else if(!FLAC__stream_encoder_finish(encoder)) {
+			if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "(%s) FLAC encoder did not finish correctly: %s", file_ctx->name, FLAC__StreamEncoderStateString[FLAC__stream_encoder_get_state(encoder)]);
+			r = -1;
+		}
+		// pipes keep the header without length, seekpoints and frame sizes
+		if ((header = malloc(flac_header_size(s))) != NULL) {
+			flac_write_header(s, header);
+			if (file_ctx->out.f != stdout && fseek(file_ctx->out.f, 0, SEEK_SET) == 0) fwrite(header, 1, flac_header_size(s), file_ctx->out.f);
+			free(header);
+		}
+		flac_stream_free(s);
+		if (file_ctx->out.f != stdout) fclose(file_ctx->out.f);
+		if (file_ctx->flac_check) flac_verify_file_end(file_ctx->flac_check);
+		return r;
+	}
+	FLAC__metadata_object_seektable_template_sort(seektable, false);
+	/* bug in libflac < 1.5, fix seektable manually */
+#if !defined(FLAC_API_VERSION_CURRENT) || FLAC_API_VERSION_CURRENT < 14
+	for(int i = seektable->data.seek_table.num_points-1; i>=0; i--) {
+		if (seektable->data.seek_table.points[i].stream_offset != 0) break;
+		seektable->data.seek_table.points[i].sample_number = 0xFFFFFFFFFFFFFFFF;
+	}
+#endif
+	// the encoder closes the file even if it fails
+	if(!FLAC__stream_encoder_finish(encoder)) {
+		if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "(%s) FLAC encoder did not finish correctly: %s", file_ctx->name, FLAC__StreamEncoderStateString[FLAC__stream_encoder_get_state(encoder)]);
+		r = -1;
+	}
+	if (file_ctx->flac_check) flac_verify_file_end(file_ctx->flac_check);
+	FLAC__metadata_object_delete(seektable);
+	return r;
+}
+
+// choose the level for the next chunk from the ringbuffer fill and the speed of the levels
+static void flac_adapt(filewriter_ctx_t *file_ctx, size_t samples, uint64_t ns, uint32_t srate)
+{
+	size_t fill = file_ctx->rb.tail - file_ctx->rb.head;
+	size_t size = file_ctx->rb.buffer_size;
+	uint32_t level = atomic_load(&file_ctx->flac_level_req);
+	double *rate = &file_ctx->flac_rate[file_ctx->flac_level];
+	double needed = srate * 1000.0 * FLAC_ADAPT_MARGIN;
+	uint32_t next;
+	if (ns > 0) *rate = (*rate == 0.0) ? samples * 1e9 / ns : 0.9 * *rate + 0.1 * (samples * 1e9 / ns);
+	if (file_ctx->flac_adapt_wait > 0) {
+		file_ctx->flac_adapt_wait--;
+		return;
+	}
+	if (fill > size - size / 4 && level > 0) {
+		next = level - 1;
+	}
+	else if (fill < size / 4 && level < file_ctx->flac_level_max) {
+		// a level that was too slow is only tried again after a while, the load may have changed
+		if (file_ctx->flac_rate[level + 1] != 0.0 && file_ctx->flac_rate[level + 1] < needed) {
+			if (++file_ctx->flac_adapt_hold < FLAC_ADAPT_RETRY) return;
+			file_ctx->flac_rate[level + 1] = 0.0;
 		}
-#if LIBSOXR_ENABLED == 1
-		if (file_ctx->resample_rate!=0) {
-			size_t out_len;
-			soxr_err = soxr_process(resampler, &buf, len>>1, &len, &resample_buffer, len>>1, &out_len);
-			len<<=1;
-			if (soxr_err != 0) {
-				if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Error while resampling: %s", soxr_err);
-				do_exit = 1;
-				return 0;
-			}
-			if (file_ctx->reduce_8bit) {
-				conv_16to8((int16_t*)resample_buffer, (int8_t*)resample_buffer_b, out_len);
-				fwrite(resample_buffer_b, 1, out_len, file_ctx->f);
+		next = level + 1;
+	}
+	else return;
+	file_ctx->flac_adapt_hold = 0;
+	file_ctx->flac_adapt_wait = FLAC_ADAPT_WAIT;
+	atomic_store(&file_ctx->flac_level_req, next);
+	if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_INFO, "(%s) FLAC compression level %u -> %u, ringbuffer %zu%% full, level %u encodes %.1f MSPS",
+		file_ctx->name, level, next, fill * 100 / size, file_ctx->flac_level, *rate / 1e6);
+}
+
+// encode n samples, a requested level change is done at the next frame boundary
+static FLAC__bool flac_file_process(filewriter_ctx_t *file_ctx, FLAC__StreamEncoder *encoder, uint32_t srate, const FLAC__int32 *buf, size_t n)
+{
+	uint32_t level;
+	size_t part, samples = n;
+	uint64_t start;
+	if (file_ctx->flac_check) flac_verify_samples(file_ctx->flac_check, buf, n);
+	if (file_ctx->flac_builtin) return flac_builtin_process(file_ctx, buf, n);
+	if (!file_ctx->flac_relevel) return FLAC__stream_encoder_process(encoder, &buf, n);
+	start = time_ns();
+	while (n > 0) {
+		part = n;
+		level = atomic_load(&file_ctx->flac_level_req);
+		if (level != file_ctx->flac_level) {
+			if (file_ctx->flac_samples % FLAC_STITCH_BLOCKSIZE == 0) {
+				// the previous encoder ends with a complete frame, the next one continues behind it
+				if (!FLAC__stream_encoder_finish(encoder)) return false;
+				file_ctx->flac_frames += file_ctx->flac_samples / FLAC_STITCH_BLOCKSIZE;
+				file_ctx->flac_samples = 0;
+				file_ctx->flac_level = level;
+				if (flac_encoder_init(file_ctx, encoder, srate, NULL) != 0) return false;
 			}
-			else {
-				fwrite(resample_buffer, 1, out_len<<1, file_ctx->f);
+			else if (part > FLAC_STITCH_BLOCKSIZE - file_ctx->flac_samples % FLAC_STITCH_BLOCKSIZE) {
+				part = FLAC_STITCH_BLOCKSIZE - file_ctx->flac_samples % FLAC_STITCH_BLOCKSIZE;
 			}
-		} else {
-			fwrite(buf, 1, len, file_ctx->f);
 		}
-#else
-		fwrite(buf, 1, len, file_ctx->f);
-#endif
-		rb_read_finished(&file_ctx->rb, len);
+		if (!FLAC__stream_encoder_process(encoder, &buf, part)) return false;
+		file_ctx->flac_samples += part;
+		file_ctx->flac_level_samples[file_ctx->flac_level] += part;
+		buf += part;
+		n -= part;
 	}
-	if (file_ctx->f != stdout) fclose(file_ctx->f);
-#if LIBSOXR_ENABLED == 1
-	if (file_ctx->resample_rate!=0) {
-		aligned_free(resample_buffer);
-		aligned_free(resample_buffer_b);
-		soxr_delete(resampler);
-	}
-#endif
-	return 0;
+	if (file_ctx->flac_adaptive) flac_adapt(file_ctx, samples, time_ns() - start, srate);
+	return true;
 }
 
-#if LIBFLAC_ENABLED == 1
 int flac_file_writer(void *ctx)
 {
 	const char rfidx[] = { 'A', 'B' };
 	filewriter_ctx_t *file_ctx = ctx;
-	size_t len = BUFFER_READ_SIZE;
+	size_t len;
 	void *buf;
-	uint32_t ret;
 	uint32_t srate = 40000;
 	FLAC__bool ok = true;
 	FLAC__StreamEncoder *encoder = NULL;
-	FLAC__StreamEncoderInitStatus init_status;
 	FLAC__StreamMetadata *seektable;
+	bool opened;
 
 #if defined(__linux__) && defined(_GNU_SOURCE)
 	char thread_name[] = "out_FLAC_RF_X";
@@ -515,73 +1248,45 @@ int flac_file_writer(void *ctx)
 	pthread_setname_np(pthread_self(), thread_name);
 #endif
 
-#if LIBSOXR_ENABLED == 1
-	uint8_t *resample_buffer;
-	uint8_t *resample_buffer_b;
-	soxr_t resampler = NULL;
-	soxr_error_t soxr_err;
+	resampler_t resampler;
+	const char *resample_err;
 	if (file_ctx->resample_rate!=0.0) {
 		srate = (uint32_t)(file_ctx->resample_rate);
-		resample_buffer = aligned_alloc(32, BUFFER_READ_SIZE);
-		resample_buffer_b = aligned_alloc(32, BUFFER_READ_SIZE);
-		soxr_io_spec_t io_spec = soxr_io_spec(SOXR_INT32_S, SOXR_INT16_S);
-		soxr_quality_spec_t qual_spec = soxr_quality_spec(file_ctx->resample_qual, 0);
-		io_spec.scale = file_ctx->init_scale;
-		io_spec.scale *= pow(10.0,file_ctx->resample_gain/20.0);
-		if (!resample_buffer || !resample_buffer_b) {
-			if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Failed allocating resampling buffer");
+		if (resampler_init(file_ctx, &resampler, true) != 0) {
 			do_exit = 1;
 			return 0;
 		}
-		resampler = soxr_create(40000.0, file_ctx->resample_rate, 1, &soxr_err, &io_spec, &qual_spec, NULL);
-		if (!resampler || soxr_err!=0) {
-			if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Failed allocating resampling context: %s", soxr_err);
+	}
+
+	if (file_ctx->flac_builtin) {
+		file_ctx->flac_fixed = malloc(sizeof(flac_fixed_t));
+		file_ctx->flac_out = malloc(FLAC_BUILTIN_FRAMES * FLAC_FIXED_FRAME_MAX(file_ctx->flac_bits));
+		file_ctx->flac_out_len = malloc(FLAC_BUILTIN_FRAMES * sizeof(size_t));
+		file_ctx->flac_pending = malloc(FLAC_STITCH_BLOCKSIZE * sizeof(int32_t));
+		if (!file_ctx->flac_fixed || !file_ctx->flac_out || !file_ctx->flac_out_len || !file_ctx->flac_pending
+			|| flac_fixed_init(file_ctx->flac_fixed, file_ctx->flac_bits, file_ctx->flac_threads) != 0) {
+			if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Failed allocating FLAC encoder");
 			do_exit = 1;
 			return 0;
 		}
 	}
-#endif
-
-	if((encoder = FLAC__stream_encoder_new()) == NULL) {
+	else if((encoder = FLAC__stream_encoder_new()) == NULL) {
 		if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Failed allocating FLAC encoder");
 		do_exit = 1;
 		return 0;
 	}
-
-	ok &= FLAC__stream_encoder_set_verify(encoder, file_ctx->flac_verify);
-	ok &= FLAC__stream_encoder_set_compression_level(encoder, file_ctx->flac_level);
-	ok &= FLAC__stream_encoder_set_channels(encoder, 1);
-	ok &= FLAC__stream_encoder_set_bits_per_sample(encoder, file_ctx->flac_bits);
-	ok &= FLAC__stream_encoder_set_sample_rate(encoder, srate);
-	ok &= FLAC__stream_encoder_set_total_samples_estimate(encoder, 0);
-
-	if(!ok) {
-		if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Failed initializing FLAC encoder");
-		do_exit = 1;
-		return 0;
-	}
-#if defined(FLAC_API_VERSION_CURRENT) && FLAC_API_VERSION_CURRENT >= 14
-	ret = FLAC__stream_encoder_set_num_threads(encoder, file_ctx->flac_threads);
-	if (ret != FLAC__STREAM_ENCODER_SET_NUM_THREADS_OK) {
-		if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Failed to set FLAC threads: %s", _FLAC_StreamEncoderSetNumThreadsStatusString[ret]);
-	}
-#endif
-	if((seektable = FLAC__metadata_object_new(FLAC__METADATA_TYPE_SEEKTABLE)) == NULL
-		|| FLAC__metadata_object_seektable_template_append_spaced_points(seektable, 1<<18, (uint64_t)1<<41) != true
-		|| FLAC__stream_encoder_set_metadata(encoder, &seektable, 1) != true) {
-		if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Could not create FLAC seektable");
+	if (file_ctx->flac_relevel && (file_ctx->flac_frame = malloc(FLAC_FRAME_MAX)) == NULL) {
+		if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Failed allocating FLAC frame buffer");
 		do_exit = 1;
 		return 0;
 	}
 
-	init_status = FLAC__stream_encoder_init_FILE(encoder, file_ctx->f, NULL, NULL);
-	if(init_status != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
-		if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Failed initializing FLAC encoder: %s", FLAC__StreamEncoderInitStatusString[init_status]);
-		do_exit = 1;
-		return 0;
-	}
+	// errors are reported where they happen, the encoder and buffers are freed below
+	opened = (flac_file_open(file_ctx, encoder, srate, &seektable) == 0);
+	if (!opened) do_exit = 1;
 
-	while(true) {
+	while(opened) {
+		len = BUFFER_READ_SIZE;
 		while(((buf = rb_read_ptr(&file_ctx->rb, len)) == NULL) && !do_exit) {
 			thrd_sleep(&(struct timespec){.tv_nsec=10000000}, NULL);
 		}
@@ -590,70 +1295,268 @@ int flac_file_writer(void *ctx)
 			if (len == 0) break;
 			buf = rb_read_ptr(&file_ctx->rb, len);
 		}
-#if LIBSOXR_ENABLED == 1
+		// cuts are queued before the data behind them, every segment is a complete FLAC stream, stdout is not split
+		if (seg_cut(&file_ctx->seg) && file_ctx->out.f_next != NULL) {
+			opened = false;
+			if (flac_file_close(file_ctx, encoder, seektable) != 0) {
+				do_exit = 1;
+				break;
+			}
+			if (seg_switch(&file_ctx->out) != 0) do_exit = 1;
+			if (flac_file_open(file_ctx, encoder, srate, &seektable) != 0) {
+				do_exit = 1;
+				break;
+			}
+			opened = true;
+		}
+		len = seg_limit(&file_ctx->seg, len);
 		if (file_ctx->resample_rate!=0) {
 			size_t out_len;
-			soxr_err = soxr_process(resampler, &buf, len>>2, &len, &resample_buffer, len>>1, &out_len);
+			resample_err = resample(&resampler, buf, len>>2, true, &len, &out_len);
 			len<<=2;
-			if (soxr_err != 0) {
-				if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Error while converting: %s", soxr_err);
+			if (resample_err != NULL) {
+				if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Error while converting: %s", resample_err);
 				do_exit = 1;
 				return 0;
 			}
-			file_ctx->conv_func((int16_t*)resample_buffer, (int32_t*)resample_buffer_b, out_len);
-			ok = FLAC__stream_encoder_process(encoder, (const FLAC__int32**)&resample_buffer_b, out_len);
+			file_ctx->conv_func((int16_t*)resampler.buf, (int32_t*)resampler.buf_b, out_len);
+			ok = flac_file_process(file_ctx, encoder, srate, (const FLAC__int32*)resampler.buf_b, out_len);
 		} else {
-			ok = FLAC__stream_encoder_process(encoder, (const FLAC__int32**)&buf, len>>2);
+			ok = flac_file_process(file_ctx, encoder, srate, (const FLAC__int32*)buf, len>>2);
 		}
-#else
-		ok = FLAC__stream_encoder_process(encoder, (const FLAC__int32**)&buf, len>>2);
-#endif
 		if(!ok) {
-			if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "(RF %c) FLAC encoder could not process data: %s", rfidx[file_ctx->idx], FLAC__StreamEncoderStateString[FLAC__stream_encoder_get_state(encoder)]);
+			if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "(%s) FLAC encoder could not process data: %s", file_ctx->name,
+				file_ctx->flac_builtin ? strerror(errno) : FLAC__StreamEncoderStateString[FLAC__stream_encoder_get_state(encoder)]);
 		}
 		rb_read_finished(&file_ctx->rb, len);
+		file_ctx->seg.done += len;
 	}
-	FLAC__metadata_object_seektable_template_sort(seektable, false);
-	/* bug in libflac < 1.5, fix seektable manually */
-#if !defined(FLAC_API_VERSION_CURRENT) || FLAC_API_VERSION_CURRENT < 14
-	for(int i = seektable->data.seek_table.num_points-1; i>=0; i--) {
-		if (seektable->data.seek_table.points[i].stream_offset != 0) break;
-		seektable->data.seek_table.points[i].sample_number = 0xFFFFFFFFFFFFFFFF;
+	seg_close(&file_ctx->out);
+	if (opened && flac_file_close(file_ctx, encoder, seektable) != 0) do_exit = 1;
+	if (file_ctx->flac_builtin) {
+		flac_fixed_free(file_ctx->flac_fixed);
+		free(file_ctx->flac_fixed);
+		free(file_ctx->flac_out);
+		free(file_ctx->flac_out_len);
+		free(file_ctx->flac_pending);
+	}
+	else FLAC__stream_encoder_delete(encoder);
+	free(file_ctx->flac_frame);
+	if (file_ctx->flac_adaptive && file_ctx->set->msg_cb) {
+		uint64_t total = 0;
+		char levels[FLAC_LEVELS * 16] = "";
+		for(int i=0; i<FLAC_LEVELS; i++) total += file_ctx->flac_level_samples[i];
+		for(int i=0; i<FLAC_LEVELS && total > 0; i++) {
+			if (file_ctx->flac_level_samples[i] == 0) continue;
+			snprintf(&levels[strlen(levels)], sizeof(levels) - strlen(levels), " %d: %.1f%%", i, file_ctx->flac_level_samples[i] * 100.0 / total);
+		}
+		file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_INFO, "(%s) FLAC compression levels used:%s", file_ctx->name, levels);
 	}
+	if (file_ctx->resample_rate!=0) resampler_free(&resampler);
+	return 0;
+}
 #endif
-	ok = FLAC__stream_encoder_finish(encoder);
-	if(!ok) {
-		if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "(RF %c) FLAC encoder did not finish correctly: %s", rfidx[file_ctx->idx], FLAC__StreamEncoderStateString[FLAC__stream_encoder_get_state(encoder)]);
-		return 0;
+
+// start a MISRC container in the current file, the header is rewritten when the file is closed
+static int rfc_file_open(filewriter_ctx_t *file_ctx)
+{
+	uint8_t header[RFC_HEADER_SIZE];
+	wb_init(&file_ctx->wb, file_ctx->out.f, file_ctx->set->writeback << 20);
+	atomic_store(&file_ctx->seg_bytes, 0);
+	rfc_stream_init(&file_ctx->rfc_stream, file_ctx->rfc_codec, 12, file_ctx->set->pad ? RFC_FLAG_PADDED : 0, 40000000);
+	rfc_write_header(&file_ctx->rfc_stream, false, header);
+	if (fwrite(header, 1, RFC_HEADER_SIZE, file_ctx->out.f) != RFC_HEADER_SIZE) {
+		if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "(%s) Could not write container header: %s", file_ctx->name, strerror(errno));
+		return -1;
 	}
-	FLAC__metadata_object_delete(seektable);
-	FLAC__stream_encoder_delete(encoder);
-#if LIBSOXR_ENABLED == 1
-	if (file_ctx->resample_rate!=0) {
-		aligned_free(resample_buffer);
-		aligned_free(resample_buffer_b);
-		soxr_delete(resampler);
+	wb_written(&file_ctx->wb, RFC_HEADER_SIZE);
+	return 0;
+}
+
+// write the index behind the chunks and the final header, this also closes the file
+static int rfc_file_close(filewriter_ctx_t *file_ctx)
+{
+	rfc_stream_t *s = &file_ctx->rfc_stream;
+	uint8_t header[RFC_HEADER_SIZE], *index;
+	size_t len = rfc_index_size(s);
+	int r = -1;
+	if ((index = malloc(len)) != NULL) {
+		rfc_write_index(s, index);
+		if (fwrite(index, 1, len, file_ctx->out.f) == len) r = 0;
+		free(index);
+	}
+	// pipes keep the header without index, the chunks can still be read in order
+	if (r == 0 && file_ctx->out.f != stdout) {
+		rfc_write_header(s, true, header);
+		if (fseek(file_ctx->out.f, 0, SEEK_SET) != 0 || fwrite(header, 1, RFC_HEADER_SIZE, file_ctx->out.f) != RFC_HEADER_SIZE) r = -1;
 	}
+	if (r != 0 && file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "(%s) Could not write container index: %s", file_ctx->name, strerror(errno));
+	rfc_stream_free(s);
+	if (file_ctx->out.f != stdout) fclose(file_ctx->out.f);
+	return r;
+}
+
+static int rfc_file_writer(void *ctx)
+{
+	filewriter_ctx_t *file_ctx = ctx;
+	rfc_stream_t *s = &file_ctx->rfc_stream;
+	rfc_encoder_t *enc;
+	size_t len, chunks, batch, i;
+	void *buf;
+	uint8_t *out;
+	size_t *out_len;
+	bool open = false;
+#if defined(__linux__) && defined(_GNU_SOURCE)
+	char thread_name[] = "out_MRC_RF_X";
+	thread_name[11] = 'A' + file_ctx->idx;
+	pthread_setname_np(pthread_self(), thread_name);
 #endif
+	// one chunk for every thread, at least a capture block
+	batch = (file_ctx->rfc_threads < 2) ? 2 : file_ctx->rfc_threads;
+	if (batch > RFC_BATCH_MAX) batch = RFC_BATCH_MAX;
+	enc = malloc(sizeof(rfc_encoder_t));
+	out = malloc(batch * RFC_CHUNK_MAX);
+	out_len = malloc(batch * sizeof(size_t));
+	if (!enc || !out || !out_len || rfc_encoder_init(enc, file_ctx->rfc_codec, file_ctx->rfc_level, file_ctx->rfc_threads) != 0) {
+		if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Failed allocating container encoder");
+		do_exit = 1;
+		free(enc);
+		enc = NULL;
+		goto end;
+	}
+	if (rfc_file_open(file_ctx) != 0) {
+		do_exit = 1;
+		goto end;
+	}
+	open = true;
+
+	while(true) {
+		len = batch * RFC_CHUNK_SAMPLES * 2;
+		while(((buf = rb_read_ptr(&file_ctx->rb, len)) == NULL) && !do_exit) {
+			thrd_sleep(&(struct timespec){.tv_nsec=10000000}, NULL);
+		}
+		if (do_exit) {
+			len = file_ctx->rb.tail - file_ctx->rb.head;
+			if (len == 0) break;
+			if (len > batch * RFC_CHUNK_SAMPLES * 2) len = batch * RFC_CHUNK_SAMPLES * 2;
+			buf = rb_read_ptr(&file_ctx->rb, len);
+		}
+		// cuts are queued before the data behind them, every segment is a complete container, stdout is not split
+		if (seg_cut(&file_ctx->seg) && file_ctx->out.f_next != NULL) {
+			open = false;
+			if (rfc_file_close(file_ctx) != 0 || seg_switch(&file_ctx->out) != 0 || rfc_file_open(file_ctx) != 0) {
+				do_exit = 1;
+				break;
+			}
+			open = true;
+		}
+		len = seg_limit(&file_ctx->seg, len);
+		// the chunks of a file are numbered by their first sample in the file
+		chunks = rfc_encode(enc, buf, len / 2, s->samples, out, out_len);
+		for(i = 0; i < chunks; i++) {
+			if (fwrite(&out[i * RFC_CHUNK_MAX], 1, out_len[i], file_ctx->out.f) != out_len[i] || rfc_stream_add(s, &out[i * RFC_CHUNK_MAX], out_len[i]) != 0) {
+				if(file_ctx->set->msg_cb) file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Error writing %s: %s", file_ctx->name, strerror(errno));
+				do_exit = 1;
+				break;
+			}
+			wb_written(&file_ctx->wb, out_len[i]);
+			atomic_fetch_add(&file_ctx->seg_bytes, out_len[i]);
+		}
+		if (i < chunks) break;
+		rb_read_finished(&file_ctx->rb, len);
+		file_ctx->seg.done += len;
+	}
+	seg_close(&file_ctx->out);
+	if (open) rfc_file_close(file_ctx);
+end:
+	if (enc) {
+		rfc_encoder_free(enc);
+		free(enc);
+	}
+	free(out);
+	free(out_len);
 	return 0;
 }
-#endif
 
-static int open_file(FILE **f, char *filename, misrc_settings_t *set)
+// space for the next block of an output, NULL if the block is dropped for it
+static void *out_write_ptr(filewriter_ctx_t *file_ctx, size_t size, uint64_t sample)
 {
-	if (strcmp(filename, "-") == 0) { // Write to stdout
-		*f = stdout;
-		return 0;
+	void *buf;
+	while(((buf = rb_write_ptr(&file_ctx->rb, size)) == NULL) && file_ctx->policy == BACKPRESSURE_BLOCK && !do_exit) {
+		sleep_ms(10);
 	}
-	if (access(filename, F_OK) == 0 && !set->overwrite_files) {
-		if (!set->overwrite_cb || !set->overwrite_cb(set->overwrite_cb_ctx, filename)) return MISRC_RET_USER_ABORT;
+	if (buf == NULL) {
+		if (do_exit) return NULL;
+		if (file_ctx->gap_start == UINT64_MAX) {
+			file_ctx->gap_start = sample;
+			file_ctx->gaps++;
+			file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_ERROR, "%s output can't keep up, dropping data from sample %" PRIu64 " (output byte %" PRIu64 ")", file_ctx->name, sample, file_ctx->queued);
+		}
+		file_ctx->dropped += BUFFER_READ_SIZE;
+		return NULL;
 	}
-	*f = fopen(filename, "wb");
-	if (!(*f)) {
-		set->msg_cb(set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Failed to open %s", filename);
-		return MISRC_RET_FILE_ERROR;
+	if (file_ctx->gap_start != UINT64_MAX) {
+		file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_ERROR, "%s output continues at sample %" PRIu64 ", gap of %" PRIu64 " samples", file_ctx->name, sample, sample - file_ctx->gap_start);
+		file_ctx->gap_start = UINT64_MAX;
 	}
-	return 0;
+	return buf;
+}
+
+#if LIBFLAC_ENABLED == 1
+// lower the FLAC level of an output that falls behind before data has to be dropped
+static void out_degrade(filewriter_ctx_t *file_ctx)
+{
+	size_t fill = file_ctx->rb.tail - file_ctx->rb.head;
+	uint32_t level = atomic_load(&file_ctx->flac_level_req);
+	if (file_ctx->degrade_wait > 0) {
+		file_ctx->degrade_wait--;
+		return;
+	}
+	if (level == 0 || fill < file_ctx->rb.buffer_size - file_ctx->rb.buffer_size / 4) return;
+	atomic_store(&file_ctx->flac_level_req, level - 1);
+	file_ctx->degrade_wait = BACKPRESSURE_DEGRADE_WAIT;
+	file_ctx->set->msg_cb(file_ctx->set->msg_cb_ctx, MISRC_MSG_WARNING, "%s output can't keep up, lowering FLAC compression level to %u", file_ctx->name, level - 1);
+}
+#endif
+
+#if LIBFLAC_ENABLED == 1 && defined(FLAC_API_VERSION_CURRENT) && FLAC_API_VERSION_CURRENT >= 14
+// smallest number of encoder threads that is fast enough for srate kHz, measured once and kept in the profile
+static uint32_t flac_auto_threads(misrc_settings_t *set, const char *name, uint32_t bits, uint32_t srate, uint32_t max_threads)
+{
+	char key[FLAC_TUNE_KEY_LEN];
+	flac_tune_t res;
+	flac_tune_key(key, sizeof(key), set->flac_level, bits, srate, max_threads);
+	if (set->flac_calibrate || flac_tune_load(key, &res) != 0) {
+		set->msg_cb(set->msg_cb_ctx, MISRC_MSG_INFO, "Measuring FLAC encoder speed for %s output, this takes a moment...", name);
+		if (flac_tune_measure(set->flac_level, bits, max_threads, srate * 1000.0 * FLAC_TUNE_MARGIN, &res) != 0) {
+			set->msg_cb(set->msg_cb_ctx, MISRC_MSG_WARNING, "Measuring the FLAC encoder failed, using %u threads for %s output", max_threads, name);
+			return max_threads;
+		}
+		if (flac_tune_save(key, &res) != 0) {
+			set->msg_cb(set->msg_cb_ctx, MISRC_MSG_WARNING, "Could not store FLAC encoder profile in %s", flac_tune_path() ? flac_tune_path() : "(no cache directory)");
+		}
+	}
+	set->msg_cb(set->msg_cb_ctx, MISRC_MSG_INFO, "%s output: using %u FLAC encoder threads, %.1f MSPS at level %u (%s)", name, res.threads, res.rate / 1e6, (uint32_t)set->flac_level, res.cached ? "profile" : "measured");
+	if (!res.sufficient) {
+		set->msg_cb(set->msg_cb_ctx, MISRC_MSG_WARNING, "FLAC level %u is too slow for %s output on this system, lower the level or use --rf-flac-adaptive", (uint32_t)set->flac_level, name);
+	}
+	return res.threads;
+}
+#endif
+
+// threads each RF output can use, the capture callback and main loop need a core, audio capture another one
+static uint32_t out_max_threads(misrc_settings_t *set)
+{
+	int out_cnt = ((set->output_names_rf[0] == NULL) ? 0 : 1) + ((set->output_names_rf[1] == NULL) ? 0 : 1);
+	uint32_t reserved = 2, cores, max_threads;
+	if (out_cnt == 0) return 0;
+	cores = get_num_cores();
+	if (set->output_name_4ch_audio != NULL) reserved = 3;
+	for(int i=0; i<2; i++) if (set->output_names_2ch_audio[i] != NULL) reserved = 3;
+	for(int i=0; i<4; i++) if (set->output_names_1ch_audio[i] != NULL) reserved = 3;
+	set->msg_cb(set->msg_cb_ctx, MISRC_MSG_INFO, "Detected %d cores in the system available to the process", cores);
+	max_threads = (cores > reserved + out_cnt) ? (cores - reserved) / out_cnt : 1;
+	return (max_threads > 128) ? 128 : max_threads;
 }
 
 static bool str_starts_with(const char *restrict prefixA, const char *restrict prefixB, size_t *prefixLen, const char *restrict string)
@@ -735,6 +1638,11 @@ void misrc_stop_capture()
 	do_exit = 1;
 }
 
+void misrc_cut_capture()
+{
+	atomic_store(&cut_request, 1);
+}
+
 int misrc_run_capture(misrc_settings_t *set)
 {
 //set pipe mode to binary in windows
@@ -742,9 +1650,10 @@ int misrc_run_capture(misrc_settings_t *set)
 	_setmode(_fileno(stdout), O_BINARY);
 	_setmode(_fileno(stdin), O_BINARY);
 #endif
-	const int64_t resample_qual_list[] = { SOXR_QQ, SOXR_LQ, SOXR_MQ, SOXR_HQ, SOXR_VHQ };
 
 	int r, dev_index = 0, out_size = 2;
+	size_t out_block_size;
+	bool direct_8bit = false;
 	size_t str_cnt = 0;
 
 	thrd_start_t output_thread_func = (thrd_start_t)raw_file_writer;
@@ -759,21 +1668,33 @@ int misrc_run_capture(misrc_settings_t *set)
 	char *sc_dev_name = NULL;
 
 	//output threads
-	// out 1, 2
-	thrd_t thread_out[2] = { 0, 0 };
+	// out 1, 2, raw, aux
+	thrd_t thread_out[OUT_CNT] = { 0, 0, 0, 0 };
 	thrd_t thread_audio = 0;
-	filewriter_ctx_t thread_out_ctx[2];
+	filewriter_ctx_t thread_out_ctx[OUT_CNT];
 	audiowriter_ctx_t thread_audio_ctx;
 	char outbuffer_name[] = "outX_ringbuffer";
+	const char *out_names[OUT_CNT] = { "RF A", "RF B", "raw", "aux" };
 
-	//aux buffer
+	//aux buffer, only used if the aux data is not written
 	uint8_t  *buf_aux = aligned_alloc(16,sizeof(uint8_t) *BUFFER_READ_SIZE);
+	//RF data of blocks that are dropped
+	uint8_t  *buf_drop = NULL;
+	size_t out_block[OUT_CNT];
+#if LIBFLAC_ENABLED == 1
+	uint32_t flac_max_threads = 0;
+#endif
+	int rfc_codec = RFC_CODEC_STORE;
+	uint32_t rfc_threads = 0;
 
 	uint64_t total_samples = 0;
 
-	//output files
-	FILE *output_aux = NULL;
-	FILE *output_raw = NULL;
+	//splitting into segments
+	bool split;
+	uint64_t split_samples = 0;
+	uint64_t split_bytes = set->split_size << 30;
+	uint64_t seg_start = 0;
+	unsigned int seg_idx = 0;
 
 	//clipping state
 	size_t clip[2] = {0, 0};
@@ -782,8 +1703,12 @@ int misrc_run_capture(misrc_settings_t *set)
 
 	// conversion function
 	conv_function_t conv_function;
+	conv_float_function_t conv_float = NULL;
+	extract_float_state_t float_state;
 
+	memset(&thread_out_ctx, 0, sizeof(thread_out_ctx));
 	memset(&thread_audio_ctx, 0, sizeof(audiowriter_ctx_t));
+	atomic_store(&cut_request, 0);
 
 	cap_ctx.capture_rf = true;
 	cap_ctx.set = set;
@@ -794,6 +1719,27 @@ int misrc_run_capture(misrc_settings_t *set)
 	else
 		dev_index = (int)atoi(set->device);
 
+	if (set->capture_time) {
+		double capture_time = parse_time(set->capture_time);
+		uint64_t capture_samples;
+		if (capture_time < 0.0) {
+			set->msg_cb(set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Invalid capture duration: %s", set->capture_time);
+			return MISRC_RET_INVALID_SETTINGS;
+		}
+		capture_samples = (uint64_t)llround(capture_time * PARSE_TIME_SAMPLE_RATE);
+		if (set->total_samples_before_exit == 0 || capture_samples < set->total_samples_before_exit) set->total_samples_before_exit = capture_samples;
+	}
+
+	if (set->split_time) {
+		double split_time = parse_time(set->split_time);
+		if (split_time <= 0.0) {
+			set->msg_cb(set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Invalid split duration: %s", set->split_time);
+			return MISRC_RET_INVALID_SETTINGS;
+		}
+		split_samples = (uint64_t)llround(split_time * PARSE_TIME_SAMPLE_RATE);
+	}
+	split = (split_samples != 0 || split_bytes != 0 || set->split_manual);
+
 #if LIBFLAC_ENABLED == 1
 	if(set->flac_12bit && set->flac_bits == 0) set->flac_bits = 1;
 	if(set->flac_enable) {
@@ -809,77 +1755,169 @@ int misrc_run_capture(misrc_settings_t *set)
 		else {
 			if(set->flac_bits != 2) set->flac_bits = 1;
 		}
-# if defined(FLAC_API_VERSION_CURRENT) && FLAC_API_VERSION_CURRENT >= 14
-		if (set->flac_threads == 0) {
-			int out_cnt = ((set->output_names_rf[0] == NULL) ? 0 : 1) + ((set->output_names_rf[1] == NULL) ? 0 : 1);
-			if (out_cnt != 0) {
-				set->flac_threads = get_num_cores();
-				set->msg_cb(set->msg_cb_ctx, MISRC_MSG_INFO, "Detected %d cores in the system available to the process",set->flac_threads);
-				set->flac_threads = (set->flac_threads - 2 - out_cnt) / out_cnt;
-				if (set->flac_threads == 0) set->flac_threads = 1;
-				if (set->flac_threads > 128) set->flac_threads = 128;
-			}
-		}
-# endif
+		if (set->flac_threads == 0) flac_max_threads = out_max_threads(set);
 	}
 #endif
 
-#if LIBSOXR_ENABLED == 1
+	if (set->rf_container != 0) {
+		rfc_codec = (int)set->rf_container - 1;
+		if (rfc_codec_name(rfc_codec) == NULL) {
+			set->msg_cb(set->msg_cb_ctx, MISRC_MSG_CRITICAL, "The MISRC container with %s compression is not supported by this build!", rf_container_options[set->rf_container]);
+			return MISRC_RET_INVALID_SETTINGS;
+		}
+		if (out_size != 2 || set->rf_format != 0 || set->reduce_8bit[0] || set->reduce_8bit[1]) {
+			set->msg_cb(set->msg_cb_ctx, MISRC_MSG_CRITICAL, "The MISRC container only holds 16 bit RF, it cannot be combined with FLAC, other RF formats or 8 bit reduction!");
+			return MISRC_RET_INVALID_SETTINGS;
+		}
+		if (set->resample_rate[0] != 40000.0 || set->resample_rate[1] != 40000.0) {
+			set->msg_cb(set->msg_cb_ctx, MISRC_MSG_CRITICAL, "The MISRC container cannot be combined with resampling!");
+			return MISRC_RET_INVALID_SETTINGS;
+		}
+		output_thread_func = (thrd_start_t)rfc_file_writer;
+		rfc_threads = (set->rf_container_threads != 0) ? (uint32_t)set->rf_container_threads : out_max_threads(set);
+		if (rfc_threads > RFC_BATCH_MAX) rfc_threads = RFC_BATCH_MAX;
+		if (rfc_threads < 1) rfc_threads = 1;
+		set->msg_cb(set->msg_cb_ctx, MISRC_MSG_INFO, "MISRC container: %s level %" PRIi64 ", %u threads per RF output", rfc_codec_name(rfc_codec), set->rf_container_level, rfc_threads);
+	}
+
 	for(int i=0; i<2; i++) {
-		set->resample_qual[i] = resample_qual_list[set->resample_qual[i]];
 		if (set->resample_rate[i] == 40000.0) set->resample_rate[i] = 0.0;
 	}
 	if(set->resample_rate[0] > 40000.0 || set->resample_rate[1] > 40000.0) {
 		set->msg_cb(set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Upsampling to higher frequencies than 40 kHz is not supported!");
 		return MISRC_RET_INVALID_SETTINGS;
 	}
+	// the built-in decimator handles 40 MHz times 1/M or 2/M, libsoxr any other rate
+	for(int i=0; i<2; i++) {
+		if (set->output_names_rf[i] == NULL || set->resample_rate[i] == 0.0) continue;
+		bool builtin = rfd_supported(40000.0, set->resample_rate[i]);
+#if LIBSOXR_ENABLED == 1
+		if (set->resample_soxr) builtin = false;
+#else
+		if (!builtin) {
+			set->msg_cb(set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Resampling to %.3f kHz needs libsoxr, without it only 40000 kHz times 1/M or 2/M is supported!", set->resample_rate[i]);
+			return MISRC_RET_INVALID_SETTINGS;
+		}
+#endif
+		set->msg_cb(set->msg_cb_ctx, MISRC_MSG_INFO, "%s: resampling to %.3f kHz (%s) with %s", out_names[i], set->resample_rate[i],
+			sox_quality_options[set->resample_qual[i]], builtin ? "the built-in decimator" : "libsoxr");
+	}
 	if((set->resample_rate[0] != 0.0 || set->resample_rate[1] != 0.0) && out_size == 4) {
-# if LIBFLAC_ENABLED == 1
+#if LIBFLAC_ENABLED == 1
 		if (set->flac_bits == 1) {
 			conv_16to12to32 = get_16to12to32_function();
 		} else {
-# endif
+#endif
 			conv_16to32 = get_16to32_function();
-# if LIBFLAC_ENABLED == 1
+#if LIBFLAC_ENABLED == 1
 		}
-# endif
+#endif
 	}
+	/* 8 bit reduction is done directly in the extraction if all RF outputs are reduced and none is
+	   resampled, otherwise it is done after resampling in the output threads */
 	if(set->reduce_8bit[0] || set->reduce_8bit[1]) {
-		if (out_size == 4) 
-			conv_16to8to32 = get_16to8to32_function();
-		else 
-			conv_16to8 = get_16to8_function();
-		if(set->reduce_8bit[0] && set->resample_rate[0]==0.0) set->resample_rate[0] = 40000.0;
-		if(set->reduce_8bit[1] && set->resample_rate[1]==0.0) set->resample_rate[1] = 40000.0;
+		direct_8bit = true;
+		for(int i=0; i<2; i++) {
+			if (set->output_names_rf[i] == NULL) continue;
+			if (!set->reduce_8bit[i]) direct_8bit = false;
+			if (set->resample_rate[i] != 0.0) direct_8bit = false;
+		}
+		if (direct_8bit) {
+			if (out_size == 2) out_size = 1;
+		}
+		else {
+			// the resampler only scales at 40 MHz
+			if (out_size == 4) 
+				conv_16to8to32 = get_16to8to32_function();
+			else 
+				conv_16to8 = get_16to8_function();
+			if(set->reduce_8bit[0] && set->resample_rate[0]==0.0) set->resample_rate[0] = 40000.0;
+			if(set->reduce_8bit[1] && set->resample_rate[1]==0.0) set->resample_rate[1] = 40000.0;
+		}
 	}
-#endif
+
+	if (set->rf_format != 0) {
+		const char *format_name = (set->rf_format == 1) ? "Packed 12 bit" : "Float";
+		if (out_size == 4) {
+			set->msg_cb(set->msg_cb_ctx, MISRC_MSG_CRITICAL, "%s RF output cannot be combined with FLAC compression!", format_name);
+			return MISRC_RET_INVALID_SETTINGS;
+		}
+		if (set->pad) {
+			set->msg_cb(set->msg_cb_ctx, MISRC_MSG_CRITICAL, "%s RF output cannot be padded!", format_name);
+			return MISRC_RET_INVALID_SETTINGS;
+		}
+		if (set->reduce_8bit[0] || set->reduce_8bit[1]) {
+			set->msg_cb(set->msg_cb_ctx, MISRC_MSG_CRITICAL, "%s RF output cannot be combined with 8 bit reduction!", format_name);
+			return MISRC_RET_INVALID_SETTINGS;
+		}
+		if (set->resample_rate[0] != 0.0 || set->resample_rate[1] != 0.0) {
+			set->msg_cb(set->msg_cb_ctx, MISRC_MSG_CRITICAL, "%s RF output cannot be combined with resampling!", format_name);
+			return MISRC_RET_INVALID_SETTINGS;
+		}
+	}
+	if (set->rf_dc_removal && set->rf_format < 2) {
+		set->msg_cb(set->msg_cb_ctx, MISRC_MSG_CRITICAL, "DC removal is only possible for float RF output!");
+		return MISRC_RET_INVALID_SETTINGS;
+	}
+	if (set->rf_format == 1) out_block_size = (BUFFER_READ_SIZE*3)/2;
+	else if (set->rf_format >= 2) out_block_size = BUFFER_READ_SIZE*sizeof(float);
+	else out_block_size = BUFFER_READ_SIZE*out_size;
 
 	for(int i=0; i<2; i++) {
 		if (set->output_names_rf[i] != NULL) {
-			if (open_file(&(thread_out_ctx[i].f), set->output_names_rf[i],set)) return -ENOENT;
-			if (out_size == 4) {
-				thread_out_ctx[i].init_scale = (set->reduce_8bit[i]) ? ((set->pad) ? 256.0 : 4096.0) : 65536.0;
-			} else {
-				thread_out_ctx[i].init_scale = (set->reduce_8bit[i]) ? ((set->pad) ? 0.00390625 : 0.0625) : 1.0;
-			}
+			if (seg_open(&(thread_out_ctx[i].out), set->output_names_rf[i], set, split)) return -ENOENT;
 			thread_out_ctx[i].idx = i;
+			thread_out_ctx[i].name = out_names[i];
 			thread_out_ctx[i].set = set;
+			thread_out_ctx[i].policy = set->backpressure[i];
+			thread_out_ctx[i].gap_start = UINT64_MAX;
+			out_block[i] = out_block_size;
+			thread_out_ctx[i].rfc_codec = rfc_codec;
+			thread_out_ctx[i].rfc_level = (int)set->rf_container_level;
+			thread_out_ctx[i].rfc_threads = rfc_threads;
+			// FLAC, container and resampled output have an unknown size, segments are not preallocated
+			thread_out_ctx[i].expected_size = (out_size == 4 || split || set->rf_container != 0) ? 0 : (uint64_t)((double)set->total_samples_before_exit * out_block_size / (BUFFER_READ_SIZE));
 #if LIBFLAC_ENABLED == 1
 			thread_out_ctx[i].flac_level = set->flac_level;
 			thread_out_ctx[i].flac_verify = set->flac_verify;
 			thread_out_ctx[i].flac_threads = set->flac_threads;
-#if LIBSOXR_ENABLED == 1
 			thread_out_ctx[i].flac_bits = set->reduce_8bit[i] ? 8 : ((set->flac_bits == 1) ? 12 : 16);
+			// the built-in encoder has no levels
+			thread_out_ctx[i].flac_builtin = set->flac_enable && set->flac_builtin;
+			thread_out_ctx[i].flac_relevel = set->flac_enable && !set->flac_builtin && (set->flac_adaptive || set->backpressure[i] == BACKPRESSURE_DEGRADE);
+			thread_out_ctx[i].flac_adaptive = set->flac_enable && !set->flac_builtin && set->flac_adaptive;
+			thread_out_ctx[i].flac_level_max = set->flac_level;
+			atomic_store(&thread_out_ctx[i].flac_level_req, set->flac_level);
 			thread_out_ctx[i].conv_func = set->reduce_8bit[i] ? conv_16to8to32 : ((set->flac_bits == 1) ? conv_16to12to32 : conv_16to32);
-#else
-			thread_out_ctx[i].flac_bits = (set->flac_bits == 1) ? 12 : 16;
 #endif
-#endif
-#if LIBSOXR_ENABLED == 1
+			if (out_size == 4) {
+				thread_out_ctx[i].init_scale = (set->reduce_8bit[i]) ? ((set->pad) ? 256.0 : 4096.0) : 65536.0;
+			} else {
+				thread_out_ctx[i].init_scale = (set->reduce_8bit[i]) ? ((set->pad) ? 0.00390625 : 0.0625) : 1.0;
+			}
 			thread_out_ctx[i].reduce_8bit = set->reduce_8bit[i];
 			thread_out_ctx[i].resample_rate = set->resample_rate[i];
 			thread_out_ctx[i].resample_qual = set->resample_qual[i];
 			thread_out_ctx[i].resample_gain = set->resample_gain[i];
+#if LIBFLAC_ENABLED == 1
+			if (set->flac_enable && set->flac_builtin && flac_max_threads > 0) {
+				thread_out_ctx[i].flac_threads = (flac_max_threads < FLAC_BUILTIN_THREADS) ? flac_max_threads : FLAC_BUILTIN_THREADS;
+			}
+# if defined(FLAC_API_VERSION_CURRENT) && FLAC_API_VERSION_CURRENT >= 14
+			else if (set->flac_enable && flac_max_threads > 0) {
+				uint32_t srate = (set->resample_rate[i] > 0.0) ? (uint32_t)set->resample_rate[i] : 40000;
+				thread_out_ctx[i].flac_threads = flac_auto_threads(set, out_names[i], thread_out_ctx[i].flac_bits, srate, flac_max_threads);
+			}
+# endif
+#endif
+#if LIBFLAC_ENABLED == 1
+			if (set->flac_enable && set->flac_check) {
+				thread_out_ctx[i].flac_check = malloc(sizeof(flac_verify_t));
+				if (!thread_out_ctx[i].flac_check || flac_verify_start(thread_out_ctx[i].flac_check, out_names[i], set->msg_cb, set->msg_cb_ctx) != 0) {
+					set->msg_cb(set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Failed to start FLAC verification");
+					return MISRC_RET_THREAD_ERROR;
+				}
+			}
 #endif
 			outbuffer_name[3] = (char)(i+48);
 			rb_init(&thread_out_ctx[i].rb, outbuffer_name, BUFFER_TOTAL_SIZE);
@@ -893,7 +1931,7 @@ int misrc_run_capture(misrc_settings_t *set)
 	if(set->output_name_4ch_audio != NULL)
 	{
 		//opening output file audio
-		if (open_file(&(thread_audio_ctx.f_4ch), set->output_name_4ch_audio, set)) return -ENOENT;
+		if (seg_open(&(thread_audio_ctx.out_4ch), set->output_name_4ch_audio, set, split)) return -ENOENT;
 		cap_ctx.capture_audio = true;
 	}
 
@@ -901,7 +1939,7 @@ int misrc_run_capture(misrc_settings_t *set)
 		if(set->output_names_2ch_audio[i] != NULL)
 		{
 			//opening output file audio
-			if (open_file(&(thread_audio_ctx.f_2ch[i]), set->output_names_2ch_audio[i], set)) return -ENOENT;
+			if (seg_open(&(thread_audio_ctx.out_2ch[i]), set->output_names_2ch_audio[i], set, split)) return -ENOENT;
 			cap_ctx.capture_audio = true;
 		}
 	}
@@ -910,26 +1948,48 @@ int misrc_run_capture(misrc_settings_t *set)
 		if(set->output_names_1ch_audio[i] != NULL)
 		{
 			//opening output file audio
-			if (open_file(&(thread_audio_ctx.f_1ch[i]), set->output_names_1ch_audio[i], set)) return -ENOENT;
+			if (seg_open(&(thread_audio_ctx.out_1ch[i]), set->output_names_1ch_audio[i], set, split)) return -ENOENT;
 			cap_ctx.capture_audio = true;
 		}
 	}
 
-	if(set->output_name_aux != NULL)
-	{
-		//opening output file aux
-		if (open_file(&output_aux, set->output_name_aux, set)) return -ENOENT;
+	// raw and aux are written by their own threads, the main loop only converts
+	for(int i=OUT_RAW; i<=OUT_AUX; i++) {
+		char *name = (i == OUT_RAW) ? set->output_name_raw : set->output_name_aux;
+		// 4 bytes per sample for raw, 1 for aux
+		uint64_t bytes_per_sample = (i == OUT_RAW) ? 4 : 1;
+		if (name == NULL) continue;
+		if (seg_open(&(thread_out_ctx[i].out), name, set, split)) return -ENOENT;
+		thread_out_ctx[i].idx = i;
+		thread_out_ctx[i].name = out_names[i];
+		thread_out_ctx[i].set = set;
+		// there is nothing to degrade, the data is dropped instead
+		thread_out_ctx[i].policy = set->backpressure_raw;
+		thread_out_ctx[i].gap_start = UINT64_MAX;
+		out_block[i] = BUFFER_READ_SIZE * bytes_per_sample;
+		thread_out_ctx[i].expected_size = split ? 0 : set->total_samples_before_exit * bytes_per_sample;
+		outbuffer_name[3] = (char)(i+48);
+		rb_init(&thread_out_ctx[i].rb, outbuffer_name, (BUFFER_TOTAL_SIZE) / 4 * bytes_per_sample);
+		r = thrd_create(&thread_out[i], (thrd_start_t)raw_file_writer, &thread_out_ctx[i]);
+		if (r != thrd_success) {
+			return MISRC_RET_THREAD_ERROR;
+		}
 	}
 
-	if(set->output_name_raw != NULL)
-	{
-		//opening output file raw
-		if (open_file(&output_raw, set->output_name_raw, set)) return -ENOENT;
+	for(int i=0; i<2; i++) {
+		if (thread_out[i] != 0 && thread_out_ctx[i].policy != BACKPRESSURE_BLOCK && buf_drop == NULL) {
+			buf_drop = aligned_alloc(64, out_block_size);
+			if (!buf_drop) {
+				set->msg_cb(set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Failed allocating buffer");
+				return MISRC_RET_MEMORY_ERROR;
+			}
+		}
 	}
 
 	if(cap_ctx.capture_audio) {
 		rb_init(&cap_ctx.rb_audio,"capture_audio_ringbuffer",BUFFER_AUDIO_TOTAL_SIZE);
 		thread_audio_ctx.rb = &cap_ctx.rb_audio;
+		thread_audio_ctx.seg.gated = split;
 		r = thrd_create(&thread_audio, &audio_file_writer, &thread_audio_ctx);
 		if (r != thrd_success) {
 			set->msg_cb(set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Failed to create thread for output processing");
@@ -937,7 +1997,17 @@ int misrc_run_capture(misrc_settings_t *set)
 		}
 	}
 
-	conv_function = get_conv_function(0, set->pad, (out_size==2) ? 0 : 1, set->calc_level, set->output_names_rf[0], set->output_names_rf[1]);
+	if (set->rf_format >= 2 && (set->output_names_rf[0] != NULL || set->output_names_rf[1] != NULL)) {
+		conv_float = get_conv_float_function(set->calc_level, set->output_names_rf[0], set->output_names_rf[1]);
+		extract_float_init(&float_state, set->rf_format == 2, set->rf_dc_removal);
+		conv_function = NULL;
+	}
+	else if (direct_8bit)
+		conv_function = get_conv_8bit_function(set->reduce_8bit_rounding, (out_size==4) ? 1 : 0, set->calc_level, set->output_names_rf[0], set->output_names_rf[1]);
+	else if (set->rf_format == 1)
+		conv_function = get_conv_12p_function(0, set->calc_level, set->output_names_rf[0], set->output_names_rf[1]);
+	else
+		conv_function = get_conv_function(0, set->pad, (out_size==2) ? 0 : 1, set->calc_level, set->output_names_rf[0], set->output_names_rf[1]);
 
 	rb_init(&cap_ctx.rb,"capture_ringbuffer",BUFFER_TOTAL_SIZE);
 
@@ -990,21 +2060,37 @@ int misrc_run_capture(misrc_settings_t *set)
 #endif
 
 	while (!do_exit) {
-		void *buf, *buf_out1 = NULL, *buf_out2 = NULL;
-		while((((buf = rb_read_ptr(&cap_ctx.rb, BUFFER_READ_SIZE*4)) == NULL) || 
-			  (set->output_names_rf[0] != NULL && ((buf_out1 = rb_write_ptr(&thread_out_ctx[0].rb, BUFFER_READ_SIZE*out_size)) == NULL)) ||
-			  (set->output_names_rf[1] != NULL && ((buf_out2 = rb_write_ptr(&thread_out_ctx[1].rb, BUFFER_READ_SIZE*out_size)) == NULL))) && 
-			  !do_exit)
-		{
+		void *buf, *buf_out[OUT_CNT] = { NULL, NULL, NULL, NULL }, *buf_out1, *buf_out2, *buf_out_aux;
+		while(((buf = rb_read_ptr(&cap_ctx.rb, BUFFER_READ_SIZE*4)) == NULL) && !do_exit) {
 			sleep_ms(10);
 		}
+		// every output has its own ringbuffer, only outputs that block hold back the others
+		for(int i=0; i<OUT_CNT && !do_exit; i++) {
+			if (thread_out[i] == 0) continue;
+#if LIBFLAC_ENABLED == 1
+			// an adaptive writer lowers the level itself
+			if (thread_out_ctx[i].flac_relevel && !thread_out_ctx[i].flac_adaptive) out_degrade(&thread_out_ctx[i]);
+#endif
+			buf_out[i] = out_write_ptr(&thread_out_ctx[i], out_block[i], total_samples);
+		}
 		if (do_exit) break;
-		conv_function((uint32_t*)buf, BUFFER_READ_SIZE, clip, buf_aux, buf_out1, buf_out2, peak_level);
-		if(output_raw != NULL){fwrite(buf,4,BUFFER_READ_SIZE,output_raw);}
+		buf_out1 = (thread_out[OUT_RF_A] != 0 && buf_out[OUT_RF_A] == NULL) ? buf_drop : buf_out[OUT_RF_A];
+		buf_out2 = (thread_out[OUT_RF_B] != 0 && buf_out[OUT_RF_B] == NULL) ? buf_drop : buf_out[OUT_RF_B];
+		buf_out_aux = (buf_out[OUT_AUX] == NULL) ? buf_aux : buf_out[OUT_AUX];
+		if (conv_float) {
+			conv_float((uint32_t*)buf, BUFFER_READ_SIZE, clip, buf_out_aux, buf_out1, buf_out2, peak_level, &float_state);
+			extract_float_update_dc(&float_state, BUFFER_READ_SIZE);
+		}
+		else
+			conv_function((uint32_t*)buf, BUFFER_READ_SIZE, clip, buf_out_aux, buf_out1, buf_out2, peak_level);
+		// the capture ringbuffer has a single reader, the raw data is copied to the raw writer
+		if(buf_out[OUT_RAW] != NULL) memcpy(buf_out[OUT_RAW], buf, BUFFER_READ_SIZE*4);
 		rb_read_finished(&cap_ctx.rb, BUFFER_READ_SIZE*4);
-		if(output_aux != NULL){fwrite(buf_aux,1,BUFFER_READ_SIZE,output_aux);}
-		if(set->output_names_rf[0] != NULL) rb_write_finished(&thread_out_ctx[0].rb, BUFFER_READ_SIZE*out_size);
-		if(set->output_names_rf[1] != NULL) rb_write_finished(&thread_out_ctx[1].rb, BUFFER_READ_SIZE*out_size);
+		for(int i=0; i<OUT_CNT; i++) {
+			if (buf_out[i] == NULL) continue;
+			rb_write_finished(&thread_out_ctx[i].rb, out_block[i]);
+			thread_out_ctx[i].queued += out_block[i];
+		}
 
 		total_samples += BUFFER_READ_SIZE;
 
@@ -1014,7 +2100,36 @@ int misrc_run_capture(misrc_settings_t *set)
 			if (set->count_cb) set->count_cb(set->count_cb_ctx, MISRC_COUNT_TOTAL_SAMPLES_END, total_samples);
 			do_exit = true;
 		}
+
+		if (!split) {
+			if (atomic_exchange(&cut_request, 0)) set->msg_cb(set->msg_cb_ctx, MISRC_MSG_WARNING, "Splitting the outputs is not enabled");
+		}
+		else if (!do_exit) {
+			bool cut = atomic_exchange(&cut_request, 0);
+			if (split_samples != 0 && total_samples - seg_start >= split_samples) cut = true;
+			// the sizes are only up to date if all writers have reached the last cut
+			if (split_bytes != 0 && seg_queue_empty(&thread_audio_ctx.seg)) {
+				uint64_t seg_bytes = atomic_load(&thread_audio_ctx.seg_bytes);
+				bool empty = true;
+				for(int i=0; i<OUT_CNT; i++) {
+					if (!seg_queue_empty(&thread_out_ctx[i].seg)) empty = false;
+					if (atomic_load(&thread_out_ctx[i].seg_bytes) > seg_bytes) seg_bytes = atomic_load(&thread_out_ctx[i].seg_bytes);
+				}
+				if (empty && seg_bytes >= split_bytes) cut = true;
+			}
+			if (cut) {
+				// all outputs are cut behind this block, the writer threads switch files when they get there
+				seg_start = total_samples;
+				seg_idx++;
+				for(int i=0; i<OUT_CNT; i++) if (thread_out[i] != 0) seg_queue_cut(&thread_out_ctx[i].seg, thread_out_ctx[i].queued);
+				if (cap_ctx.capture_audio) seg_queue_cut(&thread_audio_ctx.seg, total_samples / 512 * 12);
+				set->msg_cb(set->msg_cb_ctx, MISRC_MSG_INFO, "Starting segment %u at sample %" PRIu64, seg_idx, total_samples);
+			}
+		}
+		// 40 MHz / 78.125 kHz = 512 RF samples per audio sample of 12 bytes
+		atomic_store(&thread_audio_ctx.seg.end, total_samples / 512 * 12);
 	}
+	atomic_store(&thread_audio_ctx.seg.end, UINT64_MAX);
 
 	if (do_exit)
 		set->msg_cb(set->msg_cb_ctx, MISRC_MSG_INFO, "User cancel, exiting...");
@@ -1027,17 +2142,34 @@ int misrc_run_capture(misrc_settings_t *set)
 ////ending of the program
 
 	aligned_free(buf_aux);
+	if (buf_drop) aligned_free(buf_drop);
 
-	if (output_aux && (output_aux != stdout)) fclose(output_aux);
-	if (output_raw && (output_raw != stdout)) fclose(output_raw);
+	for(int i=0; i<OUT_CNT; i++) {
+		if (thread_out[i] == 0 || thread_out_ctx[i].policy == BACKPRESSURE_BLOCK) continue;
+		if (thread_out_ctx[i].gap_start != UINT64_MAX) set->msg_cb(set->msg_cb_ctx, MISRC_MSG_ERROR, "%s output ends with a gap of %" PRIu64 " samples", thread_out_ctx[i].name, total_samples - thread_out_ctx[i].gap_start);
+		set->msg_cb(set->msg_cb_ctx, (thread_out_ctx[i].gaps == 0) ? MISRC_MSG_INFO : MISRC_MSG_ERROR, "%s output: %" PRIu64 " gaps, %" PRIu64 " samples dropped", thread_out_ctx[i].name, thread_out_ctx[i].gaps, thread_out_ctx[i].dropped);
+#if LIBFLAC_ENABLED == 1
+		if (thread_out_ctx[i].flac_relevel && !thread_out_ctx[i].flac_adaptive && atomic_load(&thread_out_ctx[i].flac_level_req) != set->flac_level) set->msg_cb(set->msg_cb_ctx, MISRC_MSG_WARNING, "%s output: FLAC compression level lowered from %u to %u", thread_out_ctx[i].name, (unsigned int)set->flac_level, atomic_load(&thread_out_ctx[i].flac_level_req));
+#endif
+	}
 
-	for(int i=0;i<2;i++) {
+	for(int i=0;i<OUT_CNT;i++) {
 		if (thread_out[i]!=0) {
 			r = thrd_join(thread_out[i], NULL);
 			if (r != thrd_success) set->msg_cb(set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Failed to join thread %d.", i);
 		}
 	}
 
+#if LIBFLAC_ENABLED == 1
+	// the verifiers catch up with the data written at the end
+	for(int i=0;i<2;i++) {
+		if (!thread_out_ctx[i].flac_check) continue;
+		flac_verify_finish(thread_out_ctx[i].flac_check);
+		free(thread_out_ctx[i].flac_check);
+		thread_out_ctx[i].flac_check = NULL;
+	}
+#endif
+
 	if (thread_audio!=0) {
 		r = thrd_join(thread_audio, NULL);
 		if (r != thrd_success) set->msg_cb(set->msg_cb_ctx, MISRC_MSG_CRITICAL, "Failed to join audio thread.");
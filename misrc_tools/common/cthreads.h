@@ -1,3 +1,6 @@
+#ifndef CTHREADS_H
+#define CTHREADS_H
+
 #ifdef _WIN32
   #include <windows.h>
   #include <process.h>
@@ -29,3 +32,5 @@
   #define thrd_sleep(a,b) nanosleep(a,b)
 
 #endif
+
+#endif // CTHREADS_H
@@ -47,6 +47,12 @@ default rel
 	%define level r10
 %endif
 
+%if WIN
+	%define state r13
+%else
+	%define state r11
+%endif
+
 %if WIN
 	%define to32_in   rcx
 	%define to32_out  rdx
@@ -90,6 +96,46 @@ default rel
 	%endif
 %endmacro
 
+; for the float extraction: additional state argument, xmm6-xmm13 are used
+%macro STARTF 0
+	%if WIN
+		push r12
+		push r13
+		mov outA, [rsp+56]
+		mov outB, [rsp+64]
+		mov level, [rsp+72]
+		mov state, [rsp+80]
+		sub rsp, 136
+		movdqa [rsp], xmm6
+		movdqa [rsp+16], xmm7
+		movdqa [rsp+32], xmm8
+		movdqa [rsp+48], xmm9
+		movdqa [rsp+64], xmm10
+		movdqa [rsp+80], xmm11
+		movdqa [rsp+96], xmm12
+		movdqa [rsp+112], xmm13
+	%else
+		mov level, [rsp+8]
+		mov state, [rsp+16]
+	%endif
+%endmacro
+
+%macro ENDF 0
+	%if WIN
+		movdqa xmm6, [rsp]
+		movdqa xmm7, [rsp+16]
+		movdqa xmm8, [rsp+32]
+		movdqa xmm9, [rsp+48]
+		movdqa xmm10, [rsp+64]
+		movdqa xmm11, [rsp+80]
+		movdqa xmm12, [rsp+96]
+		movdqa xmm13, [rsp+112]
+		add rsp, 136
+		pop r13
+		pop r12
+	%endif
+%endmacro
+
 %macro PEAKCALC16 2
 	pshufd xmm0, %2, 0b01001110
 	pmaxuw xmm0, %2
@@ -124,6 +170,14 @@ section .data
 	subval32:   dd  2047, 2047, 2047, 2047
 	clip_maskA: db	 1,	1,	1,	1,	1,	1,	1,	1
 	clip_maskB: db	 2,	2,	2,	2,	2,	2,	2,	2
+	ALIGN 16
+	mask12:	 dw  0x0fff, 0x0fff, 0x0fff, 0x0fff, 0x0fff, 0x0fff, 0x0fff, 0x0fff
+	mul_pack12: dw  1, 4096, 1, 4096, 1, 4096, 1, 4096
+	shuf_pack12: db	 0,	1,	2,	4,	5,	6,	8,	9,   10,   12,   13,   14, 0x80, 0x80, 0x80, 0x80
+	shuf_unpack12: db	 0,	1,	1,	2,	3,	4,	4,	5,	6,	7,	7,	8,	9,   10,   10,   11
+	mul_unpack12: dw  16, 1, 16, 1, 16, 1, 16, 1
+	mask_fff0:  dw  0xfff0, 0xfff0, 0xfff0, 0xfff0, 0xfff0, 0xfff0, 0xfff0, 0xfff0
+	round8:	 dw  8, 8, 8, 8, 8, 8, 8, 8
 
 section .text
 
@@ -652,6 +706,652 @@ loop_S_p_0:
 
 
 
+; pack 8 signed 12 bit samples in %1 into 12 bytes at %2 and advance %2
+%macro PACK12 2
+	pand %1, [mask12]
+	pmaddwd %1, [mul_pack12]
+	pshufb %1, [shuf_pack12]
+	movq [%2], %1
+	psrldq %1, 8
+	movd [%2+8], %1
+	add %2, 12
+%endmacro
+
+%macro EXTRACT_AB_12P 0
+%if PEAK
+	STARTP
+	pxor xmm7, xmm7
+	pxor xmm8, xmm8
+%else
+	START
+%endif
+%%loop_AB_12p:
+	movdqa xmm0, [in]
+	movdqa xmm1, [in+16]
+	movdqa xmm2, xmm0
+	movdqa xmm3, xmm1
+	pshufb xmm0, [shuf_dat]
+	pshufb xmm1, [shuf_dat]
+	movdqa xmm4, xmm0
+	movlhps xmm4, xmm1
+	movhlps xmm1, xmm0
+	psrlw xmm1, 4
+	pand xmm4, [andmask]
+	movdqa xmm5, [subval]
+	psubw xmm5, xmm4
+%if PEAK
+	pabsw xmm6, xmm5
+	pmaxuw xmm7, xmm6
+%endif
+	PACK12 xmm5, outA
+	movdqa xmm5, [subval]
+	psubw xmm5, xmm1
+%if PEAK
+	pabsw xmm6, xmm5
+	pmaxuw xmm8, xmm6
+%endif
+	PACK12 xmm5, outB
+	psrld xmm2, 12
+	psrld xmm3, 12
+	pshufb xmm2, [shuf_aux0]
+	pshufb xmm3, [shuf_aux1]
+	por xmm2, xmm3
+	movlpd [aux], xmm2
+	movq rax, xmm2
+	and rax, [clip_maskA]
+	popcnt rax, rax
+	add [clip], rax
+	movq rax, xmm2
+	and rax, [clip_maskB]
+	popcnt rax, rax
+	add [clip+8], rax
+	add aux, 8
+	add in, 32
+	sub len, 8
+	jg %%loop_AB_12p
+%if PEAK
+	PEAKCALC16 rax, xmm7
+	PEAKCALC16 rcx, xmm8
+	mov [level], ax
+	mov [level+2], cx
+	ENDP
+%endif
+	ret
+%endmacro
+
+%define PEAK 1
+global extract_AB_peak_12p_sse
+extract_AB_peak_12p_sse:
+	EXTRACT_AB_12P
+
+%define PEAK 0
+global extract_AB_12p_sse
+extract_AB_12p_sse:
+	EXTRACT_AB_12P
+
+
+
+%macro EXTRACT_A_12P 0
+%if PEAK
+	STARTP
+	pxor xmm7, xmm7
+%else
+	START
+%endif
+%%loop_A_12p:
+	movdqa xmm0, [in]
+	movdqa xmm1, [in+16]
+	movdqa xmm2, xmm0
+	movdqa xmm3, xmm1
+	pshufb xmm0, [shuf_dat]
+	pshufb xmm1, [shuf_dat]
+	movlhps xmm0, xmm1
+	pand xmm0, [andmask]
+	movdqa xmm4, [subval]
+	psubw xmm4, xmm0
+%if PEAK
+	pabsw xmm6, xmm4
+	pmaxuw xmm7, xmm6
+%endif
+	PACK12 xmm4, outA
+	psrld xmm2, 12
+	psrld xmm3, 12
+	pshufb xmm2, [shuf_aux0]
+	pshufb xmm3, [shuf_aux1]
+	por xmm2, xmm3
+	movlpd [aux], xmm2
+	movq rax, xmm2
+	and rax, [clip_maskA]
+	popcnt rax, rax
+	add [clip], rax
+	add aux, 8
+	add in, 32
+	sub len, 8
+	jg %%loop_A_12p
+%if PEAK
+	PEAKCALC16 rax, xmm7
+	mov [level], ax
+	ENDP
+%endif
+	ret
+%endmacro
+
+%define PEAK 1
+global extract_A_peak_12p_sse
+extract_A_peak_12p_sse:
+	EXTRACT_A_12P
+
+%define PEAK 0
+global extract_A_12p_sse
+extract_A_12p_sse:
+	EXTRACT_A_12P
+
+
+
+%macro EXTRACT_B_12P 0
+%if PEAK
+	STARTP
+	pxor xmm7, xmm7
+%else
+	START
+%endif
+%%loop_B_12p:
+	movdqa xmm0, [in]
+	movdqa xmm1, [in+16]
+	movdqa xmm2, xmm0
+	movdqa xmm3, xmm1
+	pshufb xmm0, [shuf_dat]
+	pshufb xmm1, [shuf_dat]
+	movhlps xmm1, xmm0
+	psrlw xmm1, 4
+	movdqa xmm4, [subval]
+	psubw xmm4, xmm1
+%if PEAK
+	pabsw xmm6, xmm4
+	pmaxuw xmm7, xmm6
+%endif
+	PACK12 xmm4, outB
+	psrld xmm2, 12
+	psrld xmm3, 12
+	pshufb xmm2, [shuf_aux0]
+	pshufb xmm3, [shuf_aux1]
+	por xmm2, xmm3
+	movlpd [aux], xmm2
+	movq rax, xmm2
+	and rax, [clip_maskB]
+	popcnt rax, rax
+	add [clip+8], rax
+	add aux, 8
+	add in, 32
+	sub len, 8
+	jg %%loop_B_12p
+%if PEAK
+	PEAKCALC16 rax, xmm7
+	mov [level+2], ax
+	ENDP
+%endif
+	ret
+%endmacro
+
+%define PEAK 1
+global extract_B_peak_12p_sse
+extract_B_peak_12p_sse:
+	EXTRACT_B_12P
+
+%define PEAK 0
+global extract_B_12p_sse
+extract_B_12p_sse:
+	EXTRACT_B_12P
+
+
+
+global extract_S_12p_sse
+extract_S_12p_sse:
+	START
+loop_S_12p:
+	movdqa xmm0, [in]
+	movdqa xmm2, xmm0
+	pand xmm0, [andmask]
+	movdqa xmm4, [subval]
+	psubw xmm4, xmm0
+	PACK12 xmm4, outA
+	psrlw xmm2, 12
+	pshufb xmm2, [shuf_auxS]
+	movlpd [aux], xmm2
+	movq rax, xmm2
+	and rax, [clip_maskA]
+	popcnt rax, rax
+	add [clip], rax
+	add aux, 8
+	add in, 16
+	sub len, 8
+	jg loop_S_12p
+	ret
+
+
+
+; SSSE3, reads 4 bytes beyond the last 12 byte group
+%macro CONVERT_12PTO16 0
+%%loop_12pto16:
+	movdqu xmm0, [to32_in]
+	pshufb xmm0, [shuf_unpack12]
+	pmullw xmm0, [mul_unpack12]
+	pand xmm0, [mask_fff0]
+%if PAD == 0
+	psraw xmm0, 4
+%endif
+	movdqa [to32_out], xmm0
+	add to32_in, 12
+	add to32_out, 16
+	sub to32_len, 8
+	jg %%loop_12pto16
+	ret
+%endmacro
+
+%define PAD 0
+global convert_12pto16_sse
+convert_12pto16_sse:
+	CONVERT_12PTO16
+
+%define PAD 1
+global convert_12pto16_p_sse
+convert_12pto16_p_sse:
+	CONVERT_12PTO16
+
+
+
+; reduce 8 signed 12 bit samples in %1 to 8 bit and store them at %2 (as bytes or dwords)
+%macro REDUCE8 2
+%if RND
+	paddw %1, [round8]
+%endif
+	psraw %1, 4
+	packsswb %1, %1
+%if OUT32
+	pmovsxbd xmm6, %1
+	movdqa [%2], xmm6
+	psrldq %1, 4
+	pmovsxbd xmm6, %1
+	movdqa [%2+16], xmm6
+	add %2, 32
+%else
+	movq [%2], %1
+	add %2, 8
+%endif
+%endmacro
+
+; SSE4.1
+%macro EXTRACT_8 0
+%if PEAK
+	STARTP
+	pxor xmm7, xmm7
+	pxor xmm8, xmm8
+%else
+	START
+%endif
+%%loop_8:
+	movdqa xmm0, [in]
+	movdqa xmm1, [in+16]
+	movdqa xmm2, xmm0
+	movdqa xmm3, xmm1
+	pshufb xmm0, [shuf_dat]
+	pshufb xmm1, [shuf_dat]
+%if CHA
+	movdqa xmm4, xmm0
+	movlhps xmm4, xmm1
+	pand xmm4, [andmask]
+	movdqa xmm5, [subval]
+	psubw xmm5, xmm4
+%if PEAK
+	pabsw xmm6, xmm5
+	pmaxuw xmm7, xmm6
+%endif
+	REDUCE8 xmm5, outA
+%endif
+%if CHB
+	movhlps xmm1, xmm0
+	psrlw xmm1, 4
+	movdqa xmm5, [subval]
+	psubw xmm5, xmm1
+%if PEAK
+	pabsw xmm6, xmm5
+	pmaxuw xmm8, xmm6
+%endif
+	REDUCE8 xmm5, outB
+%endif
+	psrld xmm2, 12
+	psrld xmm3, 12
+	pshufb xmm2, [shuf_aux0]
+	pshufb xmm3, [shuf_aux1]
+	por xmm2, xmm3
+	movlpd [aux], xmm2
+%if CHA
+	movq rax, xmm2
+	and rax, [clip_maskA]
+	popcnt rax, rax
+	add [clip], rax
+%endif
+%if CHB
+	movq rax, xmm2
+	and rax, [clip_maskB]
+	popcnt rax, rax
+	add [clip+8], rax
+%endif
+	add aux, 8
+	add in, 32
+	sub len, 8
+	jg %%loop_8
+%if PEAK
+%if CHA
+	PEAKCALC16 rax, xmm7
+	mov [level], ax
+%endif
+%if CHB
+	PEAKCALC16 rax, xmm8
+	mov [level+2], ax
+%endif
+	ENDP
+%endif
+	ret
+%endmacro
+
+%define RND 0
+%define OUT32 0
+%define PEAK 1
+%define CHA 1
+%define CHB 0
+global extract_A_8t_peak_sse
+extract_A_8t_peak_sse:
+	EXTRACT_8
+
+%define CHA 0
+%define CHB 1
+global extract_B_8t_peak_sse
+extract_B_8t_peak_sse:
+	EXTRACT_8
+
+%define CHA 1
+%define CHB 1
+global extract_AB_8t_peak_sse
+extract_AB_8t_peak_sse:
+	EXTRACT_8
+
+%define PEAK 0
+%define CHA 1
+%define CHB 0
+global extract_A_8t_sse
+extract_A_8t_sse:
+	EXTRACT_8
+
+%define CHA 0
+%define CHB 1
+global extract_B_8t_sse
+extract_B_8t_sse:
+	EXTRACT_8
+
+%define CHA 1
+%define CHB 1
+global extract_AB_8t_sse
+extract_AB_8t_sse:
+	EXTRACT_8
+
+%define OUT32 1
+%define PEAK 1
+%define CHA 1
+%define CHB 0
+global extract_A_8t_peak_32_sse
+extract_A_8t_peak_32_sse:
+	EXTRACT_8
+
+%define CHA 0
+%define CHB 1
+global extract_B_8t_peak_32_sse
+extract_B_8t_peak_32_sse:
+	EXTRACT_8
+
+%define CHA 1
+%define CHB 1
+global extract_AB_8t_peak_32_sse
+extract_AB_8t_peak_32_sse:
+	EXTRACT_8
+
+%define PEAK 0
+%define CHA 1
+%define CHB 0
+global extract_A_8t_32_sse
+extract_A_8t_32_sse:
+	EXTRACT_8
+
+%define CHA 0
+%define CHB 1
+global extract_B_8t_32_sse
+extract_B_8t_32_sse:
+	EXTRACT_8
+
+%define CHA 1
+%define CHB 1
+global extract_AB_8t_32_sse
+extract_AB_8t_32_sse:
+	EXTRACT_8
+
+
+%define RND 1
+%define OUT32 0
+%define PEAK 1
+%define CHA 1
+%define CHB 0
+global extract_A_8r_peak_sse
+extract_A_8r_peak_sse:
+	EXTRACT_8
+
+%define CHA 0
+%define CHB 1
+global extract_B_8r_peak_sse
+extract_B_8r_peak_sse:
+	EXTRACT_8
+
+%define CHA 1
+%define CHB 1
+global extract_AB_8r_peak_sse
+extract_AB_8r_peak_sse:
+	EXTRACT_8
+
+%define PEAK 0
+%define CHA 1
+%define CHB 0
+global extract_A_8r_sse
+extract_A_8r_sse:
+	EXTRACT_8
+
+%define CHA 0
+%define CHB 1
+global extract_B_8r_sse
+extract_B_8r_sse:
+	EXTRACT_8
+
+%define CHA 1
+%define CHB 1
+global extract_AB_8r_sse
+extract_AB_8r_sse:
+	EXTRACT_8
+
+%define OUT32 1
+%define PEAK 1
+%define CHA 1
+%define CHB 0
+global extract_A_8r_peak_32_sse
+extract_A_8r_peak_32_sse:
+	EXTRACT_8
+
+%define CHA 0
+%define CHB 1
+global extract_B_8r_peak_32_sse
+extract_B_8r_peak_32_sse:
+	EXTRACT_8
+
+%define CHA 1
+%define CHB 1
+global extract_AB_8r_peak_32_sse
+extract_AB_8r_peak_32_sse:
+	EXTRACT_8
+
+%define PEAK 0
+%define CHA 1
+%define CHB 0
+global extract_A_8r_32_sse
+extract_A_8r_32_sse:
+	EXTRACT_8
+
+%define CHA 0
+%define CHB 1
+global extract_B_8r_32_sse
+extract_B_8r_32_sse:
+	EXTRACT_8
+
+%define CHA 1
+%define CHB 1
+global extract_AB_8r_32_sse
+extract_AB_8r_32_sse:
+	EXTRACT_8
+
+
+
+; convert 4 signed samples in %1 to float, subtract DC %3, scale and store at %2,
+; the samples are also added to the 64 bit sums in %4
+%macro TOFLOAT 4
+	pmovsxdq xmm6, %1
+	paddq %4, xmm6
+	pshufd xmm6, %1, 0b01001110
+	pmovsxdq xmm6, xmm6
+	paddq %4, xmm6
+	cvtdq2ps %1, %1
+	subps %1, %3
+	mulps %1, xmm9
+	movaps [%2], %1
+	add %2, 16
+%endmacro
+
+; SSE4.1
+%macro EXTRACT_F32 0
+	STARTF
+	pxor xmm7, xmm7
+	pxor xmm8, xmm8
+	pxor xmm12, xmm12
+	pxor xmm13, xmm13
+	movss xmm9, [state]
+	shufps xmm9, xmm9, 0
+	movss xmm10, [state+4]
+	shufps xmm10, xmm10, 0
+	movss xmm11, [state+8]
+	shufps xmm11, xmm11, 0
+%%loop_f32:
+	movdqa xmm0, [in]
+%if CHA
+	movdqa xmm2, xmm0
+	pand xmm2, [andmask32]
+	movdqa xmm5, [subval32]
+	psubd xmm5, xmm2
+%if PEAK
+	pabsd xmm6, xmm5
+	pmaxud xmm7, xmm6
+%endif
+	TOFLOAT xmm5, outA, xmm10, xmm12
+%endif
+%if CHB
+	movdqa xmm2, xmm0
+	psrld xmm2, 20
+	movdqa xmm5, [subval32]
+	psubd xmm5, xmm2
+%if PEAK
+	pabsd xmm6, xmm5
+	pmaxud xmm8, xmm6
+%endif
+	TOFLOAT xmm5, outB, xmm11, xmm13
+%endif
+	psrld xmm0, 12
+	pshufb xmm0, [shuf_aux0]
+	movd [aux], xmm0
+%if CHA
+	movd eax, xmm0
+	and eax, [clip_maskA]
+	popcnt eax, eax
+	add [clip], rax
+%endif
+%if CHB
+	movd eax, xmm0
+	and eax, [clip_maskB]
+	popcnt eax, eax
+	add [clip+8], rax
+%endif
+	add aux, 4
+	add in, 16
+	sub len, 4
+	jg %%loop_f32
+%if CHA
+	pshufd xmm6, xmm12, 0b01001110
+	paddq xmm12, xmm6
+	movq [state+16], xmm12
+%endif
+%if CHB
+	pshufd xmm6, xmm13, 0b01001110
+	paddq xmm13, xmm6
+	movq [state+24], xmm13
+%endif
+%if PEAK
+%if CHA
+	PEAKCALC32 rax, xmm7
+	mov [level], ax
+%endif
+%if CHB
+	PEAKCALC32 rax, xmm8
+	mov [level+2], ax
+%endif
+%endif
+	ENDF
+	ret
+%endmacro
+
+%define PEAK 1
+%define CHA 1
+%define CHB 0
+global extract_A_peak_f32_sse
+extract_A_peak_f32_sse:
+	EXTRACT_F32
+
+%define CHA 0
+%define CHB 1
+global extract_B_peak_f32_sse
+extract_B_peak_f32_sse:
+	EXTRACT_F32
+
+%define CHA 1
+%define CHB 1
+global extract_AB_peak_f32_sse
+extract_AB_peak_f32_sse:
+	EXTRACT_F32
+
+
+%define PEAK 0
+%define CHA 1
+%define CHB 0
+global extract_A_f32_sse
+extract_A_f32_sse:
+	EXTRACT_F32
+
+%define CHA 0
+%define CHB 1
+global extract_B_f32_sse
+extract_B_f32_sse:
+	EXTRACT_F32
+
+%define CHA 1
+%define CHB 1
+global extract_AB_f32_sse
+extract_AB_f32_sse:
+	EXTRACT_F32
+
+
+
 ; SSE4.1
 global convert_16to32_sse
 convert_16to32_sse:
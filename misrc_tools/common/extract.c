@@ -404,6 +404,261 @@ void extract_AB_p_peak_32_C(uint32_t *in, size_t len, size_t *clip, uint8_t *aux
 	}
 }
 
+/* packed 12 bit: two samples are stored in three bytes (little endian),
+   first sample in the lower 12 bits of the 24 bit word */
+#define PACK12(out, s0, s1) do { \
+		(out)[0] = (uint8_t)(s0); \
+		(out)[1] = (uint8_t)((((s0) >> 8) & 0x0F) | ((s1) << 4)); \
+		(out)[2] = (uint8_t)((s1) >> 4); \
+	} while(0)
+
+void extract_S_12p_C(uint16_t *in, size_t len, size_t *clip, uint8_t *aux, uint8_t *outA, uint8_t UNUSED(*outB), uint16_t UNUSED(*peak_level)) {
+	for(size_t i = 0; i < len; i+=2)
+	{
+		int16_t s0 = 2047 - ((int16_t)(in[i] & MASK_1));
+		int16_t s1 = 2047 - ((int16_t)(in[i+1] & MASK_1));
+		PACK12(outA, s0, s1);
+		outA += 3;
+		aux[i]   = (in[i] & MASK_AUXS) >> 12;
+		aux[i+1] = (in[i+1] & MASK_AUXS) >> 12;
+		clip[0] += ((in[i] >> 12) & 1) + ((in[i+1] >> 12) & 1);
+	}
+}
+
+void extract_A_12p_C(uint32_t *in, size_t len, size_t *clip, uint8_t *aux, uint8_t *outA, uint8_t UNUSED(*outB), uint16_t UNUSED(*peak_level)) {
+	for(size_t i = 0; i < len; i+=2)
+	{
+		int16_t s0 = 2047 - ((int16_t)(in[i] & MASK_1));
+		int16_t s1 = 2047 - ((int16_t)(in[i+1] & MASK_1));
+		PACK12(outA, s0, s1);
+		outA += 3;
+		aux[i]   = (in[i] & MASK_AUX) >> 12;
+		aux[i+1] = (in[i+1] & MASK_AUX) >> 12;
+		clip[0] += ((in[i] >> 12) & 1) + ((in[i+1] >> 12) & 1);
+	}
+}
+
+void extract_A_peak_12p_C(uint32_t *in, size_t len, size_t *clip, uint8_t *aux, uint8_t *outA, uint8_t UNUSED(*outB), uint16_t *peak_level) {
+	peak_level[0] = 0;
+	for(size_t i = 0; i < len; i+=2)
+	{
+		int16_t s0 = 2047 - ((int16_t)(in[i] & MASK_1));
+		int16_t s1 = 2047 - ((int16_t)(in[i+1] & MASK_1));
+		PACK12(outA, s0, s1);
+		outA += 3;
+		aux[i]   = (in[i] & MASK_AUX) >> 12;
+		aux[i+1] = (in[i+1] & MASK_AUX) >> 12;
+		clip[0] += ((in[i] >> 12) & 1) + ((in[i+1] >> 12) & 1);
+		if(abs(s0)>peak_level[0]) peak_level[0] = abs(s0);
+		if(abs(s1)>peak_level[0]) peak_level[0] = abs(s1);
+	}
+}
+
+void extract_B_12p_C(uint32_t *in, size_t len, size_t *clip, uint8_t *aux, uint8_t UNUSED(*outA), uint8_t *outB, uint16_t UNUSED(*peak_level)) {
+	for(size_t i = 0; i < len; i+=2)
+	{
+		int16_t s0 = 2047 - ((int16_t)((in[i] & MASK_2) >> 20));
+		int16_t s1 = 2047 - ((int16_t)((in[i+1] & MASK_2) >> 20));
+		PACK12(outB, s0, s1);
+		outB += 3;
+		aux[i]   = (in[i] & MASK_AUX) >> 12;
+		aux[i+1] = (in[i+1] & MASK_AUX) >> 12;
+		clip[1] += ((in[i] >> 13) & 1) + ((in[i+1] >> 13) & 1);
+	}
+}
+
+void extract_B_peak_12p_C(uint32_t *in, size_t len, size_t *clip, uint8_t *aux, uint8_t UNUSED(*outA), uint8_t *outB, uint16_t *peak_level) {
+	peak_level[1] = 0;
+	for(size_t i = 0; i < len; i+=2)
+	{
+		int16_t s0 = 2047 - ((int16_t)((in[i] & MASK_2) >> 20));
+		int16_t s1 = 2047 - ((int16_t)((in[i+1] & MASK_2) >> 20));
+		PACK12(outB, s0, s1);
+		outB += 3;
+		aux[i]   = (in[i] & MASK_AUX) >> 12;
+		aux[i+1] = (in[i+1] & MASK_AUX) >> 12;
+		clip[1] += ((in[i] >> 13) & 1) + ((in[i+1] >> 13) & 1);
+		if(abs(s0)>peak_level[1]) peak_level[1] = abs(s0);
+		if(abs(s1)>peak_level[1]) peak_level[1] = abs(s1);
+	}
+}
+
+void extract_AB_12p_C(uint32_t *in, size_t len, size_t *clip, uint8_t *aux, uint8_t *outA, uint8_t *outB, uint16_t UNUSED(*peak_level)) {
+	for(size_t i = 0; i < len; i+=2)
+	{
+		int16_t a0 = 2047 - ((int16_t)(in[i] & MASK_1));
+		int16_t a1 = 2047 - ((int16_t)(in[i+1] & MASK_1));
+		int16_t b0 = 2047 - ((int16_t)((in[i] & MASK_2) >> 20));
+		int16_t b1 = 2047 - ((int16_t)((in[i+1] & MASK_2) >> 20));
+		PACK12(outA, a0, a1);
+		PACK12(outB, b0, b1);
+		outA += 3;
+		outB += 3;
+		aux[i]   = (in[i] & MASK_AUX) >> 12;
+		aux[i+1] = (in[i+1] & MASK_AUX) >> 12;
+		clip[0] += ((in[i] >> 12) & 1) + ((in[i+1] >> 12) & 1);
+		clip[1] += ((in[i] >> 13) & 1) + ((in[i+1] >> 13) & 1);
+	}
+}
+
+void extract_AB_peak_12p_C(uint32_t *in, size_t len, size_t *clip, uint8_t *aux, uint8_t *outA, uint8_t *outB, uint16_t *peak_level) {
+	peak_level[0] = 0;
+	peak_level[1] = 0;
+	for(size_t i = 0; i < len; i+=2)
+	{
+		int16_t a0 = 2047 - ((int16_t)(in[i] & MASK_1));
+		int16_t a1 = 2047 - ((int16_t)(in[i+1] & MASK_1));
+		int16_t b0 = 2047 - ((int16_t)((in[i] & MASK_2) >> 20));
+		int16_t b1 = 2047 - ((int16_t)((in[i+1] & MASK_2) >> 20));
+		PACK12(outA, a0, a1);
+		PACK12(outB, b0, b1);
+		outA += 3;
+		outB += 3;
+		aux[i]   = (in[i] & MASK_AUX) >> 12;
+		aux[i+1] = (in[i+1] & MASK_AUX) >> 12;
+		clip[0] += ((in[i] >> 12) & 1) + ((in[i+1] >> 12) & 1);
+		clip[1] += ((in[i] >> 13) & 1) + ((in[i+1] >> 13) & 1);
+		if(abs(a0)>peak_level[0]) peak_level[0] = abs(a0);
+		if(abs(a1)>peak_level[0]) peak_level[0] = abs(a1);
+		if(abs(b0)>peak_level[1]) peak_level[1] = abs(b0);
+		if(abs(b1)>peak_level[1]) peak_level[1] = abs(b1);
+	}
+}
+
+/* direct reduction to 8 bit, a 12 bit sample v becomes v/16 with the selected rounding:
+   truncate (floor), round (to nearest) or dither (triangular noise of +-1 LSB before rounding) */
+#if defined(_MSC_VER)
+static __declspec(thread) uint32_t dither_state = 0x9E3779B9;
+#else
+static _Thread_local uint32_t dither_state = 0x9E3779B9;
+#endif
+
+static inline int32_t dither_noise() {
+	uint32_t x = dither_state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	dither_state = x;
+	return (int32_t)(x & 0xF) - (int32_t)((x >> 4) & 0xF);
+}
+
+static inline int32_t sat_8bit(int32_t v) {
+	return (v > 127) ? 127 : ((v < -128) ? -128 : v);
+}
+
+#define REDUCE_8T(v) ((int32_t)(v) >> 4)
+#define REDUCE_8R(v) sat_8bit(((int32_t)(v) + 8) >> 4)
+#define REDUCE_8D(v) sat_8bit(((int32_t)(v) + 8 + dither_noise()) >> 4)
+
+#define EXTRACT_8BIT_C(mode, suffix, otype, REDUCE) \
+void extract_A_##mode##suffix##_C(uint32_t *in, size_t len, size_t *clip, uint8_t *aux, otype *outA, otype UNUSED(*outB), uint16_t *peak_level) { \
+	uint16_t peak = 0; \
+	for(size_t i = 0; i < len; i++) \
+	{ \
+		int16_t v = 2047 - ((int16_t)(in[i] & MASK_1)); \
+		outA[i] = REDUCE(v); \
+		aux[i] = (in[i] & MASK_AUX) >> 12; \
+		clip[0] += (in[i] >> 12) & 1; \
+		if(abs(v)>peak) peak = abs(v); \
+	} \
+	if (peak_level) peak_level[0] = peak; \
+} \
+void extract_B_##mode##suffix##_C(uint32_t *in, size_t len, size_t *clip, uint8_t *aux, otype UNUSED(*outA), otype *outB, uint16_t *peak_level) { \
+	uint16_t peak = 0; \
+	for(size_t i = 0; i < len; i++) \
+	{ \
+		int16_t v = 2047 - ((int16_t)((in[i] & MASK_2) >> 20)); \
+		outB[i] = REDUCE(v); \
+		aux[i] = (in[i] & MASK_AUX) >> 12; \
+		clip[1] += (in[i] >> 13) & 1; \
+		if(abs(v)>peak) peak = abs(v); \
+	} \
+	if (peak_level) peak_level[1] = peak; \
+} \
+void extract_AB_##mode##suffix##_C(uint32_t *in, size_t len, size_t *clip, uint8_t *aux, otype *outA, otype *outB, uint16_t *peak_level) { \
+	uint16_t peak[2] = { 0, 0 }; \
+	for(size_t i = 0; i < len; i++) \
+	{ \
+		int16_t a = 2047 - ((int16_t)(in[i] & MASK_1)); \
+		int16_t b = 2047 - ((int16_t)((in[i] & MASK_2) >> 20)); \
+		outA[i] = REDUCE(a); \
+		outB[i] = REDUCE(b); \
+		aux[i] = (in[i] & MASK_AUX) >> 12; \
+		clip[0] += (in[i] >> 12) & 1; \
+		clip[1] += (in[i] >> 13) & 1; \
+		if(abs(a)>peak[0]) peak[0] = abs(a); \
+		if(abs(b)>peak[1]) peak[1] = abs(b); \
+	} \
+	if (peak_level) { \
+		peak_level[0] = peak[0]; \
+		peak_level[1] = peak[1]; \
+	} \
+}
+
+EXTRACT_8BIT_C(8t, , int8_t, REDUCE_8T)
+EXTRACT_8BIT_C(8r, , int8_t, REDUCE_8R)
+EXTRACT_8BIT_C(8d, , int8_t, REDUCE_8D)
+EXTRACT_8BIT_C(8t, _32, int32_t, REDUCE_8T)
+EXTRACT_8BIT_C(8r, _32, int32_t, REDUCE_8R)
+EXTRACT_8BIT_C(8d, _32, int32_t, REDUCE_8D)
+
+void extract_A_f32_C(uint32_t *in, size_t len, size_t *clip, uint8_t *aux, float *outA, float UNUSED(*outB), uint16_t *peak_level, extract_float_state_t *state) {
+	uint16_t peak = 0;
+	int64_t sum = 0;
+	for(size_t i = 0; i < len; i++)
+	{
+		int16_t v = 2047 - ((int16_t)(in[i] & MASK_1));
+		outA[i] = ((float)v - state->dc[0]) * state->scale;
+		sum += v;
+		aux[i] = (in[i] & MASK_AUX) >> 12;
+		clip[0] += (in[i] >> 12) & 1;
+		if(abs(v)>peak) peak = abs(v);
+	}
+	state->sum[0] = sum;
+	if (peak_level) peak_level[0] = peak;
+}
+
+void extract_B_f32_C(uint32_t *in, size_t len, size_t *clip, uint8_t *aux, float UNUSED(*outA), float *outB, uint16_t *peak_level, extract_float_state_t *state) {
+	uint16_t peak = 0;
+	int64_t sum = 0;
+	for(size_t i = 0; i < len; i++)
+	{
+		int16_t v = 2047 - ((int16_t)((in[i] & MASK_2) >> 20));
+		outB[i] = ((float)v - state->dc[1]) * state->scale;
+		sum += v;
+		aux[i] = (in[i] & MASK_AUX) >> 12;
+		clip[1] += (in[i] >> 13) & 1;
+		if(abs(v)>peak) peak = abs(v);
+	}
+	state->sum[1] = sum;
+	if (peak_level) peak_level[1] = peak;
+}
+
+void extract_AB_f32_C(uint32_t *in, size_t len, size_t *clip, uint8_t *aux, float *outA, float *outB, uint16_t *peak_level, extract_float_state_t *state) {
+	uint16_t peak[2] = { 0, 0 };
+	int64_t sum[2] = { 0, 0 };
+	for(size_t i = 0; i < len; i++)
+	{
+		int16_t a = 2047 - ((int16_t)(in[i] & MASK_1));
+		int16_t b = 2047 - ((int16_t)((in[i] & MASK_2) >> 20));
+		outA[i] = ((float)a - state->dc[0]) * state->scale;
+		outB[i] = ((float)b - state->dc[1]) * state->scale;
+		sum[0] += a;
+		sum[1] += b;
+		aux[i] = (in[i] & MASK_AUX) >> 12;
+		clip[0] += (in[i] >> 12) & 1;
+		clip[1] += (in[i] >> 13) & 1;
+		if(abs(a)>peak[0]) peak[0] = abs(a);
+		if(abs(b)>peak[1]) peak[1] = abs(b);
+	}
+	state->sum[0] = sum[0];
+	state->sum[1] = sum[1];
+	if (peak_level) {
+		peak_level[0] = peak[0];
+		peak_level[1] = peak[1];
+	}
+}
+
 void convert_16to32_C(int16_t *in, int32_t *out, size_t len) {
 	for(size_t i = 0; i < len; i++)
 	{
@@ -432,6 +687,24 @@ void convert_16to8_C(int16_t *in, int8_t *out, size_t len) {
 	}
 }
 
+void convert_12pto16_C(uint8_t *in, int16_t *out, size_t len) {
+	for(size_t i = 0; i < len; i+=2)
+	{
+		out[i]   = ((int16_t)((in[0] | (in[1] << 8)) << 4)) >> 4;
+		out[i+1] = ((int16_t)((in[1] | (in[2] << 8)) & 0xFFF0)) >> 4;
+		in += 3;
+	}
+}
+
+void convert_12pto16_p_C(uint8_t *in, int16_t *out, size_t len) {
+	for(size_t i = 0; i < len; i+=2)
+	{
+		out[i]   = (int16_t)((in[0] | (in[1] << 8)) << 4);
+		out[i+1] = (int16_t)((in[1] | (in[2] << 8)) & 0xFFF0);
+		in += 3;
+	}
+}
+
 /* untested, therefore not used yet */
 #if defined(__aarch64__) || defined(__arm64__)
 #include <arm_neon.h>
@@ -619,6 +892,162 @@ conv_function_t get_conv_function(bool single, bool pad, bool dword, bool peak_l
 	return NULL;
 }
 
+conv_function_t get_conv_12p_function(bool single, bool peak_level, void* outA, void* outB) {
+
+	if (single) peak_level = 0;
+
+	if (outA == NULL && outB == NULL) return get_conv_function(single, false, false, peak_level, outA, outB);
+#if defined(__x86_64__) || defined(_M_X64)
+	if (peak_level) {
+		if(check_cpu_feat()>=2) {
+			fprintf(stderr,"Detected processor with SSE4.1, using optimized 12 bit packing routine\n\n");
+			if (outA == NULL) return (conv_function_t) &extract_B_peak_12p_sse;
+			if (outB == NULL) return (conv_function_t) &extract_A_peak_12p_sse;
+			return (conv_function_t) &extract_AB_peak_12p_sse;
+		}
+	}
+	else {
+		if(check_cpu_feat()>=1) {
+			fprintf(stderr,"Detected processor with SSSE3 and POPCNT, using optimized 12 bit packing routine\n\n");
+			if (single == 1) return (conv_function_t) &extract_S_12p_sse;
+			if (outA == NULL) return (conv_function_t) &extract_B_12p_sse;
+			if (outB == NULL) return (conv_function_t) &extract_A_12p_sse;
+			return (conv_function_t) &extract_AB_12p_sse;
+		}
+	}
+	if (peak_level) fprintf(stderr,"Detected processor without SSE4.1, using standard 12 bit packing routine\n\n");
+	else  fprintf(stderr,"Detected processor without SSSE3 and POPCNT, using standard 12 bit packing routine\n\n");
+#endif
+	if (peak_level) {
+		if (outA == NULL) return (conv_function_t) &extract_B_peak_12p_C;
+		if (outB == NULL) return (conv_function_t) &extract_A_peak_12p_C;
+		return (conv_function_t) &extract_AB_peak_12p_C;
+	}
+	if (single == 1) return (conv_function_t) &extract_S_12p_C;
+	if (outA == NULL) return (conv_function_t) &extract_B_12p_C;
+	if (outB == NULL) return (conv_function_t) &extract_A_12p_C;
+	return (conv_function_t) &extract_AB_12p_C;
+}
+
+conv_function_t get_conv_8bit_function(int rounding, bool dword, bool peak_level, void* outA, void* outB) {
+
+	if (outA == NULL && outB == NULL) return get_conv_function(false, false, false, peak_level, outA, outB);
+#if defined(__x86_64__) || defined(_M_X64)
+	if (rounding != EXTRACT_8BIT_DITHER) {
+		if (check_cpu_feat()>=2) {
+			fprintf(stderr,"Detected processor with SSE4.1, using optimized 8 bit extraction routine\n\n");
+			if (rounding == EXTRACT_8BIT_ROUND) {
+				if (dword) {
+					if (peak_level) {
+						if (outA == NULL) return (conv_function_t) &extract_B_8r_peak_32_sse;
+						if (outB == NULL) return (conv_function_t) &extract_A_8r_peak_32_sse;
+						return (conv_function_t) &extract_AB_8r_peak_32_sse;
+					}
+					if (outA == NULL) return (conv_function_t) &extract_B_8r_32_sse;
+					if (outB == NULL) return (conv_function_t) &extract_A_8r_32_sse;
+					return (conv_function_t) &extract_AB_8r_32_sse;
+				}
+				if (peak_level) {
+					if (outA == NULL) return (conv_function_t) &extract_B_8r_peak_sse;
+					if (outB == NULL) return (conv_function_t) &extract_A_8r_peak_sse;
+					return (conv_function_t) &extract_AB_8r_peak_sse;
+				}
+				if (outA == NULL) return (conv_function_t) &extract_B_8r_sse;
+				if (outB == NULL) return (conv_function_t) &extract_A_8r_sse;
+				return (conv_function_t) &extract_AB_8r_sse;
+			}
+			else {
+				if (dword) {
+					if (peak_level) {
+						if (outA == NULL) return (conv_function_t) &extract_B_8t_peak_32_sse;
+						if (outB == NULL) return (conv_function_t) &extract_A_8t_peak_32_sse;
+						return (conv_function_t) &extract_AB_8t_peak_32_sse;
+					}
+					if (outA == NULL) return (conv_function_t) &extract_B_8t_32_sse;
+					if (outB == NULL) return (conv_function_t) &extract_A_8t_32_sse;
+					return (conv_function_t) &extract_AB_8t_32_sse;
+				}
+				if (peak_level) {
+					if (outA == NULL) return (conv_function_t) &extract_B_8t_peak_sse;
+					if (outB == NULL) return (conv_function_t) &extract_A_8t_peak_sse;
+					return (conv_function_t) &extract_AB_8t_peak_sse;
+				}
+				if (outA == NULL) return (conv_function_t) &extract_B_8t_sse;
+				if (outB == NULL) return (conv_function_t) &extract_A_8t_sse;
+				return (conv_function_t) &extract_AB_8t_sse;
+			}
+		}
+		fprintf(stderr,"Detected processor without SSE4.1, using standard 8 bit extraction routine\n\n");
+	}
+#endif
+	if (dword) {
+		if (rounding == EXTRACT_8BIT_DITHER) {
+			if (outA == NULL) return (conv_function_t) &extract_B_8d_32_C;
+			if (outB == NULL) return (conv_function_t) &extract_A_8d_32_C;
+			return (conv_function_t) &extract_AB_8d_32_C;
+		}
+		if (rounding == EXTRACT_8BIT_ROUND) {
+			if (outA == NULL) return (conv_function_t) &extract_B_8r_32_C;
+			if (outB == NULL) return (conv_function_t) &extract_A_8r_32_C;
+			return (conv_function_t) &extract_AB_8r_32_C;
+		}
+		if (outA == NULL) return (conv_function_t) &extract_B_8t_32_C;
+		if (outB == NULL) return (conv_function_t) &extract_A_8t_32_C;
+		return (conv_function_t) &extract_AB_8t_32_C;
+	}
+	if (rounding == EXTRACT_8BIT_DITHER) {
+		if (outA == NULL) return (conv_function_t) &extract_B_8d_C;
+		if (outB == NULL) return (conv_function_t) &extract_A_8d_C;
+		return (conv_function_t) &extract_AB_8d_C;
+	}
+	if (rounding == EXTRACT_8BIT_ROUND) {
+		if (outA == NULL) return (conv_function_t) &extract_B_8r_C;
+		if (outB == NULL) return (conv_function_t) &extract_A_8r_C;
+		return (conv_function_t) &extract_AB_8r_C;
+	}
+	if (outA == NULL) return (conv_function_t) &extract_B_8t_C;
+	if (outB == NULL) return (conv_function_t) &extract_A_8t_C;
+	return (conv_function_t) &extract_AB_8t_C;
+}
+
+conv_float_function_t get_conv_float_function(bool peak_level, void* outA, void* outB) {
+
+	if (outA == NULL && outB == NULL) return NULL;
+#if defined(__x86_64__) || defined(_M_X64)
+	if (check_cpu_feat()>=2) {
+		fprintf(stderr,"Detected processor with SSE4.1, using optimized float extraction routine\n\n");
+		if (peak_level) {
+			if (outA == NULL) return (conv_float_function_t) &extract_B_peak_f32_sse;
+			if (outB == NULL) return (conv_float_function_t) &extract_A_peak_f32_sse;
+			return (conv_float_function_t) &extract_AB_peak_f32_sse;
+		}
+		if (outA == NULL) return (conv_float_function_t) &extract_B_f32_sse;
+		if (outB == NULL) return (conv_float_function_t) &extract_A_f32_sse;
+		return (conv_float_function_t) &extract_AB_f32_sse;
+	}
+	fprintf(stderr,"Detected processor without SSE4.1, using standard float extraction routine\n\n");
+#endif
+	if (outA == NULL) return (conv_float_function_t) &extract_B_f32_C;
+	if (outB == NULL) return (conv_float_function_t) &extract_A_f32_C;
+	return (conv_float_function_t) &extract_AB_f32_C;
+}
+
+void extract_float_init(extract_float_state_t *state, bool normalize, bool dc_removal) {
+	state->scale = normalize ? 1.0f/2048.0f : 1.0f;
+	state->dc[0] = 0.0f;
+	state->dc[1] = 0.0f;
+	state->sum[0] = 0;
+	state->sum[1] = 0;
+	state->dc_removal = dc_removal;
+}
+
+/* the DC offset removed from a block is the mean of the previous block */
+void extract_float_update_dc(extract_float_state_t *state, size_t len) {
+	if (!state->dc_removal || len == 0) return;
+	state->dc[0] = (float)((double)state->sum[0] / (double)len);
+	state->dc[1] = (float)((double)state->sum[1] / (double)len);
+}
+
 conv_16to32_t get_16to32_function() {
 #if defined(__x86_64__) || defined(_M_X64)
 	if(check_cpu_feat()>=2) {
@@ -671,3 +1100,75 @@ conv_16to8_t get_16to8_function() {
 	return (conv_16to8_t) &convert_16to8_C;
 #endif
 }
+
+conv_12pto16_t get_12pto16_function(bool pad) {
+#if defined(__x86_64__) || defined(_M_X64)
+	if(check_cpu_feat()>=1) {
+		fprintf(stderr,"Detected processor with SSSE3, using optimized 12 bit unpacking routine\n");
+		return (conv_12pto16_t) (pad ? &convert_12pto16_p_sse : &convert_12pto16_sse);
+	}
+	fprintf(stderr,"Detected processor without SSSE3, using standard 12 bit unpacking routine\n");
+#endif
+	return (conv_12pto16_t) (pad ? &convert_12pto16_p_C : &convert_12pto16_C);
+}
+
+#define CONV_NAME(f) { (void (*)(void)) &f, #f }
+
+static const struct {
+	void (*func)(void);
+	const char *name;
+} conv_names[] = {
+#if defined(__x86_64__) || defined(_M_X64)
+	CONV_NAME(extract_A_sse), CONV_NAME(extract_B_sse), CONV_NAME(extract_AB_sse), CONV_NAME(extract_S_sse),
+	CONV_NAME(extract_A_p_sse), CONV_NAME(extract_B_p_sse), CONV_NAME(extract_AB_p_sse),
+	CONV_NAME(extract_S_p_sse), CONV_NAME(extract_A_32_sse), CONV_NAME(extract_B_32_sse),
+	CONV_NAME(extract_AB_32_sse), CONV_NAME(extract_A_p_32_sse), CONV_NAME(extract_B_p_32_sse),
+	CONV_NAME(extract_AB_p_32_sse), CONV_NAME(extract_A_peak_sse), CONV_NAME(extract_B_peak_sse),
+	CONV_NAME(extract_AB_peak_sse), CONV_NAME(extract_A_p_peak_sse), CONV_NAME(extract_B_p_peak_sse),
+	CONV_NAME(extract_AB_p_peak_sse), CONV_NAME(extract_A_peak_32_sse), CONV_NAME(extract_B_peak_32_sse),
+	CONV_NAME(extract_AB_peak_32_sse), CONV_NAME(extract_A_p_peak_32_sse), CONV_NAME(extract_B_p_peak_32_sse),
+	CONV_NAME(extract_AB_p_peak_32_sse), CONV_NAME(extract_A_12p_sse), CONV_NAME(extract_B_12p_sse),
+	CONV_NAME(extract_AB_12p_sse), CONV_NAME(extract_S_12p_sse), CONV_NAME(extract_A_peak_12p_sse),
+	CONV_NAME(extract_B_peak_12p_sse), CONV_NAME(extract_AB_peak_12p_sse), CONV_NAME(extract_A_8t_sse),
+	CONV_NAME(extract_B_8t_sse), CONV_NAME(extract_AB_8t_sse), CONV_NAME(extract_A_8t_peak_sse),
+	CONV_NAME(extract_B_8t_peak_sse), CONV_NAME(extract_AB_8t_peak_sse), CONV_NAME(extract_A_8r_sse),
+	CONV_NAME(extract_B_8r_sse), CONV_NAME(extract_AB_8r_sse), CONV_NAME(extract_A_8r_peak_sse),
+	CONV_NAME(extract_B_8r_peak_sse), CONV_NAME(extract_AB_8r_peak_sse), CONV_NAME(extract_A_8t_32_sse),
+	CONV_NAME(extract_B_8t_32_sse), CONV_NAME(extract_AB_8t_32_sse), CONV_NAME(extract_A_8t_peak_32_sse),
+	CONV_NAME(extract_B_8t_peak_32_sse), CONV_NAME(extract_AB_8t_peak_32_sse), CONV_NAME(extract_A_8r_32_sse),
+	CONV_NAME(extract_B_8r_32_sse), CONV_NAME(extract_AB_8r_32_sse), CONV_NAME(extract_A_8r_peak_32_sse),
+	CONV_NAME(extract_B_8r_peak_32_sse), CONV_NAME(extract_AB_8r_peak_32_sse), CONV_NAME(extract_A_f32_sse),
+	CONV_NAME(extract_B_f32_sse), CONV_NAME(extract_AB_f32_sse), CONV_NAME(extract_A_peak_f32_sse),
+	CONV_NAME(extract_B_peak_f32_sse), CONV_NAME(extract_AB_peak_f32_sse), CONV_NAME(convert_16to32_sse),
+	CONV_NAME(convert_16to32_avx), CONV_NAME(convert_16to8to32_sse), CONV_NAME(convert_16to12to32_sse),
+	CONV_NAME(convert_16to8_sse), CONV_NAME(convert_12pto16_sse), CONV_NAME(convert_12pto16_p_sse),
+#endif
+	CONV_NAME(extract_X_C), CONV_NAME(extract_XS_C), CONV_NAME(extract_A_C), CONV_NAME(extract_B_C),
+	CONV_NAME(extract_AB_C), CONV_NAME(extract_S_C), CONV_NAME(extract_A_p_C), CONV_NAME(extract_B_p_C),
+	CONV_NAME(extract_AB_p_C), CONV_NAME(extract_S_p_C), CONV_NAME(extract_A_32_C), CONV_NAME(extract_B_32_C),
+	CONV_NAME(extract_AB_32_C), CONV_NAME(extract_S_32_C), CONV_NAME(extract_A_p_32_C),
+	CONV_NAME(extract_B_p_32_C), CONV_NAME(extract_AB_p_32_C), CONV_NAME(extract_S_p_32_C),
+	CONV_NAME(extract_X_peak_C), CONV_NAME(extract_A_peak_C), CONV_NAME(extract_B_peak_C),
+	CONV_NAME(extract_AB_peak_C), CONV_NAME(extract_A_p_peak_C), CONV_NAME(extract_B_p_peak_C),
+	CONV_NAME(extract_AB_p_peak_C), CONV_NAME(extract_A_peak_32_C), CONV_NAME(extract_B_peak_32_C),
+	CONV_NAME(extract_AB_peak_32_C), CONV_NAME(extract_A_p_peak_32_C), CONV_NAME(extract_B_p_peak_32_C),
+	CONV_NAME(extract_AB_p_peak_32_C), CONV_NAME(extract_A_12p_C), CONV_NAME(extract_B_12p_C),
+	CONV_NAME(extract_AB_12p_C), CONV_NAME(extract_S_12p_C), CONV_NAME(extract_A_peak_12p_C),
+	CONV_NAME(extract_B_peak_12p_C), CONV_NAME(extract_AB_peak_12p_C), CONV_NAME(extract_A_8t_C),
+	CONV_NAME(extract_B_8t_C), CONV_NAME(extract_AB_8t_C), CONV_NAME(extract_A_8r_C), CONV_NAME(extract_B_8r_C),
+	CONV_NAME(extract_AB_8r_C), CONV_NAME(extract_A_8d_C), CONV_NAME(extract_B_8d_C),
+	CONV_NAME(extract_AB_8d_C), CONV_NAME(extract_A_8t_32_C), CONV_NAME(extract_B_8t_32_C),
+	CONV_NAME(extract_AB_8t_32_C), CONV_NAME(extract_A_8r_32_C), CONV_NAME(extract_B_8r_32_C),
+	CONV_NAME(extract_AB_8r_32_C), CONV_NAME(extract_A_8d_32_C), CONV_NAME(extract_B_8d_32_C),
+	CONV_NAME(extract_AB_8d_32_C), CONV_NAME(extract_A_f32_C), CONV_NAME(extract_B_f32_C),
+	CONV_NAME(extract_AB_f32_C), CONV_NAME(convert_16to32_C), CONV_NAME(convert_16to8to32_C),
+	CONV_NAME(convert_16to12to32_C), CONV_NAME(convert_16to8_C), CONV_NAME(convert_12pto16_C),
+	CONV_NAME(convert_12pto16_p_C), CONV_NAME(extract_audio_2ch_C), CONV_NAME(extract_audio_1ch_C),
+};
+
+const char* get_conv_name(void (*func)(void)) {
+	for(size_t i = 0; i < sizeof(conv_names)/sizeof(conv_names[0]); i++) {
+		if (conv_names[i].func == func) return conv_names[i].name;
+	}
+	return "unknown";
+}
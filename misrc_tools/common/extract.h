@@ -24,6 +24,21 @@
 typedef void (*conv_function_t)(void*,size_t,size_t*,uint8_t*,void*,void*,uint16_t*);
 typedef void (*conv_16to32_t)(int16_t*,int32_t*,size_t);
 typedef void (*conv_16to8_t)(int16_t*,int8_t*,size_t);
+typedef void (*conv_12pto16_t)(uint8_t*,int16_t*,size_t);
+
+/* state of the float extraction, the layout is used by extract.asm */
+typedef struct {
+	float scale;     /* 1/2048 for output normalized to +-1.0, 1 for raw counts */
+	float dc[2];     /* DC offset (in counts) subtracted from the samples of each ADC */
+	int64_t sum[2];  /* sum of the samples (in counts) of the last call, set by the extraction */
+	bool dc_removal; /* update dc from the sums after each call */
+} extract_float_state_t;
+
+typedef void (*conv_float_function_t)(void*,size_t,size_t*,uint8_t*,float*,float*,uint16_t*,extract_float_state_t*);
+
+#define EXTRACT_8BIT_TRUNCATE 0
+#define EXTRACT_8BIT_ROUND    1
+#define EXTRACT_8BIT_DITHER   2
 
 #if defined(__x86_64__) || defined(_M_X64)
 void extract_A_sse      (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int16_t *outA, int16_t *outB, uint16_t *peak_level);
@@ -52,12 +67,51 @@ void extract_AB_peak_32_sse  (uint32_t *in, size_t len, size_t *clip, uint8_t *a
 void extract_A_p_peak_32_sse (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
 void extract_B_p_peak_32_sse (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
 void extract_AB_p_peak_32_sse(uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
+void extract_A_12p_sse       (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, uint8_t *outA, uint8_t *outB, uint16_t *peak_level);
+void extract_B_12p_sse       (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, uint8_t *outA, uint8_t *outB, uint16_t *peak_level);
+void extract_AB_12p_sse      (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, uint8_t *outA, uint8_t *outB, uint16_t *peak_level);
+void extract_S_12p_sse       (uint16_t *in, size_t len, size_t *clip, uint8_t *aux, uint8_t *outA, uint8_t *outB, uint16_t *peak_level);
+void extract_A_peak_12p_sse  (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, uint8_t *outA, uint8_t *outB, uint16_t *peak_level);
+void extract_B_peak_12p_sse  (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, uint8_t *outA, uint8_t *outB, uint16_t *peak_level);
+void extract_AB_peak_12p_sse (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, uint8_t *outA, uint8_t *outB, uint16_t *peak_level);
+void extract_A_8t_sse            (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int8_t *outA, int8_t *outB, uint16_t *peak_level);
+void extract_B_8t_sse            (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int8_t *outA, int8_t *outB, uint16_t *peak_level);
+void extract_AB_8t_sse           (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int8_t *outA, int8_t *outB, uint16_t *peak_level);
+void extract_A_8t_peak_sse       (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int8_t *outA, int8_t *outB, uint16_t *peak_level);
+void extract_B_8t_peak_sse       (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int8_t *outA, int8_t *outB, uint16_t *peak_level);
+void extract_AB_8t_peak_sse      (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int8_t *outA, int8_t *outB, uint16_t *peak_level);
+void extract_A_8r_sse            (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int8_t *outA, int8_t *outB, uint16_t *peak_level);
+void extract_B_8r_sse            (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int8_t *outA, int8_t *outB, uint16_t *peak_level);
+void extract_AB_8r_sse           (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int8_t *outA, int8_t *outB, uint16_t *peak_level);
+void extract_A_8r_peak_sse       (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int8_t *outA, int8_t *outB, uint16_t *peak_level);
+void extract_B_8r_peak_sse       (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int8_t *outA, int8_t *outB, uint16_t *peak_level);
+void extract_AB_8r_peak_sse      (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int8_t *outA, int8_t *outB, uint16_t *peak_level);
+void extract_A_8t_32_sse         (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
+void extract_B_8t_32_sse         (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
+void extract_AB_8t_32_sse        (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
+void extract_A_8t_peak_32_sse    (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
+void extract_B_8t_peak_32_sse    (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
+void extract_AB_8t_peak_32_sse   (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
+void extract_A_8r_32_sse         (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
+void extract_B_8r_32_sse         (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
+void extract_AB_8r_32_sse        (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
+void extract_A_8r_peak_32_sse    (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
+void extract_B_8r_peak_32_sse    (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
+void extract_AB_8r_peak_32_sse   (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
+void extract_A_f32_sse           (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, float *outA, float *outB, uint16_t *peak_level, extract_float_state_t *state);
+void extract_B_f32_sse           (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, float *outA, float *outB, uint16_t *peak_level, extract_float_state_t *state);
+void extract_AB_f32_sse          (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, float *outA, float *outB, uint16_t *peak_level, extract_float_state_t *state);
+void extract_A_peak_f32_sse      (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, float *outA, float *outB, uint16_t *peak_level, extract_float_state_t *state);
+void extract_B_peak_f32_sse      (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, float *outA, float *outB, uint16_t *peak_level, extract_float_state_t *state);
+void extract_AB_peak_f32_sse     (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, float *outA, float *outB, uint16_t *peak_level, extract_float_state_t *state);
 
 void convert_16to32_sse (int16_t *in, int32_t *out, size_t len);
 void convert_16to32_avx (int16_t *in, int32_t *out, size_t len);
 void convert_16to8to32_sse (int16_t *in, int32_t *out, size_t len);
 void convert_16to12to32_sse (int16_t *in, int32_t *out, size_t len);
 void convert_16to8_sse (int16_t *in, int8_t *out, size_t len);
+void convert_12pto16_sse (uint8_t *in, int16_t *out, size_t len);
+void convert_12pto16_p_sse (uint8_t *in, int16_t *out, size_t len);
 
 int check_cpu_feat();
 #endif
@@ -94,19 +148,57 @@ void extract_AB_peak_32_C  (uint32_t *in, size_t len, size_t *clip, uint8_t *aux
 void extract_A_p_peak_32_C (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
 void extract_B_p_peak_32_C (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
 void extract_AB_p_peak_32_C(uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
+void extract_A_12p_C       (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, uint8_t *outA, uint8_t *outB, uint16_t *peak_level);
+void extract_B_12p_C       (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, uint8_t *outA, uint8_t *outB, uint16_t *peak_level);
+void extract_AB_12p_C      (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, uint8_t *outA, uint8_t *outB, uint16_t *peak_level);
+void extract_S_12p_C       (uint16_t *in, size_t len, size_t *clip, uint8_t *aux, uint8_t *outA, uint8_t *outB, uint16_t *peak_level);
+void extract_A_peak_12p_C  (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, uint8_t *outA, uint8_t *outB, uint16_t *peak_level);
+void extract_B_peak_12p_C  (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, uint8_t *outA, uint8_t *outB, uint16_t *peak_level);
+void extract_AB_peak_12p_C (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, uint8_t *outA, uint8_t *outB, uint16_t *peak_level);
+void extract_A_8t_C        (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int8_t *outA, int8_t *outB, uint16_t *peak_level);
+void extract_B_8t_C        (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int8_t *outA, int8_t *outB, uint16_t *peak_level);
+void extract_AB_8t_C       (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int8_t *outA, int8_t *outB, uint16_t *peak_level);
+void extract_A_8r_C        (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int8_t *outA, int8_t *outB, uint16_t *peak_level);
+void extract_B_8r_C        (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int8_t *outA, int8_t *outB, uint16_t *peak_level);
+void extract_AB_8r_C       (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int8_t *outA, int8_t *outB, uint16_t *peak_level);
+void extract_A_8d_C        (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int8_t *outA, int8_t *outB, uint16_t *peak_level);
+void extract_B_8d_C        (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int8_t *outA, int8_t *outB, uint16_t *peak_level);
+void extract_AB_8d_C       (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int8_t *outA, int8_t *outB, uint16_t *peak_level);
+void extract_A_8t_32_C     (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
+void extract_B_8t_32_C     (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
+void extract_AB_8t_32_C    (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
+void extract_A_8r_32_C     (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
+void extract_B_8r_32_C     (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
+void extract_AB_8r_32_C    (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
+void extract_A_8d_32_C     (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
+void extract_B_8d_32_C     (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
+void extract_AB_8d_32_C    (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, int32_t *outA, int32_t *outB, uint16_t *peak_level);
+void extract_A_f32_C       (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, float *outA, float *outB, uint16_t *peak_level, extract_float_state_t *state);
+void extract_B_f32_C       (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, float *outA, float *outB, uint16_t *peak_level, extract_float_state_t *state);
+void extract_AB_f32_C      (uint32_t *in, size_t len, size_t *clip, uint8_t *aux, float *outA, float *outB, uint16_t *peak_level, extract_float_state_t *state);
 
 void convert_16to32_C (int16_t *in, int32_t *out, size_t len);
 void convert_16to8to32_C (int16_t *in, int32_t *out, size_t len);
 void convert_16to12to32_C (int16_t *in, int32_t *out, size_t len);
 void convert_16to8_C (int16_t *in, int8_t *out, size_t len);
+void convert_12pto16_C (uint8_t *in, int16_t *out, size_t len);
+void convert_12pto16_p_C (uint8_t *in, int16_t *out, size_t len);
 
 void extract_audio_2ch_C  (uint16_t *in, size_t len, uint16_t *out12, uint16_t *out34);
 void extract_audio_1ch_C  (uint8_t  *in, size_t len, uint8_t   *out1, uint8_t  *out2, uint8_t *out3, uint8_t *out4);
 
 conv_function_t get_conv_function(bool single, bool pad, bool dword, bool peak_level, void* outA, void* outB);
+conv_function_t get_conv_12p_function(bool single, bool peak_level, void* outA, void* outB);
+conv_function_t get_conv_8bit_function(int rounding, bool dword, bool peak_level, void* outA, void* outB);
+conv_float_function_t get_conv_float_function(bool peak_level, void* outA, void* outB);
+void extract_float_init(extract_float_state_t *state, bool normalize, bool dc_removal);
+void extract_float_update_dc(extract_float_state_t *state, size_t len);
 conv_16to32_t get_16to32_function();
 conv_16to32_t get_16to8to32_function();
 conv_16to32_t get_16to12to32_function();
 conv_16to8_t get_16to8_function();
+conv_12pto16_t get_12pto16_function(bool pad);
+/* name of a conversion function for reports */
+const char* get_conv_name(void (*func)(void));
 
 #endif // EXTRACT_H
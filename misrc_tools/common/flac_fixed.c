@@ -0,0 +1,476 @@
+/*
+* MISRC tools
+* Copyright (C) 2025  vrunk11, stefan_o
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "flac_fixed.h"
+
+#if (defined(__x86_64__) || defined(_M_X64)) && defined(__GNUC__)
+#include <immintrin.h>
+#define FIXED_AVX2 1
+#endif
+#if defined(__aarch64__) || defined(__arm64__)
+#include <arm_neon.h>
+#define FIXED_NEON 1
+#endif
+
+#define WORKER_WAIT (struct timespec){.tv_nsec=100000}
+
+/* big endian bit writer, bits are collected in acc and written 32 at a time */
+typedef struct {
+	uint8_t *p;
+	uint64_t acc;
+	unsigned int bits;
+} bitwriter_t;
+
+static inline uint32_t to_be32(uint32_t v)
+{
+#if defined(__GNUC__)
+	return __builtin_bswap32(v);
+#else
+	return (v >> 24) | ((v >> 8) & 0xFF00) | ((v << 8) & 0xFF0000) | (v << 24);
+#endif
+}
+
+// v must not have bits above the lower n
+static inline void bw_put(bitwriter_t *w, uint32_t v, unsigned int n)
+{
+	w->acc = (w->acc << n) | v;
+	w->bits += n;
+	if (w->bits >= 32) {
+		uint32_t out;
+		w->bits -= 32;
+		out = to_be32((uint32_t)(w->acc >> w->bits));
+		memcpy(w->p, &out, 4);
+		w->p += 4;
+	}
+}
+
+static inline void bw_rice(bitwriter_t *w, uint32_t u, unsigned int k)
+{
+	uint32_t q = u >> k, low = u & ((1u << k) - 1);
+	if (q + 1 + k <= 32) {
+		bw_put(w, (1u << k) | low, q + 1 + k);
+		return;
+	}
+	for(; q >= 32; q -= 32) bw_put(w, 0, 32);
+	bw_put(w, 1, q + 1);
+	if (k > 0) bw_put(w, low, k);
+}
+
+// pad with zeros to a byte boundary and write everything
+static inline void bw_flush(bitwriter_t *w)
+{
+	if (w->bits & 7) bw_put(w, 0, 8 - (w->bits & 7));
+	while (w->bits >= 8) {
+		w->bits -= 8;
+		*w->p++ = (uint8_t)(w->acc >> w->bits);
+	}
+}
+
+/* sum of the absolute residuals of the fixed predictors of order 0 to 4, for samples 4...n-1 */
+static void fixed_sums_c(const int32_t *x, uint32_t n, uint64_t *sum)
+{
+	uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0, s4 = 0;
+	for(uint32_t i = 4; i < n; i++) {
+		int32_t e1 = x[i] - x[i-1];
+		int32_t e2 = e1 - (x[i-1] - x[i-2]);
+		int32_t e3 = e2 - (x[i-1] - 2 * x[i-2] + x[i-3]);
+		int32_t e4 = e3 - (x[i-1] - 3 * x[i-2] + 3 * x[i-3] - x[i-4]);
+		s0 += abs(x[i]);
+		s1 += abs(e1);
+		s2 += abs(e2);
+		s3 += abs(e3);
+		s4 += abs(e4);
+	}
+	sum[0] = s0; sum[1] = s1; sum[2] = s2; sum[3] = s3; sum[4] = s4;
+}
+
+static inline int32_t fixed_residual(const int32_t *x, uint32_t i, uint32_t order)
+{
+	switch(order) {
+	case 0: return x[i];
+	case 1: return x[i] - x[i-1];
+	case 2: return x[i] - 2 * x[i-1] + x[i-2];
+	case 3: return x[i] - 3 * x[i-1] + 3 * x[i-2] - x[i-3];
+	default: return x[i] - 4 * x[i-1] + 6 * x[i-2] - 4 * x[i-3] + x[i-4];
+	}
+}
+
+/* residuals of samples order...n-1, zigzag coded as used by Rice coding */
+static void fixed_residual_c(const int32_t *x, uint32_t n, uint32_t order, uint32_t *u)
+{
+	for(uint32_t i = order; i < n; i++) {
+		int32_t e = fixed_residual(x, i, order);
+		u[i] = ((uint32_t)e << 1) ^ (uint32_t)(e >> 31);
+	}
+}
+
+#ifdef FIXED_AVX2
+// the sums of 8 lanes do not overflow for 16 bit samples and frames of up to 65536 samples
+__attribute__((target("avx2")))
+static void fixed_sums_avx2(const int32_t *x, uint32_t n, uint64_t *sum)
+{
+	__m256i a0 = _mm256_setzero_si256(), a1 = a0, a2 = a0, a3 = a0, a4 = a0;
+	uint32_t lanes[8], i;
+	uint64_t tail[5];
+	for(i = 4; i + 8 <= n; i += 8) {
+		__m256i x0 = _mm256_loadu_si256((const __m256i*)&x[i]);
+		__m256i x1 = _mm256_loadu_si256((const __m256i*)&x[i-1]);
+		__m256i x2 = _mm256_loadu_si256((const __m256i*)&x[i-2]);
+		__m256i x3 = _mm256_loadu_si256((const __m256i*)&x[i-3]);
+		__m256i x4 = _mm256_loadu_si256((const __m256i*)&x[i-4]);
+		__m256i d0 = _mm256_sub_epi32(x0, x1), d1 = _mm256_sub_epi32(x1, x2);
+		__m256i d2 = _mm256_sub_epi32(x2, x3), d3 = _mm256_sub_epi32(x3, x4);
+		__m256i e2 = _mm256_sub_epi32(d0, d1), f2 = _mm256_sub_epi32(d1, d2), g2 = _mm256_sub_epi32(d2, d3);
+		__m256i e3 = _mm256_sub_epi32(e2, f2), f3 = _mm256_sub_epi32(f2, g2);
+		__m256i e4 = _mm256_sub_epi32(e3, f3);
+		a0 = _mm256_add_epi32(a0, _mm256_abs_epi32(x0));
+		a1 = _mm256_add_epi32(a1, _mm256_abs_epi32(d0));
+		a2 = _mm256_add_epi32(a2, _mm256_abs_epi32(e2));
+		a3 = _mm256_add_epi32(a3, _mm256_abs_epi32(e3));
+		a4 = _mm256_add_epi32(a4, _mm256_abs_epi32(e4));
+	}
+	fixed_sums_c(&x[i-4], n - i + 4, tail);
+	__m256i a[5] = { a0, a1, a2, a3, a4 };
+	for(int o = 0; o < 5; o++) {
+		_mm256_storeu_si256((__m256i*)lanes, a[o]);
+		sum[o] = tail[o];
+		for(int l = 0; l < 8; l++) sum[o] += lanes[l];
+	}
+}
+
+__attribute__((target("avx2")))
+static void fixed_residual_avx2(const int32_t *x, uint32_t n, uint32_t order, uint32_t *u)
+{
+	uint32_t i;
+	for(i = order; i + 8 <= n; i += 8) {
+		__m256i e = _mm256_loadu_si256((const __m256i*)&x[i]);
+		if (order > 0) {
+			__m256i x1 = _mm256_loadu_si256((const __m256i*)&x[i-1]);
+			__m256i d = _mm256_sub_epi32(e, x1);
+			if (order == 1) e = d;
+			else {
+				__m256i x2 = _mm256_loadu_si256((const __m256i*)&x[i-2]);
+				__m256i d1 = _mm256_sub_epi32(x1, x2);
+				e = _mm256_sub_epi32(d, d1);
+				if (order > 2) {
+					__m256i x3 = _mm256_loadu_si256((const __m256i*)&x[i-3]);
+					__m256i d2 = _mm256_sub_epi32(x2, x3);
+					__m256i f2 = _mm256_sub_epi32(d1, d2);
+					__m256i e3 = _mm256_sub_epi32(e, f2);
+					if (order == 3) e = e3;
+					else {
+						__m256i x4 = _mm256_loadu_si256((const __m256i*)&x[i-4]);
+						__m256i g2 = _mm256_sub_epi32(d2, _mm256_sub_epi32(x3, x4));
+						e = _mm256_sub_epi32(e3, _mm256_sub_epi32(f2, g2));
+					}
+				}
+			}
+		}
+		e = _mm256_xor_si256(_mm256_slli_epi32(e, 1), _mm256_srai_epi32(e, 31));
+		_mm256_storeu_si256((__m256i*)&u[i], e);
+	}
+	for(; i < n; i++) {
+		int32_t e = fixed_residual(x, i, order);
+		u[i] = ((uint32_t)e << 1) ^ (uint32_t)(e >> 31);
+	}
+}
+#endif
+
+#ifdef FIXED_NEON
+static void fixed_sums_neon(const int32_t *x, uint32_t n, uint64_t *sum)
+{
+	uint32x4_t a[5];
+	uint64_t tail[5];
+	uint32_t i;
+	for(int o = 0; o < 5; o++) a[o] = vdupq_n_u32(0);
+	for(i = 4; i + 4 <= n; i += 4) {
+		int32x4_t x0 = vld1q_s32(&x[i]), x1 = vld1q_s32(&x[i-1]), x2 = vld1q_s32(&x[i-2]);
+		int32x4_t x3 = vld1q_s32(&x[i-3]), x4 = vld1q_s32(&x[i-4]);
+		int32x4_t d0 = vsubq_s32(x0, x1), d1 = vsubq_s32(x1, x2), d2 = vsubq_s32(x2, x3), d3 = vsubq_s32(x3, x4);
+		int32x4_t e2 = vsubq_s32(d0, d1), f2 = vsubq_s32(d1, d2), g2 = vsubq_s32(d2, d3);
+		int32x4_t e3 = vsubq_s32(e2, f2), f3 = vsubq_s32(f2, g2);
+		int32x4_t e4 = vsubq_s32(e3, f3);
+		a[0] = vaddq_u32(a[0], vreinterpretq_u32_s32(vabsq_s32(x0)));
+		a[1] = vaddq_u32(a[1], vreinterpretq_u32_s32(vabsq_s32(d0)));
+		a[2] = vaddq_u32(a[2], vreinterpretq_u32_s32(vabsq_s32(e2)));
+		a[3] = vaddq_u32(a[3], vreinterpretq_u32_s32(vabsq_s32(e3)));
+		a[4] = vaddq_u32(a[4], vreinterpretq_u32_s32(vabsq_s32(e4)));
+	}
+	fixed_sums_c(&x[i-4], n - i + 4, tail);
+	for(int o = 0; o < 5; o++) sum[o] = tail[o] + vaddlvq_u32(a[o]);
+}
+
+static void fixed_residual_neon(const int32_t *x, uint32_t n, uint32_t order, uint32_t *u)
+{
+	uint32_t i;
+	for(i = order; i + 4 <= n; i += 4) {
+		int32x4_t e = vld1q_s32(&x[i]);
+		if (order > 0) {
+			int32x4_t x1 = vld1q_s32(&x[i-1]);
+			int32x4_t d = vsubq_s32(e, x1);
+			if (order == 1) e = d;
+			else {
+				int32x4_t x2 = vld1q_s32(&x[i-2]);
+				int32x4_t d1 = vsubq_s32(x1, x2);
+				e = vsubq_s32(d, d1);
+				if (order > 2) {
+					int32x4_t x3 = vld1q_s32(&x[i-3]);
+					int32x4_t d2 = vsubq_s32(x2, x3);
+					int32x4_t f2 = vsubq_s32(d1, d2);
+					int32x4_t e3 = vsubq_s32(e, f2);
+					if (order == 3) e = e3;
+					else {
+						int32x4_t g2 = vsubq_s32(d2, vsubq_s32(x3, vld1q_s32(&x[i-4])));
+						e = vsubq_s32(e3, vsubq_s32(f2, g2));
+					}
+				}
+			}
+		}
+		e = veorq_s32(vshlq_n_s32(e, 1), vshrq_n_s32(e, 31));
+		vst1q_u32(&u[i], vreinterpretq_u32_s32(e));
+	}
+	for(; i < n; i++) {
+		int32_t e = fixed_residual(x, i, order);
+		u[i] = ((uint32_t)e << 1) ^ (uint32_t)(e >> 31);
+	}
+}
+#endif
+
+static void fixed_sums(const int32_t *x, uint32_t n, uint64_t *sum)
+{
+#if defined(FIXED_AVX2)
+	if (__builtin_cpu_supports("avx2")) {
+		fixed_sums_avx2(x, n, sum);
+		return;
+	}
+#elif defined(FIXED_NEON)
+	fixed_sums_neon(x, n, sum);
+	return;
+#endif
+	fixed_sums_c(x, n, sum);
+}
+
+static void fixed_residuals(const int32_t *x, uint32_t n, uint32_t order, uint32_t *u)
+{
+#if defined(FIXED_AVX2)
+	if (__builtin_cpu_supports("avx2")) {
+		fixed_residual_avx2(x, n, order, u);
+		return;
+	}
+#elif defined(FIXED_NEON)
+	fixed_residual_neon(x, n, order, u);
+	return;
+#endif
+	fixed_residual_c(x, n, order, u);
+}
+
+/* Rice parameter for m residuals with the sum s and an estimate of the bits they need */
+static uint64_t rice_param(uint64_t s, uint32_t m, uint32_t *k)
+{
+	uint64_t mean = s / m, bits, bits_lower;
+	uint32_t p = 0;
+#if defined(__GNUC__)
+	if (mean > 1) p = 63 - __builtin_clzll(mean);
+#else
+	while ((mean >> p) > 1) p++;
+#endif
+	if (p > 30) p = 30;
+	bits = (uint64_t)m * (p + 1) + (s >> p);
+	if (p > 0 && (bits_lower = (uint64_t)m * p + (s >> (p - 1))) < bits) {
+		p--;
+		bits = bits_lower;
+	}
+	*k = p;
+	return bits;
+}
+
+static uint32_t bits_code(uint32_t bits)
+{
+	switch(bits) {
+	case 8: return 1;
+	case 12: return 2;
+	case 16: return 4;
+	case 20: return 5;
+	case 24: return 6;
+	default: return 0;
+	}
+}
+
+size_t flac_fixed_frame(const int32_t *x, uint32_t n, uint32_t bits, uint64_t frame_number, uint8_t *out)
+{
+	uint32_t u[FLAC_STITCH_BLOCKSIZE];
+	uint64_t sum[FLAC_FIXED_MAX_ORDER + 1], psum[1 << FLAC_FIXED_MAX_PARTITION];
+	uint32_t k[1 << FLAC_FIXED_MAX_PARTITION], best_k[1 << FLAC_FIXED_MAX_PARTITION];
+	uint32_t order = 0, porder = 0, max_porder = 0, kmax = 0, blocksize_code, mask = (uint32_t)((1ULL << bits) - 1);
+	uint64_t best = UINT64_MAX;
+	bitwriter_t w;
+	size_t len;
+	uint16_t crc;
+
+	// frame header, sample rate from STREAMINFO, mono
+	blocksize_code = (n == FLAC_STITCH_BLOCKSIZE) ? 12 : ((n <= 256) ? 6 : 7);
+	out[0] = 0xFF;
+	out[1] = 0xF8;
+	out[2] = blocksize_code << 4;
+	out[3] = bits_code(bits) << 1;
+	len = 4 + flac_utf8_write(frame_number, &out[4]);
+	if (blocksize_code == 6) out[len++] = n - 1;
+	else if (blocksize_code == 7) {
+		out[len++] = (n - 1) >> 8;
+		out[len++] = (n - 1) & 0xFF;
+	}
+	out[len] = flac_crc8(out, len);
+	len++;
+	w = (bitwriter_t){ &out[len], 0, 0 };
+
+	if (n > FLAC_FIXED_MAX_ORDER) {
+		fixed_sums(x, n, sum);
+		for(uint32_t o = 1; o <= FLAC_FIXED_MAX_ORDER; o++) if (sum[o] < sum[order]) order = o;
+		if (sum[1] == 0 && x[0] == x[1] && x[1] == x[2] && x[2] == x[3] && x[3] == x[4]) {
+			// constant subframe
+			bw_put(&w, 0x00, 8);
+			bw_put(&w, x[0] & mask, bits);
+			goto finish;
+		}
+		fixed_residuals(x, n, order, u);
+		// partitions have to divide the frame and the first one has to be longer than the warm-up
+		while (max_porder < FLAC_FIXED_MAX_PARTITION && (n >> (max_porder + 1)) << (max_porder + 1) == n && (n >> (max_porder + 1)) > order) max_porder++;
+		for(uint32_t p = 0; p < (1u << max_porder); p++) {
+			uint32_t start = (p == 0) ? order : p * (n >> max_porder), end = (p + 1) * (n >> max_porder);
+			uint64_t s = 0;
+			for(uint32_t i = start; i < end; i++) s += u[i];
+			psum[p] = s;
+		}
+		// from the finest partitioning to a single partition, neighbouring sums are merged in place
+		for(int po = max_porder; po >= 0; po--) {
+			uint32_t parts = 1u << po, m = n >> po, km = 0;
+			uint64_t total = 0;
+			if (po < (int)max_porder) for(uint32_t p = 0; p < parts; p++) psum[p] = psum[2*p] + psum[2*p+1];
+			for(uint32_t p = 0; p < parts; p++) {
+				total += rice_param(psum[p], (p == 0) ? m - order : m, &k[p]);
+				if (k[p] > km) km = k[p];
+			}
+			total += parts * ((km > 14) ? 5 : 4);
+			if (total < best) {
+				best = total;
+				porder = po;
+				kmax = km;
+				memcpy(best_k, k, parts * sizeof(uint32_t));
+			}
+		}
+	}
+	if (n <= FLAC_FIXED_MAX_ORDER || best + order * bits + 8 + 6 >= (uint64_t)n * bits) {
+		// verbatim subframe, the residual would not be smaller
+		bw_put(&w, 0x02, 8);
+		for(uint32_t i = 0; i < n; i++) bw_put(&w, x[i] & mask, bits);
+		goto finish;
+	}
+	// fixed subframe: warm-up samples, Rice coding method and partition order, partitions
+	bw_put(&w, 0x10 | (order << 1), 8);
+	for(uint32_t i = 0; i < order; i++) bw_put(&w, x[i] & mask, bits);
+	bw_put(&w, (kmax > 14) ? 1 : 0, 2);
+	bw_put(&w, porder, 4);
+	for(uint32_t p = 0; p < (1u << porder); p++) {
+		uint32_t start = (p == 0) ? order : p * (n >> porder), end = (p + 1) * (n >> porder);
+		bw_put(&w, best_k[p], (kmax > 14) ? 5 : 4);
+		for(uint32_t i = start; i < end; i++) bw_rice(&w, u[i], best_k[p]);
+	}
+
+finish:
+	bw_flush(&w);
+	len = w.p - out;
+	crc = flac_crc16(0, out, len);
+	out[len++] = crc >> 8;
+	out[len++] = crc & 0xFF;
+	return len;
+}
+
+static void encode_frames(flac_fixed_t *enc)
+{
+	size_t i, start;
+	while ((i = atomic_fetch_add(&enc->next, 1)) < enc->frames) {
+		start = i * FLAC_STITCH_BLOCKSIZE;
+		enc->len[i] = flac_fixed_frame(&enc->samples[start], (enc->n - start < FLAC_STITCH_BLOCKSIZE) ? enc->n - start : FLAC_STITCH_BLOCKSIZE,
+			enc->bits, enc->first_frame + i, &enc->out[i * FLAC_FIXED_FRAME_MAX(enc->bits)]);
+		atomic_fetch_add(&enc->done, 1);
+	}
+}
+
+static int worker_thread(void *ctx)
+{
+	flac_fixed_t *enc = ctx;
+	unsigned int job = 0;
+	while (!atomic_load(&enc->exit)) {
+		if (atomic_load(&enc->job) == job) {
+			thrd_sleep(&WORKER_WAIT, NULL);
+			continue;
+		}
+		job++;
+		encode_frames(enc);
+		// the job is only finished when every worker has left it, so the next one can be set up
+		atomic_fetch_add(&enc->finished, 1);
+	}
+	return 0;
+}
+
+int flac_fixed_init(flac_fixed_t *enc, uint32_t bits, uint32_t threads)
+{
+	memset(enc, 0, sizeof(flac_fixed_t));
+	enc->bits = bits;
+	if (threads < 1) threads = 1;
+	if (threads > FLAC_FIXED_MAX_THREADS) threads = FLAC_FIXED_MAX_THREADS;
+	atomic_init(&enc->job, 0);
+	atomic_init(&enc->next, 0);
+	atomic_init(&enc->done, 0);
+	atomic_init(&enc->finished, 0);
+	atomic_init(&enc->exit, false);
+	for(enc->threads = 1; enc->threads < threads; enc->threads++) {
+		if (thrd_create(&enc->thread[enc->threads - 1], (thrd_start_t)worker_thread, enc) != thrd_success) {
+			flac_fixed_free(enc);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+size_t flac_fixed_encode(flac_fixed_t *enc, const int32_t *samples, size_t n, uint64_t first_frame, uint8_t *out, size_t *len)
+{
+	if (n == 0) return 0;
+	enc->samples = samples;
+	enc->n = n;
+	enc->first_frame = first_frame;
+	enc->out = out;
+	enc->len = len;
+	enc->frames = (n + FLAC_STITCH_BLOCKSIZE - 1) / FLAC_STITCH_BLOCKSIZE;
+	atomic_store(&enc->done, 0);
+	atomic_store(&enc->finished, 0);
+	atomic_store(&enc->next, 0);
+	atomic_fetch_add(&enc->job, 1);
+	encode_frames(enc);
+	while (atomic_load(&enc->done) < enc->frames || atomic_load(&enc->finished) < enc->threads - 1) thrd_sleep(&WORKER_WAIT, NULL);
+	return enc->frames;
+}
+
+void flac_fixed_free(flac_fixed_t *enc)
+{
+	atomic_store(&enc->exit, true);
+	for(uint32_t i = 0; i + 1 < enc->threads; i++) thrd_join(enc->thread[i], NULL);
+	enc->threads = 0;
+}
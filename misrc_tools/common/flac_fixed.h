@@ -0,0 +1,76 @@
+/*
+* MISRC tools
+* Copyright (C) 2025  vrunk11, stefan_o
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FLAC_FIXED_H
+#define FLAC_FIXED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#if __STDC_VERSION__ >= 201112L && ! __STDC_NO_THREADS__ && ! _WIN32
+#include <threads.h>
+#else
+#include "cthreads.h"
+#endif
+#include "flac_stitch.h"
+
+/* Built-in FLAC encoder for mono RF data, it only uses the fixed predictors
+ * of order 0 to 4 and Rice coded residuals with a partition search, which is
+ * all the lower libFLAC levels use anyway, but without the generic overhead.
+ * The predictor choice and residuals are computed with AVX2 or NEON where
+ * available. Frames have FLAC_STITCH_BLOCKSIZE samples (the last one of a
+ * stream may be shorter) and are encoded by several threads at the same time,
+ * the output is a standard FLAC stream behind a flac_write_header() header. */
+
+#define FLAC_FIXED_MAX_ORDER     4
+#define FLAC_FIXED_MAX_PARTITION 6   // 64 samples per partition
+#define FLAC_FIXED_MAX_THREADS   64
+// verbatim subframe plus frame header and footer
+#define FLAC_FIXED_FRAME_MAX(bits) ((size_t)FLAC_STITCH_BLOCKSIZE * (bits) / 8 + 32)
+
+typedef struct {
+	uint32_t bits;
+	uint32_t threads;
+	thrd_t thread[FLAC_FIXED_MAX_THREADS];
+	// current job, frames are taken one by one by the workers and the caller
+	const int32_t *samples;
+	size_t n;
+	uint64_t first_frame;
+	uint8_t *out;               // FLAC_FIXED_FRAME_MAX(bits) bytes per frame
+	size_t *len;                // length of each frame
+	size_t frames;
+	atomic_uint job;            // incremented for every job
+	atomic_size_t next;
+	atomic_size_t done;
+	atomic_uint finished;       // workers that are done with the current job
+	atomic_bool exit;
+} flac_fixed_t;
+
+/* encode a single frame of n <= FLAC_STITCH_BLOCKSIZE samples, returns its length */
+size_t flac_fixed_frame(const int32_t *samples, uint32_t n, uint32_t bits, uint64_t frame_number, uint8_t *out);
+
+/* start threads-1 worker threads, the caller is the last one, returns 0 on success */
+int flac_fixed_init(flac_fixed_t *enc, uint32_t bits, uint32_t threads);
+/* encode n samples as frames first_frame, first_frame+1, ... into out, every frame
+ * except the last one has FLAC_STITCH_BLOCKSIZE samples, frame i is written to
+ * out + i * FLAC_FIXED_FRAME_MAX(bits) and its length to len[i], returns the number of frames */
+size_t flac_fixed_encode(flac_fixed_t *enc, const int32_t *samples, size_t n, uint64_t first_frame, uint8_t *out, size_t *len);
+void flac_fixed_free(flac_fixed_t *enc);
+
+#endif // FLAC_FIXED_H
@@ -0,0 +1,104 @@
+/*
+* MISRC tools
+* Copyright (C) 2025  vrunk11, stefan_o
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FLAC_STITCH_H
+#define FLAC_STITCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Independent segments of one stream are encoded concurrently, every segment
+ * starts at a multiple of FLAC_STITCH_BLOCKSIZE samples. The frames of each
+ * segment are renumbered to their position in the whole stream, so the
+ * segments only have to be concatenated behind a header written with
+ * flac_write_header(). */
+
+#define FLAC_STITCH_BLOCKSIZE   4096
+#define FLAC_STITCH_SEEKSPACING (1<<18)
+#define FLAC_STITCH_MAX_SEEK    16
+
+#define SEEKPOINT_PLACEHOLDER 0xFFFFFFFFFFFFFFFFULL
+
+typedef struct {
+	uint64_t sample_number;
+	uint64_t stream_offset;
+	uint32_t frame_samples;
+} flac_seekpoint_t;
+
+typedef struct {
+	uint8_t *buf;           // encoded frames
+	size_t len;
+	size_t size;
+	uint64_t first_sample;  // position of the segment in the stream
+	size_t samples;
+	uint64_t seek_spacing;
+	uint32_t min_framesize;
+	uint32_t max_framesize;
+	uint32_t seek_cnt;      // seekpoints in this segment, offsets relative to buf
+	flac_seekpoint_t seek[FLAC_STITCH_MAX_SEEK];
+	bool error;
+} flac_segment_t;
+
+typedef struct {
+	uint32_t sample_rate;
+	uint32_t bits;
+	uint64_t total_samples;
+	uint32_t min_framesize;
+	uint32_t max_framesize;
+	uint8_t md5[16];
+	uint64_t seek_spacing;
+	size_t seek_points;
+	flac_seekpoint_t *seek;
+	uint64_t stream_len;    // bytes of frames
+} flac_stream_t;
+
+/* frame and header checksums */
+uint8_t flac_crc8(const uint8_t *data, size_t len);
+uint16_t flac_crc16(uint16_t crc, const uint8_t *data, size_t len);
+
+/* frame number in the UTF-8 like coding of the frame header, returns its length */
+size_t flac_utf8_write(uint64_t v, uint8_t *out);
+
+/* copy a frame to out with a new frame number, returns the new length or 0 if the header is invalid */
+size_t flac_frame_renumber(const uint8_t *frame, size_t len, uint64_t number, uint8_t *out);
+
+/* read the header of the frame at frame: the frame number, or the sample number if variable
+ * is set, and the number of samples, returns 0 if the header and its checksum are valid */
+int flac_frame_header_read(const uint8_t *frame, size_t len, uint64_t *number, uint32_t *blocksize, bool *variable);
+
+/* prepare the stream for total_samples, the seektable is allocated */
+int flac_stream_init(flac_stream_t *s, uint32_t sample_rate, uint32_t bits, uint64_t total_samples);
+/* append a finished segment to the stream, segments have to be added in order */
+void flac_stream_add_segment(flac_stream_t *s, const flac_segment_t *seg);
+size_t flac_header_size(const flac_stream_t *s);
+/* write fLaC marker, STREAMINFO and SEEKTABLE into out (flac_header_size() bytes) */
+void flac_write_header(const flac_stream_t *s, uint8_t *out);
+void flac_stream_free(flac_stream_t *s);
+
+/* add a frame written by an encoder to the segment */
+void flac_segment_add_frame(flac_segment_t *seg, const uint8_t *frame, size_t len, uint32_t samples, uint32_t frame_idx);
+
+#if LIBFLAC_ENABLED == 1
+#include "FLAC/stream_encoder.h"
+
+/* encode samples into seg, the encoder is reinitialized for every segment */
+int flac_segment_encode(FLAC__StreamEncoder *encoder, flac_segment_t *seg, const int16_t *samples, int32_t *buf32, uint32_t level, uint32_t bits, uint32_t sample_rate);
+#endif
+
+#endif // FLAC_STITCH_H
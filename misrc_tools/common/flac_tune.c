@@ -0,0 +1,226 @@
+/*
+* MISRC tools
+* Copyright (C) 2025  vrunk11, stefan_o
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#if defined(__APPLE__) || defined(__MACH__)
+#include <sys/types.h>
+#include <sys/sysctl.h>
+#endif
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+#include "flac_tune.h"
+
+#if LIBFLAC_ENABLED == 1
+#include "FLAC/format.h"
+#include "FLAC/stream_encoder.h"
+
+#define PROFILE_NAME "misrc_flac_profile"
+#define PROFILE_LINE 512
+
+static char profile_path[1024];
+
+const char *flac_tune_path(void)
+{
+	const char *dir;
+	if (profile_path[0] != '\0') return profile_path;
+#ifdef _WIN32
+	if ((dir = getenv("LOCALAPPDATA")) != NULL) snprintf(profile_path, sizeof(profile_path), "%s\\" PROFILE_NAME, dir);
+#else
+	if ((dir = getenv("XDG_CACHE_HOME")) != NULL && dir[0] != '\0') {
+		snprintf(profile_path, sizeof(profile_path), "%s/" PROFILE_NAME, dir);
+	}
+	else if ((dir = getenv("HOME")) != NULL) {
+		snprintf(profile_path, sizeof(profile_path), "%s/.cache", dir);
+		mkdir(profile_path, 0700);
+		snprintf(profile_path, sizeof(profile_path), "%s/.cache/" PROFILE_NAME, dir);
+	}
+#endif
+	return (profile_path[0] != '\0') ? profile_path : NULL;
+}
+
+static void cpu_name(char *name, size_t len)
+{
+	snprintf(name, len, "unknown");
+#if defined(__linux__)
+	char line[PROFILE_LINE], *p;
+	FILE *f = fopen("/proc/cpuinfo", "r");
+	if (!f) return;
+	while (fgets(line, sizeof(line), f)) {
+		// x86 has a model name, ARM only a part number
+		if (strncmp(line, "model name", 10) != 0 && strncmp(line, "CPU part", 8) != 0) continue;
+		if ((p = strchr(line, ':')) == NULL) continue;
+		p += strspn(p, ": \t");
+		p[strcspn(p, "\r\n")] = '\0';
+		snprintf(name, len, "%s", p);
+		break;
+	}
+	fclose(f);
+#elif defined(__APPLE__) || defined(__MACH__)
+	size_t size = len;
+	if (sysctlbyname("machdep.cpu.brand_string", name, &size, NULL, 0) != 0) snprintf(name, len, "unknown");
+#elif defined(_WIN32)
+	const char *id = getenv("PROCESSOR_IDENTIFIER");
+	if (id) snprintf(name, len, "%s", id);
+#endif
+	// the name is part of a tab separated line
+	for(char *c = name; *c; c++) if (*c == '\t') *c = ' ';
+}
+
+void flac_tune_key(char *key, size_t len, uint32_t level, uint32_t bits, uint32_t sample_rate, uint32_t max_threads)
+{
+	char cpu[128];
+	cpu_name(cpu, sizeof(cpu));
+	snprintf(key, len, "%s|flac %s|level %u|bits %u|rate %u|max threads %u", cpu, FLAC__VERSION_STRING, level, bits, sample_rate, max_threads);
+}
+
+int flac_tune_load(const char *key, flac_tune_t *res)
+{
+	char line[PROFILE_LINE], *t;
+	size_t key_len = strlen(key);
+	const char *path = flac_tune_path();
+	FILE *f;
+	int r = -1;
+	if (!path || (f = fopen(path, "r")) == NULL) return -1;
+	while (fgets(line, sizeof(line), f)) {
+		if (strncmp(line, key, key_len) != 0 || line[key_len] != '\t') continue;
+		t = &line[key_len + 1];
+		res->threads = strtoul(t, &t, 10);
+		res->rate = strtod(t, &t);
+		res->sufficient = strtoul(t, NULL, 10) != 0;
+		res->cached = true;
+		r = (res->threads > 0) ? 0 : -1;
+	}
+	fclose(f);
+	return r;
+}
+
+int flac_tune_save(const char *key, const flac_tune_t *res)
+{
+	char line[PROFILE_LINE];
+	size_t key_len = strlen(key), len = 0, size = 0;
+	char *lines = NULL, *tmp;
+	const char *path = flac_tune_path();
+	FILE *f;
+	if (!path) return -1;
+	// keep the results of other machines and settings
+	if ((f = fopen(path, "r")) != NULL) {
+		while (fgets(line, sizeof(line), f)) {
+			if (strncmp(line, key, key_len) == 0 && line[key_len] == '\t') continue;
+			if (len + strlen(line) + 1 > size) {
+				size = (size + strlen(line) + 1) * 2;
+				if ((tmp = realloc(lines, size)) == NULL) {
+					free(lines);
+					fclose(f);
+					return -1;
+				}
+				lines = tmp;
+			}
+			memcpy(&lines[len], line, strlen(line) + 1);
+			len += strlen(line);
+		}
+		fclose(f);
+	}
+	if ((f = fopen(path, "w")) == NULL) {
+		free(lines);
+		return -1;
+	}
+	if (len > 0) fwrite(lines, 1, len, f);
+	fprintf(f, "%s\t%u\t%.0f\t%d\n", key, res->threads, res->rate, res->sufficient ? 1 : 0);
+	free(lines);
+	return (fclose(f) == 0) ? 0 : -1;
+}
+
+static FLAC__StreamEncoderWriteStatus discard_cb(const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes, uint32_t samples, uint32_t current_frame, void *client_data)
+{
+	(void)encoder; (void)buffer; (void)bytes; (void)samples; (void)current_frame; (void)client_data;
+	return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+}
+
+static double now(void)
+{
+	struct timespec t;
+	timespec_get(&t, TIME_UTC);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// encode n samples and return the samples/s, 0 if the encoder could not be set up
+static double encode_rate(FLAC__StreamEncoder *encoder, const int32_t *buf, size_t n, uint32_t level, uint32_t bits, uint32_t threads)
+{
+	FLAC__bool ok = true;
+	double start;
+	ok &= FLAC__stream_encoder_set_compression_level(encoder, level);
+	ok &= FLAC__stream_encoder_set_channels(encoder, 1);
+	ok &= FLAC__stream_encoder_set_bits_per_sample(encoder, bits);
+	ok &= FLAC__stream_encoder_set_sample_rate(encoder, 40000);
+#if defined(FLAC_API_VERSION_CURRENT) && FLAC_API_VERSION_CURRENT >= 14
+	ok &= FLAC__stream_encoder_set_num_threads(encoder, threads) == FLAC__STREAM_ENCODER_SET_NUM_THREADS_OK;
+#else
+	ok &= (threads == 1);
+#endif
+	if (!ok || FLAC__stream_encoder_init_stream(encoder, discard_cb, NULL, NULL, NULL, NULL) != FLAC__STREAM_ENCODER_INIT_STATUS_OK) return 0.0;
+	start = now();
+	ok = FLAC__stream_encoder_process(encoder, &buf, n);
+	ok &= FLAC__stream_encoder_finish(encoder);
+	return ok ? n / (now() - start) : 0.0;
+}
+
+int flac_tune_measure(uint32_t level, uint32_t bits, uint32_t max_threads, double rate, flac_tune_t *res)
+{
+	int32_t *buf = malloc(FLAC_TUNE_SAMPLES * sizeof(int32_t));
+	FLAC__StreamEncoder *encoder = FLAC__stream_encoder_new();
+	double amp = (double)(1 << (bits - 1)), r;
+	uint32_t noise = 1;
+	memset(res, 0, sizeof(flac_tune_t));
+	if (!buf || !encoder) {
+		free(buf);
+		if (encoder) FLAC__stream_encoder_delete(encoder);
+		return -1;
+	}
+	// a few carriers and some noise, roughly as hard to compress as a video RF signal
+	for(size_t i = 0; i < FLAC_TUNE_SAMPLES; i++) {
+		noise = noise * 1664525 + 1013904223;
+		r = 0.4 * sin(i * 0.0771) + 0.2 * sin(i * 0.5123) + 0.1 * sin(i * 1.9001) + 0.05 * ((double)(noise >> 8) / (1 << 24) - 0.5);
+		buf[i] = (int32_t)lrint(r * amp);
+	}
+	// warm up caches and the CPU clock
+	encode_rate(encoder, buf, FLAC_TUNE_SAMPLES / 8, level, bits, 1);
+	for(uint32_t t = 1; t <= max_threads; t++) {
+		r = encode_rate(encoder, buf, FLAC_TUNE_SAMPLES, level, bits, t);
+		// threads > 1 fail if libFLAC is built without multithreading
+		if (r == 0.0) break;
+		if (r > res->rate) {
+			res->threads = t;
+			res->rate = r;
+		}
+		if (r >= rate) {
+			res->threads = t;
+			res->rate = r;
+			res->sufficient = true;
+			break;
+		}
+	}
+	free(buf);
+	FLAC__stream_encoder_delete(encoder);
+	return (res->threads > 0) ? 0 : -1;
+}
+#endif
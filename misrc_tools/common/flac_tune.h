@@ -0,0 +1,55 @@
+/*
+* MISRC tools
+* Copyright (C) 2025  vrunk11, stefan_o
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FLAC_TUNE_H
+#define FLAC_TUNE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Choose the number of FLAC encoder threads by measuring: a synthetic RF
+ * like signal is encoded with the given level and an increasing number of
+ * threads until the encoder is fast enough. The result is stored in a
+ * profile file together with the CPU, the FLAC version and the settings,
+ * so the measurement is only done once per machine and level. */
+
+#define FLAC_TUNE_SAMPLES (1<<21)  // samples encoded per measurement
+#define FLAC_TUNE_MARGIN  1.25     // the encoder has to be faster than real time by this factor
+#define FLAC_TUNE_KEY_LEN 256
+
+typedef struct {
+	uint32_t threads;
+	double rate;       // samples/s encoded with this number of threads
+	bool cached;       // taken from the profile file
+	bool sufficient;   // the rate reaches the requested rate
+} flac_tune_t;
+
+/* identify the machine, FLAC version and encoder settings */
+void flac_tune_key(char *key, size_t len, uint32_t level, uint32_t bits, uint32_t sample_rate, uint32_t max_threads);
+/* look up key in the profile file, returns 0 if found */
+int flac_tune_load(const char *key, flac_tune_t *res);
+/* add the result for key to the profile file, replacing an older one, returns 0 on success */
+int flac_tune_save(const char *key, const flac_tune_t *res);
+/* measure 1..max_threads threads and take the smallest number that encodes
+ * rate samples/s, or the fastest if none does, returns 0 on success */
+int flac_tune_measure(uint32_t level, uint32_t bits, uint32_t max_threads, double rate, flac_tune_t *res);
+/* path of the profile file */
+const char *flac_tune_path(void);
+
+#endif // FLAC_TUNE_H
@@ -0,0 +1,316 @@
+/*
+* MISRC tools
+* Copyright (C) 2025  vrunk11, stefan_o
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if defined(__linux__)
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sys/resource.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include "flac_verify.h"
+
+#if LIBFLAC_ENABLED == 1
+#include "FLAC/stream_decoder.h"
+
+#define VERIFY_WAIT (struct timespec){.tv_nsec=50000000}
+
+/* weighted sum of the chunk in 32 bit lanes, a changed sample always changes
+ * the weighted part, as every weight is odd, swapped samples change it too */
+static void hash_update(uint32_t *sum, uint32_t *wsum, const int32_t *samples, size_t n, size_t pos)
+{
+	uint32_t s = *sum, w = *wsum;
+	for(size_t i = 0; i < n; i++) {
+		s += (uint32_t)samples[i];
+		w += (uint32_t)samples[i] * (uint32_t)(2 * (pos + i) + 1);
+	}
+	*sum = s;
+	*wsum = w;
+}
+
+static uint64_t hash_value(uint32_t sum, uint32_t wsum)
+{
+	return ((uint64_t)wsum << 32) | sum;
+}
+
+// writer side, the record is dropped and verification stopped if the queue is full
+static void rec_push(flac_verify_t *v, int type, char *name, uint64_t hash, uint64_t samples)
+{
+	size_t wr = atomic_load(&v->wr);
+	if (atomic_load(&v->stopped)) {
+		free(name);
+		return;
+	}
+	if (wr - atomic_load(&v->rd) == FLAC_VERIFY_QUEUE) {
+		atomic_store(&v->stopped, true);
+		free(name);
+		return;
+	}
+	v->q[wr % FLAC_VERIFY_QUEUE] = (flac_verify_rec_t){ type, name, hash, samples };
+	atomic_store(&v->wr, wr + 1);
+}
+
+// next record, NULL if there is none anymore
+static flac_verify_rec_t *rec_wait(flac_verify_t *v)
+{
+	for(;;) {
+		if (atomic_load(&v->rd) != atomic_load(&v->wr)) return &v->q[atomic_load(&v->rd) % FLAC_VERIFY_QUEUE];
+		if (atomic_load(&v->stopped)) return NULL;
+		// everything is queued before exit is set
+		if (atomic_load(&v->exit)) {
+			if (atomic_load(&v->rd) != atomic_load(&v->wr)) continue;
+			return NULL;
+		}
+		thrd_sleep(&VERIFY_WAIT, NULL);
+	}
+}
+
+static void rec_pop(flac_verify_t *v)
+{
+	atomic_fetch_add(&v->rd, 1);
+}
+
+static FLAC__StreamDecoderReadStatus verify_read(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data)
+{
+	flac_verify_t *v = client_data;
+	bool closed;
+	size_t n;
+	(void)decoder;
+	for(;;) {
+		// the end of the file is only final if it was closed before reading
+		closed = atomic_load(&v->files_closed) > v->file_no || atomic_load(&v->exit);
+		n = fread(buffer, 1, *bytes, v->f);
+		if (n > 0) {
+			*bytes = n;
+			return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+		}
+		if (ferror(v->f)) return FLAC__STREAM_DECODER_READ_STATUS_ABORT;
+		if (closed || atomic_load(&v->stopped)) {
+			*bytes = 0;
+			return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+		}
+		// wait for the writer
+		clearerr(v->f);
+		thrd_sleep(&VERIFY_WAIT, NULL);
+	}
+}
+
+static FLAC__StreamDecoderWriteStatus verify_write(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 *const buffer[], void *client_data)
+{
+	flac_verify_t *v = client_data;
+	const int32_t *s = buffer[0];
+	size_t n = frame->header.blocksize, part;
+	flac_verify_rec_t *rec;
+	(void)decoder;
+	while(n > 0) {
+		part = FLAC_VERIFY_CHUNK - v->vpos;
+		if (part > n) part = n;
+		hash_update(&v->vsum, &v->vwsum, s, part, v->vpos);
+		v->vpos += part;
+		v->vsamples += part;
+		s += part;
+		n -= part;
+		if (v->vpos < FLAC_VERIFY_CHUNK) break;
+		if ((rec = rec_wait(v)) == NULL) return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+		if (rec->type != FLAC_VERIFY_HASH) {
+			// more samples than the encoder got
+			if (v->msg_cb) v->msg_cb(v->msg_cb_ctx, MISRC_MSG_ERROR, "(%s) FLAC verification: more samples decoded than encoded", v->name);
+			v->failed = true;
+			return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+		}
+		if (rec->hash != hash_value(v->vsum, v->vwsum) && !v->failed) {
+			if (v->msg_cb) v->msg_cb(v->msg_cb_ctx, MISRC_MSG_ERROR, "(%s) FLAC verification: decoded samples %" PRIu64 " to %" PRIu64 " differ from the encoder input",
+				v->name, v->vsamples - FLAC_VERIFY_CHUNK, v->vsamples - 1);
+			v->failed = true;
+		}
+		rec_pop(v);
+		v->vsum = 0;
+		v->vwsum = 0;
+		v->vpos = 0;
+	}
+	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+static void verify_error(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data)
+{
+	flac_verify_t *v = client_data;
+	(void)decoder;
+	if (v->msg_cb && !v->failed) v->msg_cb(v->msg_cb_ctx, MISRC_MSG_ERROR, "(%s) FLAC verification: decoder error after sample %" PRIu64 ": %s",
+		v->name, v->vsamples, FLAC__StreamDecoderErrorStatusString[status]);
+	v->failed = true;
+}
+
+// decode one file while it is written, the hashes of the chunks are taken from the queue
+static void verify_file(flac_verify_t *v, const char *filename)
+{
+	FLAC__StreamDecoder *decoder = FLAC__stream_decoder_new();
+	flac_verify_rec_t *rec;
+	v->vsum = 0;
+	v->vwsum = 0;
+	v->vpos = 0;
+	v->vsamples = 0;
+	v->failed = false;
+	if (!decoder || (v->f = fopen(filename, "rb")) == NULL) {
+		if (v->msg_cb) v->msg_cb(v->msg_cb_ctx, MISRC_MSG_WARNING, "(%s) FLAC verification: could not read back %s", v->name, filename);
+		v->failed = true;
+	}
+	else if (FLAC__stream_decoder_init_stream(decoder, verify_read, NULL, NULL, NULL, NULL, verify_write, NULL, verify_error, v) != FLAC__STREAM_DECODER_INIT_STATUS_OK
+		|| !FLAC__stream_decoder_process_until_end_of_stream(decoder)) {
+		if (v->msg_cb && !v->failed && !atomic_load(&v->stopped)) v->msg_cb(v->msg_cb_ctx, MISRC_MSG_ERROR, "(%s) FLAC verification: could not decode %s: %s",
+			v->name, filename, FLAC__StreamDecoderStateString[FLAC__stream_decoder_get_state(decoder)]);
+		v->failed = true;
+	}
+	if (decoder) FLAC__stream_decoder_delete(decoder);
+	if (v->f) fclose(v->f);
+	v->f = NULL;
+	// the hashes of samples that were not decoded are skipped
+	while((rec = rec_wait(v)) != NULL && rec->type == FLAC_VERIFY_HASH) {
+		if (!v->failed && v->msg_cb) v->msg_cb(v->msg_cb_ctx, MISRC_MSG_ERROR, "(%s) FLAC verification: only %" PRIu64 " samples could be decoded", v->name, v->vsamples);
+		v->failed = true;
+		rec_pop(v);
+	}
+	if (!rec) return;
+	if (!v->failed && (rec->samples != v->vsamples || rec->hash != hash_value(v->vsum, v->vwsum))) {
+		if (v->msg_cb) v->msg_cb(v->msg_cb_ctx, MISRC_MSG_ERROR, "(%s) FLAC verification: the end of %s differs from the encoder input (%" PRIu64 " of %" PRIu64 " samples decoded)",
+			v->name, filename, v->vsamples, rec->samples);
+		v->failed = true;
+	}
+	if (!v->failed) {
+		v->verified += v->vsamples;
+		if (v->msg_cb) v->msg_cb(v->msg_cb_ctx, MISRC_MSG_INFO, "(%s) FLAC verification: %s is correct, %" PRIu64 " samples", v->name, filename, v->vsamples);
+	}
+	else v->files_failed++;
+	v->files++;
+	rec_pop(v);
+}
+
+static int verify_thread(void *ctx)
+{
+	flac_verify_t *v = ctx;
+	flac_verify_rec_t *rec;
+	char *filename;
+	int type;
+#if defined(__linux__)
+	// the nice value is per thread on Linux
+	pthread_setname_np(pthread_self(), "flac_verify");
+	setpriority(PRIO_PROCESS, 0, 19);
+#elif defined(_WIN32)
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#endif
+	while((rec = rec_wait(v)) != NULL) {
+		// the slot can be reused once the record is popped
+		filename = rec->name;
+		type = rec->type;
+		rec_pop(v);
+		if (type != FLAC_VERIFY_FILE) continue;
+		if (filename) {
+			verify_file(v, filename);
+			free(filename);
+		}
+		else {
+			// skip the file
+			while((rec = rec_wait(v)) != NULL) {
+				type = rec->type;
+				rec_pop(v);
+				if (type == FLAC_VERIFY_END) break;
+			}
+		}
+		v->file_no++;
+	}
+	return 0;
+}
+
+int flac_verify_start(flac_verify_t *v, const char *name, misrc_message_cb_t msg_cb, void *msg_cb_ctx)
+{
+	memset(v, 0, sizeof(*v));
+	v->name = name;
+	v->msg_cb = msg_cb;
+	v->msg_cb_ctx = msg_cb_ctx;
+	atomic_init(&v->wr, 0);
+	atomic_init(&v->rd, 0);
+	atomic_init(&v->files_closed, 0);
+	atomic_init(&v->stopped, false);
+	atomic_init(&v->exit, false);
+	return (thrd_create(&v->thread, verify_thread, v) == thrd_success) ? 0 : -1;
+}
+
+void flac_verify_file(flac_verify_t *v, const char *filename)
+{
+	char *name = (filename) ? strdup(filename) : NULL;
+	v->active = (name != NULL);
+	v->sum = 0;
+	v->wsum = 0;
+	v->pos = 0;
+	v->samples = 0;
+	rec_push(v, FLAC_VERIFY_FILE, name, 0, 0);
+}
+
+void flac_verify_samples(flac_verify_t *v, const int32_t *samples, size_t n)
+{
+	size_t part;
+	if (!v->active || atomic_load(&v->stopped)) return;
+	v->samples += n;
+	while(n > 0) {
+		part = FLAC_VERIFY_CHUNK - v->pos;
+		if (part > n) part = n;
+		hash_update(&v->sum, &v->wsum, samples, part, v->pos);
+		v->pos += part;
+		samples += part;
+		n -= part;
+		if (v->pos < FLAC_VERIFY_CHUNK) break;
+		rec_push(v, FLAC_VERIFY_HASH, NULL, hash_value(v->sum, v->wsum), 0);
+		v->sum = 0;
+		v->wsum = 0;
+		v->pos = 0;
+	}
+}
+
+void flac_verify_file_end(flac_verify_t *v)
+{
+	rec_push(v, FLAC_VERIFY_END, NULL, hash_value(v->sum, v->wsum), v->samples);
+	atomic_fetch_add(&v->files_closed, 1);
+}
+
+void flac_verify_finish(flac_verify_t *v)
+{
+	flac_verify_rec_t *rec;
+	if (v->msg_cb && atomic_load(&v->wr) != atomic_load(&v->rd)) v->msg_cb(v->msg_cb_ctx, MISRC_MSG_INFO, "(%s) Waiting for the FLAC verification to finish...", v->name);
+	atomic_store(&v->exit, true);
+	thrd_join(v->thread, NULL);
+	// names of files that were not reached anymore
+	for(; atomic_load(&v->rd) != atomic_load(&v->wr); rec_pop(v)) {
+		rec = &v->q[atomic_load(&v->rd) % FLAC_VERIFY_QUEUE];
+		free(rec->name);
+	}
+	if (!v->msg_cb) return;
+	if (atomic_load(&v->stopped)) {
+		v->msg_cb(v->msg_cb_ctx, MISRC_MSG_WARNING, "(%s) FLAC verification could not keep up and was stopped, %" PRIu64 " samples in %u files verified before",
+			v->name, v->verified, v->files - v->files_failed);
+	}
+	if (v->files_failed > 0) {
+		v->msg_cb(v->msg_cb_ctx, MISRC_MSG_ERROR, "(%s) FLAC verification failed for %u of %u files", v->name, v->files_failed, v->files);
+	}
+	else if (!atomic_load(&v->stopped)) {
+		v->msg_cb(v->msg_cb_ctx, MISRC_MSG_INFO, "(%s) FLAC verification: %u files with %" PRIu64 " samples are correct", v->name, v->files, v->verified);
+	}
+}
+#endif
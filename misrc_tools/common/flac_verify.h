@@ -0,0 +1,98 @@
+/*
+* MISRC tools
+* Copyright (C) 2025  vrunk11, stefan_o
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FLAC_VERIFY_H
+#define FLAC_VERIFY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#if __STDC_VERSION__ >= 201112L && ! __STDC_NO_THREADS__ && ! _WIN32
+#include <threads.h>
+#else
+#include "cthreads.h"
+#endif
+#include "misrc.h"
+
+/* Verification of the FLAC files written during a capture without the cost
+ * of the encoder verification: the writer hashes the samples it passes to the
+ * encoder in chunks and queues the hashes, a thread with low priority reads
+ * the files back while they are written, decodes them and compares the hashes.
+ * It may fall behind during the capture, as long as the queue does not
+ * overflow, the rest is verified after the capture ended. Files that cannot
+ * be read back (stdout) are not verified. */
+
+#define FLAC_VERIFY_CHUNK (1<<20)  // samples per hash
+#define FLAC_VERIFY_QUEUE 4096     // hashes the verifier can be behind, about 100 s at 40 MSPS
+
+#define FLAC_VERIFY_FILE 0
+#define FLAC_VERIFY_HASH 1
+#define FLAC_VERIFY_END  2
+
+typedef struct {
+	int type;
+	char *name;        // FILE: the file to read back, NULL if it is not verified
+	uint64_t hash;     // HASH: of a chunk, END: of the incomplete last chunk
+	uint64_t samples;  // END: samples of the file
+} flac_verify_rec_t;
+
+typedef struct {
+	const char *name;            // of the output, for messages
+	misrc_message_cb_t msg_cb;
+	void *msg_cb_ctx;
+	thrd_t thread;
+	flac_verify_rec_t q[FLAC_VERIFY_QUEUE];
+	atomic_size_t wr;
+	atomic_size_t rd;
+	atomic_uint files_closed;    // files completely written
+	atomic_bool stopped;         // the queue overflowed, nothing more is verified
+	atomic_bool exit;            // nothing more is queued
+	// writer side
+	bool active;                 // the current file is verified
+	uint32_t sum;
+	uint32_t wsum;
+	size_t pos;                  // samples in the current chunk
+	uint64_t samples;            // samples of the current file
+	// verifier side
+	FILE *f;
+	unsigned int file_no;
+	uint32_t vsum;
+	uint32_t vwsum;
+	size_t vpos;
+	uint64_t vsamples;
+	bool failed;                 // the current file has an error
+	// results
+	unsigned int files;
+	unsigned int files_failed;
+	uint64_t verified;           // samples
+} flac_verify_t;
+
+/* start the verifier thread, returns 0 on success */
+int flac_verify_start(flac_verify_t *v, const char *name, misrc_message_cb_t msg_cb, void *msg_cb_ctx);
+/* a new file is written, filename NULL if it cannot be read back */
+void flac_verify_file(flac_verify_t *v, const char *filename);
+/* samples passed to the encoder */
+void flac_verify_samples(flac_verify_t *v, const int32_t *samples, size_t n);
+/* the file is complete and closed */
+void flac_verify_file_end(flac_verify_t *v);
+/* wait until everything is verified and report the result */
+void flac_verify_finish(flac_verify_t *v);
+
+#endif // FLAC_VERIFY_H
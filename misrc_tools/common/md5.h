@@ -0,0 +1,39 @@
+/*
+* MISRC tools
+* Copyright (C) 2025  vrunk11, stefan_o
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MD5_H
+#define MD5_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* MD5 (RFC 1321), used for the FLAC STREAMINFO signature */
+
+typedef struct {
+	uint32_t state[4];
+	uint64_t count;
+	uint8_t buffer[64];
+} md5_ctx_t;
+
+void md5_init(md5_ctx_t *ctx);
+void md5_update(md5_ctx_t *ctx, const void *data, size_t len);
+// add samples in the byte order and width of a FLAC stream with bps bits per sample (bps/8 bytes each)
+void md5_update_flac(md5_ctx_t *ctx, const int16_t *samples, size_t count, uint32_t bps);
+void md5_final(md5_ctx_t *ctx, uint8_t digest[16]);
+
+#endif // MD5_H
@@ -82,6 +82,12 @@ typedef struct {
 	bool pad;
 	bool calc_level;
 	bool disable_clip[2];
+	uint64_t rf_format;
+	bool rf_dc_removal;
+	// MISRC container, 0 if not used, otherwise the codec + 1
+	uint64_t rf_container;
+	int64_t rf_container_level;
+	uint64_t rf_container_threads;
 #if LIBFLAC_ENABLED == 1
 	uint64_t flac_level;
 	bool flac_enable;
@@ -89,13 +95,32 @@ typedef struct {
 	bool flac_12bit;
 	uint64_t flac_bits;
 	uint64_t flac_threads;
+	bool flac_adaptive;
+	bool flac_calibrate;
+	bool flac_builtin;
+	bool flac_check;
 #endif
-#if LIBSOXR_ENABLED == 1
 	double resample_rate[2];
 	uint64_t resample_qual[2];
 	double resample_gain[2];
+#if LIBSOXR_ENABLED == 1
+	bool resample_soxr;
+#endif
 	bool reduce_8bit[2];
+	uint64_t reduce_8bit_rounding;
+	bool direct_write;
+	bool pipe_zerocopy;
+#if LIBURING_ENABLED == 1
+	bool io_uring;
 #endif
+	uint64_t writeback;
+	// what to do if an output can't keep up
+	uint64_t backpressure[2];
+	uint64_t backpressure_raw;
+	// splitting into segments
+	uint64_t split_size;
+	char *split_time;
+	bool split_manual;
 	// output file names
 	char *output_names_rf[2];
 	char *output_name_aux;
@@ -165,6 +190,8 @@ typedef struct {
 
 int misrc_run_capture(misrc_settings_t *set);
 void misrc_stop_capture();
+/* start new output files at the next block, if splitting is enabled */
+void misrc_cut_capture();
 void misrc_capture_set_default(misrc_settings_t *set, misrc_option_t *opt);
 void misrc_list_devices(misrc_device_info_t **dev_info, size_t *n);
 char* misrc_sc_capture_impl_name();
@@ -21,12 +21,37 @@
 #define MISRC_OPT_RESAMPLE_GAIN_B  269
 #define MISRC_OPT_8BIT_A           270
 #define MISRC_OPT_8BIT_B           271
+#define MISRC_OPT_RF_FORMAT        272
+#define MISRC_OPT_8BIT_ROUNDING    273
+#define MISRC_OPT_RF_DC_REMOVAL    274
+#define MISRC_OPT_IO_URING         275
+#define MISRC_OPT_DIRECT_WRITE     276
+#define MISRC_OPT_WRITEBACK        277
+#define MISRC_OPT_SPLIT_SIZE       278
+#define MISRC_OPT_SPLIT_TIME       279
+#define MISRC_OPT_SPLIT_MANUAL     280
+#define MISRC_OPT_BACKPRESSURE_A   281
+#define MISRC_OPT_BACKPRESSURE_B   282
+#define MISRC_OPT_BACKPRESSURE_RAW 283
+#define MISRC_OPT_RF_FLAC_ADAPTIVE 284
+#define MISRC_OPT_RF_FLAC_CALIBRATE 285
+#define MISRC_OPT_RF_FLAC_BUILTIN  286
+#define MISRC_OPT_RF_FLAC_CHECK    287
+#define MISRC_OPT_RF_CONTAINER     288
+#define MISRC_OPT_RF_CONTAINER_LEVEL 289
+#define MISRC_OPT_RF_CONTAINER_THREADS 290
+#define MISRC_OPT_RESAMPLE_SOXR    291
+#define MISRC_OPT_PIPE_ZEROCOPY    292
 
 
 #define MISRC_SET_OPTION(t,s,o,x,v) (*(((t*)(((void*)s)+(o->setting_offset)))+x)=(t)v)
 
 static char* sox_quality_options[] = { "QQ", "LQ", "MQ", "HQ", "VHQ" };
 static char* flac_bits_options[] = { "auto", "12", "16" };
+static char* rf_format_options[] = { "s16", "s12p", "f32", "f32raw" };
+static char* rounding_8bit_options[] = { "truncate", "round", "dither" };
+static char* backpressure_options[] = { "block", "drop", "degrade" };
+static char* rf_container_options[] = { "off", "store", "zstd", "lz4", "rice" };
 
 static int mirsc_opt_type_cnt[] = { 1, 1, 1, 2, 1, 2, 4 };
 
@@ -36,26 +61,48 @@ static misrc_option_t misrc_option_list[] =
   {'n', "Number of samples to capture", "count", "n", "samples", "number of samples to capture", MISRC_OPTTYPE_CAPTURE_ALL, MISRC_ARGTYPE_INT, 0, { 0 }, { 0 }, { 0 }, "0 means infinite", NULL, NULL, offsetof(misrc_settings_t, total_samples_before_exit) },
   {'t', "Capture duration", "time", "time", "s, m:s or h:m:s", "time to capture", MISRC_OPTTYPE_CAPTURE_ALL, MISRC_ARGTYPE_STR, MISRC_OPTFLAG_CLIONLY, { 0 }, { 0 }, { 0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, capture_time) },
   {'w', "Overwrite output", "overwrite", NULL, NULL, "overwrite any files without asking", MISRC_OPTTYPE_CAPTURE_ALL, MISRC_ARGTYPE_BOOL, 0, { 0 }, { 0 }, { 0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, overwrite_files) },
+  {MISRC_OPT_WRITEBACK, "Streaming writeback", "writeback", "size", "MiB", "start writing output files to disk every given MiB and drop the written data from the page cache (Linux only)", MISRC_OPTTYPE_CAPTURE_ALL, MISRC_ARGTYPE_INT, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 1024 }, "0 means disabled", NULL, NULL, offsetof(misrc_settings_t, writeback) },
+  {MISRC_OPT_SPLIT_SIZE, "Split by size", "split-size", "size", "GiB", "start new output files when one of them reaches the given size", MISRC_OPTTYPE_CAPTURE_ALL, MISRC_ARGTYPE_INT, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 65536 }, "0 means disabled", NULL, NULL, offsetof(misrc_settings_t, split_size) },
+  {MISRC_OPT_SPLIT_TIME, "Split by time", "split-time", "time", "s, m:s or h:m:s", "start new output files after the given time", MISRC_OPTTYPE_CAPTURE_ALL, MISRC_ARGTYPE_STR, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, split_time) },
+  {MISRC_OPT_SPLIT_MANUAL, "Split on request", "split-manual", NULL, NULL, "start new output files on request (SIGUSR1), also possible with --split-size or --split-time", MISRC_OPTTYPE_CAPTURE_ALL, MISRC_ARGTYPE_BOOL, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, split_manual) },
   {'a', "RF A output file", "rf-a", "filename", NULL, "device index/name to use for capture", MISRC_OPTTYPE_CAPTURE_RFC, MISRC_ARGTYPE_OUTFILE, 0, { 0 }, { 0 }, { 0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, output_names_rf), },
   {'x', "AUX output file", "aux", "filename", NULL, "AUX output file", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_OUTFILE, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, output_name_aux) },
   {'r', "RAW data output file", "raw", "filename", NULL, "raw data output file", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_OUTFILE, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, output_name_raw) },
+  {MISRC_OPT_BACKPRESSURE_RAW, "Slow RAW/AUX output", "backpressure-raw", "policy", NULL, "what to do if the raw or AUX output can't keep up (block: hold back the capture, drop or degrade: drop data and report the gap)", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_LIST, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 2 }, NULL, NULL, backpressure_options, offsetof(misrc_settings_t, backpressure_raw) },
   {'p', "Pad RF output data", "pad", NULL, NULL, "pad lower 4 bits of 16 bit output with 0 instead of upper 4", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_BOOL, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, pad)},
+  {MISRC_OPT_RF_FORMAT, "RF sample format", "rf-format", "format", NULL, "sample format of uncompressed RF output (s12p: two 12 bit samples packed in 3 bytes, f32: float normalized to +-1.0, f32raw: float in ADC counts)", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_LIST, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 3 }, NULL, NULL, rf_format_options, offsetof(misrc_settings_t, rf_format) },
+  {MISRC_OPT_RF_DC_REMOVAL, "Remove DC offset", "rf-dc-removal", NULL, NULL, "remove DC offset from float RF output", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_BOOL, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, rf_dc_removal) },
+  {MISRC_OPT_RF_CONTAINER, "MISRC container", "rf-container", "codec", NULL, "write RF output as MISRC container, chunks with index and checksums that are compressed in parallel (store: uncompressed, zstd or lz4 if supported by the build, rice: built-in, compresses best)", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_LIST, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 4 }, NULL, NULL, rf_container_options, offsetof(misrc_settings_t, rf_container) },
+  {MISRC_OPT_RF_CONTAINER_LEVEL, "MISRC container compression level", "rf-container-level", "level", NULL, "compression level of the MISRC container (zstd: negative levels are faster, up to 19; lz4: up to 1 fast with more acceleration for lower levels, 2 to 12 high compression; not used by rice)", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_INT, MISRC_OPTFLAG_ADVANCED, { 1 }, { -20 }, { 19 }, "fastest, lowest compression", "slowest, highest compression", NULL, offsetof(misrc_settings_t, rf_container_level) },
+  {MISRC_OPT_RF_CONTAINER_THREADS, "MISRC container threads", "rf-container-threads", "threads", NULL, "number of threads compressing the chunks of the MISRC container per file", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_INT, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 64 }, "0 means automatic, all cores that are not used otherwise", NULL, NULL, offsetof(misrc_settings_t, rf_container_threads) },
   {'L', "RF peak level display", "level", NULL, NULL, "display peak level of RF ADCs", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_BOOL, MISRC_OPTFLAG_CLIONLY, { 0 }, { 0 }, { 0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, calc_level)},
   {'A', "Suppress clipping display", "suppress-clip-rf-a", NULL, NULL, "suppress clipping messages for this RF channel", MISRC_OPTTYPE_CAPTURE_RFC, MISRC_ARGTYPE_BOOL, MISRC_OPTFLAG_CLIONLY, { 0 }, { 0 }, { 0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, disable_clip)},
-#if LIBSOXR_ENABLED == 1
   {MISRC_OPT_8BIT_A, "Reduce to 8 Bit", "8bit-rf-a", NULL, NULL, "reduce output from 12 bit to 8 bit for this RF channel", MISRC_OPTTYPE_CAPTURE_RFC, MISRC_ARGTYPE_BOOL, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, reduce_8bit) },
+  {MISRC_OPT_BACKPRESSURE_A, "Slow output", "backpressure-rf-a", "policy", NULL, "what to do if the output of this RF channel can't keep up (block: hold back the capture and all other outputs, drop: drop data and report the gap, degrade: lower the FLAC compression level first, then drop)", MISRC_OPTTYPE_CAPTURE_RFC, MISRC_ARGTYPE_LIST, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 2 }, NULL, NULL, backpressure_options, offsetof(misrc_settings_t, backpressure) },
+  {MISRC_OPT_DIRECT_WRITE, "Direct I/O", "direct-write", NULL, NULL, "write RF output files with direct I/O, preallocated if the capture length is known", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_BOOL, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, direct_write) },
+  {MISRC_OPT_PIPE_ZEROCOPY, "Zero-copy pipes", "pipe-zerocopy", NULL, NULL, "write RF and 4 channel audio output pipes with vmsplice instead of copying, only if the reader copies the data with read(): a reader that splices it on (e.g. to a file or socket) gets corrupted data", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_BOOL, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, pipe_zerocopy) },
+#if LIBURING_ENABLED == 1
+  {MISRC_OPT_IO_URING, "Asynchronous writes", "io-uring", NULL, NULL, "write RF and 4 channel audio output files with io_uring, several writes in flight", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_BOOL, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, io_uring) },
+#endif
+  {MISRC_OPT_8BIT_ROUNDING, "8 Bit rounding", "8bit-rounding", "mode", NULL, "rounding used when reducing RF output to 8 bit without resampling", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_LIST, MISRC_OPTFLAG_ADVANCED, { 1 }, { 0 }, { 2 }, NULL, NULL, rounding_8bit_options, offsetof(misrc_settings_t, reduce_8bit_rounding) },
   {MISRC_OPT_RESAMPLE_A, "Resample to", "resample-rf-a", "samplerate", "kHz", "resample this RF channel to given sample rate", MISRC_OPTTYPE_CAPTURE_RFC, MISRC_ARGTYPE_FLOAT, 0, { .f=40000.0 }, { .f=1.0  }, { .f=40000.0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, resample_rate) },
   {MISRC_OPT_RESAMPLE_QUAL_A, "Resample quality", "resample-rf-quality-a", "quality", NULL, "resample quality of this RF channel", MISRC_OPTTYPE_CAPTURE_RFC, MISRC_ARGTYPE_LIST, MISRC_OPTFLAG_ADVANCED, { 3 }, { 0 }, { 4 }, "lowest quality, less processing intensive", "very high quality, more processing intensive", sox_quality_options, offsetof(misrc_settings_t, resample_qual) },
   {MISRC_OPT_RESAMPLE_GAIN_A, "Gain during resampling", "resample-rf-gain-a", "gain", "dB", "apply gain during resampling of this RF channel", MISRC_OPTTYPE_CAPTURE_RFC, MISRC_ARGTYPE_FLOAT, MISRC_OPTFLAG_ADVANCED, { .f=0.0 }, { .f=-72.0  }, { .f=72.0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, resample_gain) },
+#if LIBSOXR_ENABLED == 1
+  {MISRC_OPT_RESAMPLE_SOXR, "Resample with libsoxr", "resample-soxr", NULL, NULL, "resample RF with libsoxr even if the built-in decimator supports the sample rate (40000 kHz times 1/M or 2/M)", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_BOOL, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, resample_soxr) },
 #endif
 #if LIBFLAC_ENABLED == 1
   {'f', "FLAC compression", "rf-flac", NULL, NULL, "compress RF ADC output as FLAC", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_BOOL, 0, { 0 }, { 0 }, { 0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, flac_enable) },
   {MISRC_OPT_RF_FLAC_12BIT, "FLAC 12 Bit", "rf-flac-12bit", NULL, NULL, "set RF FLAC bith depth to 12 bit", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_BOOL, MISRC_OPTFLAG_ADVANCED | MISRC_OPTFLAG_LEGACY, { 0 }, { 0 }, { 0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, flac_12bit) },
   {MISRC_OPT_RF_FLAC_BITS, "FLAC bit depth", "rf-flac-bits", "bits", NULL, "Set the RF FLAC bit depth field", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_LIST, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 2 }, NULL, NULL, flac_bits_options, offsetof(misrc_settings_t, flac_bits) },
   {'l', "FLAC compression level", "rf-flac-level", "level", NULL, "set RF flac compression level", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_INT, MISRC_OPTFLAG_ADVANCED, { 1 }, { 0 }, { 8 }, "lowest compression, less processing intensive", "highest compression, more processing intensive", NULL, offsetof(misrc_settings_t, flac_level) },
+  {MISRC_OPT_RF_FLAC_ADAPTIVE, "Adaptive FLAC compression", "rf-flac-adaptive", NULL, NULL, "lower the RF flac compression level while the encoder can't keep up, up to the level set with -l", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_BOOL, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, flac_adaptive) },
   {'v', "FLAC encoding validation", "rf-flac-verification", NULL, NULL, "enable verification of RF flac encoder output", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_BOOL, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, flac_verify) },
+  {MISRC_OPT_RF_FLAC_CHECK, "FLAC read-back check", "rf-flac-check", NULL, NULL, "read the RF flac files back while they are written and compare the decoded samples with the encoder input, at low priority instead of the costly encoder verification", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_BOOL, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, flac_check) },
+  {MISRC_OPT_RF_FLAC_BUILTIN, "Built-in FLAC encoder", "rf-flac-builtin", NULL, NULL, "encode RF flac with the built-in fixed predictor encoder instead of libFLAC, much faster, about the compression of level 1, -l is ignored", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_BOOL, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, flac_builtin) },
+  {'c', "FLAC encoding threads", "rf-flac-threads", "threads", NULL, "number of RF flac encoding threads per file (libFLAC 1.5 or newer, or the built-in encoder)", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_INT, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 128 }, "0 means automatic, measured once and stored", NULL, NULL, offsetof(misrc_settings_t, flac_threads) },
 #if defined(FLAC_API_VERSION_CURRENT) && FLAC_API_VERSION_CURRENT >= 14
-  {'c', "FLAC encoding threads", "rf-flac-threads", "threads", NULL, "number of RF flac encoding threads per file", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_INT, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 128 }, "0 means automatic detection", NULL, NULL, offsetof(misrc_settings_t, flac_threads) },
+  {MISRC_OPT_RF_FLAC_CALIBRATE, "FLAC thread calibration", "rf-flac-calibrate", NULL, NULL, "measure the RF flac encoder speed again instead of using the stored profile", MISRC_OPTTYPE_CAPTURE_RF, MISRC_ARGTYPE_BOOL, MISRC_OPTFLAG_ADVANCED, { 0 }, { 0 }, { 0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, flac_calibrate) },
 #endif
 #endif
   {MISRC_OPT_AUDIO_4CH_OUT, "4ch output file", "audio-4ch", "filename", NULL, "4 channel audio output", MISRC_OPTTYPE_CAPTURE_AUDIO_ALL, MISRC_ARGTYPE_OUTFILE, 0, { .i=0 }, { .i=0 }, { .i=0 }, NULL, NULL, NULL, offsetof(misrc_settings_t, output_name_4ch_audio) },
@@ -0,0 +1,68 @@
+/*
+* MISRC tools
+* Copyright (C) 2025  vrunk11, stefan_o
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PARSE_TIME_H
+#define PARSE_TIME_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define PARSE_TIME_SAMPLE_RATE 40000000
+
+/* parse a time given as s, m:s or h:m:s (the seconds may have decimals and
+ * an 's' suffix), returns the time in seconds or -1 if it is invalid */
+static inline double parse_time(const char *str)
+{
+	double t = 0.0, v;
+	char *end;
+	for(int i = 0; i < 3; i++) {
+		v = strtod(str, &end);
+		if (end == str || v < 0.0) return -1.0;
+		t = t * 60.0 + v;
+		if (*end == ':') {
+			// only the seconds may have decimals
+			if (v != floor(v)) return -1.0;
+			str = end + 1;
+			continue;
+		}
+		if (*end == 's') end++;
+		return (*end == '\0') ? t : -1.0;
+	}
+	return -1.0;
+}
+
+/* parse a sample position, either a number of samples or a time (see above,
+ * the unit 's' or colons are required) at 40 MSPS, returns 0 on success */
+static inline int parse_sample_pos(const char *str, uint64_t *samples)
+{
+	double t;
+	char *end;
+	if (strchr(str, ':') || (str[0] != '\0' && str[strlen(str)-1] == 's')) {
+		t = parse_time(str);
+		if (t < 0.0) return -1;
+		*samples = (uint64_t)llround(t * PARSE_TIME_SAMPLE_RATE);
+		return 0;
+	}
+	if (str[0] < '0' || str[0] > '9') return -1;
+	*samples = strtoull(str, &end, 10);
+	return (*end == '\0') ? 0 : -1;
+}
+
+#endif // PARSE_TIME_H
@@ -0,0 +1,432 @@
+/*
+* MISRC tools
+* Copyright (C) 2025  vrunk11, stefan_o
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if defined(__linux__)
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#endif
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#if __STDC_VERSION__ >= 201112L && ! __STDC_NO_THREADS__ && ! _WIN32
+#include <threads.h>
+#else
+#include "cthreads.h"
+#endif
+#include "pipe_writer.h"
+
+void pw_init(pipe_writer_t *pw, FILE *f, bool splice)
+{
+	memset(pw, 0, sizeof(*pw));
+	pw->f = f;
+	pw->fd = -1;
+	pw->mode = PIPE_WRITER_STDIO;
+#if defined(__linux__)
+	struct stat st;
+	int fd = fileno(f), size;
+	if (fstat(fd, &st) != 0) return;
+	if (S_ISREG(st.st_mode) && splice) {
+		fflush(f);
+		pw->fd = fd;
+		pw->offset = lseek(fd, 0, SEEK_CUR);
+		pw->mode = PIPE_WRITER_COPY;
+		return;
+	}
+	if (!S_ISFIFO(st.st_mode)) return;
+	// the size is limited by /proc/sys/fs/pipe-max-size for unprivileged users
+	for(size = PIPE_WRITER_SIZE; size > 65536; size >>= 1) {
+		if (fcntl(fd, F_SETPIPE_SZ, size) >= 0) break;
+	}
+	size = fcntl(fd, F_GETPIPE_SZ);
+	pw->pipe_size = (size > 0) ? size : 65536;
+	fflush(f);
+	pw->fd = fd;
+	pw->mode = PIPE_WRITER_WRITE;
+#else
+	(void)splice;
+#endif
+}
+
+#define PW_ALIGNED(pw, buf, len) ((((uintptr_t)(buf) | (len) | (pw)->offset) % PIPE_WRITER_ALIGN) == 0)
+
+static void pw_release(pipe_writer_t *pw, ringbuffer_t *rb);
+#if defined(__linux__)
+static void pw_direct_off(pipe_writer_t *pw, ringbuffer_t *rb);
+#endif
+
+// release the oldest pending write in the ringbuffer
+static void pw_pop(pipe_writer_t *pw, ringbuffer_t *rb)
+{
+	rb_read_finished(rb, pw->release[pw->first]);
+	pw->held -= pw->release[pw->first];
+	pw->first = (pw->first + 1) % PIPE_WRITER_PENDING;
+	pw->cnt--;
+}
+
+#if LIBURING_ENABLED == 1
+static uint64_t pw_time_ns(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+int pw_use_uring(pipe_writer_t *pw)
+{
+	if (pw->mode != PIPE_WRITER_COPY && pw->mode != PIPE_WRITER_SENDFILE && pw->mode != PIPE_WRITER_DIRECT) return -1;
+	if (io_uring_queue_init(PIPE_WRITER_URING_DEPTH, &pw->uring, 0) != 0) return -1;
+	pw->mode = PIPE_WRITER_URING;
+	return 0;
+}
+
+// handle completed writes, with wait set at least one
+static void pw_uring_reap(pipe_writer_t *pw, bool wait)
+{
+	struct io_uring_cqe *cqe;
+	uint64_t lat;
+	size_t i;
+	ssize_t n, m;
+	while((wait ? io_uring_wait_cqe(&pw->uring, &cqe) : io_uring_peek_cqe(&pw->uring, &cqe)) == 0) {
+		i = (uintptr_t)io_uring_cqe_get_data(cqe);
+		n = cqe->res;
+		io_uring_cqe_seen(&pw->uring, cqe);
+		wait = false;
+		if (n < 0) pw->uring_error = -n;
+		// the rest of a short write is written synchronously
+		else while((size_t)n < pw->wlen[i]) {
+			m = pwrite(pw->fd, pw->wbuf[i] + n, pw->wlen[i] - n, pw->woff[i] + n);
+			if (m < 0 && errno == EINTR) continue;
+			if (m <= 0) {
+				pw->uring_error = (m < 0) ? errno : EIO;
+				break;
+			}
+			n += m;
+		}
+		lat = pw_time_ns() - pw->wtime[i];
+		pw->lat_sum += lat;
+		pw->lat_cnt++;
+		if (lat > pw->lat_max) pw->lat_max = lat;
+		pw->done[i] = true;
+	}
+}
+
+static int pw_uring_write(pipe_writer_t *pw, ringbuffer_t *rb, const uint8_t *buf, size_t len, size_t size)
+{
+	struct io_uring_sqe *sqe;
+	struct iovec iov;
+	size_t i;
+	if (!pw->uring_registered) {
+		// a registered buffer is not mapped again for every write, but needs RLIMIT_MEMLOCK for the whole ringbuffer
+		iov.iov_base = rb->buffer;
+		iov.iov_len = 2 * rb->buffer_size;
+		pw->uring_fixed = (io_uring_register_buffers(&pw->uring, &iov, 1) == 0);
+		pw->uring_registered = true;
+	}
+	// the unaligned tail is written through the page cache
+	if (pw->direct && !PW_ALIGNED(pw, buf, len)) pw_direct_off(pw, rb);
+	while(pw->cnt >= PIPE_WRITER_URING_DEPTH) {
+		pw_uring_reap(pw, true);
+		pw_release(pw, rb);
+	}
+	if (pw->uring_error || (sqe = io_uring_get_sqe(&pw->uring)) == NULL) {
+		errno = (pw->uring_error) ? pw->uring_error : EBUSY;
+		return -1;
+	}
+	i = (pw->first + pw->cnt) % PIPE_WRITER_PENDING;
+	if (pw->uring_fixed)
+		io_uring_prep_write_fixed(sqe, pw->fd, buf, len, pw->offset, 0);
+	else
+		io_uring_prep_write(sqe, pw->fd, buf, len, pw->offset);
+	io_uring_sqe_set_data(sqe, (void*)(uintptr_t)i);
+	pw->done[i] = false;
+	pw->wbuf[i] = buf;
+	pw->wlen[i] = len;
+	pw->woff[i] = pw->offset;
+	pw->wtime[i] = pw_time_ns();
+	pw->offset += len;
+	// released when the write has completed
+	pw->release[i] = size;
+	pw->held += size;
+	pw->cnt++;
+	if (pw->cnt > pw->depth_max) pw->depth_max = pw->cnt;
+	if (io_uring_submit(&pw->uring) < 0) {
+		pw->done[i] = true;
+		pw->uring_error = EIO;
+		return -1;
+	}
+	return 0;
+}
+#endif
+
+// release the writes that are no longer needed, for pipes the ones the reader has consumed
+static void pw_release(pipe_writer_t *pw, ringbuffer_t *rb)
+{
+	uint64_t consumed = 0;
+	if (pw->cnt == 0) return;
+#if LIBURING_ENABLED == 1
+	if (pw->mode == PIPE_WRITER_URING) {
+		pw_uring_reap(pw, false);
+		while(pw->cnt > 0 && pw->done[pw->first]) pw_pop(pw, rb);
+		return;
+	}
+#endif
+#if defined(__linux__)
+	int queued;
+	if (ioctl(pw->fd, FIONREAD, &queued) == 0) consumed = pw->written - queued;
+	// the pipe never holds more than its size
+	else if (pw->written > pw->pipe_size) consumed = pw->written - pw->pipe_size;
+#endif
+	while(pw->cnt > 0 && pw->end[pw->first] <= consumed) pw_pop(pw, rb);
+}
+
+void* pw_read_ptr(pipe_writer_t *pw, ringbuffer_t *rb, size_t size)
+{
+	uint8_t *buf;
+	pw_release(pw, rb);
+	buf = rb_read_ptr(rb, pw->held + size);
+	return (buf) ? buf + pw->held : NULL;
+}
+
+size_t pw_available(pipe_writer_t *pw, ringbuffer_t *rb)
+{
+	pw_release(pw, rb);
+	return rb->tail - rb->head - pw->held;
+}
+
+#if defined(__linux__)
+static int pw_write_fd(pipe_writer_t *pw, const uint8_t *buf, size_t len)
+{
+	ssize_t n;
+	while(len > 0) {
+		n = write(pw->fd, buf, len);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int pw_vmsplice(pipe_writer_t *pw, const uint8_t *buf, size_t len)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	// whole pages are gifted, they are not modified until the reader consumed them
+	unsigned int flags = (((uintptr_t)buf | len) % page == 0) ? SPLICE_F_GIFT : 0;
+	struct iovec iov = { .iov_base = (void*)buf, .iov_len = len };
+	ssize_t n;
+	while(iov.iov_len > 0) {
+		n = vmsplice(pw->fd, &iov, 1, flags);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			if (errno == EINVAL || errno == ENOSYS) {
+				pw->mode = PIPE_WRITER_WRITE;
+				return pw_write_fd(pw, iov.iov_base, iov.iov_len);
+			}
+			return -1;
+		}
+		iov.iov_base = (uint8_t*)iov.iov_base + n;
+		iov.iov_len -= n;
+	}
+	return 0;
+}
+
+// copy from the memfd of the ringbuffer without mapping the data into user space
+static int pw_copy(pipe_writer_t *pw, ringbuffer_t *rb, const uint8_t *buf, size_t len)
+{
+	loff_t off = (buf - rb->buffer) % rb->buffer_size;
+	ssize_t n;
+	while(len > 0) {
+		// the memfd is only mapped twice in memory, the copy has to wrap at its end
+		size_t part = rb->buffer_size - off;
+		if (part > len) part = len;
+		if (pw->mode == PIPE_WRITER_COPY)
+			n = copy_file_range(rb->fd, &off, pw->fd, NULL, part, 0);
+		else
+			n = sendfile(pw->fd, rb->fd, &off, part);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) {
+			// copy_file_range() between file systems needs a recent kernel
+			if (pw->mode == PIPE_WRITER_COPY && (n == 0 || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP || errno == ENOSYS)) {
+				pw->mode = PIPE_WRITER_SENDFILE;
+				continue;
+			}
+			if (n == 0 || errno == EINVAL || errno == ENOSYS) {
+				pw->mode = PIPE_WRITER_WRITE;
+				return pw_write_fd(pw, buf, len);
+			}
+			return -1;
+		}
+		buf += n;
+		len -= n;
+		if (off >= (loff_t)rb->buffer_size) off -= rb->buffer_size;
+	}
+	return 0;
+}
+#endif
+
+#if defined(__linux__)
+int pw_use_vmsplice(pipe_writer_t *pw)
+{
+	if (pw->mode != PIPE_WRITER_WRITE) return -1;
+	pw->mode = PIPE_WRITER_VMSPLICE;
+	return 0;
+}
+
+int pw_use_direct(pipe_writer_t *pw, uint64_t size)
+{
+	int flags;
+	if (pw->mode != PIPE_WRITER_COPY && pw->mode != PIPE_WRITER_SENDFILE) return -1;
+	// the extents are reserved without changing the size, the rest is freed by pw_close()
+	if (size > 0 && fallocate(pw->fd, FALLOC_FL_KEEP_SIZE, pw->offset, size) == 0) pw->prealloc = true;
+	flags = fcntl(pw->fd, F_GETFL);
+	if (flags < 0 || fcntl(pw->fd, F_SETFL, flags | O_DIRECT) != 0) return -1;
+	pw->direct = true;
+	pw->mode = PIPE_WRITER_DIRECT;
+	return 0;
+}
+
+// continue without O_DIRECT, the writes in flight have to complete first
+static void pw_direct_off(pipe_writer_t *pw, ringbuffer_t *rb)
+{
+#if LIBURING_ENABLED == 1
+	if (pw->mode == PIPE_WRITER_URING) {
+		while(pw->cnt > 0) {
+			pw_uring_reap(pw, !pw->done[pw->first]);
+			pw_release(pw, rb);
+		}
+	}
+#else
+	(void)rb;
+#endif
+	fcntl(pw->fd, F_SETFL, fcntl(pw->fd, F_GETFL) & ~O_DIRECT);
+	pw->direct = false;
+	if (pw->mode == PIPE_WRITER_DIRECT) pw->mode = PIPE_WRITER_COPY;
+}
+#else
+int pw_use_vmsplice(pipe_writer_t *pw)
+{
+	(void)pw;
+	return -1;
+}
+
+int pw_use_direct(pipe_writer_t *pw, uint64_t size)
+{
+	(void)pw;
+	(void)size;
+	return -1;
+}
+#endif
+
+// queue a release behind the data in the pipe
+static void pw_push(pipe_writer_t *pw, ringbuffer_t *rb, size_t size)
+{
+	while(pw->cnt == PIPE_WRITER_PENDING) {
+		pw_release(pw, rb);
+		if (pw->cnt == PIPE_WRITER_PENDING) thrd_sleep(&(struct timespec){.tv_nsec=1000000}, NULL);
+	}
+	pw->end[(pw->first + pw->cnt) % PIPE_WRITER_PENDING] = pw->written;
+	pw->release[(pw->first + pw->cnt) % PIPE_WRITER_PENDING] = size;
+	pw->held += size;
+	pw->cnt++;
+}
+
+int pw_write(pipe_writer_t *pw, ringbuffer_t *rb, const void *buf, size_t len, size_t size)
+{
+	switch(pw->mode) {
+#if defined(__linux__)
+	case PIPE_WRITER_VMSPLICE:
+		if (pw_vmsplice(pw, buf, len) != 0) return -1;
+		pw->written += len;
+		pw_push(pw, rb, size);
+		return 0;
+	case PIPE_WRITER_WRITE:
+		if (pw_write_fd(pw, buf, len) != 0) return -1;
+		pw->written += len;
+		pw->offset += len;
+		break;
+	case PIPE_WRITER_DIRECT:
+		if (PW_ALIGNED(pw, buf, len)) {
+			if (pw_write_fd(pw, buf, len) != 0) return -1;
+			pw->offset += len;
+			break;
+		}
+		// the unaligned tail is written through the page cache
+		pw_direct_off(pw, rb);
+		/* fall through */
+	case PIPE_WRITER_COPY:
+	case PIPE_WRITER_SENDFILE:
+		if (pw_copy(pw, rb, buf, len) != 0) return -1;
+		pw->offset += len;
+		break;
+#endif
+#if LIBURING_ENABLED == 1
+	case PIPE_WRITER_URING:
+		return pw_uring_write(pw, rb, buf, len, size);
+#endif
+	default:
+		if (fwrite(buf, 1, len, pw->f) != len) return -1;
+		break;
+	}
+	// copied data can be released right away, but not before the data still in the pipe
+	if (pw->cnt > 0) {
+		pw_push(pw, rb, size);
+		pw_release(pw, rb);
+	}
+	else rb_read_finished(rb, size);
+	return 0;
+}
+
+int pw_close(pipe_writer_t *pw, ringbuffer_t *rb)
+{
+	int ret = 0;
+#if LIBURING_ENABLED == 1
+	if (pw->mode == PIPE_WRITER_URING) {
+		while(pw->cnt > 0) {
+			pw_uring_reap(pw, !pw->done[pw->first]);
+			pw_release(pw, rb);
+		}
+		if (pw->uring_error) {
+			errno = pw->uring_error;
+			ret = -1;
+		}
+		// following writes with stdio continue at the end
+		lseek(pw->fd, pw->offset, SEEK_SET);
+		io_uring_queue_exit(&pw->uring);
+		pw->mode = PIPE_WRITER_COPY;
+	}
+#endif
+#if defined(__linux__)
+	// following writes with stdio are not aligned
+	if (pw->direct) pw_direct_off(pw, rb);
+	if (pw->prealloc) {
+		// free the preallocated extents behind the end
+		if (ftruncate(pw->fd, pw->offset) != 0) ret = -1;
+		pw->prealloc = false;
+	}
+#endif
+	// data in a pipe stays valid, as the ringbuffer is not written anymore
+	while(pw->cnt > 0) pw_pop(pw, rb);
+	return ret;
+}
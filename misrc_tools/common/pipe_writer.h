@@ -0,0 +1,116 @@
+/*
+* MISRC tools
+* Copyright (C) 2025  vrunk11, stefan_o
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PIPE_WRITER_H
+#define PIPE_WRITER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "ringbuffer.h"
+#if LIBURING_ENABLED == 1
+#include <liburing.h>
+#endif
+
+/* Writes the data of a ringbuffer to a file. On Linux pipes are enlarged and
+ * if selected written with vmsplice(), the pipe then references the pages of
+ * the ringbuffer instead of copying them. These pages are only released in the
+ * ringbuffer once the reader of the pipe has consumed them, until then the
+ * writer continues behind them. Consumed is judged by the bytes left in the
+ * pipe (FIONREAD): a reader that moves the data on with splice() or tee()
+ * instead of read() can still reference the pages after they were released
+ * and would see them overwritten, so vmsplice() is not used by default.
+ * Regular files are filled by the kernel from
+ * the memfd of the ringbuffer with copy_file_range() or sendfile(), or if
+ * selected with several asynchronous writes in flight using io_uring and
+ * with direct I/O (O_DIRECT) as long as the writes are aligned.
+ * Everything else is written with fwrite(). */
+
+#define PIPE_WRITER_SIZE    (1<<20)  // requested pipe size
+#define PIPE_WRITER_PENDING 64       // writes that can be in the pipe at the same time
+
+#define PIPE_WRITER_STDIO    0
+#define PIPE_WRITER_VMSPLICE 1
+#define PIPE_WRITER_WRITE    2       // pipe, copied with write()
+#define PIPE_WRITER_COPY     3       // regular file, copy_file_range() from the memfd
+#define PIPE_WRITER_SENDFILE 4       // regular file, copy_file_range() is not supported
+#define PIPE_WRITER_URING    5       // regular file, io_uring writes from the ringbuffer
+#define PIPE_WRITER_DIRECT   6       // regular file, O_DIRECT writes from the ringbuffer
+
+#define PIPE_WRITER_ALIGN    4096    // alignment of direct I/O
+
+#define PIPE_WRITER_URING_DEPTH 8    // io_uring writes in flight
+
+typedef struct {
+	FILE *f;
+	int fd;
+	int mode;
+	size_t pipe_size;
+	uint64_t written;                      // bytes written to the pipe
+	uint64_t end[PIPE_WRITER_PENDING];     // position in the stream after each pending write
+	size_t release[PIPE_WRITER_PENDING];   // bytes of the ringbuffer to release after it
+	size_t first;
+	size_t cnt;
+	size_t held;                           // sum of the pending releases
+	uint64_t offset;                       // regular files: file offset of the next write
+	bool direct;                           // O_DIRECT is set
+	bool prealloc;                         // extents behind the end are freed on close
+#if LIBURING_ENABLED == 1
+	struct io_uring uring;
+	bool uring_fixed;                      // the ringbuffer is registered
+	bool uring_registered;
+	int uring_error;
+	bool done[PIPE_WRITER_PENDING];
+	const uint8_t *wbuf[PIPE_WRITER_PENDING];
+	size_t wlen[PIPE_WRITER_PENDING];
+	uint64_t woff[PIPE_WRITER_PENDING];
+	uint64_t wtime[PIPE_WRITER_PENDING];
+	// statistics
+	unsigned int depth_max;
+	uint64_t lat_sum;                      // ns
+	uint64_t lat_max;
+	uint64_t lat_cnt;
+#endif
+} pipe_writer_t;
+
+/* prepare writing to f, splice = false always copies in user space (for data that is not in the ringbuffer) */
+void pw_init(pipe_writer_t *pw, FILE *f, bool splice);
+/* like rb_read_ptr(), but behind the data that is still referenced by the pipe */
+void* pw_read_ptr(pipe_writer_t *pw, ringbuffer_t *rb, size_t size);
+/* bytes of the ringbuffer that are readable with pw_read_ptr() */
+size_t pw_available(pipe_writer_t *pw, ringbuffer_t *rb);
+/* write len bytes of buf and release size bytes of rb once they are no longer needed,
+ * unless splice was false buf has to be the pointer returned by pw_read_ptr(), returns 0 on success */
+int pw_write(pipe_writer_t *pw, ringbuffer_t *rb, const void *buf, size_t len, size_t size);
+/* wait for writes in flight and release everything, returns 0 if all writes succeeded */
+int pw_close(pipe_writer_t *pw, ringbuffer_t *rb);
+/* write a pipe with vmsplice() instead of copying, only safe if the reader of the pipe copies
+ * the data with read(), splice was true for pw_init(), returns 0 if it is used */
+int pw_use_vmsplice(pipe_writer_t *pw);
+/* write a regular file with O_DIRECT while the writes are aligned to PIPE_WRITER_ALIGN,
+ * the rest is written through the page cache. size > 0 preallocates the file,
+ * returns 0 if direct I/O is used */
+int pw_use_direct(pipe_writer_t *pw, uint64_t size);
+#if LIBURING_ENABLED == 1
+/* write a regular file with io_uring instead of copying, can be combined with direct I/O,
+ * returns 0 if it is used */
+int pw_use_uring(pipe_writer_t *pw);
+#endif
+
+#endif // PIPE_WRITER_H
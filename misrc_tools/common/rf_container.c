@@ -0,0 +1,635 @@
+/*
+* MISRC tools
+* Copyright (C) 2025  vrunk11, stefan_o
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+#define _FILE_OFFSET_BITS 64
+
+#include <stdlib.h>
+#include <string.h>
+#include "rf_container.h"
+#include "rf_rice.h"
+
+#if LIBZSTD_ENABLED == 1
+#include <zstd.h>
+#endif
+#if LIBLZ4_ENABLED == 1
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+
+#ifdef _WIN32
+	#define fseeko _fseeki64
+	#define ftello _ftelli64
+#endif
+
+#define WORKER_WAIT (struct timespec){.tv_nsec=100000}
+
+static const uint8_t file_magic[8] = { 'M', 'I', 'S', 'R', 'C', '-', 'R', 'F' };
+static const uint8_t chunk_magic[4] = { 'M', 'R', 'C', 'K' };
+static const uint8_t index_magic[4] = { 'M', 'R', 'C', 'I' };
+
+const char *rfc_codec_name(int codec)
+{
+	switch (codec) {
+	case RFC_CODEC_STORE:
+		return "store";
+	case RFC_CODEC_RICE:
+		return "rice";
+#if LIBZSTD_ENABLED == 1
+	case RFC_CODEC_ZSTD:
+		return "zstd";
+#endif
+#if LIBLZ4_ENABLED == 1
+	case RFC_CODEC_LZ4:
+		return "lz4";
+#endif
+	default:
+		return NULL;
+	}
+}
+
+const char *rfc_strerror(int err)
+{
+	switch (err) {
+	case 0:
+		return "no error";
+	case RFC_ERR_IO:
+		return "read error";
+	case RFC_ERR_FORMAT:
+		return "invalid header or index";
+	case RFC_ERR_CODEC:
+		return "decompression failed or codec not supported";
+	case RFC_ERR_CRC:
+		return "CRC mismatch";
+	case RFC_ERR_MEMORY:
+		return "out of memory";
+	case RFC_ERR_TRUNCATED:
+		return "the last chunk is cut off";
+	default:
+		return "unknown error";
+	}
+}
+
+/* CRC-32 (IEEE 802.3), slicing by 8 */
+static uint32_t crc_table[8][256];
+static atomic_bool crc_init;
+
+// called before any threads are started by rfc_encoder_init() and rfc_stream_read()
+static void crc32_init(void)
+{
+	uint32_t c;
+	if (atomic_load(&crc_init)) return;
+	for(uint32_t i = 0; i < 256; i++) {
+		c = i;
+		for(int j = 0; j < 8; j++) c = (c & 1) ? (c >> 1) ^ 0xEDB88320 : c >> 1;
+		crc_table[0][i] = c;
+	}
+	for(uint32_t i = 0; i < 256; i++) {
+		for(int j = 1; j < 8; j++) crc_table[j][i] = (crc_table[j-1][i] >> 8) ^ crc_table[0][crc_table[j-1][i] & 0xFF];
+	}
+	atomic_store(&crc_init, true);
+}
+
+uint32_t rfc_crc32(uint32_t crc, const uint8_t *data, size_t len)
+{
+	uint32_t a, b;
+	crc32_init();
+	crc = ~crc;
+	while (len >= 8) {
+		a = crc ^ ((uint32_t)data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24);
+		b = (uint32_t)data[4] | (uint32_t)data[5] << 8 | (uint32_t)data[6] << 16 | (uint32_t)data[7] << 24;
+		crc = crc_table[7][a & 0xFF] ^ crc_table[6][(a >> 8) & 0xFF] ^ crc_table[5][(a >> 16) & 0xFF] ^ crc_table[4][a >> 24]
+			^ crc_table[3][b & 0xFF] ^ crc_table[2][(b >> 8) & 0xFF] ^ crc_table[1][(b >> 16) & 0xFF] ^ crc_table[0][b >> 24];
+		data += 8;
+		len -= 8;
+	}
+	while (len--) crc = (crc >> 8) ^ crc_table[0][(crc ^ *data++) & 0xFF];
+	return ~crc;
+}
+
+static void put_le(uint8_t *b, uint64_t v, int bytes)
+{
+	for(int i = 0; i < bytes; i++) b[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint64_t get_le(const uint8_t *b, int bytes)
+{
+	uint64_t v = 0;
+	for(int i = bytes - 1; i >= 0; i--) v = (v << 8) | b[i];
+	return v;
+}
+
+/* filter: zigzag coded differences, low bytes first, then high bytes */
+static void delta_planes(const int16_t *smp, size_t n, uint8_t *planes)
+{
+	const uint16_t *s = (const uint16_t*)smp;
+	uint8_t *lo = planes, *hi = planes + n;
+	uint16_t d, z;
+	if (n == 0) return;
+	z = (uint16_t)((s[0] << 1) ^ (0 - (s[0] >> 15)));
+	lo[0] = (uint8_t)z;
+	hi[0] = (uint8_t)(z >> 8);
+	for(size_t i = 1; i < n; i++) {
+		d = s[i] - s[i-1];
+		z = (uint16_t)((d << 1) ^ (0 - (d >> 15)));
+		lo[i] = (uint8_t)z;
+		hi[i] = (uint8_t)(z >> 8);
+	}
+}
+
+static void delta_planes_undo(const uint8_t *planes, size_t n, int16_t *smp)
+{
+	const uint8_t *lo = planes, *hi = planes + n;
+	uint16_t *s = (uint16_t*)smp, prev = 0, z;
+	for(size_t i = 0; i < n; i++) {
+		z = lo[i] | (uint16_t)hi[i] << 8;
+		prev += (uint16_t)((z >> 1) ^ (0 - (z & 1)));
+		s[i] = prev;
+	}
+}
+
+// returns the compressed length, 0 if it failed or does not fit
+static size_t compress_planes(rfc_worker_t *w, const uint8_t *src, size_t len, uint8_t *dst, size_t cap)
+{
+	switch (w->enc->codec) {
+#if LIBZSTD_ENABLED == 1
+	case RFC_CODEC_ZSTD: {
+		size_t r = ZSTD_compressCCtx(w->cctx, dst, cap, src, len, w->enc->level);
+		return ZSTD_isError(r) ? 0 : r;
+	}
+#endif
+#if LIBLZ4_ENABLED == 1
+	case RFC_CODEC_LZ4: {
+		int r;
+		// levels up to 1 are the fast compressor with acceleration 2-level, above the HC compressor
+		if (w->enc->level <= 1) r = LZ4_compress_fast_extState(w->cctx, (const char*)src, (char*)dst, (int)len, (int)cap, 2 - w->enc->level);
+		else r = LZ4_compress_HC_extStateHC(w->cctx, (const char*)src, (char*)dst, (int)len, (int)cap, w->enc->level);
+		return (r > 0) ? (size_t)r : 0;
+	}
+#endif
+	default:
+		(void)src; (void)len; (void)dst; (void)cap;
+		return 0;
+	}
+}
+
+static void chunk_header(uint8_t *out, int codec, int filter, size_t len, uint32_t samples, uint64_t first_sample, uint32_t crc)
+{
+	memcpy(out, chunk_magic, 4);
+	out[4] = (uint8_t)codec;
+	out[5] = (uint8_t)filter;
+	put_le(&out[6], 0, 2);
+	put_le(&out[8], len, 4);
+	put_le(&out[12], samples, 4);
+	put_le(&out[16], first_sample, 8);
+	put_le(&out[24], crc, 4);
+	put_le(&out[28], rfc_crc32(0, out, 28), 4);
+}
+
+// the samples are stored as they are if compression does not help
+static size_t encode_chunk(rfc_worker_t *w, const int16_t *smp, uint32_t n, uint64_t first_sample, uint8_t *out)
+{
+	uint8_t *payload = &out[RFC_CHUNK_HEADER_SIZE];
+	int codec = w->enc->codec, filter = RFC_FILTER_NONE;
+	uint32_t crc = rfc_crc32(0, (const uint8_t*)smp, (size_t)n * 2);
+	size_t len = 0;
+	if (codec == RFC_CODEC_RICE) {
+		len = rf_rice_encode(smp, n, payload, RFC_CHUNK_MAX - RFC_CHUNK_HEADER_SIZE);
+		if (len == 0 || len >= (size_t)n * 2) codec = RFC_CODEC_STORE;
+	}
+	else if (codec != RFC_CODEC_STORE) {
+		delta_planes(smp, n, w->planes);
+		len = compress_planes(w, w->planes, (size_t)n * 2, payload, RFC_CHUNK_MAX - RFC_CHUNK_HEADER_SIZE);
+		filter = RFC_FILTER_DELTA;
+		if (len == 0 || len >= (size_t)n * 2) codec = RFC_CODEC_STORE;
+	}
+	if (codec == RFC_CODEC_STORE) {
+		memcpy(payload, smp, (size_t)n * 2);
+		len = (size_t)n * 2;
+		filter = RFC_FILTER_NONE;
+	}
+	chunk_header(out, codec, filter, len, n, first_sample, crc);
+	return RFC_CHUNK_HEADER_SIZE + len;
+}
+
+static void encode_chunks(rfc_worker_t *w)
+{
+	rfc_encoder_t *enc = w->enc;
+	size_t i, start;
+	while ((i = atomic_fetch_add(&enc->next, 1)) < enc->chunks) {
+		start = i * RFC_CHUNK_SAMPLES;
+		enc->len[i] = encode_chunk(w, &enc->samples[start], (enc->n - start < RFC_CHUNK_SAMPLES) ? enc->n - start : RFC_CHUNK_SAMPLES,
+			enc->first_sample + start, &enc->out[i * RFC_CHUNK_MAX]);
+		atomic_fetch_add(&enc->done, 1);
+	}
+}
+
+static int worker_thread(void *ctx)
+{
+	rfc_worker_t *w = ctx;
+	rfc_encoder_t *enc = w->enc;
+	unsigned int job = 0;
+	while (!atomic_load(&enc->exit)) {
+		if (atomic_load(&enc->job) == job) {
+			thrd_sleep(&WORKER_WAIT, NULL);
+			continue;
+		}
+		job++;
+		encode_chunks(w);
+		// the job is only finished when every worker has left it, so the next one can be set up
+		atomic_fetch_add(&enc->finished, 1);
+	}
+	return 0;
+}
+
+static int worker_init(rfc_worker_t *w, rfc_encoder_t *enc)
+{
+	w->enc = enc;
+	if (enc->codec == RFC_CODEC_STORE || enc->codec == RFC_CODEC_RICE) return 0;
+	if ((w->planes = malloc(RFC_CHUNK_SAMPLES * 2)) == NULL) return -1;
+	switch (enc->codec) {
+#if LIBZSTD_ENABLED == 1
+	case RFC_CODEC_ZSTD:
+		w->cctx = ZSTD_createCCtx();
+		break;
+#endif
+#if LIBLZ4_ENABLED == 1
+	case RFC_CODEC_LZ4:
+		w->cctx = malloc((enc->level <= 1) ? LZ4_sizeofState() : LZ4_sizeofStateHC());
+		break;
+#endif
+	default:
+		break;
+	}
+	return (w->cctx) ? 0 : -1;
+}
+
+static void worker_free(rfc_worker_t *w)
+{
+	free(w->planes);
+	w->planes = NULL;
+	if (!w->cctx) return;
+#if LIBZSTD_ENABLED == 1
+	if (w->enc->codec == RFC_CODEC_ZSTD) ZSTD_freeCCtx(w->cctx);
+	else
+#endif
+	free(w->cctx);
+	w->cctx = NULL;
+}
+
+int rfc_encoder_init(rfc_encoder_t *enc, int codec, int level, uint32_t threads)
+{
+	memset(enc, 0, sizeof(rfc_encoder_t));
+	if (!rfc_codec_name(codec)) return -1;
+	crc32_init();
+	enc->codec = codec;
+	enc->level = level;
+#if LIBLZ4_ENABLED == 1
+	if (codec == RFC_CODEC_LZ4 && level > LZ4HC_CLEVEL_MAX) enc->level = LZ4HC_CLEVEL_MAX;
+#endif
+	if (threads < 1) threads = 1;
+	if (threads > RFC_MAX_THREADS) threads = RFC_MAX_THREADS;
+	atomic_init(&enc->job, 0);
+	atomic_init(&enc->next, 0);
+	atomic_init(&enc->done, 0);
+	atomic_init(&enc->finished, 0);
+	atomic_init(&enc->exit, false);
+	// the caller uses the last worker
+	if (worker_init(&enc->worker[threads - 1], enc) != 0) {
+		worker_free(&enc->worker[threads - 1]);
+		return -1;
+	}
+	for(enc->threads = 1; enc->threads < threads; enc->threads++) {
+		rfc_worker_t *w = &enc->worker[enc->threads - 1];
+		if (worker_init(w, enc) != 0 || thrd_create(&enc->thread[enc->threads - 1], (thrd_start_t)worker_thread, w) != thrd_success) {
+			worker_free(w);
+			worker_free(&enc->worker[threads - 1]);
+			rfc_encoder_free(enc);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+size_t rfc_encode(rfc_encoder_t *enc, const int16_t *samples, size_t n, uint64_t first_sample, uint8_t *out, size_t *len)
+{
+	if (n == 0) return 0;
+	enc->samples = samples;
+	enc->n = n;
+	enc->first_sample = first_sample;
+	enc->out = out;
+	enc->len = len;
+	enc->chunks = (n + RFC_CHUNK_SAMPLES - 1) / RFC_CHUNK_SAMPLES;
+	atomic_store(&enc->done, 0);
+	atomic_store(&enc->finished, 0);
+	atomic_store(&enc->next, 0);
+	atomic_fetch_add(&enc->job, 1);
+	encode_chunks(&enc->worker[enc->threads - 1]);
+	while (atomic_load(&enc->done) < enc->chunks || atomic_load(&enc->finished) < enc->threads - 1) thrd_sleep(&WORKER_WAIT, NULL);
+	return enc->chunks;
+}
+
+void rfc_encoder_free(rfc_encoder_t *enc)
+{
+	atomic_store(&enc->exit, true);
+	for(uint32_t i = 0; i + 1 < enc->threads; i++) {
+		thrd_join(enc->thread[i], NULL);
+		worker_free(&enc->worker[i]);
+	}
+	if (enc->threads > 0) worker_free(&enc->worker[enc->threads - 1]);
+	enc->threads = 0;
+}
+
+void rfc_stream_init(rfc_stream_t *s, int codec, uint32_t bits, uint32_t flags, uint32_t sample_rate)
+{
+	memset(s, 0, sizeof(rfc_stream_t));
+	s->codec = codec;
+	s->bits = bits;
+	s->flags = flags;
+	s->sample_rate = sample_rate;
+	s->offset = RFC_HEADER_SIZE;
+}
+
+static int index_append(rfc_stream_t *s, const rfc_chunk_t *c)
+{
+	if (s->chunks == s->index_size) {
+		size_t size = (s->index_size) ? s->index_size * 2 : 1024;
+		rfc_chunk_t *index = realloc(s->index, size * sizeof(rfc_chunk_t));
+		if (!index) return RFC_ERR_MEMORY;
+		s->index = index;
+		s->index_size = size;
+	}
+	s->index[s->chunks++] = *c;
+	return 0;
+}
+
+int rfc_stream_add(rfc_stream_t *s, const uint8_t *chunk, size_t len)
+{
+	rfc_chunk_t c = { s->offset, get_le(&chunk[16], 8), (uint32_t)get_le(&chunk[8], 4), (uint32_t)get_le(&chunk[12], 4) };
+	int r = index_append(s, &c);
+	if (r != 0) return r;
+	s->offset += len;
+	s->samples += c.samples;
+	return 0;
+}
+
+void rfc_write_header(const rfc_stream_t *s, bool index, uint8_t *out)
+{
+	memset(out, 0, RFC_HEADER_SIZE);
+	memcpy(out, file_magic, 8);
+	put_le(&out[8], RFC_VERSION, 2);
+	out[10] = (uint8_t)s->codec;
+	put_le(&out[12], s->bits, 2);
+	put_le(&out[14], s->flags, 2);
+	put_le(&out[16], s->sample_rate, 4);
+	put_le(&out[20], RFC_CHUNK_SAMPLES, 4);
+	if (index) {
+		put_le(&out[24], s->samples, 8);
+		put_le(&out[32], s->chunks, 8);
+		put_le(&out[40], s->offset, 8);
+	}
+	put_le(&out[60], rfc_crc32(0, out, 60), 4);
+}
+
+size_t rfc_index_size(const rfc_stream_t *s)
+{
+	return 12 + s->chunks * RFC_INDEX_ENTRY_SIZE + 4;
+}
+
+void rfc_write_index(const rfc_stream_t *s, uint8_t *out)
+{
+	uint8_t *p = &out[12];
+	memcpy(out, index_magic, 4);
+	put_le(&out[4], s->chunks, 8);
+	for(size_t i = 0; i < s->chunks; i++, p += RFC_INDEX_ENTRY_SIZE) {
+		put_le(p, s->index[i].offset, 8);
+		put_le(&p[8], s->index[i].first_sample, 8);
+		put_le(&p[16], s->index[i].size, 4);
+		put_le(&p[20], s->index[i].samples, 4);
+	}
+	put_le(p, rfc_crc32(0, out, p - out), 4);
+}
+
+void rfc_stream_free(rfc_stream_t *s)
+{
+	free(s->index);
+	s->index = NULL;
+	s->chunks = 0;
+	s->index_size = 0;
+}
+
+static int read_at(FILE *f, uint64_t offset, uint8_t *buf, size_t len)
+{
+	if (fseeko(f, offset, SEEK_SET) != 0 || fread(buf, 1, len, f) != len) return RFC_ERR_IO;
+	return 0;
+}
+
+static int chunk_header_read(const uint8_t *hdr, rfc_chunk_t *c, uint64_t offset)
+{
+	if (memcmp(hdr, chunk_magic, 4) != 0 || get_le(&hdr[28], 4) != rfc_crc32(0, hdr, 28)) return RFC_ERR_FORMAT;
+	c->offset = offset;
+	c->size = (uint32_t)get_le(&hdr[8], 4);
+	c->samples = (uint32_t)get_le(&hdr[12], 4);
+	c->first_sample = get_le(&hdr[16], 8);
+	if (c->samples > RFC_CHUNK_SAMPLES || c->size > RFC_CHUNK_MAX - RFC_CHUNK_HEADER_SIZE) return RFC_ERR_FORMAT;
+	return 0;
+}
+
+static int index_read(rfc_stream_t *s, FILE *f, uint64_t offset, uint64_t chunks)
+{
+	uint8_t hdr[12], *buf;
+	size_t len;
+	int r = RFC_ERR_FORMAT;
+	if (read_at(f, offset, hdr, sizeof(hdr)) != 0) return RFC_ERR_IO;
+	if (memcmp(hdr, index_magic, 4) != 0 || get_le(&hdr[4], 8) != chunks || chunks > SIZE_MAX / RFC_INDEX_ENTRY_SIZE / 2) return RFC_ERR_FORMAT;
+	len = 12 + chunks * RFC_INDEX_ENTRY_SIZE + 4;
+	if ((buf = malloc(len)) == NULL) return RFC_ERR_MEMORY;
+	if (read_at(f, offset, buf, len) != 0) {
+		r = RFC_ERR_IO;
+		goto end;
+	}
+	if (get_le(&buf[len - 4], 4) != rfc_crc32(0, buf, len - 4)) goto end;
+	for(size_t i = 0; i < chunks; i++) {
+		const uint8_t *p = &buf[12 + i * RFC_INDEX_ENTRY_SIZE];
+		rfc_chunk_t c = { get_le(p, 8), get_le(&p[8], 8), (uint32_t)get_le(&p[16], 4), (uint32_t)get_le(&p[20], 4) };
+		if ((r = index_append(s, &c)) != 0) goto end;
+	}
+	r = 0;
+end:
+	free(buf);
+	return r;
+}
+
+// the index of a file written to a pipe follows the last chunk and ends the file
+static bool index_at_end(const rfc_stream_t *s, FILE *f, const uint8_t *hdr, uint64_t offset, uint64_t size)
+{
+	rfc_stream_t idx;
+	uint64_t chunks = get_le(&hdr[4], 8);
+	bool ok;
+	if (memcmp(hdr, index_magic, 4) != 0 || chunks != s->chunks || 12 + chunks * RFC_INDEX_ENTRY_SIZE + 4 != size - offset) return false;
+	memset(&idx, 0, sizeof(idx));
+	ok = (index_read(&idx, f, offset, chunks) == 0);
+	for(size_t i = 0; ok && i < s->chunks; i++) {
+		ok = idx.index[i].offset == s->index[i].offset && idx.index[i].first_sample == s->index[i].first_sample
+			&& idx.index[i].size == s->index[i].size && idx.index[i].samples == s->index[i].samples;
+	}
+	rfc_stream_free(&idx);
+	return ok;
+}
+
+// follow the chunk headers, anything but a chunk or the index behind them is an error
+static int index_rebuild(rfc_stream_t *s, FILE *f)
+{
+	uint8_t hdr[RFC_CHUNK_HEADER_SIZE];
+	uint64_t offset = RFC_HEADER_SIZE, size;
+	size_t len;
+	rfc_chunk_t c;
+	int r;
+	if (fseeko(f, 0, SEEK_END) != 0) return RFC_ERR_IO;
+	size = ftello(f);
+	s->samples = 0;
+	while (offset < size) {
+		len = (size - offset < RFC_CHUNK_HEADER_SIZE) ? size - offset : RFC_CHUNK_HEADER_SIZE;
+		if (read_at(f, offset, hdr, len) != 0) return RFC_ERR_IO;
+		if (len == RFC_CHUNK_HEADER_SIZE && chunk_header_read(hdr, &c, offset) == 0) {
+			// a file that was not closed can end in a chunk
+			if (offset + RFC_CHUNK_HEADER_SIZE + c.size > size) return RFC_ERR_TRUNCATED;
+			if ((r = index_append(s, &c)) != 0) return r;
+			s->samples += c.samples;
+			offset += RFC_CHUNK_HEADER_SIZE + c.size;
+			continue;
+		}
+		if (len < RFC_CHUNK_HEADER_SIZE && memcmp(hdr, chunk_magic, (len < 4) ? len : 4) == 0) return RFC_ERR_TRUNCATED;
+		if (len >= 12 && index_at_end(s, f, hdr, offset, size)) return 0;
+		return RFC_ERR_FORMAT;
+	}
+	return 0;
+}
+
+int rfc_stream_read(rfc_stream_t *s, FILE *f)
+{
+	uint8_t hdr[RFC_HEADER_SIZE];
+	uint64_t index_offset, chunks;
+	int r;
+	memset(s, 0, sizeof(rfc_stream_t));
+	crc32_init();
+	if (read_at(f, 0, hdr, sizeof(hdr)) != 0) return RFC_ERR_IO;
+	if (memcmp(hdr, file_magic, 8) != 0 || get_le(&hdr[60], 4) != rfc_crc32(0, hdr, 60)) return RFC_ERR_FORMAT;
+	if (get_le(&hdr[8], 2) > RFC_VERSION || get_le(&hdr[20], 4) != RFC_CHUNK_SAMPLES) return RFC_ERR_FORMAT;
+	s->codec = hdr[10];
+	s->bits = (uint32_t)get_le(&hdr[12], 2);
+	s->flags = (uint32_t)get_le(&hdr[14], 2);
+	s->sample_rate = (uint32_t)get_le(&hdr[16], 4);
+	s->samples = get_le(&hdr[24], 8);
+	chunks = get_le(&hdr[32], 8);
+	index_offset = get_le(&hdr[40], 8);
+	if (index_offset == 0 || (r = index_read(s, f, index_offset, chunks)) != 0) {
+		rfc_stream_free(s);
+		r = index_rebuild(s, f);
+		if (r != 0 && r != RFC_ERR_TRUNCATED) rfc_stream_free(s);
+	}
+	s->offset = RFC_HEADER_SIZE;
+	if (s->chunks > 0) s->offset = s->index[s->chunks - 1].offset + RFC_CHUNK_HEADER_SIZE + s->index[s->chunks - 1].size;
+	return r;
+}
+
+size_t rfc_find_chunk(const rfc_stream_t *s, uint64_t sample)
+{
+	size_t lo = 0, hi = s->chunks, mid;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (s->index[mid].first_sample + s->index[mid].samples <= sample) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo;
+}
+
+int rfc_decoder_init(rfc_decoder_t *dec)
+{
+	memset(dec, 0, sizeof(rfc_decoder_t));
+	dec->payload = malloc(RFC_CHUNK_MAX);
+	dec->planes = malloc(RFC_CHUNK_SAMPLES * 2);
+#if LIBZSTD_ENABLED == 1
+	dec->dctx = ZSTD_createDCtx();
+	if (!dec->dctx) return RFC_ERR_MEMORY;
+#endif
+	return (dec->payload && dec->planes) ? 0 : RFC_ERR_MEMORY;
+}
+
+// the header of the chunk has been checked
+static int decode_payload(rfc_decoder_t *dec, const uint8_t *chunk, const rfc_chunk_t *c, int16_t *out)
+{
+	const uint8_t *payload = &chunk[RFC_CHUNK_HEADER_SIZE];
+	size_t len = (size_t)c->samples * 2;
+	int codec = chunk[4], filter = chunk[5];
+	if (filter == RFC_FILTER_NONE && codec == RFC_CODEC_STORE) {
+		if (c->size != len) return RFC_ERR_FORMAT;
+		memcpy(out, payload, len);
+	}
+	else if (filter == RFC_FILTER_NONE && codec == RFC_CODEC_RICE) {
+		if (rf_rice_decode(payload, c->size, out, c->samples) != 0) return RFC_ERR_CODEC;
+	}
+	else if (filter == RFC_FILTER_DELTA) {
+		switch (codec) {
+#if LIBZSTD_ENABLED == 1
+		case RFC_CODEC_ZSTD:
+			if (ZSTD_decompressDCtx(dec->dctx, dec->planes, len, payload, c->size) != len) return RFC_ERR_CODEC;
+			break;
+#endif
+#if LIBLZ4_ENABLED == 1
+		case RFC_CODEC_LZ4:
+			if (LZ4_decompress_safe((const char*)payload, (char*)dec->planes, (int)c->size, (int)len) != (int)len) return RFC_ERR_CODEC;
+			break;
+#endif
+		default:
+			return RFC_ERR_CODEC;
+		}
+		delta_planes_undo(dec->planes, c->samples, out);
+	}
+	else return RFC_ERR_FORMAT;
+	return (rfc_crc32(0, (const uint8_t*)out, len) == get_le(&chunk[24], 4)) ? 0 : RFC_ERR_CRC;
+}
+
+int rfc_decode_chunk(rfc_decoder_t *dec, const rfc_stream_t *s, FILE *f, size_t i, int16_t *out)
+{
+	const rfc_chunk_t *e = &s->index[i];
+	rfc_chunk_t c;
+	if (read_at(f, e->offset, dec->payload, RFC_CHUNK_HEADER_SIZE + (size_t)e->size) != 0) return RFC_ERR_IO;
+	// the chunk has to be the one of the index
+	if (chunk_header_read(dec->payload, &c, e->offset) != 0 || c.first_sample != e->first_sample || c.samples != e->samples || c.size != e->size) return RFC_ERR_FORMAT;
+	return decode_payload(dec, dec->payload, &c, out);
+}
+
+int rfc_decode(rfc_decoder_t *dec, const uint8_t *chunk, size_t len, int16_t *out)
+{
+	rfc_chunk_t c;
+	if (len < RFC_CHUNK_HEADER_SIZE || chunk_header_read(chunk, &c, 0) != 0 || RFC_CHUNK_HEADER_SIZE + (size_t)c.size != len) return RFC_ERR_FORMAT;
+	return decode_payload(dec, chunk, &c, out);
+}
+
+void rfc_decoder_free(rfc_decoder_t *dec)
+{
+#if LIBZSTD_ENABLED == 1
+	if (dec->dctx) ZSTD_freeDCtx(dec->dctx);
+#endif
+	free(dec->payload);
+	free(dec->planes);
+	memset(dec, 0, sizeof(rfc_decoder_t));
+}
@@ -0,0 +1,168 @@
+/*
+* MISRC tools
+* Copyright (C) 2025  vrunk11, stefan_o
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RF_CONTAINER_H
+#define RF_CONTAINER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#if __STDC_VERSION__ >= 201112L && ! __STDC_NO_THREADS__ && ! _WIN32
+#include <threads.h>
+#else
+#include "cthreads.h"
+#endif
+
+/* MISRC RF container: 16 bit mono RF in chunks of RFC_CHUNK_SAMPLES samples
+ * (the last one of a file may be shorter) that are compressed independently
+ * with zstd or lz4, or with the built-in Rice coder of rf_rice.h. Before zstd
+ * or lz4 compression the samples of a chunk are replaced by the zigzag coded
+ * difference to the previous sample and split into a plane of low and a plane
+ * of high bytes, for 12 bit RF the high plane is mostly zero. Every chunk has
+ * a header with its position in the stream and a CRC32 of its samples, an
+ * index of all chunks at the end of the file allows random access. A file
+ * without index (written to a pipe or not closed) can still be read by
+ * following the chunk headers, a chunk that is cut off at the end is left
+ * out and reported.
+ *
+ * file:  header (RFC_HEADER_SIZE), chunks, index
+ * chunk: header (RFC_CHUNK_HEADER_SIZE), payload
+ * index: "MRCI", count (u64), count * (offset u64, first sample u64, payload u32, samples u32), CRC32
+ * All numbers are little endian. */
+
+#define RFC_VERSION           1
+#define RFC_HEADER_SIZE       64
+#define RFC_CHUNK_HEADER_SIZE 32
+#define RFC_INDEX_ENTRY_SIZE  24
+#define RFC_CHUNK_SAMPLES     (1<<20)
+// compressed chunk in the worst case, plus its header
+#define RFC_CHUNK_MAX         (RFC_CHUNK_HEADER_SIZE + RFC_CHUNK_SAMPLES * 2 + RFC_CHUNK_SAMPLES / 64 + 4096)
+#define RFC_MAX_THREADS       64
+
+#define RFC_CODEC_STORE 0
+#define RFC_CODEC_ZSTD  1
+#define RFC_CODEC_LZ4   2
+#define RFC_CODEC_RICE  3  // always available, the level is not used
+#define RFC_CODEC_CNT   4
+
+#define RFC_FILTER_NONE   0
+#define RFC_FILTER_DELTA  1  // zigzag coded differences, split into byte planes
+
+#define RFC_FLAG_PADDED   1  // 12 bit samples in the upper bits
+
+#define RFC_ERR_IO       -1
+#define RFC_ERR_FORMAT   -2
+#define RFC_ERR_CODEC    -3
+#define RFC_ERR_CRC      -4
+#define RFC_ERR_MEMORY   -5
+#define RFC_ERR_TRUNCATED -6 // the file ends in a chunk, the chunks before it can be read
+
+typedef struct {
+	uint64_t offset;        // of the chunk header in the file
+	uint64_t first_sample;
+	uint32_t size;          // of the payload
+	uint32_t samples;
+} rfc_chunk_t;
+
+typedef struct {
+	uint32_t codec;         // used for the chunks, a chunk may be stored instead
+	uint32_t bits;          // 12 or 16
+	uint32_t flags;
+	uint32_t sample_rate;   // Hz
+	uint64_t samples;       // total, 0 until the file is finished
+	uint64_t offset;        // bytes of the file
+	rfc_chunk_t *index;
+	size_t chunks;
+	size_t index_size;
+} rfc_stream_t;
+
+struct rfc_encoder;
+
+typedef struct {
+	struct rfc_encoder *enc;
+	void *cctx;             // zstd or lz4 state
+	uint8_t *planes;        // filtered samples of a chunk
+} rfc_worker_t;
+
+typedef struct rfc_encoder {
+	int codec;
+	int level;
+	uint32_t threads;
+	thrd_t thread[RFC_MAX_THREADS];
+	rfc_worker_t worker[RFC_MAX_THREADS];
+	// current job, chunks are taken one by one by the workers and the caller
+	const int16_t *samples;
+	size_t n;
+	uint64_t first_sample;
+	uint8_t *out;           // RFC_CHUNK_MAX bytes per chunk
+	size_t *len;            // length of each chunk
+	size_t chunks;
+	atomic_uint job;        // incremented for every job
+	atomic_size_t next;
+	atomic_size_t done;
+	atomic_uint finished;   // workers that are done with the current job
+	atomic_bool exit;
+} rfc_encoder_t;
+
+typedef struct {
+	void *dctx;
+	uint8_t *payload;
+	uint8_t *planes;
+} rfc_decoder_t;
+
+/* name of a codec, NULL if it is not supported by this build */
+const char *rfc_codec_name(int codec);
+const char *rfc_strerror(int err);
+
+uint32_t rfc_crc32(uint32_t crc, const uint8_t *data, size_t len);
+
+/* start threads-1 worker threads, the caller is the last one, returns 0 on success */
+int rfc_encoder_init(rfc_encoder_t *enc, int codec, int level, uint32_t threads);
+/* compress n samples as chunks starting at first_sample into out, every chunk
+ * except the last one has RFC_CHUNK_SAMPLES samples, chunk i is written with its
+ * header to out + i * RFC_CHUNK_MAX and its length to len[i], returns the number of chunks */
+size_t rfc_encode(rfc_encoder_t *enc, const int16_t *samples, size_t n, uint64_t first_sample, uint8_t *out, size_t *len);
+void rfc_encoder_free(rfc_encoder_t *enc);
+
+/* start a stream behind a header of RFC_HEADER_SIZE bytes */
+void rfc_stream_init(rfc_stream_t *s, int codec, uint32_t bits, uint32_t flags, uint32_t sample_rate);
+/* add a chunk written by rfc_encode() to the index, chunks have to be added in order */
+int rfc_stream_add(rfc_stream_t *s, const uint8_t *chunk, size_t len);
+/* write the file header into out (RFC_HEADER_SIZE bytes), with index if it is written at s->offset */
+void rfc_write_header(const rfc_stream_t *s, bool index, uint8_t *out);
+size_t rfc_index_size(const rfc_stream_t *s);
+/* write the index into out (rfc_index_size() bytes) */
+void rfc_write_index(const rfc_stream_t *s, uint8_t *out);
+void rfc_stream_free(rfc_stream_t *s);
+
+/* read the header and the index of a file, a missing index is rebuilt from the chunk headers,
+ * returns RFC_ERR_TRUNCATED with the complete chunks in the index if the last one is cut off */
+int rfc_stream_read(rfc_stream_t *s, FILE *f);
+/* first chunk that contains samples at or behind sample */
+size_t rfc_find_chunk(const rfc_stream_t *s, uint64_t sample);
+
+int rfc_decoder_init(rfc_decoder_t *dec);
+/* read, decompress and check chunk i of the stream, out has room for its samples */
+int rfc_decode_chunk(rfc_decoder_t *dec, const rfc_stream_t *s, FILE *f, size_t i, int16_t *out);
+/* decompress and check a chunk of len bytes written by rfc_encode() */
+int rfc_decode(rfc_decoder_t *dec, const uint8_t *chunk, size_t len, int16_t *out);
+void rfc_decoder_free(rfc_decoder_t *dec);
+
+#endif // RF_CONTAINER_H
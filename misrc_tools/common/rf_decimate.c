@@ -0,0 +1,470 @@
+/*
+* MISRC tools
+* Copyright (C) 2025  vrunk11, stefan_o
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "rf_decimate.h"
+
+#if (defined(__x86_64__) || defined(_M_X64)) && defined(__GNUC__)
+#include <immintrin.h>
+#define RFD_AVX2 1
+#endif
+#if defined(__aarch64__) || defined(__arm64__)
+#include <arm_neon.h>
+#define RFD_NEON 1
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define MAX_FACTOR  64
+#define VEC         16          // outputs computed at once, padding of the buffers
+#define RESPONSE_POINTS 16384
+
+// passband edge relative to the output Nyquist frequency and stopband attenuation,
+// 16 bit coefficients and samples limit the attenuation to about 75 dB, that is
+// about the dynamic range of the 12 bit ADC, so VHQ is the same as HQ. The quantized
+// filters reach about 48 to 54 dB alias rejection with QQ and 70 to 78 dB with the
+// others, test/rf_decimate_test.c checks at least 45, 60 and 70 dB
+static const struct {
+	double passband;
+	double attenuation;
+} quality_spec[RFD_QUALITIES] = {
+	{ 0.600, 45.0 },    // QQ
+	{ 0.670, 70.0 },    // LQ
+	{ 0.830, 75.0 },    // MQ
+	{ 0.913, 80.0 },    // HQ
+	{ 0.913, 80.0 },    // VHQ
+};
+
+static inline int16_t sat16(float v)
+{
+	if (v <= -32768.0f) return INT16_MIN;
+	if (v >= 32767.0f) return INT16_MAX;
+	return (int16_t)lrintf(v);
+}
+
+static bool ratio(double in_rate, double out_rate, uint32_t *m, uint32_t *l)
+{
+	if (in_rate <= 0 || out_rate <= 0 || out_rate > in_rate) return false;
+	for(uint32_t i = 1; i <= 2; i++) {
+		double f = in_rate * i / out_rate, r = round(f);
+		if (fabs(f - r) < 1e-6 * f && r <= MAX_FACTOR) {
+			*m = (uint32_t)r;
+			*l = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool rfd_supported(double in_rate, double out_rate)
+{
+	uint32_t m, l;
+	return ratio(in_rate, out_rate, &m, &l);
+}
+
+static double bessel_i0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	for(int k = 1; k < 100; k++) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+		if (term < sum * 1e-15) break;
+	}
+	return sum;
+}
+
+static double kaiser_beta(double attenuation)
+{
+	if (attenuation > 50) return 0.1102 * (attenuation - 8.7);
+	if (attenuation > 21) return 0.5842 * pow(attenuation - 21, 0.4) + 0.07886 * (attenuation - 21);
+	return 0;
+}
+
+/* quantize the coefficients of a branch, the sum of the products with samples
+ * up to peak has to fit into 32 bits, returns the scale of the sums */
+static float quantize(const double *g, uint32_t n, int16_t *q, double *taps, uint32_t stride, double peak, double gain)
+{
+	double sum = 0, max = 0;
+	int s = 30;
+	for(uint32_t j = 0; j < n; j++) {
+		sum += fabs(g[j]);
+		if (fabs(g[j]) > max) max = fabs(g[j]);
+	}
+	while (s > 0 && (max * (1 << s) > 32767.0 || peak * sum * (1 << s) > 2147483647.0 - 65536.0)) s--;
+	for(uint32_t j = 0; j < n; j++) {
+		q[j] = (int16_t)lrint(g[j] * (1 << s));
+		taps[j * stride] = (double)q[j] / (1 << s);
+	}
+	return (float)(gain / (1 << s));
+}
+
+/* output q of a branch is the sum of g[j] * x[q * factor + offset - j], the
+ * input is split into factor phases and the coefficients are paired to
+ * neighbouring samples of the same phase */
+static int branch_init(rfd_stage_t *st, rfd_branch_t *b, const int16_t *g, uint32_t n, uint32_t offset)
+{
+	uint32_t f = st->factor, r, first, last;
+	int16_t *c = calloc(n / f + 3, sizeof(int16_t));
+	b->pos = malloc((n / 2 + f + 1) * sizeof(uint32_t));
+	b->coef = malloc((n + 2 * f + 2) * sizeof(int16_t));
+	b->pairs = 0;
+	if (!c || !b->pos || !b->coef) {
+		free(c);
+		return -1;
+	}
+	for(uint32_t s = 0; s < f; s++) {
+		// coefficients of phase s by delay, without zeros at the ends
+		memset(c, 0, (n / f + 3) * sizeof(int16_t));
+		first = UINT32_MAX;
+		last = 0;
+		for(uint32_t j = 0; j < n; j++) {
+			r = st->back + offset - j;
+			if (r % f != s || g[j] == 0) continue;
+			c[r / f] = g[j];
+			if (r / f < first) first = r / f;
+			if (r / f > last) last = r / f;
+		}
+		for(uint32_t d = first; first != UINT32_MAX && d <= last; d += 2) {
+			if (c[d] == 0 && c[d + 1] == 0) continue;
+			b->pos[b->pairs] = s * (uint32_t)st->phase_len + d;
+			b->coef[2 * b->pairs] = c[d];
+			b->coef[2 * b->pairs + 1] = c[d + 1];
+			b->pairs++;
+			if (d + 2 > st->span) st->span = d + 2;
+		}
+	}
+	free(c);
+	return 0;
+}
+
+/* stage decimating by factor and interpolating by branches, with the passband
+ * and the stopband edge in Hz and the largest input, a halfband filter if halfband is set */
+static int stage_init(rfd_stage_t *st, uint32_t factor, uint32_t branches, double rate, double passband, double stopband, double attenuation, double peak, double gain, bool halfband)
+{
+	double fr = rate * branches, fc, beta, sum = 0, *h, *g;
+	uint32_t n, c, len[2], off[2], behind = 0;
+	int16_t *q;
+	int ret = -1;
+	n = (uint32_t)ceil((attenuation - 7.95) / (14.36 * (stopband - passband) / fr)) + 1;
+	if (halfband) {
+		// 4k+3 taps, every second one is zero except the centre
+		n = (n <= 3) ? 3 : n / 4 * 4 + 3;
+		fc = 0.25;
+	}
+	else {
+		n |= 1;
+		fc = (passband + stopband) / 2 / fr;
+	}
+	c = (n - 1) / 2;
+	beta = kaiser_beta(attenuation);
+	h = malloc(n * sizeof(double));
+	g = malloc(n * sizeof(double));
+	q = malloc(n * sizeof(int16_t));
+	st->taps = calloc(n, sizeof(double));
+	if (!h || !g || !q || !st->taps) goto out;
+	for(uint32_t k = 0; k < n; k++) {
+		double x = (double)k - c, w = (double)k / c - 1.0;
+		h[k] = ((x == 0) ? 2 * fc : sin(2 * M_PI * fc * x) / (M_PI * x)) * bessel_i0(beta * sqrt(1.0 - w * w)) / bessel_i0(beta);
+		if (halfband && k != c && (k - c) % 2 == 0) h[k] = 0;
+		sum += h[k];
+	}
+	for(uint32_t k = 0; k < n; k++) h[k] *= branches / sum;
+	st->factor = factor;
+	st->branches = branches;
+	st->ntaps = n;
+	// the branches of 2/M use the even or the odd taps of the filter at twice the rate
+	for(uint32_t p = 0; p < branches; p++) {
+		uint32_t kmin = (branches == 1) ? 0 : (p * factor + c) % 2;
+		len[p] = (branches == 1) ? n : (n - kmin + 1) / 2;
+		off[p] = (branches == 1) ? c : (p * factor + c - kmin) / 2;
+		if (off[p] > st->ahead) st->ahead = off[p];
+		if (len[p] - 1 - off[p] > behind) behind = len[p] - 1 - off[p];
+	}
+	st->back = (behind + factor - 1) / factor * factor;
+	st->phase_len = (RFD_CHUNK / factor + 2 + VEC) / VEC * VEC + (st->back + st->ahead) / factor + 2 + VEC;
+	for(uint32_t p = 0; p < branches; p++) {
+		uint32_t kmin = (branches == 1) ? 0 : (p * factor + c) % 2;
+		for(uint32_t j = 0; j < len[p]; j++) g[j] = h[kmin + branches * j];
+		st->branch[p].scale = quantize(g, len[p], q, &st->taps[kmin], branches, peak, gain);
+		if (branch_init(st, &st->branch[p], q, len[p], off[p]) != 0) goto out;
+		st->out[p] = malloc((st->phase_len + VEC) * sizeof(int16_t));
+		if (!st->out[p]) goto out;
+	}
+	st->buf = calloc(st->back + st->ahead + 2 * factor + RFD_CHUNK, sizeof(int16_t));
+	st->phase = calloc(factor * st->phase_len + VEC, sizeof(int16_t));
+	if (!st->buf || !st->phase) goto out;
+	st->len = st->back;
+	ret = 0;
+out:
+	free(h);
+	free(g);
+	free(q);
+	return ret;
+}
+
+static void branch_c(const int16_t *phase, const rfd_branch_t *b, size_t nq, int16_t *out)
+{
+	for(size_t q = 0; q < nq; q++) {
+		int32_t acc = 0;
+		for(uint32_t p = 0; p < b->pairs; p++) {
+			const int16_t *x = &phase[b->pos[p] + q];
+			acc += b->coef[2 * p] * x[0] + b->coef[2 * p + 1] * x[1];
+		}
+		out[q] = sat16(acc * b->scale);
+	}
+}
+
+#ifdef RFD_AVX2
+// 16 outputs at once, the pairs are multiplied and added by madd
+__attribute__((target("avx2")))
+static void branch_avx2(const int16_t *phase, const rfd_branch_t *b, size_t nq, int16_t *out)
+{
+	const __m256 scale = _mm256_set1_ps(b->scale), lo = _mm256_set1_ps(-32768.0f), hi = _mm256_set1_ps(32767.0f);
+	for(size_t q = 0; q < nq; q += 16) {
+		__m256i s0 = _mm256_setzero_si256(), s1 = s0;
+		for(uint32_t p = 0; p < b->pairs; p++) {
+			const int16_t *x = &phase[b->pos[p] + q];
+			__m256i x0 = _mm256_loadu_si256((const __m256i*)x);
+			__m256i x1 = _mm256_loadu_si256((const __m256i*)(x + 1));
+			int32_t pair;
+			memcpy(&pair, &b->coef[2 * p], sizeof(pair));
+			__m256i c = _mm256_set1_epi32(pair);
+			// outputs 0-3 and 8-11 in s0, 4-7 and 12-15 in s1, packs puts them in order again
+			s0 = _mm256_add_epi32(s0, _mm256_madd_epi16(_mm256_unpacklo_epi16(x0, x1), c));
+			s1 = _mm256_add_epi32(s1, _mm256_madd_epi16(_mm256_unpackhi_epi16(x0, x1), c));
+		}
+		__m256 f0 = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(s0), scale), lo), hi);
+		__m256 f1 = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(s1), scale), lo), hi);
+		_mm256_storeu_si256((__m256i*)&out[q], _mm256_packs_epi32(_mm256_cvtps_epi32(f0), _mm256_cvtps_epi32(f1)));
+	}
+}
+#endif
+
+#ifdef RFD_NEON
+static void branch_neon(const int16_t *phase, const rfd_branch_t *b, size_t nq, int16_t *out)
+{
+	const float32x4_t lo = vdupq_n_f32(-32768.0f), hi = vdupq_n_f32(32767.0f);
+	for(size_t q = 0; q < nq; q += 8) {
+		int32x4_t s0 = vdupq_n_s32(0), s1 = s0;
+		for(uint32_t p = 0; p < b->pairs; p++) {
+			const int16_t *x = &phase[b->pos[p] + q];
+			int16x8_t x0 = vld1q_s16(x), x1 = vld1q_s16(x + 1);
+			s0 = vmlal_n_s16(s0, vget_low_s16(x0), b->coef[2 * p]);
+			s1 = vmlal_high_n_s16(s1, x0, b->coef[2 * p]);
+			s0 = vmlal_n_s16(s0, vget_low_s16(x1), b->coef[2 * p + 1]);
+			s1 = vmlal_high_n_s16(s1, x1, b->coef[2 * p + 1]);
+		}
+		float32x4_t f0 = vminq_f32(vmaxq_f32(vmulq_n_f32(vcvtq_f32_s32(s0), b->scale), lo), hi);
+		float32x4_t f1 = vminq_f32(vmaxq_f32(vmulq_n_f32(vcvtq_f32_s32(s1), b->scale), lo), hi);
+		vst1q_s16(&out[q], vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(f0)), vqmovn_s32(vcvtnq_s32_f32(f1))));
+	}
+}
+#endif
+
+static void branch_process(const int16_t *phase, const rfd_branch_t *b, size_t nq, int16_t *out)
+{
+#if defined(RFD_AVX2)
+	if (__builtin_cpu_supports("avx2")) {
+		branch_avx2(phase, b, nq, out);
+		return;
+	}
+#elif defined(RFD_NEON)
+	branch_neon(phase, b, nq, out);
+	return;
+#endif
+	branch_c(phase, b, nq, out);
+}
+
+static size_t stage_process(rfd_stage_t *st, const int16_t *in, size_t n, uint32_t shift, int16_t *out)
+{
+	size_t nq, t_end, consumed;
+	uint32_t f = st->factor;
+	if (shift > 0) {
+		for(size_t i = 0; i < n; i++) st->buf[st->len + i] = in[i] >> shift;
+	}
+	else memcpy(&st->buf[st->len], in, n * sizeof(int16_t));
+	st->len += n;
+	// output q is centred on buf[back + q * factor] and needs ahead samples behind it
+	if (st->len < st->back + st->ahead + 1) return 0;
+	nq = (st->len - 1 - st->back - st->ahead) / f + 1;
+	t_end = (nq + VEC - 1) / VEC * VEC + st->span;
+	if (t_end > (st->len + f - 1) / f) t_end = (st->len + f - 1) / f;
+	if (f == 2) {
+		for(size_t t = 0; t < t_end; t++) {
+			st->phase[t] = st->buf[2 * t];
+			st->phase[st->phase_len + t] = st->buf[2 * t + 1];
+		}
+	}
+	else {
+		for(size_t t = 0; t < t_end; t++) {
+			for(uint32_t s = 0; s < f; s++) st->phase[s * st->phase_len + t] = st->buf[t * f + s];
+		}
+	}
+	for(uint32_t b = 0; b < st->branches; b++) branch_process(st->phase, &st->branch[b], nq, st->out[b]);
+	if (st->branches == 1) memcpy(out, st->out[0], nq * sizeof(int16_t));
+	else {
+		for(size_t q = 0; q < nq; q++) {
+			out[2 * q] = st->out[0][q];
+			out[2 * q + 1] = st->out[1][q];
+		}
+	}
+	// keep back samples before the centre of the next output
+	consumed = nq * f;
+	memmove(st->buf, &st->buf[consumed], (st->len - consumed) * sizeof(int16_t));
+	st->len -= consumed;
+	return nq * st->branches;
+}
+
+int rfd_init(rfd_t *d, double in_rate, double out_rate, int quality, double gain, uint32_t bits, bool padded)
+{
+	uint32_t m, l;
+	double rate = in_rate, passband, frac = 1.0, peak = (double)(1 << (bits - 1)), attenuation;
+	memset(d, 0, sizeof(rfd_t));
+	if (!ratio(in_rate, out_rate, &m, &l) || quality < 0 || quality >= RFD_QUALITIES || bits < 8 || bits > 16) return -1;
+	d->in_rate = in_rate;
+	d->out_rate = out_rate;
+	// padded samples are shifted down when they are split into phases, the gain shifts them up again
+	d->shift = padded ? 16 - bits : 0;
+	gain *= 1 << d->shift;
+	d->scale = (float)gain;
+	passband = quality_spec[quality].passband * out_rate / 2;
+	attenuation = quality_spec[quality].attenuation;
+	d->passband = passband / in_rate;
+	// unused bits of the input are kept as fraction between the stages, one is left for overshoot,
+	// two are left to the coefficients of a polyphase stage behind halfband stages
+	if (bits < 15) frac = (double)(1 << (15 - bits));
+	if (l == 1 && m % 2 == 0 && (m & (m - 1)) != 0) frac = (frac > 4.0) ? frac / 4 : 1.0;
+	// halfband stages only have to keep the passband free of aliases
+	while (l == 1 && m % 2 == 0) {
+		double g = (m == 2) ? gain : 1.0;
+		if (d->stages == 0) g *= (m == 2) ? 1.0 : frac;
+		else if (m == 2) g /= frac;
+		if (stage_init(&d->stage[d->stages], 2, 1, rate, passband, rate / 2 - passband, attenuation, peak, g, true) != 0) {
+			rfd_free(d);
+			return -1;
+		}
+		d->stages++;
+		peak = fmin(32768.0, (1 << (bits - 1)) * frac * 1.5);
+		rate /= 2;
+		m /= 2;
+	}
+	if (m > 1 || l > 1) {
+		if (stage_init(&d->stage[d->stages], m, l, rate, passband, out_rate / 2, attenuation, peak, (d->stages == 0) ? gain : gain / frac, false) != 0) {
+			rfd_free(d);
+			return -1;
+		}
+		d->stages++;
+	}
+	d->tmp[0] = malloc((RFD_CHUNK + VEC) * sizeof(int16_t));
+	d->tmp[1] = malloc((RFD_CHUNK + VEC) * sizeof(int16_t));
+	d->narrow = malloc(RFD_CHUNK * sizeof(int16_t));
+	if (!d->tmp[0] || !d->tmp[1] || !d->narrow) {
+		rfd_free(d);
+		return -1;
+	}
+	return 0;
+}
+
+size_t rfd_process(rfd_t *d, const int16_t *in, size_t n, int16_t *out)
+{
+	size_t total = 0, len, m;
+	const int16_t *x;
+	if (d->stages == 0) {
+		for(size_t i = 0; i < n; i++) out[i] = sat16((in[i] >> d->shift) * d->scale);
+		return n;
+	}
+	while (n > 0) {
+		len = (n < RFD_CHUNK) ? n : RFD_CHUNK;
+		x = in;
+		m = len;
+		for(uint32_t i = 0; i < d->stages; i++) {
+			int16_t *y = (i == d->stages - 1) ? &out[total] : d->tmp[i & 1];
+			m = stage_process(&d->stage[i], x, m, (i == 0) ? d->shift : 0, y);
+			x = y;
+		}
+		total += m;
+		in += len;
+		n -= len;
+	}
+	return total;
+}
+
+size_t rfd_process_s32(rfd_t *d, const int32_t *in, size_t n, int16_t *out)
+{
+	size_t total = 0, len;
+	while (n > 0) {
+		len = (n < RFD_CHUNK) ? n : RFD_CHUNK;
+		for(size_t i = 0; i < len; i++) d->narrow[i] = (int16_t)in[i];
+		total += rfd_process(d, d->narrow, len, &out[total]);
+		in += len;
+		n -= len;
+	}
+	return total;
+}
+
+// gain of a stage at frequency f, relative to the input rate of the stage
+static double stage_gain(const rfd_stage_t *st, double f)
+{
+	double sum = 0, c = (st->ntaps - 1) / 2.0;
+	for(uint32_t k = 0; k < st->ntaps; k++) sum += st->taps[k] * cos(2 * M_PI * f / st->branches * (k - c));
+	return fabs(sum) / st->branches;
+}
+
+void rfd_response(const rfd_t *d, double *passband, double *ripple, double *rejection)
+{
+	double worst = 0, alias = 0;
+	for(uint32_t i = 0; i <= RESPONSE_POINTS; i++) {
+		double f = 0.5 * i / RESPONSE_POINTS, fo = f, g = 1.0, rate = 1.0;
+		// follow the frequency through the stages, it is folded by every decimation
+		for(uint32_t s = 0; s < d->stages; s++) {
+			const rfd_stage_t *st = &d->stage[s];
+			g *= stage_gain(st, fo / rate);
+			rate = rate * st->branches / st->factor;
+			fo = fmod(fo, rate);
+			if (fo > rate / 2) fo = rate - fo;
+		}
+		if (f <= d->passband && fabs(20 * log10(g)) > worst) worst = fabs(20 * log10(g));
+		if (f > rate / 2 && fo <= d->passband && g > alias) alias = g;
+	}
+	*passband = d->passband;
+	*ripple = worst;
+	*rejection = (alias > 0) ? -20 * log10(alias) : INFINITY;
+}
+
+void rfd_free(rfd_t *d)
+{
+	for(uint32_t i = 0; i < RFD_MAX_STAGES; i++) {
+		rfd_stage_t *st = &d->stage[i];
+		for(int b = 0; b < 2; b++) {
+			free(st->branch[b].pos);
+			free(st->branch[b].coef);
+			free(st->out[b]);
+		}
+		free(st->taps);
+		free(st->buf);
+		free(st->phase);
+	}
+	free(d->tmp[0]);
+	free(d->tmp[1]);
+	free(d->narrow);
+	memset(d, 0, sizeof(rfd_t));
+}
@@ -0,0 +1,92 @@
+/*
+* MISRC tools
+* Copyright (C) 2025  vrunk11, stefan_o
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RF_DECIMATE_H
+#define RF_DECIMATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Built-in decimator for 16 bit RF, for output rates of the input rate times
+ * 1/M or 2/M (40 MSPS to 20, 16, 10 or 8 MSPS and so on). Factors of two are
+ * removed by halfband filters, the rest by a polyphase FIR filter that also
+ * interpolates by two for 2/M. Every stage works on 16 bit samples with 16 bit
+ * coefficients and 32 bit sums (AVX2 or NEON where available), the gain is
+ * applied to the output of the last stage. The filters are Kaiser windowed
+ * sinc filters designed for the passband and the stopband attenuation of the
+ * quality, the stopband starts at the output Nyquist frequency (halfband
+ * stages only protect the passband, like most multistage decimators). The
+ * output is centred on the input like that of libsoxr, the last samples of a
+ * stream remain in the filter. */
+
+#define RFD_MAX_STAGES  8
+#define RFD_CHUNK       16384   // input samples a stage processes at once
+#define RFD_QUALITIES   5       // QQ, LQ, MQ, HQ and VHQ like libsoxr
+
+typedef struct {
+	uint32_t pairs;
+	uint32_t *pos;          // of each coefficient pair in the phases, phase * phase_len + delay
+	int16_t *coef;          // two per pair, for output q they are applied to [q + pos] and [q + pos + 1]
+	float scale;            // of the 32 bit sums
+} rfd_branch_t;
+
+typedef struct {
+	uint32_t factor;        // decimation
+	uint32_t branches;      // 2 if the stage interpolates by two
+	rfd_branch_t branch[2];
+	uint32_t back;          // input samples before the centre of an output, a multiple of factor
+	uint32_t ahead;         // input samples behind the centre of an output
+	double *taps;           // quantized filter at the input rate times branches, for rfd_response()
+	uint32_t ntaps;
+	int16_t *buf;           // input behind back samples of history
+	size_t len;
+	int16_t *phase;         // input split into factor phases of phase_len samples
+	size_t phase_len;
+	uint32_t span;          // samples of a phase behind q that are used for output q
+	int16_t *out[2];        // output of each branch
+} rfd_stage_t;
+
+typedef struct {
+	double in_rate;
+	double out_rate;
+	double passband;        // edge relative to the input rate
+	uint32_t stages;
+	rfd_stage_t stage[RFD_MAX_STAGES];
+	float scale;            // without stages
+	uint32_t shift;         // of padded input
+	int16_t *tmp[2];        // between stages
+	int16_t *narrow;        // 32 bit input
+} rfd_t;
+
+/* true if out_rate can be reached from in_rate, out_rate = in_rate is allowed and only applies the gain */
+bool rfd_supported(double in_rate, double out_rate);
+/* quality from 0 (QQ) to RFD_QUALITIES-1 (VHQ), gain is a factor, bits is the number of used
+ * bits of the input (12 or 16), in the upper bits if padded is set, the coefficients use the
+ * unused bits and the stages in between keep them as fraction, returns 0 on success */
+int rfd_init(rfd_t *d, double in_rate, double out_rate, int quality, double gain, uint32_t bits, bool padded);
+/* decimate n samples, out has room for n * out_rate / in_rate + 4 samples, returns the number of output samples */
+size_t rfd_process(rfd_t *d, const int16_t *in, size_t n, int16_t *out);
+/* the same for 32 bit samples in the 16 bit range */
+size_t rfd_process_s32(rfd_t *d, const int32_t *in, size_t n, int16_t *out);
+/* passband edge in units of the input rate, ripple in the passband and attenuation
+ * of the frequencies that alias into the passband in dB, of the quantized filters */
+void rfd_response(const rfd_t *d, double *passband, double *ripple, double *rejection);
+void rfd_free(rfd_t *d);
+
+#endif // RF_DECIMATE_H
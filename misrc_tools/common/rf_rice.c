@@ -0,0 +1,582 @@
+/*
+* MISRC tools
+* Copyright (C) 2025  vrunk11, stefan_o
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include "rf_rice.h"
+
+#if (defined(__x86_64__) || defined(_M_X64)) && defined(__GNUC__)
+#include <immintrin.h>
+#define RICE_AVX2 1
+#endif
+#if defined(__aarch64__) || defined(__arm64__)
+#include <arm_neon.h>
+#define RICE_NEON 1
+#endif
+
+#define ORDERS        3  // fixed predictors, order 0 to 2
+#define PRED_LPC      3  // LPC predictor with the coefficients in the block
+#define PREDICTORS    4
+#define LPC_ORDER     8
+#define LPC_SHIFT     9
+#define LPC_COEF_BITS 13  // the sum of LPC_ORDER products with 16 bit samples fits into 32 bits
+#define LPC_COEF_MIN  (-(1 << (LPC_COEF_BITS - 1)))
+#define LPC_COEF_MAX  ((1 << (LPC_COEF_BITS - 1)) - 1)
+// block header, coefficients and every residual escaped, plus the bits still in the writer and the padding
+#define BLOCK_MAX_BYTES ((8 + LPC_ORDER * LPC_COEF_BITS + RF_RICE_BLOCK * (RF_RICE_ESCAPE + RF_RICE_BITS)) / 8 + 8)
+#if BLOCK_MAX_BYTES != RF_RICE_BLOCK_MAX
+#error "RF_RICE_BLOCK_MAX does not match the block layout"
+#endif
+
+/* big endian bit writer, bits are collected in acc and written 32 at a time */
+typedef struct {
+	uint8_t *p;
+	uint64_t acc;
+	unsigned int bits;
+} bitwriter_t;
+
+static inline uint32_t to_be32(uint32_t v)
+{
+#if defined(__GNUC__)
+	return __builtin_bswap32(v);
+#else
+	return (v >> 24) | ((v >> 8) & 0xFF00) | ((v << 8) & 0xFF0000) | (v << 24);
+#endif
+}
+
+static inline uint64_t from_be64(uint64_t v)
+{
+#if defined(__GNUC__)
+	return __builtin_bswap64(v);
+#else
+	return ((uint64_t)to_be32((uint32_t)v) << 32) | to_be32((uint32_t)(v >> 32));
+#endif
+}
+
+static inline unsigned int clz64(uint64_t v)
+{
+#if defined(__GNUC__)
+	return (v) ? (unsigned int)__builtin_clzll(v) : 64;
+#else
+	unsigned int n = 0;
+	if (v == 0) return 64;
+	while (!(v & (1ULL << 63))) {
+		v <<= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+// v must not have bits above the lower n, n <= 32
+static inline void bw_put(bitwriter_t *w, uint32_t v, unsigned int n)
+{
+	w->acc = (w->acc << n) | v;
+	w->bits += n;
+	if (w->bits >= 32) {
+		uint32_t out;
+		w->bits -= 32;
+		out = to_be32((uint32_t)(w->acc >> w->bits));
+		memcpy(w->p, &out, 4);
+		w->p += 4;
+	}
+}
+
+static inline void bw_rice(bitwriter_t *w, uint32_t u, unsigned int k)
+{
+	uint32_t q = u >> k;
+	if (q >= RF_RICE_ESCAPE) {
+		bw_put(w, 0, RF_RICE_ESCAPE);
+		bw_put(w, u, RF_RICE_BITS);
+		return;
+	}
+	if (q + 1 + k <= 32) {
+		bw_put(w, (1u << k) | (u & ((1u << k) - 1)), q + 1 + k);
+		return;
+	}
+	bw_put(w, 0, q);
+	bw_put(w, (1u << k) | (u & ((1u << k) - 1)), k + 1);
+}
+
+// pad with zeros to a byte boundary and write everything
+static inline void bw_flush(bitwriter_t *w)
+{
+	if (w->bits & 7) bw_put(w, 0, 8 - (w->bits & 7));
+	while (w->bits >= 8) {
+		w->bits -= 8;
+		*w->p++ = (uint8_t)(w->acc >> w->bits);
+	}
+}
+
+/* big endian bit reader, the next bits are the upper ones of cache */
+typedef struct {
+	const uint8_t *p;
+	const uint8_t *end;
+	uint64_t cache;
+	unsigned int bits;      // valid bits in cache
+} bitreader_t;
+
+// at least 57 bits are in the cache afterwards, unless the end is reached
+static inline void br_refill(bitreader_t *r)
+{
+	if (r->end - r->p >= 8) {
+		uint64_t v;
+		memcpy(&v, r->p, 8);
+		// the bits below the valid ones are the next bytes, reading them again does not change them
+		r->cache |= from_be64(v) >> r->bits;
+		r->p += (63 - r->bits) >> 3;
+		r->bits |= 56;
+		return;
+	}
+	while (r->bits <= 56 && r->p < r->end) {
+		r->cache |= (uint64_t)*r->p++ << (56 - r->bits);
+		r->bits += 8;
+	}
+}
+
+static inline void br_skip(bitreader_t *r, unsigned int n)
+{
+	r->cache <<= n;
+	r->bits -= n;
+}
+
+// n from 1 to 57, the cache has to hold n bits and the value has to fit into 32 bits
+static inline uint32_t br_get(bitreader_t *r, unsigned int n)
+{
+	uint32_t v = (uint32_t)(r->cache >> (64 - n));
+	br_skip(r, n);
+	return v;
+}
+
+static inline uint32_t zigzag(int32_t e)
+{
+	return ((uint32_t)e << 1) ^ (uint32_t)(e >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t u)
+{
+	return (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+}
+
+static inline int32_t lpc_predict(const int32_t *c, const int16_t *x)
+{
+	int32_t p = 1 << (LPC_SHIFT - 1);
+	for(int l = 0; l < LPC_ORDER; l++) p += c[l] * x[-1 - l];
+	p >>= LPC_SHIFT;
+	return (p < INT16_MIN) ? INT16_MIN : ((p > INT16_MAX) ? INT16_MAX : p);
+}
+
+/* zigzag coded residuals of order 0 to 2 with their sums and maxima and the
+ * autocorrelation of lag 0 to LPC_ORDER, x[-1] to x[-LPC_ORDER] are the previous samples */
+static void block_residuals_c(const int16_t *x, uint32_t n, uint32_t u[PREDICTORS][RF_RICE_BLOCK], uint64_t *sum, uint32_t *max, double *acf)
+{
+	for(uint32_t i = 0; i < n; i++) {
+		int32_t d1 = x[i] - x[(int)i - 1];
+		int32_t d2 = d1 - (x[(int)i - 1] - x[(int)i - 2]);
+		u[0][i] = zigzag(x[i]);
+		u[1][i] = zigzag(d1);
+		u[2][i] = zigzag(d2);
+		for(int o = 0; o < ORDERS; o++) {
+			sum[o] += u[o][i];
+			if (u[o][i] > max[o]) max[o] = u[o][i];
+		}
+		for(int l = 0; l <= LPC_ORDER; l++) acf[l] += (double)x[i] * x[(int)i - l];
+	}
+}
+
+/* zigzag coded residuals of the LPC predictor with their sum and maximum */
+static void lpc_residuals_c(const int16_t *x, uint32_t n, const int32_t *c, uint32_t *u, uint64_t *sum, uint32_t *max)
+{
+	for(uint32_t i = 0; i < n; i++) {
+		u[i] = zigzag(x[i] - lpc_predict(c, &x[i]));
+		*sum += u[i];
+		if (u[i] > *max) *max = u[i];
+	}
+}
+
+#ifdef RICE_AVX2
+__attribute__((target("avx2")))
+static inline __m256i load_avx2(const int16_t *x)
+{
+	return _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)x));
+}
+
+// the sums of 8 lanes do not overflow for blocks of up to 2^13 samples
+__attribute__((target("avx2")))
+static void block_residuals_avx2(const int16_t *x, uint32_t n, uint32_t u[PREDICTORS][RF_RICE_BLOCK], uint64_t *sum, uint32_t *max, double *acf)
+{
+	__m256i s[ORDERS], m[ORDERS], xl[LPC_ORDER + 1];
+	__m256 a[LPC_ORDER + 1];
+	uint32_t lanes[8], i;
+	float f[8];
+	for(int o = 0; o < ORDERS; o++) s[o] = m[o] = _mm256_setzero_si256();
+	for(int l = 0; l <= LPC_ORDER; l++) a[l] = _mm256_setzero_ps();
+	for(i = 0; i + 8 <= n; i += 8) {
+		for(int l = 0; l <= LPC_ORDER; l++) xl[l] = load_avx2(&x[(int)i - l]);
+		__m256i d1 = _mm256_sub_epi32(xl[0], xl[1]);
+		__m256i e[ORDERS] = { xl[0], d1, _mm256_sub_epi32(d1, _mm256_sub_epi32(xl[1], xl[2])) };
+		__m256 f0 = _mm256_cvtepi32_ps(xl[0]);
+		for(int o = 0; o < ORDERS; o++) {
+			__m256i z = _mm256_xor_si256(_mm256_slli_epi32(e[o], 1), _mm256_srai_epi32(e[o], 31));
+			_mm256_storeu_si256((__m256i*)&u[o][i], z);
+			s[o] = _mm256_add_epi32(s[o], z);
+			m[o] = _mm256_max_epu32(m[o], z);
+		}
+		for(int l = 0; l <= LPC_ORDER; l++) a[l] = _mm256_add_ps(a[l], _mm256_mul_ps(f0, _mm256_cvtepi32_ps(xl[l])));
+	}
+	for(int o = 0; o < ORDERS; o++) {
+		_mm256_storeu_si256((__m256i*)lanes, s[o]);
+		for(int l = 0; l < 8; l++) sum[o] += lanes[l];
+		_mm256_storeu_si256((__m256i*)lanes, m[o]);
+		for(int l = 0; l < 8; l++) if (lanes[l] > max[o]) max[o] = lanes[l];
+	}
+	for(int k = 0; k <= LPC_ORDER; k++) {
+		_mm256_storeu_ps(f, a[k]);
+		for(int l = 0; l < 8; l++) acf[k] += f[l];
+	}
+	if (i < n) {
+		uint32_t t[PREDICTORS][RF_RICE_BLOCK];
+		block_residuals_c(&x[i], n - i, t, sum, max, acf);
+		for(int o = 0; o < ORDERS; o++) memcpy(&u[o][i], t[o], (n - i) * sizeof(uint32_t));
+	}
+}
+
+__attribute__((target("avx2")))
+static void lpc_residuals_avx2(const int16_t *x, uint32_t n, const int32_t *c, uint32_t *u, uint64_t *sum, uint32_t *max)
+{
+	__m256i s = _mm256_setzero_si256(), m = s, v[LPC_ORDER];
+	__m256i round = _mm256_set1_epi32(1 << (LPC_SHIFT - 1)), lo = _mm256_set1_epi32(INT16_MIN), hi = _mm256_set1_epi32(INT16_MAX);
+	uint32_t lanes[8], i;
+	for(int l = 0; l < LPC_ORDER; l++) v[l] = _mm256_set1_epi32(c[l]);
+	for(i = 0; i + 8 <= n; i += 8) {
+		__m256i pred = round;
+		for(int l = 0; l < LPC_ORDER; l++) pred = _mm256_add_epi32(pred, _mm256_mullo_epi32(v[l], load_avx2(&x[(int)i - 1 - l])));
+		pred = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(pred, LPC_SHIFT), lo), hi);
+		__m256i e = _mm256_sub_epi32(load_avx2(&x[i]), pred);
+		__m256i z = _mm256_xor_si256(_mm256_slli_epi32(e, 1), _mm256_srai_epi32(e, 31));
+		_mm256_storeu_si256((__m256i*)&u[i], z);
+		s = _mm256_add_epi32(s, z);
+		m = _mm256_max_epu32(m, z);
+	}
+	_mm256_storeu_si256((__m256i*)lanes, s);
+	for(int l = 0; l < 8; l++) *sum += lanes[l];
+	_mm256_storeu_si256((__m256i*)lanes, m);
+	for(int l = 0; l < 8; l++) if (lanes[l] > *max) *max = lanes[l];
+	if (i < n) lpc_residuals_c(&x[i], n - i, c, &u[i], sum, max);
+}
+#endif
+
+#ifdef RICE_NEON
+static void block_residuals_neon(const int16_t *x, uint32_t n, uint32_t u[PREDICTORS][RF_RICE_BLOCK], uint64_t *sum, uint32_t *max, double *acf)
+{
+	uint32x4_t s[ORDERS], m[ORDERS];
+	int32x4_t xl[LPC_ORDER + 1];
+	float32x4_t a[LPC_ORDER + 1];
+	uint32_t i;
+	for(int o = 0; o < ORDERS; o++) s[o] = m[o] = vdupq_n_u32(0);
+	for(int l = 0; l <= LPC_ORDER; l++) a[l] = vdupq_n_f32(0);
+	for(i = 0; i + 4 <= n; i += 4) {
+		for(int l = 0; l <= LPC_ORDER; l++) xl[l] = vmovl_s16(vld1_s16(&x[(int)i - l]));
+		int32x4_t d1 = vsubq_s32(xl[0], xl[1]);
+		int32x4_t e[ORDERS] = { xl[0], d1, vsubq_s32(d1, vsubq_s32(xl[1], xl[2])) };
+		float32x4_t f0 = vcvtq_f32_s32(xl[0]);
+		for(int o = 0; o < ORDERS; o++) {
+			uint32x4_t z = vreinterpretq_u32_s32(veorq_s32(vshlq_n_s32(e[o], 1), vshrq_n_s32(e[o], 31)));
+			vst1q_u32(&u[o][i], z);
+			s[o] = vaddq_u32(s[o], z);
+			m[o] = vmaxq_u32(m[o], z);
+		}
+		for(int l = 0; l <= LPC_ORDER; l++) a[l] = vmlaq_f32(a[l], f0, vcvtq_f32_s32(xl[l]));
+	}
+	for(int o = 0; o < ORDERS; o++) {
+		sum[o] += vaddlvq_u32(s[o]);
+		if (vmaxvq_u32(m[o]) > max[o]) max[o] = vmaxvq_u32(m[o]);
+	}
+	for(int l = 0; l <= LPC_ORDER; l++) acf[l] += vaddvq_f32(a[l]);
+	if (i < n) {
+		uint32_t t[PREDICTORS][RF_RICE_BLOCK];
+		block_residuals_c(&x[i], n - i, t, sum, max, acf);
+		for(int o = 0; o < ORDERS; o++) memcpy(&u[o][i], t[o], (n - i) * sizeof(uint32_t));
+	}
+}
+
+static void lpc_residuals_neon(const int16_t *x, uint32_t n, const int32_t *c, uint32_t *u, uint64_t *sum, uint32_t *max)
+{
+	uint32x4_t s = vdupq_n_u32(0), m = s;
+	int32x4_t round = vdupq_n_s32(1 << (LPC_SHIFT - 1)), lo = vdupq_n_s32(INT16_MIN), hi = vdupq_n_s32(INT16_MAX);
+	uint32_t i;
+	for(i = 0; i + 4 <= n; i += 4) {
+		int32x4_t pred = round;
+		for(int l = 0; l < LPC_ORDER; l++) pred = vmlaq_n_s32(pred, vmovl_s16(vld1_s16(&x[(int)i - 1 - l])), c[l]);
+		pred = vminq_s32(vmaxq_s32(vshrq_n_s32(pred, LPC_SHIFT), lo), hi);
+		int32x4_t e = vsubq_s32(vmovl_s16(vld1_s16(&x[i])), pred);
+		uint32x4_t z = vreinterpretq_u32_s32(veorq_s32(vshlq_n_s32(e, 1), vshrq_n_s32(e, 31)));
+		vst1q_u32(&u[i], z);
+		s = vaddq_u32(s, z);
+		m = vmaxq_u32(m, z);
+	}
+	*sum += vaddlvq_u32(s);
+	if (vmaxvq_u32(m) > *max) *max = vmaxvq_u32(m);
+	if (i < n) lpc_residuals_c(&x[i], n - i, c, &u[i], sum, max);
+}
+#endif
+
+static void block_residuals(const int16_t *x, uint32_t n, uint32_t u[PREDICTORS][RF_RICE_BLOCK], uint64_t *sum, uint32_t *max, double *acf)
+{
+	for(int o = 0; o < ORDERS; o++) {
+		sum[o] = 0;
+		max[o] = 0;
+	}
+	for(int l = 0; l <= LPC_ORDER; l++) acf[l] = 0;
+#if defined(RICE_AVX2)
+	if (__builtin_cpu_supports("avx2")) {
+		block_residuals_avx2(x, n, u, sum, max, acf);
+		return;
+	}
+#elif defined(RICE_NEON)
+	block_residuals_neon(x, n, u, sum, max, acf);
+	return;
+#endif
+	block_residuals_c(x, n, u, sum, max, acf);
+}
+
+static void lpc_residuals(const int16_t *x, uint32_t n, const int32_t *c, uint32_t *u, uint64_t *sum, uint32_t *max)
+{
+	*sum = 0;
+	*max = 0;
+#if defined(RICE_AVX2)
+	if (__builtin_cpu_supports("avx2")) {
+		lpc_residuals_avx2(x, n, c, u, sum, max);
+		return;
+	}
+#elif defined(RICE_NEON)
+	lpc_residuals_neon(x, n, c, u, sum, max);
+	return;
+#endif
+	lpc_residuals_c(x, n, c, u, sum, max);
+}
+
+/* LPC coefficients from the autocorrelation (Levinson-Durbin), returns false if there are none */
+static bool lpc_coefs(double *acf, int32_t *c)
+{
+	double a[LPC_ORDER + 1] = { 1.0 }, tmp[LPC_ORDER + 1], err, k;
+	// a little white noise keeps the solution stable
+	acf[0] *= 1.0 + 1e-6;
+	if (acf[0] <= 0) return false;
+	err = acf[0];
+	for(int i = 1; i <= LPC_ORDER; i++) {
+		k = -acf[i];
+		for(int j = 1; j < i; j++) k -= a[j] * acf[i - j];
+		k /= err;
+		// rounding errors may make a nearly singular block unstable, stop at the last stable order
+		if (k * k >= 1.0) break;
+		memcpy(tmp, a, sizeof(a));
+		for(int j = 1; j < i; j++) a[j] = tmp[j] + k * tmp[i - j];
+		a[i] = k;
+		err *= 1.0 - k * k;
+	}
+	// the prediction is the negated sum
+	for(int i = 0; i < LPC_ORDER; i++) {
+		double v = -a[i + 1] * (1 << LPC_SHIFT);
+		c[i] = (v < LPC_COEF_MIN) ? LPC_COEF_MIN : ((v > LPC_COEF_MAX) ? LPC_COEF_MAX : (int32_t)lrint(v));
+	}
+	return true;
+}
+
+/* Rice parameter for m residuals with the sum s and an estimate of the bits they need */
+static uint64_t rice_param(uint64_t s, uint32_t m, uint32_t *k)
+{
+	uint64_t mean = s / m, bits, bits_lower;
+	uint32_t p = 0;
+	if (mean > 1) p = 63 - clz64(mean);
+	if (p > RF_RICE_BITS - 1) p = RF_RICE_BITS - 1;
+	bits = (uint64_t)m * (p + 1) + (s >> p);
+	if (p > 0 && (bits_lower = (uint64_t)m * p + (s >> (p - 1))) < bits) {
+		p--;
+		bits = bits_lower;
+	}
+	*k = p;
+	return bits;
+}
+
+static void encode_block(bitwriter_t *w, const int16_t *x, uint32_t n)
+{
+	uint32_t u[PREDICTORS][RF_RICE_BLOCK], max[PREDICTORS], k, width, pred = 0, param = 0, preds = ORDERS;
+	uint64_t sum[PREDICTORS], bits, best = UINT64_MAX;
+	int32_t c[LPC_ORDER];
+	double acf[LPC_ORDER + 1];
+	bool packed = false;
+	block_residuals(x, n, u, sum, max, acf);
+	// only the products within the block, the autocorrelation of the block is positive definite
+	for(int l = 1; l <= LPC_ORDER; l++) {
+		for(int i = 0; i < l && i < (int)n; i++) acf[l] -= (double)x[i] * x[i - l];
+	}
+	if (lpc_coefs(acf, c)) {
+		lpc_residuals(x, n, c, u[PRED_LPC], &sum[PRED_LPC], &max[PRED_LPC]);
+		preds = PREDICTORS;
+	}
+	for(uint32_t o = 0; o < preds; o++) {
+		// the coefficients of the LPC predictor are part of the block
+		uint64_t extra = (o == PRED_LPC) ? LPC_ORDER * LPC_COEF_BITS : 0;
+		width = 32 - (uint32_t)clz64((uint64_t)max[o] << 32);
+		if (max[o] == 0) width = 0;
+		// packing is preferred on a tie, it decodes faster
+		if ((bits = (uint64_t)n * width + extra) <= best) {
+			best = bits;
+			pred = o;
+			packed = true;
+			param = width;
+		}
+		if ((bits = rice_param(sum[o], n, &k) + extra) < best) {
+			best = bits;
+			pred = o;
+			packed = false;
+			param = k;
+		}
+	}
+	bw_put(w, pred << 6 | (uint32_t)packed << 5 | param, 8);
+	if (pred == PRED_LPC) {
+		for(int l = 0; l < LPC_ORDER; l++) bw_put(w, (uint32_t)c[l] & ((1u << LPC_COEF_BITS) - 1), LPC_COEF_BITS);
+	}
+	if (packed) {
+		if (param > 0) for(uint32_t i = 0; i < n; i++) bw_put(w, u[pred][i], param);
+	}
+	else for(uint32_t i = 0; i < n; i++) bw_rice(w, u[pred][i], param);
+}
+
+size_t rf_rice_encode(const int16_t *samples, size_t n, uint8_t *out, size_t cap)
+{
+	// the first block starts with zero samples before it
+	int16_t first[LPC_ORDER + RF_RICE_BLOCK] = { 0 };
+	bitwriter_t w = { out, 0, 0 };
+	uint32_t len;
+	for(size_t i = 0; i < n; i += RF_RICE_BLOCK) {
+		/* the writer does not check the room, a block is only started if its worst
+		 * case fits. The bits left in the writer (less than 32) and the padding of
+		 * bw_flush() are part of BLOCK_MAX_BYTES, so nothing is written past cap */
+		if (cap < (size_t)(w.p - out) || cap - (size_t)(w.p - out) < BLOCK_MAX_BYTES) return 0;
+		len = (n - i < RF_RICE_BLOCK) ? (uint32_t)(n - i) : RF_RICE_BLOCK;
+		if (i == 0) {
+			memcpy(&first[LPC_ORDER], samples, len * sizeof(int16_t));
+			encode_block(&w, &first[LPC_ORDER], len);
+		}
+		else encode_block(&w, &samples[i], len);
+	}
+	bw_flush(&w);
+	return w.p - out;
+}
+
+static inline uint32_t rice_get(bitreader_t *r, uint32_t k)
+{
+	uint32_t q = clz64(r->cache), v;
+	if (q >= RF_RICE_ESCAPE) {
+		br_skip(r, RF_RICE_ESCAPE);
+		return br_get(r, RF_RICE_BITS);
+	}
+	// the terminating one and the remainder are read together
+	v = br_get(r, q + 1 + k);
+	return (q << k) + v - (1u << k);
+}
+
+// residuals of a Rice coded block, a residual needs at most RF_RICE_ESCAPE + RF_RICE_BITS bits
+static int decode_rice(bitreader_t *r, uint32_t k, uint32_t *u, uint32_t n)
+{
+	uint32_t i = 0, q;
+	// as long as the whole block is in the input, residuals are decoded until the cache may run out
+	if ((size_t)(r->end - r->p) >= BLOCK_MAX_BYTES) {
+		while (i < n) {
+			br_refill(r);
+			do u[i++] = rice_get(r, k);
+			while (i < n && r->bits >= RF_RICE_ESCAPE + RF_RICE_BITS);
+		}
+		return 0;
+	}
+	for(; i < n; i++) {
+		br_refill(r);
+		q = clz64(r->cache);
+		if (r->bits < ((q >= RF_RICE_ESCAPE) ? RF_RICE_ESCAPE + RF_RICE_BITS : q + 1 + k)) return -1;
+		u[i] = rice_get(r, k);
+	}
+	return 0;
+}
+
+static int decode_packed(bitreader_t *r, uint32_t width, uint32_t *u, uint32_t n)
+{
+	if (width == 0) {
+		memset(u, 0, n * sizeof(uint32_t));
+		return 0;
+	}
+	for(uint32_t i = 0; i < n; i++) {
+		br_refill(r);
+		if (r->bits < width) return -1;
+		u[i] = br_get(r, width);
+	}
+	return 0;
+}
+
+// sign extend the lower bits of v
+static inline int32_t sign_extend(uint32_t v, unsigned int bits)
+{
+	return (int32_t)(v << (32 - bits)) >> (32 - bits);
+}
+
+int rf_rice_decode(const uint8_t *in, size_t len, int16_t *samples, size_t n)
+{
+	bitreader_t r = { in, in + len, 0, 0 };
+	// the samples of a block behind the last ones of the previous block
+	int16_t y[LPC_ORDER + RF_RICE_BLOCK] = { 0 }, *x = &y[LPC_ORDER];
+	uint32_t u[RF_RICE_BLOCK], hdr, pred, param, end;
+	int32_t c[LPC_ORDER];
+	for(size_t i = 0; i < n; i += RF_RICE_BLOCK) {
+		end = (n - i < RF_RICE_BLOCK) ? (uint32_t)(n - i) : RF_RICE_BLOCK;
+		br_refill(&r);
+		if (r.bits < 8) return -1;
+		hdr = br_get(&r, 8);
+		pred = hdr >> 6;
+		param = hdr & 0x1F;
+		if (pred == PRED_LPC) {
+			for(int l = 0; l < LPC_ORDER; l++) {
+				br_refill(&r);
+				if (r.bits < LPC_COEF_BITS) return -1;
+				c[l] = sign_extend(br_get(&r, LPC_COEF_BITS), LPC_COEF_BITS);
+			}
+		}
+		if (hdr & 0x20) {
+			if (param > RF_RICE_BITS || decode_packed(&r, param, u, end) != 0) return -1;
+		}
+		else if (param >= RF_RICE_BITS || decode_rice(&r, param, u, end) != 0) return -1;
+		switch (pred) {
+		case 0:
+			for(uint32_t j = 0; j < end; j++) x[j] = (int16_t)unzigzag(u[j]);
+			break;
+		case 1:
+			for(uint32_t j = 0; j < end; j++) x[j] = (int16_t)(unzigzag(u[j]) + x[(int)j - 1]);
+			break;
+		case 2:
+			for(uint32_t j = 0; j < end; j++) x[j] = (int16_t)(unzigzag(u[j]) + 2 * x[(int)j - 1] - x[(int)j - 2]);
+			break;
+		default:
+			for(uint32_t j = 0; j < end; j++) x[j] = (int16_t)(unzigzag(u[j]) + lpc_predict(c, &x[j]));
+			break;
+		}
+		memcpy(&samples[i], x, end * sizeof(int16_t));
+		memmove(y, &x[(int)end - LPC_ORDER], LPC_ORDER * sizeof(int16_t));
+	}
+	return 0;
+}
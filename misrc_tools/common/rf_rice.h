@@ -0,0 +1,61 @@
+/*
+* MISRC tools
+* Copyright (C) 2025  vrunk11, stefan_o
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RF_RICE_H
+#define RF_RICE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Lossless codec for 16 bit RF, used by the rice codec of the RF container.
+ * The samples are coded in blocks of RF_RICE_BLOCK samples, every block
+ * chooses the sample itself, the first or the second difference or the error
+ * of an order 8 linear predictor fitted to the block as residual, the latter
+ * removes most of a carrier. The zigzag coded residuals are coded either with
+ * a Rice code or packed with a fixed number of bits, whichever is smaller. The
+ * predictors start from zero at the beginning of a buffer, so every buffer (a
+ * container chunk) can be decoded on its own. The residuals, the sums for the
+ * choice and the autocorrelation for the linear predictor are computed with
+ * AVX2 or NEON where available.
+ *
+ * block: predictor (2 bits: order 0 to 2 or 3 for linear prediction), packed
+ *        (1 bit), parameter (5 bits: Rice parameter or bits per residual),
+ *        linear prediction only: coefficients of x[i-1] to x[i-8] (13 bits
+ *        each) in units of 2^-9, the prediction is rounded and limited to
+ *        16 bits, residuals
+ * Rice:  quotient in unary (zeros terminated by a one), parameter bits of the
+ *        remainder, a quotient of RF_RICE_ESCAPE or more is written as
+ *        RF_RICE_ESCAPE zeros followed by the residual in RF_RICE_BITS bits
+ * The bits are written big endian, the end is padded to a byte. */
+
+#define RF_RICE_BLOCK   1024
+#define RF_RICE_ESCAPE  24
+// largest zigzag coded residual of 16 bit samples
+#define RF_RICE_BITS    18
+
+// room the encoder needs for a block in the worst case
+#define RF_RICE_BLOCK_MAX (RF_RICE_BLOCK * (RF_RICE_ESCAPE + RF_RICE_BITS) / 8 + 22)
+
+/* encode n samples into out, returns the length or 0 if it does not fit into cap bytes.
+ * A block is only encoded if RF_RICE_BLOCK_MAX bytes are left, so cap has to be
+ * at least RF_RICE_BLOCK_MAX for any n > 0, nothing is written past cap */
+size_t rf_rice_encode(const int16_t *samples, size_t n, uint8_t *out, size_t cap);
+/* decode n samples from len bytes, returns 0 on success and -1 if the data is invalid */
+int rf_rice_decode(const uint8_t *in, size_t len, int16_t *samples, size_t n);
+
+#endif // RF_RICE_H
@@ -167,5 +167,6 @@ void rb_close(ringbuffer_t *rb) {
 #else
 	munmap(rb->buffer, rb->buffer_size);
 	munmap(rb->buffer+rb->buffer_size, rb->buffer_size);
+	close(rb->fd);
 #endif
 }
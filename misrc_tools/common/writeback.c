@@ -0,0 +1,71 @@
+/*
+* MISRC tools
+* Copyright (C) 2025  vrunk11, stefan_o
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if defined(__linux__)
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+#include <string.h>
+#include "writeback.h"
+
+int wb_init(writeback_t *wb, FILE *f, uint64_t chunk)
+{
+	memset(wb, 0, sizeof(*wb));
+	wb->f = f;
+	wb->fd = -1;
+#if defined(__linux__)
+	struct stat st;
+	off_t pos;
+	if (chunk == 0 || fstat(fileno(f), &st) != 0 || !S_ISREG(st.st_mode)) return -1;
+	fflush(f);
+	if ((pos = lseek(fileno(f), 0, SEEK_CUR)) < 0) return -1;
+	wb->fd = fileno(f);
+	wb->chunk = chunk;
+	wb->pos = pos;
+	wb->start = pos;
+	return 0;
+#else
+	(void)chunk;
+	return -1;
+#endif
+}
+
+void wb_position(writeback_t *wb, uint64_t pos)
+{
+#if defined(__linux__)
+	if (wb->fd < 0) return;
+	wb->pos = pos;
+	if (pos < wb->start + wb->chunk) return;
+	// stdio may still hold the end of the chunk
+	fflush(wb->f);
+	while(pos >= wb->start + wb->chunk) {
+		// start writeback of the new chunk, then wait for the previous one which should be done by now
+		sync_file_range(wb->fd, wb->start, wb->chunk, SYNC_FILE_RANGE_WRITE);
+		if (wb->start >= wb->chunk) {
+			sync_file_range(wb->fd, wb->start - wb->chunk, wb->chunk, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+			posix_fadvise(wb->fd, wb->start - wb->chunk, wb->chunk, POSIX_FADV_DONTNEED);
+		}
+		wb->start += wb->chunk;
+	}
+#else
+	(void)wb;
+	(void)pos;
+#endif
+}
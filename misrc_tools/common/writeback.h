@@ -0,0 +1,52 @@
+/*
+* MISRC tools
+* Copyright (C) 2025  vrunk11, stefan_o
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WRITEBACK_H
+#define WRITEBACK_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Streaming writes to regular files without filling the page cache. After
+ * every chunk the writeback of that chunk is started with sync_file_range(),
+ * then the chunk before it is waited for and dropped from the cache with
+ * posix_fadvise(POSIX_FADV_DONTNEED). At most two chunks per file are dirty
+ * or cached this way, the data is not forced to disk synchronously.
+ * Only available on Linux, elsewhere the files are written as before. */
+
+typedef struct {
+	FILE *f;
+	int fd;          // -1 if not used
+	uint64_t chunk;
+	uint64_t pos;    // file offset behind the last write
+	uint64_t start;  // start of the chunk that is currently written
+} writeback_t;
+
+/* use streaming writeback for f every chunk bytes, returns 0 if it is used
+ * (f is a regular file and chunk > 0) */
+int wb_init(writeback_t *wb, FILE *f, uint64_t chunk);
+/* the file was written up to offset pos */
+void wb_position(writeback_t *wb, uint64_t pos);
+/* len bytes were written behind the last position */
+static inline void wb_written(writeback_t *wb, uint64_t len)
+{
+	if (wb->fd >= 0) wb_position(wb, wb->pos + len);
+}
+
+#endif // WRITEBACK_H
@@ -226,6 +226,11 @@ static void sighandler(int UNUSED(signum))
 	fprintf(stderr, "Signal caught, exiting!\n");
 	misrc_stop_capture();
 }
+
+static void cut_sighandler(int UNUSED(signum))
+{
+	misrc_cut_capture();
+}
 #endif
 
 static bool ask_overwrite(void UNUSED(*ctx), char *filename)
@@ -344,6 +349,10 @@ int main(int argc, char **argv)
 	sigaction(SIGTERM, &sigact, NULL);
 	sigaction(SIGQUIT, &sigact, NULL);
 	sigaction(SIGPIPE, &sigact, NULL);
+	// the capture continues, so blocked writes of the output threads have to resume
+	sigact.sa_handler = cut_sighandler;
+	sigact.sa_flags = SA_RESTART;
+	sigaction(SIGUSR1, &sigact, NULL);
 #else
 	SetConsoleCtrlHandler( (PHANDLER_ROUTINE) sighandler, true );
 #endif
@@ -16,6 +16,16 @@
 * along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#if defined(__linux__)
+#define _GNU_SOURCE
+#include <sched.h>
+#include <pthread.h>
+#include <sys/sysmacros.h>
+#elif defined(__APPLE__) || defined(__MACH__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__) || defined(__DragonFly__)
+#include <sys/types.h>
+#include <sys/sysctl.h>
+#endif
+
 #include <errno.h>
 #include <string.h>
 #include <stdio.h>
@@ -23,12 +33,27 @@
 #include <math.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdarg.h>
 #include <inttypes.h>
+#include <limits.h>
+#include <stdatomic.h>
+#if __STDC_VERSION__ >= 201112L && ! __STDC_NO_THREADS__ && ! _WIN32
+#include <threads.h>
+#else
+#include "cthreads.h"
+#warning "No C threads, fallback to pthreads/winthreads"
+#endif
+#include <time.h>
 
 #ifndef _WIN32
 	#include <getopt.h>
+	#include <unistd.h>
+	#include <fcntl.h>
+	#include <sys/stat.h>
+	#include <sys/mman.h>
+	#include <glob.h>
 	#define aligned_free(x) free(x)
-	#define PERF_MEASURE 0
+	#define DIRECT_ALIGN 4096
 #else
 	#include <windows.h>
 	#include <io.h>
@@ -40,283 +65,2540 @@
 	#endif
 	#define aligned_free(x) _aligned_free(x)
 	#define aligned_alloc(a,s) _aligned_malloc(s,a)
-	#define PERF_MEASURE 0
-#endif
-
-
-#if PERF_MEASURE
-#include <time.h>
+	#define fseeko _fseeki64
+	#define flockfile _lock_file
+	#define funlockfile _unlock_file
 #endif
 
 #include "../version.h"
 #include "extract.h"
+#include "ringbuffer.h"
+#include "numcores.h"
+#include "md5.h"
+#include "flac_stitch.h"
+#include "parse_time.h"
+#include "pipe_writer.h"
+#include "rf_container.h"
+#include "rf_decimate.h"
+
+#if LIBFLAC_ENABLED == 1
+#include "FLAC/stream_decoder.h"
+#endif
+#if LIBSOXR_ENABLED == 1
+#include <soxr.h>
+#endif
 
 #define BUFFER_SIZE 65536*32
 
+#define FORMAT_RAW32 0
+#define FORMAT_RAW16 1
+#define FORMAT_S12P  2
+#define FORMAT_S8    3
+#define FORMAT_F32   4
+#define FORMAT_F32R  5
+#define FORMAT_S16   6
+#define FORMAT_FLAC  7
+#define FORMAT_MRC   8
+
+#define FLAC_SAMPLE_RATE 40000
+// room for the frame headers in a block of FLAC output
+#define FLAC_SLOT_MARGIN (256*1024)
+
+#define INPUT_AUTO   0
+#define INPUT_READ   1
+#define INPUT_MMAP   2
+#define INPUT_DIRECT 3
+
+#define DIRECT_READERS 4
+
+#define OUT_A   0
+#define OUT_B   1
+#define OUT_AUX 2
+#define OUT_CNT 3
+
+#define OPT_START    1000
+#define OPT_COUNT    1001
+#define OPT_NO_MD5   1002
+#define OPT_MANIFEST 1003
+#define OPT_STATS    1004
+#define OPT_STATS_JSON 1005
+#define OPT_IO_URING 1006
+#define OPT_DIRECT_WRITE 1007
+#define OPT_VERIFY   1008
+#define OPT_BENCHMARK 1009
+#define OPT_PIPE_ZEROCOPY 1010
+#define OPT_8BIT_ROUNDING 1011
+#define OPT_JOBS_PER_DISK 1012
+
+#define MAX_THREADS 64
+#define MAX_SLOTS   24
+
 #define _FILE_OFFSET_BITS 64
 
+/* The input is read into a buffer divided into slots of one block each,
+ * every output has a ringbuffer with the same number of slots.
+ * Block k always uses slot k%slots, so the workers can convert disjoint blocks
+ * in parallel, the main thread releases them to the writers in order.
+ * A memory mapped input is converted in place, the slot is only used for the
+ * last block. A sample range (--start/--count) is read by seeking to its byte
+ * offset, nothing beyond its end is read.
+ * FLAC and MISRC container input have no reader, every worker seeks to its
+ * block with its own decoder. With --verify the decoded blocks are not written, the main thread
+ * computes the MD5 signature in order and every worker checks the seekpoints
+ * of its block.
+ * With -D the DC offset removed from block k is the mean of block k-1: every
+ * worker converts its block without offset, publishes the sums of its samples
+ * and then subtracts the mean of the previous block, so only the subtraction
+ * waits for the previous block. */
+
+typedef struct {
+	uint8_t *in;        // set by the reader
+	size_t samples;     // set by the reader
+	atomic_size_t seq;  // k+1 once block k is read
+	size_t clip[2];     // set by the worker
+	atomic_int done;    // set by the worker, cleared by the main thread
+} block_t;
+
+// sums of the samples of a block for the DC removal of the next block
+typedef struct {
+	int64_t sum[2];
+	size_t samples;
+	atomic_size_t seq;  // k+1 once the sums of block k are set
+} dc_sum_t;
+
+#define STAGE_READ  0
+#define STAGE_CONV  1
+#define STAGE_WRITE 2
+#define STAGE_CNT   3
+
+// times in ns, the wall time is the sum of all threads of the stage
+typedef struct {
+	atomic_uint_least64_t wall;
+	atomic_uint_least64_t cpu;
+	atomic_uint_least64_t bytes;
+} stage_stats_t;
+
+struct pipeline;
+
+typedef struct {
+	struct pipeline *p;
+	FILE *f;
+	ringbuffer_t rb;
+	pipe_writer_t pw;
+	uint64_t expected;     // bytes of the output if known, for preallocation
+	size_t slot_size;
+	size_t *len;           // bytes to write of each slot
+	atomic_size_t written; // number of slots that can be reused
+	thrd_t thread;
+	int idx;
+	// FLAC: the samples of each slot for the MD5 signature and the encoded segments
+	int16_t *smp;
+	flac_segment_t *seg;
+	flac_stream_t stream;
+	md5_ctx_t md5;
+} output_t;
+
+typedef struct pipeline {
+	FILE *in;
+	int in_fd;
+	int in_mode;
+	uint8_t *in_map;
+	size_t in_size;
+	uint64_t in_offset;  // start of the range in bytes
+	uint64_t in_limit;   // length of the range in bytes, UINT64_MAX for all
+	uint64_t in_skip;    // bytes to discard from an input that cannot seek
+	uint64_t in_count;   // samples of the range, packed 12 bit input reads whole pairs of samples
+	ringbuffer_t rb_in;
+	size_t in_slot_size;
+	size_t slots;
+	block_t *blocks;
+	output_t out[OUT_CNT];
+	int in_format;
+	int out_format;
+	bool single;
+	conv_function_t conv_function;
+	conv_12pto16_t conv_12pto16;
+	conv_float_function_t conv_float;
+	extract_float_state_t float_state;
+	dc_sum_t *dc;          // 2*slots entries, k uses k%(2*slots): block k+1 is committed before k+2*slots is converted
+	uint32_t flac_level;
+	uint32_t flac_bits;
+	char *flac_in_name;
+	char *mrc_in_name;
+	rfc_stream_t mrc;      // header and chunk index of the container input
+	uint64_t flac_total;   // samples of the FLAC input, 0 if unknown
+	bool flac_check_md5;
+	uint8_t flac_md5[16];
+	// --verify
+	bool verify;
+	int16_t *verify_smp;             // decoded samples of each slot
+	md5_ctx_t verify_md5;
+	flac_seekpoint_t *seek;          // seektable of the input, without placeholders
+	size_t seek_cnt;
+	uint64_t frames_offset;          // file offset of the first frame
+	uint32_t flac_blocksize;         // of streams with fixed block size
+	uint32_t flac_bps;               // of the FLAC input, the MD5 signature covers bps/8 bytes per sample
+	atomic_size_t seek_checked;
+	atomic_size_t seek_errors;
+	atomic_size_t blocks_total;      // SIZE_MAX until the end of the input is found
+	atomic_size_t direct_next;
+	atomic_size_t next_block;
+	atomic_size_t blocks_committed;
+	atomic_bool commit_finished;
+	atomic_bool error;
+	uint64_t samples_done;           // samples committed to the writers
+	bool io_uring;
+	bool direct_write;
+	bool pipe_zerocopy;
+	bool stats;
+	stage_stats_t stage[STAGE_CNT];
+	uint64_t in_total;               // bytes of the input range, 0 if unknown
+	uint64_t start_time;
+	uint64_t progress_time;
+} pipeline_t;
+
+#define pipeline_wait() thrd_sleep(&(struct timespec){.tv_nsec=1000000}, NULL)
+
+static uint64_t time_ns(clockid_t clock)
+{
+	struct timespec t;
+	clock_gettime(clock, &t);
+	return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+// add the CPU time of the calling thread to a stage
+static void stage_cpu_done(pipeline_t *p, int stage)
+{
+	if (p->stats) p->stage[stage].cpu += time_ns(CLOCK_THREAD_CPUTIME_ID);
+}
+
 void usage(void)
 {
 	fprintf(stderr,
 		"A simple program for extracting captured data into separate files\n\n"
 		"Usage:\n"
 		"\t[-i input file (use '-' to read from stdin)]\n"
+		"\t[files... or --manifest (file with one input per line): batch mode, the output names are patterns\n"
+		"\t    with %%n (input name without extension), %%f (input name) and %%d (input directory)]\n"
+		"\t[-j number of files extracted at the same time in batch mode (default: 2)]\n"
+		"\t[--jobs-per-disk number of those files that read or write the same hard disk (default: 1, 0 = no limit, Linux)]\n"
 		"\t[-a ADC A output file (use '-' to write on stdout)]\n"
 		"\t[-b ADC B output file (use '-' to write on stdout)]\n"
 		"\t[-x AUX output file (use '-' to write on stdout)]\n"
 		"\t[-p pad lower 4 bits of 16 bit output with 0 instead of upper 4]\n"
 		"\t[-s input is captured as single channel (-b cannot be used)]\n"
+		"\t[-I input format: raw32 (default), raw16 (same as -s), s12p (packed 12 bit RF, unpacked to -a)\n"
+		"\t    or s16 (16 bit RF, encoded to FLAC on -a)"
+#if LIBFLAC_ENABLED == 1
+		"\n\t    or flac (decoded to 16 bit on -a, blocks are decoded in parallel)"
+#endif
+		"\n\t    or mrc (MISRC container, decoded to 16 bit on -a, chunks are decoded in parallel and checked)"
+		"]\n"
+		"\t[-F output format of -a/-b: s16 (default), s12p (two 12 bit samples packed in 3 bytes), s8 (reduced to 8 bit),\n"
+		"\t    f32 (float normalized to +-1.0), f32raw (float in ADC counts)"
+#if LIBFLAC_ENABLED == 1
+		" or flac (segments encoded in parallel)"
+#endif
+		"]\n"
+		"\t[--8bit-rounding rounding of s8 output: truncate, round (default) or dither]\n"
+#if LIBFLAC_ENABLED == 1
+		"\t[-l FLAC compression level (default: 1)]\n"
+		"\t[--no-md5 do not check the MD5 signature of decoded FLAC input]\n"
+		"\t[--verify only decode FLAC input to check the MD5 signature and the seektable, no output]\n"
+#endif
+		"\t[-D remove DC offset from float output]\n"
+		"\t[-t number of conversion threads (default: 0 = number of cores - 2)]\n"
+		"\t[-m input mode: auto (default), read, mmap or direct (O_DIRECT with several reads in flight)]\n"
+		"\t[--start first sample to extract, in samples or as time (s, m:s or h:m:s) at 40 MSPS]\n"
+		"\t[--count number of samples to extract, in samples or as time]\n"
+		"\t[--benchmark compare the compression and speed of FLAC levels 0-8 and the container codecs on the input\n"
+		"\t    and the resampling of misrc_capture (-I s16, flac or mrc, --start and --count select the samples,\n"
+		"\t    default: 2^26), no output]\n"
+		"\t[--stats print progress and the time and throughput of each stage]\n"
+		"\t[--stats-json append the statistics of each file as one JSON line to this file]\n"
+		"\t[--direct-write write output files with direct I/O (O_DIRECT), preallocated if the size is known]\n"
+#if LIBURING_ENABLED == 1
+		"\t[--io-uring write output files with io_uring, several writes in flight]\n"
+#endif
+		"\t[--pipe-zerocopy write pipes with vmsplice() instead of copying, only if the reader copies the data\n"
+		"\t    with read(): a reader that splice()s it on (e.g. to a file or socket) gets corrupted data]\n"
 	);
 	exit(1);
 }
 
+static size_t out_bytes(int format, size_t samples)
+{
+	switch (format) {
+	case FORMAT_S12P:
+		return (samples*3+1)/2;
+	case FORMAT_S8:
+		return samples;
+	case FORMAT_F32:
+	case FORMAT_F32R:
+		return samples*4;
+	default:
+		return samples*2;
+	}
+}
 
-int main(int argc, char **argv)
+static size_t in_samples(pipeline_t *p, size_t bytes)
 {
-//set pipe mode to binary in windows
-#if defined(_WIN32) || defined(_WIN64)
-	_setmode(_fileno(stdout), O_BINARY);
-	_setmode(_fileno(stdin), O_BINARY);
-#endif
+	if (p->in_format == FORMAT_S12P) return (bytes/3)*2;
+	if (p->in_format == FORMAT_S16 || p->in_format == FORMAT_FLAC || p->in_format == FORMAT_MRC) return bytes/2;
+	return bytes/(4>>p->single);
+}
 
-	int opt;
-	bool pad=false, single=false;
+static uint64_t in_bytes(pipeline_t *p, uint64_t samples)
+{
+	if (p->in_format == FORMAT_S12P) return (samples+1)/2*3;
+	if (p->in_format == FORMAT_S16 || p->in_format == FORMAT_FLAC || p->in_format == FORMAT_MRC) return samples*2;
+	return samples*(4>>p->single);
+}
 
+// bytes of block k within the range
+static size_t block_bytes(pipeline_t *p, size_t k)
+{
+	uint64_t off = (uint64_t)k * p->in_slot_size;
+	if (off >= p->in_limit) return 0;
+	return (p->in_limit - off < p->in_slot_size) ? p->in_limit - off : p->in_slot_size;
+}
 
-	//file adress
-	char *input_name_1    = NULL;
-	char *output_name_1   = NULL;
-	char *output_name_2   = NULL;
-	char *output_name_aux = NULL;
-	
-	//input file
-	FILE *input_1;
-	
-	//output files
-	FILE *output_1;
-	FILE *output_2;
-	FILE *output_aux;
-	
-	//buffer
-	uint32_t *buf_tmp = aligned_alloc(16,sizeof(uint32_t)*BUFFER_SIZE);
-	int16_t  *buf_1   = aligned_alloc(16,sizeof(int16_t) *BUFFER_SIZE);
-	int16_t  *buf_2   = aligned_alloc(16,sizeof(int16_t) *BUFFER_SIZE);
-	uint8_t  *buf_aux = aligned_alloc(16,sizeof(uint8_t) *BUFFER_SIZE);
-	
-	//number of byte read
-	int nb_block;
-	
-	//clipping state
-	size_t clip[2] = {0, 0};
-	
-	// conversion function
-	conv_function_t conv_function;
+// wait until the slot of block k is committed by the main thread
+static bool wait_slot(pipeline_t *p, size_t k)
+{
+	while(k >= p->blocks_committed + p->slots) {
+		if (p->error || k >= p->blocks_total) return false;
+		pipeline_wait();
+	}
+	return true;
+}
 
-#if PERF_MEASURE
-	struct timespec start, stop;
-	double timeread = 0.0, timeconv = 0.0, timewrite = 0.0;
-#endif
+static void block_read(pipeline_t *p, size_t k, uint8_t *in, size_t samples)
+{
+	block_t *blk = &p->blocks[k % p->slots];
+	blk->in = in;
+	blk->samples = samples;
+	blk->seq = k + 1;
+}
 
-	fprintf(stderr,
-		"MISRC extract " MIRSC_TOOLS_VERSION "\n"
-		MIRSC_TOOLS_COPYRIGHT "\n\n"
-	);
+static void set_total(pipeline_t *p, size_t k)
+{
+	size_t total = p->blocks_total;
+	while(k < total && !atomic_compare_exchange_weak(&p->blocks_total, &total, k));
+}
 
-	while ((opt = getopt(argc, argv, "i:a:b:x:psh")) != -1) {
-		switch (opt) {
-		case 'i':
-			input_name_1 = optarg;
-			break;
-		case 'a':
-			output_name_1 = optarg;
-			break;
-		case 'b':
-			output_name_2 = optarg;
-			break;
-		case 'x':
-			output_name_aux = optarg;
-			break;
-		case 'p':
-			pad = true;
-			break;
-		case 's':
-			single = true;
-			break;
-		case 'h':
-		default:
-			usage();
+static int reader_thread(void *ctx)
+{
+	pipeline_t *p = ctx;
+	uint8_t *buf;
+	size_t k, n, len;
+	uint64_t start = 0;
+#if defined(__linux__) && defined(_GNU_SOURCE)
+	pthread_setname_np(pthread_self(), "extract_read");
+#endif
+	// the input cannot seek to the start of the range, so the data before it is discarded
+	while(p->in_skip > 0) {
+		n = (p->in_skip < p->in_slot_size) ? p->in_skip : p->in_slot_size;
+		if (fread(p->rb_in.buffer, 1, n, p->in) != n) {
+			set_total(p, 0);
+			goto end;
+		}
+		p->in_skip -= n;
+	}
+	for(k = 0; wait_slot(p, k); k++) {
+		buf = &p->rb_in.buffer[(k % p->slots) * p->in_slot_size];
+		len = block_bytes(p, k);
+		if (len == 0) break;
+		if (p->stats) start = time_ns(CLOCK_MONOTONIC);
+		n = fread(buf, 1, len, p->in);
+		if (p->stats) {
+			p->stage[STAGE_READ].wall += time_ns(CLOCK_MONOTONIC) - start;
+			p->stage[STAGE_READ].bytes += n;
+		}
+		if (in_samples(p, n) == 0) break;
+		block_read(p, k, buf, in_samples(p, n));
+		if (n < p->in_slot_size) {
+			k++;
 			break;
 		}
 	}
-	
-	if((input_name_1 == NULL || (output_name_1 == NULL && output_name_2 == NULL && output_name_aux == NULL))
-		|| (single == 1 && output_name_2 != NULL))
-	{
-		usage();
+	set_total(p, k);
+end:
+	if (ferror(p->in)) {
+		fprintf(stderr, "Error reading input: %s\n", strerror(errno));
+		p->error = true;
 	}
-	
-	//reading file 1
-	if(input_name_1 != NULL)
-	{
-		if (strcmp(input_name_1, "-") == 0)// Read samples from stdin
-		{
-			input_1 = stdin;
+	stage_cpu_done(p, STAGE_READ);
+	return 0;
+}
+
+#ifndef _WIN32
+/* bytes the first block of a memory mapped range is shortened by, so that all
+ * following blocks start 16 byte aligned, 0 if the range is aligned or no
+ * shorter block keeps the output the same: the cut has to be whole samples,
+ * pairs of samples for packed 12 bit, and FLAC segments and the DC removal
+ * depend on the block boundaries */
+static size_t mmap_cut(pipeline_t *p, const uint8_t *data)
+{
+	size_t unit = (p->in_format == FORMAT_S12P) ? 3 : in_bytes(p, 1);
+	if (((uintptr_t)data & 15) == 0 || p->out_format == FORMAT_FLAC || p->dc) return 0;
+	for(size_t cut = (uintptr_t)data & 15; cut < 16 * unit; cut += 16) {
+		if (cut % unit == 0 && (p->out_format != FORMAT_S12P || in_samples(p, cut) % 2 == 0)) return cut;
+	}
+	return 0;
+}
+
+static int mmap_reader_thread(void *ctx)
+{
+	pipeline_t *p = ctx;
+	size_t total, off, n, size = 0, cut;
+	uint8_t *data = p->in_map + p->in_offset;
+	uintptr_t page = sysconf(_SC_PAGESIZE), lead;
+	uint64_t start = 0;
+#if defined(__linux__) && defined(_GNU_SOURCE)
+	pthread_setname_np(pthread_self(), "extract_read");
+#endif
+	if (p->in_offset < p->in_size) size = p->in_size - p->in_offset;
+	if (size > p->in_limit) size = p->in_limit;
+	// block k covers [k, k+1) slots of the range extended by cut bytes in front
+	cut = mmap_cut(p, data);
+	if (size <= p->in_slot_size - cut) cut = 0;
+	total = (size + cut) / p->in_slot_size;
+	if (in_samples(p, (size + cut) % p->in_slot_size) > 0) total++;
+	set_total(p, total);
+	for(size_t k = 0; k < total && wait_slot(p, k); k++) {
+		off = (k == 0) ? 0 : k * p->in_slot_size - cut;
+		n = size - off;
+		if (n > p->in_slot_size - ((k == 0) ? cut : 0)) n = p->in_slot_size - ((k == 0) ? cut : 0);
+		// the conversion functions may read a few bytes beyond the end of the block
+		// and need 16 byte aligned input, which a range may only have after the first block
+		if (p->stats) start = time_ns(CLOCK_MONOTONIC);
+		if (k == total - 1 || ((uintptr_t)&data[off] & 15) != 0) {
+			memcpy(&p->rb_in.buffer[(k % p->slots) * p->in_slot_size], &data[off], n);
+			block_read(p, k, &p->rb_in.buffer[(k % p->slots) * p->in_slot_size], in_samples(p, n));
 		}
-		else 
-		{
-			input_1 = fopen(input_name_1, "rb");
-			if (!input_1) {
-				fprintf(stderr, "(1) : Failed to open %s\n", input_name_1);
-				return -ENOENT;
-			}
+		else {
+			// start reading the block ahead of the workers, the page faults are counted as conversion time
+			lead = (uintptr_t)&data[off] & (page - 1);
+			madvise(&data[off] - lead, n + lead, MADV_WILLNEED);
+			block_read(p, k, &data[off], in_samples(p, n));
+		}
+		if (p->stats) {
+			p->stage[STAGE_READ].wall += time_ns(CLOCK_MONOTONIC) - start;
+			p->stage[STAGE_READ].bytes += n;
 		}
 	}
-	
-	if(output_name_1 != NULL)
-	{
-		//opening output file 1
-		if (strcmp(output_name_1, "-") == 0)// Read samples from stdin
-		{
-			output_1 = stdout;
+	stage_cpu_done(p, STAGE_READ);
+	return 0;
+}
+
+static int direct_reader_thread(void *ctx)
+{
+	pipeline_t *p = ctx;
+	uint8_t *buf;
+	ssize_t r;
+	size_t k, n, len, aligned;
+	uint64_t start = 0;
+#if defined(__linux__) && defined(_GNU_SOURCE)
+	pthread_setname_np(pthread_self(), "extract_read");
+#endif
+	for(;;) {
+		k = atomic_fetch_add(&p->direct_next, 1);
+		if (k >= p->blocks_total || !wait_slot(p, k)) break;
+		len = block_bytes(p, k);
+		if (len == 0) {
+			set_total(p, k);
+			break;
 		}
-		else
-		{
-			output_1 = fopen(output_name_1, "wb");
-			if (!output_1) {
-				fprintf(stderr, "(2) : Failed to open %s\n", output_name_1);
-				return -ENOENT;
+		// the length of direct reads has to be aligned, the slots are large enough
+		aligned = (len + DIRECT_ALIGN - 1) & ~(size_t)(DIRECT_ALIGN - 1);
+		buf = &p->rb_in.buffer[(k % p->slots) * p->in_slot_size];
+		if (p->stats) start = time_ns(CLOCK_MONOTONIC);
+		for(n = 0; n < aligned; n += r) {
+			r = pread(p->in_fd, buf + n, aligned - n, (off_t)(p->in_offset + (uint64_t)k * p->in_slot_size + n));
+			if (r < 0 && errno == EINTR) {
+				r = 0;
+				continue;
+			}
+			if (r < 0) {
+				fprintf(stderr, "Error reading input: %s\n", strerror(errno));
+				p->error = true;
+				goto end;
 			}
+			if (r == 0) break;
 		}
-	}
-	
-	if(output_name_2 != NULL)
-	{
-		//opening output file 2
-		if (strcmp(output_name_2, "-") == 0)// Read samples from stdin
-		{
-			output_2 = stdout;
+		if (n > len) n = len;
+		if (p->stats) {
+			p->stage[STAGE_READ].wall += time_ns(CLOCK_MONOTONIC) - start;
+			p->stage[STAGE_READ].bytes += n;
 		}
-		else if(output_name_2 != NULL)
-		{
-			output_2 = fopen(output_name_2, "wb");
-			if (!output_2) {
-				fprintf(stderr, "(2) : Failed to open %s\n", output_name_2);
-				return -ENOENT;
-			}
+		if (in_samples(p, n) == 0) {
+			set_total(p, k);
+			break;
+		}
+		block_read(p, k, buf, in_samples(p, n));
+		if (n < p->in_slot_size) {
+			set_total(p, k + 1);
+			break;
 		}
 	}
-	
-	if(output_name_aux != NULL)
-	{
-		//opening output file aux
-		if (strcmp(output_name_aux, "-") == 0)// Read samples from stdin
-		{
-			output_aux = stdout;
+end:
+	stage_cpu_done(p, STAGE_READ);
+	return 0;
+}
+
+static int open_input_fd(pipeline_t *p, char *name)
+{
+	struct stat st;
+	int flags = O_RDONLY;
+	if (p->in_mode == INPUT_AUTO) {
+		if (stat(name, &st) != 0) return -1;
+		if (S_ISREG(st.st_mode)) p->in_mode = INPUT_MMAP;
+		else if (S_ISBLK(st.st_mode)) p->in_mode = INPUT_DIRECT;
+		else {
+			p->in_mode = INPUT_READ;
+			return 0;
 		}
-		else if(output_name_aux != NULL)
-		{
-			output_aux = fopen(output_name_aux, "wb");
-			if (!output_aux) {
-				fprintf(stderr, "(2) : Failed to open %s\n", output_name_aux);
-				return -ENOENT;
-			}
+	}
+	if (p->in_mode == INPUT_DIRECT && p->in_offset % DIRECT_ALIGN != 0) {
+		fprintf(stderr, "Start of the range is not aligned for direct I/O, falling back to read\n");
+		p->in_mode = INPUT_READ;
+		return 0;
+	}
+#ifdef O_DIRECT
+	if (p->in_mode == INPUT_DIRECT) flags |= O_DIRECT;
+#endif
+	p->in_fd = open(name, flags);
+	if (p->in_fd < 0 && p->in_mode == INPUT_DIRECT && errno == EINVAL) {
+		fprintf(stderr, "Direct I/O is not supported for %s, falling back to read\n", name);
+		p->in_mode = INPUT_READ;
+		return 0;
+	}
+	if (p->in_fd < 0) return -1;
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+	if (p->in_mode == INPUT_DIRECT) fcntl(p->in_fd, F_NOCACHE, 1);
+#endif
+	if (p->in_mode == INPUT_MMAP) {
+		if (fstat(p->in_fd, &st) != 0) return -1;
+		p->in_size = st.st_size;
+		if (p->in_size == 0) return 0;
+		p->in_map = mmap(NULL, p->in_size, PROT_READ, MAP_SHARED, p->in_fd, 0);
+		if (p->in_map == MAP_FAILED) {
+			fprintf(stderr, "Failed to map %s, falling back to read\n", name);
+			p->in_map = NULL;
+			close(p->in_fd);
+			p->in_fd = -1;
+			p->in_mode = INPUT_READ;
+			return 0;
 		}
+		madvise(p->in_map, p->in_size, MADV_SEQUENTIAL);
 	}
+	return 0;
+}
+#endif
 
-	conv_function = get_conv_function(single, pad, false, false, output_name_1, output_name_2);
+#if LIBFLAC_ENABLED == 1
+typedef struct {
+	int16_t *buf;
+	size_t want;
+	size_t got;
+	bool error;
+	bool has_info;
+	FLAC__StreamMetadata_StreamInfo info;
+} flac_decode_t;
 
-	if(input_name_1 != NULL && (output_name_1 != NULL || output_name_2 != NULL || output_name_aux != NULL))
-	{
-		while(!feof(input_1))
-		{
-#if PERF_MEASURE
-			clock_gettime(CLOCK_MONOTONIC, &start);
-#endif
+static FLAC__StreamDecoderWriteStatus flac_decode_write(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 *const buffer[], void *client_data)
+{
+	(void)decoder;
+	flac_decode_t *d = client_data;
+	size_t n = frame->header.blocksize;
+	if (!d->buf) return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+	// the last frame may reach into the next block
+	if (n > d->want - d->got) n = d->want - d->got;
+	for(size_t i = 0; i < n; i++) d->buf[d->got + i] = buffer[0][i];
+	d->got += n;
+	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
 
-			nb_block = fread(buf_tmp,4>>single,BUFFER_SIZE,input_1);
+static void flac_decode_metadata(const FLAC__StreamDecoder *decoder, const FLAC__StreamMetadata *metadata, void *client_data)
+{
+	(void)decoder;
+	flac_decode_t *d = client_data;
+	if (metadata->type == FLAC__METADATA_TYPE_STREAMINFO) {
+		d->info = metadata->data.stream_info;
+		d->has_info = true;
+	}
+}
 
-#if PERF_MEASURE
-			clock_gettime(CLOCK_MONOTONIC, &stop);
-			timeread += (stop.tv_sec - start.tv_sec) * 1e6 + (stop.tv_nsec - start.tv_nsec) / 1e3;
-			clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
-#endif
+static void flac_decode_error(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data)
+{
+	(void)decoder;
+	flac_decode_t *d = client_data;
+	fprintf(stderr, "FLAC decoder error: %s\n", FLAC__StreamDecoderErrorStatusString[status]);
+	d->error = true;
+}
 
-			conv_function(buf_tmp, nb_block, clip, buf_aux, buf_1, buf_2, NULL);
+// decode block k into buf, returns the number of samples, 0 at the end of the stream or -1 on error
+static int64_t flac_decode_block(pipeline_t *p, FLAC__StreamDecoder *decoder, flac_decode_t *d, size_t k, int16_t *buf, size_t samples)
+{
+	uint64_t first = in_samples(p, p->in_offset) + (uint64_t)k * BUFFER_SIZE;
+	d->buf = buf;
+	d->want = samples;
+	d->got = 0;
+	d->error = false;
+	// the seektable has a point at every multiple of FLAC_STITCH_SEEKSPACING samples
+	if (!FLAC__stream_decoder_seek_absolute(decoder, first)) {
+		// seeking beyond the end of a stream of unknown length
+		if (p->flac_total == 0 && FLAC__stream_decoder_get_state(decoder) == FLAC__STREAM_DECODER_SEEK_ERROR && FLAC__stream_decoder_flush(decoder)) return 0;
+		return -1;
+	}
+	while(d->got < d->want && !d->error) {
+		if (FLAC__stream_decoder_get_state(decoder) == FLAC__STREAM_DECODER_END_OF_STREAM) break;
+		if (!FLAC__stream_decoder_process_single(decoder)) return -1;
+	}
+	return d->error ? -1 : (int64_t)d->got;
+}
 
-#if PERF_MEASURE
-			clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stop);
-			timeconv += (stop.tv_sec - start.tv_sec) * 1e6 + (stop.tv_nsec - start.tv_nsec) / 1e3;
-#endif
+// read STREAMINFO of the input
+static int flac_probe(pipeline_t *p, FLAC__StreamMetadata_StreamInfo *info)
+{
+	flac_decode_t d;
+	FLAC__StreamDecoder *decoder = FLAC__stream_decoder_new();
+	int ret = -1;
+	memset(&d, 0, sizeof(d));
+	if (!decoder) return -1;
+	if (FLAC__stream_decoder_init_file(decoder, p->flac_in_name, flac_decode_write, flac_decode_metadata, flac_decode_error, &d) == FLAC__STREAM_DECODER_INIT_STATUS_OK
+		&& FLAC__stream_decoder_process_until_end_of_metadata(decoder) && d.has_info) {
+		*info = d.info;
+		ret = 0;
+	}
+	FLAC__stream_decoder_delete(decoder);
+	return ret;
+}
 
-			if(clip[0] > 0)
-			{
-				fprintf(stderr,"ADC A : %zu samples clipped\n",clip[0]);
-				clip[0] = 0; 
+static uint64_t read_be(const uint8_t *b, int bytes)
+{
+	uint64_t v = 0;
+	for(int i = 0; i < bytes; i++) v = (v << 8) | b[i];
+	return v;
+}
+
+// read the seektable and find the first frame, the other metadata blocks are skipped
+static int flac_read_seektable(pipeline_t *p)
+{
+	uint8_t hdr[4], point[18];
+	uint64_t offset = 4;
+	size_t len;
+	bool last = false;
+	FILE *f = fopen(p->flac_in_name, "rb");
+	if (!f) return -1;
+	if (fread(hdr, 1, 4, f) != 4 || memcmp(hdr, "fLaC", 4) != 0) goto err;
+	while(!last) {
+		if (fread(hdr, 1, 4, f) != 4) goto err;
+		last = hdr[0] & 0x80;
+		len = read_be(&hdr[1], 3);
+		offset += 4 + len;
+		if ((hdr[0] & 0x7F) == 3 && !p->seek) {
+			if ((p->seek = malloc((len / 18 + 1) * sizeof(flac_seekpoint_t))) == NULL) goto err;
+			for(size_t i = 0; i < len / 18; i++) {
+				if (fread(point, 1, 18, f) != 18) goto err;
+				// placeholders are at the end
+				if (read_be(point, 8) == SEEKPOINT_PLACEHOLDER) continue;
+				p->seek[p->seek_cnt++] = (flac_seekpoint_t){ read_be(point, 8), read_be(&point[8], 8), read_be(&point[16], 2) };
 			}
-			
-			if(clip[1] > 0)
-			{
-				fprintf(stderr,"ADC B : %zu samples clipped\n",clip[1]);
-				clip[1] = 0; 
+		}
+		if (fseeko(f, offset, SEEK_SET) != 0) goto err;
+	}
+	p->frames_offset = offset;
+	fclose(f);
+	return 0;
+err:
+	fclose(f);
+	return -1;
+}
+
+// the seekpoints have to be ordered by sample and position
+static size_t flac_check_seek_order(pipeline_t *p)
+{
+	size_t errors = 0;
+	for(size_t i = 1; i < p->seek_cnt; i++) {
+		if (p->seek[i].sample_number > p->seek[i-1].sample_number && p->seek[i].stream_offset > p->seek[i-1].stream_offset) continue;
+		fprintf(stderr, "Seekpoint %zu (sample %" PRIu64 ", offset %" PRIu64 ") is not behind the previous one\n", i, p->seek[i].sample_number, p->seek[i].stream_offset);
+		errors++;
+	}
+	return errors;
+}
+
+// check that every seekpoint in the samples of block k points to the frame starting at its sample
+static void flac_check_seekpoints(pipeline_t *p, FILE *f, size_t k, size_t samples)
+{
+	uint64_t first = (uint64_t)k * BUFFER_SIZE, number, sample;
+	uint32_t blocksize;
+	bool variable;
+	uint8_t hdr[16];
+	size_t lo = 0, hi = p->seek_cnt, n;
+	flac_seekpoint_t *pt;
+	// first seekpoint of the block
+	while(lo < hi) {
+		if (p->seek[(lo + hi) / 2].sample_number < first) lo = (lo + hi) / 2 + 1;
+		else hi = (lo + hi) / 2;
+	}
+	for(; lo < p->seek_cnt && p->seek[lo].sample_number < first + samples; lo++) {
+		pt = &p->seek[lo];
+		n = (fseeko(f, p->frames_offset + pt->stream_offset, SEEK_SET) == 0) ? fread(hdr, 1, sizeof(hdr), f) : 0;
+		if (n == 0 || flac_frame_header_read(hdr, n, &number, &blocksize, &variable) != 0) {
+			fprintf(stderr, "Seekpoint %zu (sample %" PRIu64 ") does not point to a frame\n", lo, pt->sample_number);
+			p->seek_errors++;
+		}
+		else {
+			sample = (variable) ? number : number * p->flac_blocksize;
+			if (sample != pt->sample_number || blocksize != pt->frame_samples) {
+				fprintf(stderr, "Seekpoint %zu (sample %" PRIu64 ", %" PRIu32 " samples) points to the frame at sample %" PRIu64 " with %" PRIu32 " samples\n",
+					lo, pt->sample_number, pt->frame_samples, sample, blocksize);
+				p->seek_errors++;
 			}
-#if PERF_MEASURE
-			clock_gettime(CLOCK_MONOTONIC, &start);
-#endif
-			//write output
-			if(output_name_1   != NULL){fwrite(buf_1, 2,nb_block,output_1);}
-			if(output_name_2   != NULL){fwrite(buf_2, 2,nb_block,output_2);}
-			if(output_name_aux != NULL){fwrite(buf_aux,1,nb_block,output_aux);}
+		}
+		p->seek_checked++;
+	}
+}
 
-#if PERF_MEASURE
-			clock_gettime(CLOCK_MONOTONIC, &stop);
-			timewrite += (stop.tv_sec - start.tv_sec) * 1e6 + (stop.tv_nsec - start.tv_nsec) / 1e3;
 #endif
+
+// there is nothing to read for FLAC and container input, the blocks are only handed out to the workers
+static int decode_reader_thread(void *ctx)
+{
+	pipeline_t *p = ctx;
+	size_t k, len;
+	for(k = 0; wait_slot(p, k); k++) {
+		len = block_bytes(p, k);
+		if (len == 0) break;
+		block_read(p, k, NULL, in_samples(p, len));
+	}
+	set_total(p, k);
+	return 0;
+}
+
+// decode block k from the chunks of the container into buf, returns the number of samples or -1 on error
+static int64_t mrc_decode_block(pipeline_t *p, rfc_decoder_t *dec, FILE *f, int16_t *chunk, size_t k, int16_t *buf, size_t samples)
+{
+	uint64_t first = in_samples(p, p->in_offset) + (uint64_t)k * BUFFER_SIZE;
+	size_t got = 0, skip, n;
+	const rfc_chunk_t *c;
+	int r;
+	for(size_t i = rfc_find_chunk(&p->mrc, first); i < p->mrc.chunks && got < samples; i++) {
+		c = &p->mrc.index[i];
+		if (c->first_sample > first + got) {
+			fprintf(stderr, "Container input has no samples from %" PRIu64 " to %" PRIu64 "\n", first + got, c->first_sample);
+			return -1;
 		}
+		skip = first + got - c->first_sample;
+		n = c->samples - skip;
+		if (n > samples - got) n = samples - got;
+		// whole chunks are decoded in place
+		if (n == c->samples) r = rfc_decode_chunk(dec, &p->mrc, f, i, &buf[got]);
+		else if ((r = rfc_decode_chunk(dec, &p->mrc, f, i, chunk)) == 0) memcpy(&buf[got], &chunk[skip], n * sizeof(int16_t));
+		if (r != 0) {
+			fprintf(stderr, "Chunk %zu (sample %" PRIu64 ") of the container input: %s\n", i, c->first_sample, rfc_strerror(r));
+			return -1;
+		}
+		got += n;
 	}
+	return got;
+}
 
-////ending of the program
-	
-	aligned_free(buf_1);
-	aligned_free(buf_2);
-	aligned_free(buf_aux);
-	
-	//Close file 1
-	if(input_name_1 != NULL)
-	{
-		if (input_1 && (input_1 != stdin))
-		{
-			fclose(input_1);
+// publish the sums of block k and subtract the mean of block k-1 from its float output
+static int remove_dc(pipeline_t *p, size_t k, const extract_float_state_t *state, float *outA, float *outB, size_t samples)
+{
+	dc_sum_t *d = &p->dc[k % (2 * p->slots)];
+	float dc[2];
+	d->sum[0] = state->sum[0];
+	d->sum[1] = state->sum[1];
+	d->samples = samples;
+	d->seq = k + 1;
+	if (k == 0) return 0;
+	// the worker of block k-1 has started before and only waits for the blocks before it
+	d = &p->dc[(k - 1) % (2 * p->slots)];
+	while(d->seq != k) {
+		if (p->error) return -1;
+		pipeline_wait();
+	}
+	if (d->samples == 0) return 0;
+	// the same offset as extract_float_update_dc(), the scale is a power of two,
+	// so the result is the same as converting with the offset
+	for(int j = 0; j < 2; j++) dc[j] = (float)((double)d->sum[j] / (double)d->samples) * state->scale;
+	if (outA) for(size_t i = 0; i < samples; i++) outA[i] -= dc[0];
+	if (outB) for(size_t i = 0; i < samples; i++) outB[i] -= dc[1];
+	return 0;
+}
+
+static int worker_thread(void *ctx)
+{
+	pipeline_t *p = ctx;
+	size_t k, slot, samples;
+	uint8_t *in;
+	void *out[OUT_CNT];
+	// the aux output is always written by the conversion functions
+	uint8_t *aux_scratch = aligned_alloc(16, BUFFER_SIZE);
+	extract_float_state_t float_state = p->float_state;
+#if LIBFLAC_ENABLED == 1
+	FLAC__StreamEncoder *encoder[2] = { NULL, NULL };
+	int32_t *buf32 = NULL;
+	int16_t *smp[2];
+	flac_segment_t *seg;
+	FLAC__StreamDecoder *decoder = NULL;
+	flac_decode_t dec;
+	int64_t decoded;
+	FILE *verify_f = NULL;
+#endif
+	rfc_decoder_t mrc_dec;
+	FILE *mrc_f = NULL;
+	int16_t *mrc_chunk = NULL, *mrc_out;
+	int64_t mrc_decoded;
+	uint64_t start = 0;
+#if defined(__linux__) && defined(_GNU_SOURCE)
+	pthread_setname_np(pthread_self(), "extract_conv");
+#endif
+	if (!aux_scratch) {
+		fprintf(stderr, "Failed to allocate buffer\n");
+		p->error = true;
+		return 0;
+	}
+	memset(&mrc_dec, 0, sizeof(mrc_dec));
+	if (p->in_format == FORMAT_MRC) {
+		mrc_chunk = malloc(RFC_CHUNK_SAMPLES * sizeof(int16_t));
+		if (!mrc_chunk || rfc_decoder_init(&mrc_dec) != 0 || (mrc_f = fopen(p->mrc_in_name, "rb")) == NULL) {
+			fprintf(stderr, "Failed initializing container decoder\n");
+			p->error = true;
+			goto end;
 		}
 	}
-	
-	if(output_name_1 != NULL)
-	{
-		//Close out file
-		if (output_1 && (output_1 != stdout))
-		{
-			fclose(output_1);
+#if LIBFLAC_ENABLED == 1
+	if (p->out_format == FORMAT_FLAC) {
+		buf32 = aligned_alloc(16, sizeof(int32_t)*BUFFER_SIZE);
+		for(int j = OUT_A; j <= OUT_B; j++) {
+			if (p->out[j].f && (encoder[j] = FLAC__stream_encoder_new()) == NULL) buf32 = NULL;
+		}
+		if (!buf32) {
+			fprintf(stderr, "Failed allocating FLAC encoder\n");
+			p->error = true;
+			goto end;
 		}
 	}
-	
-	if(output_name_2 != NULL)
-	{
-		if (output_2 && (output_2 != stdout))
-		{
-			fclose(output_2);
+	else if (p->in_format == FORMAT_FLAC) {
+		memset(&dec, 0, sizeof(dec));
+		decoder = FLAC__stream_decoder_new();
+		if (!decoder || FLAC__stream_decoder_init_file(decoder, p->flac_in_name, flac_decode_write, NULL, flac_decode_error, &dec) != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+			fprintf(stderr, "Failed initializing FLAC decoder\n");
+			p->error = true;
+			goto end;
+		}
+		// the frame headers at the seekpoints are read separately
+		if (p->verify && (verify_f = fopen(p->flac_in_name, "rb")) == NULL) {
+			fprintf(stderr, "Failed to open %s\n", p->flac_in_name);
+			p->error = true;
+			goto end;
 		}
 	}
-	
-	if(output_name_aux != NULL)
-	{
-		if (output_aux && (output_aux != stdout))
-		{
-			fclose(output_aux);
+#endif
+	for(;;) {
+		k = atomic_fetch_add(&p->next_block, 1);
+		slot = k % p->slots;
+		// wait until the block is read
+		while(p->blocks[slot].seq != k + 1) {
+			if (p->error || k >= p->blocks_total) goto end;
+			pipeline_wait();
+		}
+		// wait until the slot of every output is free again
+		for(int j = 0; j < OUT_CNT; j++) {
+			if (!p->out[j].f) continue;
+			while(k >= p->out[j].written + p->slots) {
+				if (p->error) goto end;
+				pipeline_wait();
+			}
+		}
+		if (p->stats) start = time_ns(CLOCK_MONOTONIC);
+		samples = p->blocks[slot].samples;
+		in = p->blocks[slot].in;
+		for(int j = 0; j < OUT_CNT; j++) {
+			out[j] = (p->out[j].f) ? &p->out[j].rb.buffer[slot * p->out[j].slot_size] : NULL;
+		}
+		if (!out[OUT_AUX]) out[OUT_AUX] = aux_scratch;
+		p->blocks[slot].clip[0] = 0;
+		p->blocks[slot].clip[1] = 0;
+		if (p->conv_12pto16) {
+			p->conv_12pto16(in, out[OUT_A], samples);
+			p->out[OUT_A].len[slot] = samples * 2;
+		}
+		else if (p->in_format == FORMAT_MRC) {
+			// unpadded 12 bit samples are decoded to smp and padded
+			mrc_out = (p->out[OUT_A].smp) ? &p->out[OUT_A].smp[slot * BUFFER_SIZE] : out[OUT_A];
+			mrc_decoded = mrc_decode_block(p, &mrc_dec, mrc_f, mrc_chunk, k, mrc_out, samples);
+			if (mrc_decoded < 0) {
+				p->error = true;
+				goto end;
+			}
+			if (mrc_decoded == 0) {
+				set_total(p, k);
+				continue;
+			}
+			if ((size_t)mrc_decoded < samples) set_total(p, k + 1);
+			samples = mrc_decoded;
+			p->blocks[slot].samples = samples;
+			if (p->out[OUT_A].smp) {
+				for(size_t i = 0; i < samples; i++) ((uint16_t*)out[OUT_A])[i] = (uint16_t)mrc_out[i] << 4;
+			}
+			p->out[OUT_A].len[slot] = samples * 2;
 		}
+#if LIBFLAC_ENABLED == 1
+		else if (p->in_format == FORMAT_FLAC) {
+			// padded 12 bit samples are decoded to smp, which is used for the MD5 signature
+			if (p->verify) smp[OUT_A] = &p->verify_smp[slot * BUFFER_SIZE];
+			else smp[OUT_A] = (p->out[OUT_A].smp) ? &p->out[OUT_A].smp[slot * BUFFER_SIZE] : out[OUT_A];
+			decoded = flac_decode_block(p, decoder, &dec, k, smp[OUT_A], samples);
+			if (decoded < 0) {
+				fprintf(stderr, "FLAC decoder could not decode data: %s\n", FLAC__StreamDecoderStateString[FLAC__stream_decoder_get_state(decoder)]);
+				p->error = true;
+				goto end;
+			}
+			if (decoded == 0) {
+				set_total(p, k);
+				continue;
+			}
+			if ((size_t)decoded < samples) set_total(p, k + 1);
+			samples = decoded;
+			p->blocks[slot].samples = samples;
+			if (p->verify) flac_check_seekpoints(p, verify_f, k, samples);
+			if (p->out[OUT_A].smp) {
+				for(size_t i = 0; i < samples; i++) ((uint16_t*)out[OUT_A])[i] = (uint16_t)smp[OUT_A][i] << 4;
+			}
+			if (p->out[OUT_A].f) p->out[OUT_A].len[slot] = samples * 2;
+		}
+		else if (p->out_format == FORMAT_FLAC) {
+			for(int j = OUT_A; j <= OUT_B; j++) {
+				smp[j] = (p->out[j].f) ? &p->out[j].smp[slot * BUFFER_SIZE] : NULL;
+			}
+			if (p->in_format == FORMAT_S16)
+				memcpy(smp[OUT_A], in, samples * 2);
+			else
+				p->conv_function((uint32_t*)in, samples, p->blocks[slot].clip, out[OUT_AUX], smp[OUT_A], smp[OUT_B], NULL);
+			for(int j = OUT_A; j <= OUT_B; j++) {
+				if (!p->out[j].f) continue;
+				// every block is one segment of the stream, all blocks but the last are full
+				seg = &p->out[j].seg[slot];
+				seg->buf = out[j];
+				seg->size = p->out[j].slot_size;
+				seg->first_sample = (uint64_t)k * BUFFER_SIZE;
+				seg->samples = samples;
+				seg->seek_spacing = p->out[j].stream.seek_spacing;
+				if (flac_segment_encode(encoder[j], seg, smp[j], buf32, p->flac_level, p->flac_bits, FLAC_SAMPLE_RATE) != 0) {
+					fprintf(stderr, "(RF %c) FLAC encoder could not process data: %s\n", "AB"[j], FLAC__StreamEncoderStateString[FLAC__stream_encoder_get_state(encoder[j])]);
+					p->error = true;
+					goto end;
+				}
+				p->out[j].len[slot] = seg->len;
+			}
+			if (p->out[OUT_AUX].f) p->out[OUT_AUX].len[slot] = samples;
+		}
+#endif
+		else {
+			if (p->conv_float) {
+				p->conv_float(in, samples, p->blocks[slot].clip, out[OUT_AUX], out[OUT_A], out[OUT_B], NULL, &float_state);
+				if (p->dc && remove_dc(p, k, &float_state, out[OUT_A], out[OUT_B], samples) != 0) goto end;
+			}
+			else
+				p->conv_function((uint32_t*)in, samples, p->blocks[slot].clip, out[OUT_AUX], out[OUT_A], out[OUT_B], NULL);
+			if (p->out[OUT_A].f) p->out[OUT_A].len[slot] = out_bytes(p->out_format, samples);
+			if (p->out[OUT_B].f) p->out[OUT_B].len[slot] = out_bytes(p->out_format, samples);
+			if (p->out[OUT_AUX].f) p->out[OUT_AUX].len[slot] = samples;
+		}
+		if (p->stats) p->stage[STAGE_CONV].wall += time_ns(CLOCK_MONOTONIC) - start;
+		p->blocks[slot].done = 1;
 	}
-
-#if PERF_MEASURE
-	fprintf(stderr, "Readtime: %f\nConvtime: %f\nwrittime: %f\n", timeread, timeconv, timewrite);
+end:
+	aligned_free(aux_scratch);
+	rfc_decoder_free(&mrc_dec);
+	free(mrc_chunk);
+	if (mrc_f) fclose(mrc_f);
+#if LIBFLAC_ENABLED == 1
+	for(int j = OUT_A; j <= OUT_B; j++) {
+		if (encoder[j]) FLAC__stream_encoder_delete(encoder[j]);
+	}
+	if (buf32) aligned_free(buf32);
+	if (decoder) FLAC__stream_decoder_delete(decoder);
+	if (verify_f) fclose(verify_f);
 #endif
+	stage_cpu_done(p, STAGE_CONV);
+	return 0;
+}
 
+static int writer_thread(void *ctx)
+{
+	output_t *o = ctx;
+	pipeline_t *p = o->p;
+	uint8_t *buf, *header = NULL;
+	uint8_t digest[16];
+	size_t len, slot;
+	uint64_t start = 0;
+#if LIBURING_ENABLED == 1
+	bool uring = false;
+#endif
+#if defined(__linux__) && defined(_GNU_SOURCE)
+	char thread_name[] = "extract_write_X";
+	thread_name[14] = "ABX"[o->idx];
+	pthread_setname_np(pthread_self(), thread_name);
+#endif
+	if (o->seg) {
+		// the header is written when the stream is complete
+		header = calloc(1, flac_header_size(&o->stream));
+		if (!header || fwrite(header, 1, flac_header_size(&o->stream), o->f) != flac_header_size(&o->stream)) goto err;
+		md5_init(&o->md5);
+	}
+	if (p->flac_check_md5) md5_init(&o->md5);
+	pw_init(&o->pw, o->f, true);
+	if (p->pipe_zerocopy && pw_use_vmsplice(&o->pw) != 0) {
+		fprintf(stderr, "Output %c is not a pipe, vmsplice is not used\n", "ABX"[o->idx]);
+	}
+	if (p->direct_write && pw_use_direct(&o->pw, o->expected) != 0) {
+		fprintf(stderr, "Output %c is not a regular file or does not support direct I/O\n", "ABX"[o->idx]);
+	}
+#if LIBURING_ENABLED == 1
+	if (p->io_uring) {
+		uring = (pw_use_uring(&o->pw) == 0);
+		if (!uring) fprintf(stderr, "Output %c is not a regular file, io_uring is not used\n", "ABX"[o->idx]);
+	}
+#endif
+	for(size_t c = 0; ; c++) {
+		while((buf = pw_read_ptr(&o->pw, &o->rb, o->slot_size)) == NULL) {
+			// slots still referenced by a pipe are released while waiting
+			o->written = c - o->pw.held / o->slot_size;
+			if (p->error) goto end;
+			if (p->commit_finished && c >= p->blocks_committed) goto finish;
+			pipeline_wait();
+		}
+		slot = c % p->slots;
+		len = o->len[slot];
+		if (o->seg) {
+			md5_update(&o->md5, &o->smp[slot * BUFFER_SIZE], o->seg[slot].samples * 2);
+			flac_stream_add_segment(&o->stream, &o->seg[slot]);
+		}
+		if (p->flac_check_md5) md5_update_flac(&o->md5, (o->smp) ? &o->smp[slot * BUFFER_SIZE] : (int16_t*)buf, len / 2, p->flac_bps);
+		// the slot is released by the pipe writer, pipes may still reference it
+		if (p->stats) start = time_ns(CLOCK_MONOTONIC);
+		if (pw_write(&o->pw, &o->rb, buf, len, o->slot_size) != 0) goto err;
+		if (p->stats) {
+			p->stage[STAGE_WRITE].wall += time_ns(CLOCK_MONOTONIC) - start;
+			p->stage[STAGE_WRITE].bytes += len;
+		}
+		o->written = c + 1 - o->pw.held / o->slot_size;
+	}
+finish:
+	// all writes in flight have to be completed before the header is written
+	if (pw_close(&o->pw, &o->rb) != 0) goto err;
+#if LIBURING_ENABLED == 1
+	if (uring && p->stats && o->pw.lat_cnt > 0) {
+		fprintf(stderr, "Output %c: up to %u io_uring writes in flight, write latency %.2f ms average, %.2f ms maximum\n",
+			"ABX"[o->idx], o->pw.depth_max, o->pw.lat_sum / 1e6 / o->pw.lat_cnt, o->pw.lat_max / 1e6);
+	}
+#endif
+	if (o->seg) {
+		md5_final(&o->md5, o->stream.md5);
+		flac_write_header(&o->stream, header);
+		if (fseek(o->f, 0, SEEK_SET) != 0 || fwrite(header, 1, flac_header_size(&o->stream), o->f) != flac_header_size(&o->stream)) goto err;
+	}
+	if (p->flac_check_md5) {
+		md5_final(&o->md5, digest);
+		if (memcmp(digest, p->flac_md5, 16) != 0) {
+			fprintf(stderr, "MD5 signature of the decoded samples does not match the FLAC input\n");
+			p->error = true;
+		}
+		else fprintf(stderr, "MD5 signature of the FLAC input verified\n");
+	}
+	goto end;
+err:
+	fprintf(stderr, "Error writing output: %s\n", strerror(errno));
+	p->error = true;
+end:
+	// the ringbuffer must not be unmapped while writes are in flight
+	pw_close(&o->pw, &o->rb);
+	free(header);
+	stage_cpu_done(p, STAGE_WRITE);
 	return 0;
 }
+
+#define PROGRESS_INTERVAL 5000000000ULL
+
+static void print_progress(pipeline_t *p)
+{
+	uint64_t now = time_ns(CLOCK_MONOTONIC), done = in_bytes(p, p->samples_done);
+	double seconds;
+	if (now < p->progress_time + PROGRESS_INTERVAL) return;
+	seconds = (now - p->start_time) / 1e9;
+	if (p->in_total > 0)
+		fprintf(stderr, "Progress: %.1f %% (%.1f of %.1f MB, %.1f MB/s)\n", 100.0 * done / p->in_total, done / 1e6, p->in_total / 1e6, done / seconds / 1e6);
+	else
+		fprintf(stderr, "Progress: %.1f MB (%.1f MB/s)\n", done / 1e6, done / seconds / 1e6);
+	p->progress_time = now;
+}
+
+static const char *format_names[] = { "raw32", "raw16", "s12p", "s8", "f32", "f32raw", "s16", "flac", "mrc" };
+static const char *in_mode_names[] = { "auto", "read", "mmap", "direct" };
+static const char *stage_names[STAGE_CNT] = { "read", "convert", "write" };
+
+// append to a buffer, output that does not fit is cut off
+static void buf_printf(char *buf, size_t size, size_t *len, const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+	if (*len + 1 >= size) return;
+	va_start(ap, fmt);
+	n = vsnprintf(buf + *len, size - *len, fmt, ap);
+	va_end(ap);
+	if (n > 0) *len += n;
+	if (*len >= size) *len = size - 1;
+}
+
+// append a string as JSON string literal, needs up to 6 bytes per character
+static void json_string(char *buf, size_t size, size_t *len, const char *s)
+{
+	buf_printf(buf, size, len, "\"");
+	for(; *s; s++) {
+		if (*s == '"' || *s == '\\') buf_printf(buf, size, len, "\\%c", *s);
+		else if ((unsigned char)*s < 0x20) buf_printf(buf, size, len, "\\u%04x", *s);
+		else buf_printf(buf, size, len, "%c", *s);
+	}
+	buf_printf(buf, size, len, "\"");
+}
+
+static void print_stats(pipeline_t *p, const char *input_name, const char *kernel, int threads, bool text, FILE *json)
+{
+	double seconds = (time_ns(CLOCK_MONOTONIC) - p->start_time) / 1e9;
+	uint64_t bytes_in = in_bytes(p, p->samples_done), bytes_out = p->stage[STAGE_WRITE].bytes;
+	if (seconds <= 0.0) seconds = 1e-9;
+	if (text) {
+		fprintf(stderr, "Statistics of %s:\n", input_name);
+		fprintf(stderr, "  kernel:  %s, %d conversion threads, %s input\n", kernel, threads, in_mode_names[p->in_mode]);
+		fprintf(stderr, "  total:   %" PRIu64 " samples in %.3f s (%.1f MS/s)\n", p->samples_done, seconds, p->samples_done / seconds / 1e6);
+		fprintf(stderr, "  in/out:  %.1f MB in (%.1f MB/s), %.1f MB out (%.1f MB/s)\n", bytes_in / 1e6, bytes_in / seconds / 1e6, bytes_out / 1e6, bytes_out / seconds / 1e6);
+		for(int s = 0; s < STAGE_CNT; s++) {
+			uint64_t wall = p->stage[s].wall, cpu = p->stage[s].cpu;
+			fprintf(stderr, "  %-8s %.3f s wall, %.3f s CPU", stage_names[s], wall / 1e9, cpu / 1e9);
+			if (s != STAGE_CONV && wall > 0) fprintf(stderr, ", %.1f MB at %.1f MB/s", p->stage[s].bytes / 1e6, p->stage[s].bytes * 1e3 / wall);
+			fprintf(stderr, "\n");
+		}
+	}
+	if (json) {
+		// one line per file, so several runs can be appended and compared. The batch jobs
+		// share the file, each line is written at once so they do not interleave
+		size_t size = 1024 + 6 * (strlen(MIRSC_TOOLS_VERSION) + strlen(input_name) + strlen(kernel)), len = 0;
+		char *buf = malloc(size);
+		if (!buf) {
+			fprintf(stderr, "Failed to allocate memory for statistics\n");
+			return;
+		}
+		buf_printf(buf, size, &len, "{\"version\":");
+		json_string(buf, size, &len, MIRSC_TOOLS_VERSION);
+		buf_printf(buf, size, &len, ",\"input\":");
+		json_string(buf, size, &len, input_name);
+		buf_printf(buf, size, &len, ",\"kernel\":");
+		json_string(buf, size, &len, kernel);
+		buf_printf(buf, size, &len, ",\"cores\":%" PRIu32 ",\"threads\":%d,\"input_mode\":\"%s\",\"in_format\":\"%s\",\"out_format\":\"%s\"",
+			get_num_cores(), threads, in_mode_names[p->in_mode], format_names[p->in_format], format_names[p->out_format]);
+		buf_printf(buf, size, &len, ",\"samples\":%" PRIu64 ",\"seconds\":%.6f,\"bytes_in\":%" PRIu64 ",\"bytes_out\":%" PRIu64 ",\"mb_in_per_s\":%.3f,\"mb_out_per_s\":%.3f",
+			p->samples_done, seconds, bytes_in, bytes_out, bytes_in / seconds / 1e6, bytes_out / seconds / 1e6);
+		buf_printf(buf, size, &len, ",\"error\":%s,\"stages\":{", p->error ? "true" : "false");
+		for(int s = 0; s < STAGE_CNT; s++) {
+			buf_printf(buf, size, &len, "%s\"%s\":{\"wall\":%.6f,\"cpu\":%.6f,\"bytes\":%" PRIu64 "}", s ? "," : "", stage_names[s],
+				p->stage[s].wall / 1e9, p->stage[s].cpu / 1e9, (uint64_t)p->stage[s].bytes);
+		}
+		buf_printf(buf, size, &len, "}}\n");
+		flockfile(json);
+		fwrite(buf, 1, len, json);
+		fflush(json);
+		funlockfile(json);
+		free(buf);
+	}
+}
+
+// release the converted blocks in order to the writers
+static void commit_blocks(pipeline_t *p)
+{
+	block_t *blk;
+	for(size_t c = 0; ; c++) {
+		blk = &p->blocks[c % p->slots];
+		while(!blk->done) {
+			if (p->error || c >= p->blocks_total) goto end;
+			pipeline_wait();
+		}
+		blk->done = 0;
+		// an odd count ends in the first sample of a pair
+		if (p->in_format == FORMAT_S12P && p->samples_done + blk->samples > p->in_count) {
+			blk->samples = p->in_count - p->samples_done;
+			p->out[OUT_A].len[c % p->slots] = blk->samples * 2;
+		}
+#if LIBFLAC_ENABLED == 1
+		if (p->verify && p->flac_check_md5) md5_update_flac(&p->verify_md5, &p->verify_smp[(c % p->slots) * BUFFER_SIZE], blk->samples, p->flac_bps);
+#endif
+		p->samples_done += blk->samples;
+		if (p->stats) print_progress(p);
+		if(blk->clip[0] > 0)
+		{
+			fprintf(stderr,"ADC A : %zu samples clipped\n",blk->clip[0]);
+		}
+		if(blk->clip[1] > 0)
+		{
+			fprintf(stderr,"ADC B : %zu samples clipped\n",blk->clip[1]);
+		}
+		for(int j = 0; j < OUT_CNT; j++) {
+			if (p->out[j].f) rb_write_finished(&p->out[j].rb, p->out[j].slot_size);
+		}
+		p->blocks_committed = c + 1;
+	}
+end:
+	p->commit_finished = true;
+}
+
+// size of the input in bytes, 0 if unknown
+static uint64_t input_size(pipeline_t *p)
+{
+#ifndef _WIN32
+	struct stat st;
+	off_t end;
+	int fd = (p->in_mode == INPUT_READ) ? fileno(p->in) : p->in_fd;
+	if (p->in_map) return p->in_size;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) return st.st_size;
+	// block devices
+	end = lseek(fd, 0, SEEK_END);
+	if (end <= 0 || lseek(fd, 0, SEEK_SET) != 0) return 0;
+	return end;
+#else
+	__int64 len = _filelengthi64(_fileno(p->in));
+	return (len > 0) ? len : 0;
+#endif
+}
+
+static FILE* open_output(char *name)
+{
+	FILE *f;
+	if (strcmp(name, "-") == 0)// Write samples to stdout
+	{
+		return stdout;
+	}
+	f = fopen(name, "wb");
+	if (!f) {
+		fprintf(stderr, "(2) : Failed to open %s\n", name);
+	}
+	return f;
+}
+
+#if LIBFLAC_ENABLED == 1
+// result of --verify, errors are reported with p->error
+static void verify_report(pipeline_t *p, const char *input_name)
+{
+	uint8_t digest[16];
+	size_t beyond = 0, errors;
+	bool md5_ok = true, ok = true;
+	// seekpoints behind the last sample were not checked by the workers
+	for(size_t i = 0; i < p->seek_cnt; i++) {
+		if (p->seek[i].sample_number >= p->samples_done) beyond++;
+	}
+	if (beyond > 0) fprintf(stderr, "%zu seekpoints are behind the end of the stream\n", beyond);
+	errors = p->seek_errors + beyond;
+	if (p->flac_total > 0 && p->samples_done != p->flac_total) {
+		fprintf(stderr, "STREAMINFO has %" PRIu64 " samples, the stream %" PRIu64 "\n", p->flac_total, p->samples_done);
+		ok = false;
+	}
+	if (p->flac_check_md5) {
+		md5_final(&p->verify_md5, digest);
+		md5_ok = (memcmp(digest, p->flac_md5, 16) == 0);
+		if (!md5_ok) fprintf(stderr, "MD5 signature of the decoded samples does not match the FLAC input\n");
+	}
+	fprintf(stderr, "%s: %" PRIu64 " samples decoded, MD5 signature %s, %zu of %zu seekpoints correct\n", input_name, p->samples_done,
+		(p->flac_check_md5) ? (md5_ok ? "verified" : "wrong") : "not checked", (errors < p->seek_cnt) ? p->seek_cnt - errors : 0, p->seek_cnt);
+	if (!ok || !md5_ok || errors > 0) p->error = true;
+}
+#endif
+
+typedef struct {
+	int in_format;
+	int out_format;
+	int in_mode;
+	bool pad;
+	bool single;
+	bool dc_removal;
+	int rounding_8bit; // EXTRACT_8BIT_*
+	int threads;
+	uint32_t flac_level;
+	uint64_t start;
+	uint64_t count;
+	bool check_md5;
+	bool verify;
+	bool benchmark;
+	bool stats;
+	FILE *stats_json;  // shared by the batch jobs, one line per file
+	bool io_uring;
+	bool direct_write;
+	bool pipe_zerocopy;
+} extract_settings_t;
+
+typedef struct {
+	uint64_t samples;
+	uint64_t bytes;    // bytes of input, 0 for FLAC and container input
+	double seconds;
+} extract_result_t;
+
+/* Batch mode: the input files are distributed to jobs, each job extracts one
+ * file at a time with its share of the conversion threads, so reading and
+ * writing of several files overlap. The output names are expanded before the
+ * jobs start, no two files may be written to the same name. On Linux the
+ * devices of the inputs and of the output directories are looked up, a file
+ * is only started if every hard disk (rotational device) it uses has less
+ * than --jobs-per-disk jobs, the next file on another device is taken
+ * instead, so seeking between several files does not slow a disk down. */
+
+#define BATCH_DISKS 64
+
+typedef struct {
+	uint64_t dev;
+	atomic_int jobs;        // jobs that use the disk
+} batch_disk_t;
+
+typedef struct {
+	char *names[OUT_CNT];   // expanded output names
+	int disk[1 + OUT_CNT];  // hard disks used by the input and the outputs, each once
+	int disk_cnt;
+	atomic_bool started;
+} batch_input_t;
+
+typedef struct {
+	const extract_settings_t *set;
+	char **inputs;
+	size_t input_cnt;
+	batch_input_t *in;
+	batch_disk_t disk[BATCH_DISKS];
+	int disk_cnt;
+	int per_disk;           // jobs per hard disk, 0 for no limit
+	atomic_size_t first;    // no file before it is waiting
+	atomic_size_t failed;
+	atomic_uint_least64_t samples;
+	atomic_uint_least64_t bytes;
+} batch_t;
+
+static int extract_file(const extract_settings_t *set, char *input_name, char **output_names, extract_result_t *res)
+{
+	int r, ret = 0;
+	bool pad = set->pad, single = set->single;
+	int in_format = set->in_format, out_format = set->out_format;
+	// FLAC and container input are decoded by the workers
+	bool decoded_in = (in_format == FORMAT_FLAC || in_format == FORMAT_MRC);
+	int threads = set->threads;
+	uint64_t start = set->start, count = set->count, size;
+#if LIBFLAC_ENABLED == 1
+	FLAC__StreamMetadata_StreamInfo flac_info;
+#endif
+	char rb_name[] = "extract_out_X";
+	const char *kernel = "none";
+
+	pipeline_t p;
+	int readers = 1, readers_started = 0, threads_started = 0;
+	bool writer_started[OUT_CNT] = { false, false, false };
+	thrd_t thread_read[DIRECT_READERS];
+	thrd_t thread_conv[MAX_THREADS];
+	int (*reader_func)(void*) = reader_thread;
+
+	memset(&p, 0, sizeof(p));
+	p.blocks_total = SIZE_MAX;
+	p.in_fd = -1;
+	p.in_mode = set->in_mode;
+	p.stats = set->stats || set->stats_json;
+	p.io_uring = set->io_uring;
+	p.direct_write = set->direct_write;
+	p.pipe_zerocopy = set->pipe_zerocopy;
+	p.start_time = p.progress_time = time_ns(CLOCK_MONOTONIC);
+
+	p.in_format = in_format;
+	p.single = single;
+	if (in_format == FORMAT_S12P && (start & 1)) {
+		// two samples share three bytes
+		start &= ~(uint64_t)1;
+		fprintf(stderr, "Packed 12 bit input can only start at an even sample, starting at %" PRIu64 "\n", start);
+	}
+	p.in_offset = in_bytes(&p, start);
+	p.in_limit = (count < UINT64_MAX / 4) ? in_bytes(&p, count) : UINT64_MAX;
+	p.in_count = count;
+
+	//reading file 1
+	if (strcmp(input_name, "-") == 0)// Read samples from stdin
+	{
+		p.in = stdin;
+		p.in_mode = INPUT_READ;
+	}
+#if LIBFLAC_ENABLED == 1
+	else if (in_format == FORMAT_FLAC)
+	{
+		// every worker opens the file with its own decoder
+		p.flac_in_name = input_name;
+		p.in_mode = INPUT_READ;
+		if (flac_probe(&p, &flac_info) != 0) {
+			fprintf(stderr, "(1) : Failed to read FLAC metadata of %s\n", input_name);
+			return -ENOENT;
+		}
+		if (flac_info.channels != 1 || flac_info.bits_per_sample > 16) {
+			fprintf(stderr, "Only mono FLAC with up to 16 bit can be decoded\n");
+			return -EINVAL;
+		}
+		p.flac_total = flac_info.total_samples;
+		if (p.flac_total > 0) {
+			size = (p.flac_total > start) ? p.flac_total - start : 0;
+			if (in_bytes(&p, size) < p.in_limit) p.in_limit = in_bytes(&p, size);
+		}
+		// the signature can only be checked if the whole stream is decoded
+		memcpy(p.flac_md5, flac_info.md5sum, 16);
+		p.flac_check_md5 = set->check_md5 && start == 0 && count == UINT64_MAX && memcmp(p.flac_md5, (uint8_t[16]){ 0 }, 16) != 0;
+		if (set->check_md5 && !p.flac_check_md5) fprintf(stderr, "MD5 signature of the FLAC input is not checked\n");
+		// 12 bit streams hold the unpadded samples
+		pad = pad && flac_info.bits_per_sample == 12;
+		p.flac_bps = flac_info.bits_per_sample;
+		if (set->verify) {
+			p.verify = true;
+			p.flac_blocksize = flac_info.max_blocksize;
+			if (flac_read_seektable(&p) != 0) {
+				fprintf(stderr, "(1) : Failed to read FLAC metadata of %s\n", input_name);
+				ret = -EIO;
+				goto end;
+			}
+			if (p.seek_cnt == 0) fprintf(stderr, "%s has no seektable\n", input_name);
+			p.seek_errors = flac_check_seek_order(&p);
+		}
+	}
+#endif
+	else if (in_format == FORMAT_MRC)
+	{
+		// every worker opens the file, the index is read once
+		FILE *f = fopen(input_name, "rb");
+		p.mrc_in_name = input_name;
+		p.in_mode = INPUT_READ;
+		r = (f) ? rfc_stream_read(&p.mrc, f) : RFC_ERR_IO;
+		if (f) fclose(f);
+		// a file that was not closed is read up to the last complete chunk
+		if (r == RFC_ERR_TRUNCATED) {
+			fprintf(stderr, "Container %s: %s, %" PRIu64 " samples are read\n", input_name, rfc_strerror(r), p.mrc.samples);
+			r = 0;
+		}
+		if (r != 0) {
+			fprintf(stderr, "(1) : Failed to read container %s: %s\n", input_name, rfc_strerror(r));
+			ret = -ENOENT;
+			goto end;
+		}
+		if (!rfc_codec_name(p.mrc.codec)) {
+			fprintf(stderr, "%s is compressed with a codec that is not supported by this build\n", input_name);
+			ret = -EINVAL;
+			goto end;
+		}
+		size = (p.mrc.samples > start) ? p.mrc.samples - start : 0;
+		if (in_bytes(&p, size) < p.in_limit) p.in_limit = in_bytes(&p, size);
+		// padded samples are stored as they are
+		pad = pad && !(p.mrc.flags & RFC_FLAG_PADDED);
+	}
+	else
+	{
+#ifndef _WIN32
+		if (p.in_mode != INPUT_READ && open_input_fd(&p, input_name) != 0) {
+			fprintf(stderr, "(1) : Failed to open %s\n", input_name);
+			ret = -ENOENT;
+			goto end;
+		}
+#else
+		if (p.in_mode == INPUT_MMAP || p.in_mode == INPUT_DIRECT) {
+			fprintf(stderr, "Input mode not supported on this platform, falling back to read\n");
+		}
+		p.in_mode = INPUT_READ;
+#endif
+		if (p.in_mode == INPUT_READ) {
+			p.in = fopen(input_name, "rb");
+			if (!p.in) {
+				fprintf(stderr, "(1) : Failed to open %s\n", input_name);
+				ret = -ENOENT;
+				goto end;
+			}
+		}
+	}
+
+	for(int j = 0; j < OUT_CNT; j++) {
+		if(output_names[j] == NULL) continue;
+		p.out[j].f = open_output(output_names[j]);
+		if (!p.out[j].f) {
+			ret = -ENOENT;
+			goto end;
+		}
+	}
+
+	if (in_format == FORMAT_S12P)
+		p.conv_12pto16 = get_12pto16_function(pad);
+	else if (out_format == FORMAT_S12P)
+		p.conv_function = get_conv_12p_function(single, false, output_names[OUT_A], output_names[OUT_B]);
+	else if (out_format == FORMAT_S8)
+		p.conv_function = get_conv_8bit_function(set->rounding_8bit, false, false, output_names[OUT_A], output_names[OUT_B]);
+	else if ((out_format == FORMAT_F32 || out_format == FORMAT_F32R) && (output_names[OUT_A] != NULL || output_names[OUT_B] != NULL)) {
+		p.conv_float = get_conv_float_function(false, output_names[OUT_A], output_names[OUT_B]);
+		// the DC offset is removed by the workers in block order (remove_dc)
+		extract_float_init(&p.float_state, out_format == FORMAT_F32, false);
+	}
+	else
+		p.conv_function = get_conv_function(single, pad, false, false, output_names[OUT_A], output_names[OUT_B]);
+	if (in_format == FORMAT_FLAC) kernel = "libFLAC";
+	else if (in_format == FORMAT_MRC) kernel = rfc_codec_name(p.mrc.codec);
+	else if (p.conv_12pto16) kernel = get_conv_name((void (*)(void))p.conv_12pto16);
+	else if (p.conv_float) kernel = get_conv_name((void (*)(void))p.conv_float);
+	else if (p.conv_function) kernel = get_conv_name((void (*)(void))p.conv_function);
+
+	p.out_format = (in_format == FORMAT_S12P) ? FORMAT_S16 : out_format;
+	p.slots = threads + 4;
+	if (p.slots > MAX_SLOTS) p.slots = MAX_SLOTS;
+	if (in_format == FORMAT_S12P) p.in_slot_size = (BUFFER_SIZE*3)/2;
+	else if (in_format == FORMAT_S16 || decoded_in) p.in_slot_size = BUFFER_SIZE*2;
+	else p.in_slot_size = BUFFER_SIZE*(4>>single);
+	// 12 bit samples are stored as 12 bit FLAC, padded samples need 16 bit
+	p.flac_level = set->flac_level;
+	p.flac_bits = (pad || in_format == FORMAT_S16) ? 16 : 12;
+
+	// all slot sizes are multiples of 64 KiB, as required by rb_init
+	p.blocks = calloc(p.slots, sizeof(block_t));
+	if (p.conv_float && set->dc_removal) p.dc = calloc(2 * p.slots, sizeof(dc_sum_t));
+	if (!p.blocks || (p.conv_float && set->dc_removal && !p.dc) || (!decoded_in && rb_init(&p.rb_in, "extract_in", p.in_slot_size * p.slots))) {
+		fprintf(stderr, "Failed to allocate input buffer\n");
+		ret = -ENOMEM;
+		goto end;
+	}
+#if LIBFLAC_ENABLED == 1
+	if (p.verify) {
+		p.verify_smp = aligned_alloc(16, p.slots * BUFFER_SIZE * sizeof(int16_t));
+		if (!p.verify_smp) {
+			fprintf(stderr, "Failed to allocate buffer\n");
+			ret = -ENOMEM;
+			goto end;
+		}
+		md5_init(&p.verify_md5);
+	}
+#endif
+	// the size of the range, for the seektable
+	size = (decoded_in) ? 0 : input_size(&p);
+	if (size == 0 && p.in_limit != UINT64_MAX) size = p.in_offset + p.in_limit;
+	size = (size > p.in_offset) ? size - p.in_offset : 0;
+	if (size > p.in_limit) size = p.in_limit;
+	p.in_total = (decoded_in) ? ((p.in_limit != UINT64_MAX) ? p.in_limit : 0) : size;
+
+	for(int j = 0; j < OUT_CNT; j++) {
+		if (!p.out[j].f) continue;
+		p.out[j].p = &p;
+		p.out[j].idx = j;
+		p.out[j].slot_size = (j == OUT_AUX) ? BUFFER_SIZE : out_bytes(p.out_format, BUFFER_SIZE);
+		p.out[j].expected = (j == OUT_AUX) ? in_samples(&p, size) : ((p.out_format == FORMAT_FLAC) ? 0 : out_bytes(p.out_format, in_samples(&p, size)));
+		p.out[j].len = calloc(p.slots, sizeof(size_t));
+		if (p.out_format == FORMAT_FLAC && j != OUT_AUX) {
+			p.out[j].slot_size += FLAC_SLOT_MARGIN;
+			p.out[j].smp = aligned_alloc(16, p.slots * BUFFER_SIZE * sizeof(int16_t));
+			p.out[j].seg = calloc(p.slots, sizeof(flac_segment_t));
+			// input of unknown length (stdin) gets placeholders for up to 2^41 samples like misrc_capture
+			uint64_t seek_total = (in_samples(&p, size) > 0) ? in_samples(&p, size) : (uint64_t)1<<41;
+			if (!p.out[j].smp || !p.out[j].seg || flac_stream_init(&p.out[j].stream, FLAC_SAMPLE_RATE, p.flac_bits, seek_total) != 0) {
+				fprintf(stderr, "Failed to allocate output buffer\n");
+				ret = -ENOMEM;
+				goto end;
+			}
+		}
+		else if (decoded_in && pad) {
+			p.out[j].smp = aligned_alloc(16, p.slots * BUFFER_SIZE * sizeof(int16_t));
+			if (!p.out[j].smp) {
+				fprintf(stderr, "Failed to allocate output buffer\n");
+				ret = -ENOMEM;
+				goto end;
+			}
+		}
+		rb_name[12] = "ABX"[j];
+		if (!p.out[j].len || rb_init(&p.out[j].rb, rb_name, p.out[j].slot_size * p.slots)) {
+			fprintf(stderr, "Failed to allocate output buffer\n");
+			ret = -ENOMEM;
+			goto end;
+		}
+	}
+
+	if (p.in && p.in_offset > 0 && fseeko(p.in, p.in_offset, SEEK_SET) != 0) {
+		// stdin and pipes are read up to the start of the range
+		p.in_skip = p.in_offset;
+	}
+
+	fprintf(stderr, "Using %d conversion threads\n", threads);
+	if (set->stats) fprintf(stderr, "Conversion kernel: %s\n", kernel);
+
+	if (decoded_in) {
+		reader_func = decode_reader_thread;
+	}
+#ifndef _WIN32
+	if (p.in_mode == INPUT_MMAP) {
+		reader_func = mmap_reader_thread;
+	}
+	else if (p.in_mode == INPUT_DIRECT) {
+		reader_func = direct_reader_thread;
+		readers = DIRECT_READERS;
+	}
+#endif
+	for(; readers_started < readers; readers_started++) {
+		r = thrd_create(&thread_read[readers_started], reader_func, &p);
+		if (r != thrd_success) goto thread_err;
+	}
+	for(; threads_started < threads; threads_started++) {
+		r = thrd_create(&thread_conv[threads_started], worker_thread, &p);
+		if (r != thrd_success) goto thread_err;
+	}
+	for(int j = 0; j < OUT_CNT; j++) {
+		if (!p.out[j].f) continue;
+		r = thrd_create(&p.out[j].thread, writer_thread, &p.out[j]);
+		if (r != thrd_success) goto thread_err;
+		writer_started[j] = true;
+	}
+
+	commit_blocks(&p);
+	goto join;
+
+thread_err:
+	fprintf(stderr, "Failed to create thread\n");
+	p.error = true;
+	ret = -1;
+join:
+	for(int i = 0; i < readers_started; i++) {
+		thrd_join(thread_read[i], NULL);
+	}
+	for(int i = 0; i < threads_started; i++) {
+		thrd_join(thread_conv[i], NULL);
+	}
+	for(int j = 0; j < OUT_CNT; j++) {
+		if (writer_started[j]) thrd_join(p.out[j].thread, NULL);
+	}
+	if (p.stats && writer_started[OUT_A] + writer_started[OUT_B] + writer_started[OUT_AUX] > 0) {
+		print_stats(&p, input_name, kernel, threads, set->stats, set->stats_json);
+	}
+#if LIBFLAC_ENABLED == 1
+	if (p.verify && !p.error) verify_report(&p, input_name);
+#endif
+
+end:
+	for(int j = 0; j < OUT_CNT; j++) {
+		if (p.out[j].rb.buffer_size) rb_close(&p.out[j].rb);
+		free(p.out[j].len);
+		if (p.out[j].smp) aligned_free(p.out[j].smp);
+		if (p.out[j].seg) {
+			free(p.out[j].seg);
+			flac_stream_free(&p.out[j].stream);
+		}
+		//Close out file
+		if (p.out[j].f && p.out[j].f != stdout)
+		{
+			fclose(p.out[j].f);
+		}
+	}
+	if (p.rb_in.buffer_size) rb_close(&p.rb_in);
+	free(p.blocks);
+	free(p.dc);
+	rfc_stream_free(&p.mrc);
+#if LIBFLAC_ENABLED == 1
+	if (p.verify_smp) aligned_free(p.verify_smp);
+	free(p.seek);
+#endif
+
+	//Close file 1
+	if (p.in && p.in != stdin) fclose(p.in);
+#ifndef _WIN32
+	if (p.in_map) munmap(p.in_map, p.in_size);
+	if (p.in_fd >= 0) close(p.in_fd);
+#endif
+
+	if (res) {
+		res->samples = p.samples_done;
+		res->bytes = (decoded_in) ? 0 : in_bytes(&p, p.samples_done);
+		res->seconds = (time_ns(CLOCK_MONOTONIC) - p.start_time) / 1e9;
+	}
+
+	if (ret == 0 && p.error) ret = -EIO;
+	return ret;
+}
+
+// expand %n (input name without extension), %f (input name), %d (input directory) and %%
+static int expand_pattern(const char *pattern, const char *input, char *out, size_t size)
+{
+	const char *base = input, *ext, *c;
+	size_t len = 0, n;
+	for(c = input; *c; c++) {
+		if (*c == '/' || *c == '\\') base = c + 1;
+	}
+	ext = strrchr(base, '.');
+	if (!ext || ext == base) ext = base + strlen(base);
+	for(c = pattern; *c; c++) {
+		const char *src = c;
+		n = 1;
+		if (*c == '%') {
+			c++;
+			switch (*c) {
+			case 'n': src = base; n = ext - base; break;
+			case 'f': src = base; n = strlen(base); break;
+			case 'd':
+				if (base == input) { src = "."; n = 1; }
+				else { src = input; n = base - input - 1; }
+				break;
+			case '%': src = c; n = 1; break;
+			default: return -1;
+			}
+		}
+		if (len + n >= size) return -1;
+		memcpy(&out[len], src, n);
+		len += n;
+	}
+	out[len] = '\0';
+	return 0;
+}
+
+// start file i if it is waiting and none of its disks has per_disk jobs
+static bool batch_claim(batch_t *b, size_t i)
+{
+	batch_input_t *in = &b->in[i];
+	bool waiting = false;
+	if (!atomic_compare_exchange_strong(&in->started, &waiting, true)) return false;
+	if (b->per_disk == 0) return true;
+	for(int d = 0; d < in->disk_cnt; d++) {
+		if (atomic_fetch_add(&b->disk[in->disk[d]].jobs, 1) >= b->per_disk) {
+			for(int e = 0; e <= d; e++) b->disk[in->disk[e]].jobs--;
+			in->started = false;
+			return false;
+		}
+	}
+	return true;
+}
+
+static int batch_thread(void *ctx)
+{
+	batch_t *b = ctx;
+	extract_result_t res;
+	size_t i;
+	bool waiting;
+	int r;
+	for(;;) {
+		// files are started in order, except where a disk is busy
+		for(i = b->first; i < b->input_cnt && b->in[i].started; i++) atomic_compare_exchange_strong(&b->first, &(size_t){ i }, i + 1);
+		waiting = false;
+		for(i = b->first; i < b->input_cnt; i++) {
+			if (b->in[i].started) continue;
+			waiting = true;
+			if (batch_claim(b, i)) break;
+		}
+		if (i == b->input_cnt) {
+			if (!waiting) break;
+			// all waiting files use a busy disk
+			thrd_sleep(&(struct timespec){.tv_nsec=10000000}, NULL);
+			continue;
+		}
+		fprintf(stderr, "[%zu/%zu] %s\n", i + 1, b->input_cnt, b->inputs[i]);
+		r = extract_file(b->set, b->inputs[i], b->in[i].names, &res);
+		if (b->per_disk > 0) {
+			for(int d = 0; d < b->in[i].disk_cnt; d++) b->disk[b->in[i].disk[d]].jobs--;
+		}
+		if (r != 0) {
+			fprintf(stderr, "[%zu/%zu] %s: failed (%s)\n", i + 1, b->input_cnt, b->inputs[i], strerror(-r));
+			b->failed++;
+			continue;
+		}
+		b->samples += res.samples;
+		b->bytes += res.bytes;
+		fprintf(stderr, "[%zu/%zu] %s: %" PRIu64 " samples in %.1f s (%.1f MS/s, %.1f MB/s)\n", i + 1, b->input_cnt, b->inputs[i],
+			res.samples, res.seconds, res.samples / res.seconds / 1e6, res.bytes / res.seconds / 1e6);
+	}
+	return 0;
+}
+
+#if defined(__linux__)
+// true if the device is a hard disk, partitions are looked up on their disk
+static bool disk_rotational(dev_t dev)
+{
+	char path[96];
+	int c = EOF;
+	FILE *f;
+	snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/queue/rotational", major(dev), minor(dev));
+	if (!(f = fopen(path, "r"))) {
+		snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/../queue/rotational", major(dev), minor(dev));
+		f = fopen(path, "r");
+	}
+	if (f) {
+		c = fgetc(f);
+		fclose(f);
+	}
+	return c == '1';
+}
+
+// add the hard disk of a file (or of the directory of an output) to the disks of input i
+static void batch_add_disk(batch_t *b, size_t i, const char *name, bool output)
+{
+	char dir[4096];
+	const char *slash = strrchr(name, '/');
+	batch_input_t *in = &b->in[i];
+	struct stat st;
+	uint64_t dev;
+	int d;
+	if (output) {
+		if (!slash) snprintf(dir, sizeof(dir), ".");
+		else snprintf(dir, sizeof(dir), "%.*s", (int)(slash - name) + (slash == name), name);
+		name = dir;
+	}
+	if (stat(name, &st) != 0) return;
+	dev = (S_ISBLK(st.st_mode)) ? st.st_rdev : st.st_dev;
+	for(d = 0; d < b->disk_cnt && b->disk[d].dev != dev; d++);
+	if (d == b->disk_cnt) {
+		if (d == BATCH_DISKS || !disk_rotational((dev_t)dev)) return;
+		b->disk[b->disk_cnt++].dev = dev;
+	}
+	for(int e = 0; e < in->disk_cnt; e++) {
+		if (in->disk[e] == d) return;
+	}
+	in->disk[in->disk_cnt++] = d;
+}
+#endif
+
+typedef struct {
+	const char *name;
+	size_t input;
+} batch_name_t;
+
+static int batch_name_cmp(const void *a, const void *b)
+{
+	return strcmp(((const batch_name_t*)a)->name, ((const batch_name_t*)b)->name);
+}
+
+// expand the output names of all inputs, returns -1 if a name is invalid or used twice
+static int batch_prepare(batch_t *b, char **patterns)
+{
+	char name[4096];
+	batch_name_t *all = malloc(b->input_cnt * OUT_CNT * sizeof(batch_name_t));
+	size_t cnt = 0;
+	int r = 0;
+	b->in = calloc(b->input_cnt, sizeof(batch_input_t));
+	if (!b->in || !all) {
+		fprintf(stderr, "Failed to allocate file list\n");
+		free(all);
+		return -1;
+	}
+	for(size_t i = 0; i < b->input_cnt; i++) {
+		for(int j = 0; j < OUT_CNT; j++) {
+			if (!patterns[j]) continue;
+			if (expand_pattern(patterns[j], b->inputs[i], name, sizeof(name)) != 0 || (b->in[i].names[j] = strdup(name)) == NULL) {
+				fprintf(stderr, "Invalid output name %s for %s\n", patterns[j], b->inputs[i]);
+				r = -1;
+				continue;
+			}
+			all[cnt].name = b->in[i].names[j];
+			all[cnt++].input = i;
+		}
+#if defined(__linux__)
+		batch_add_disk(b, i, b->inputs[i], false);
+		for(int j = 0; j < OUT_CNT; j++) {
+			if (b->in[i].names[j]) batch_add_disk(b, i, b->in[i].names[j], true);
+		}
+#endif
+	}
+	qsort(all, cnt, sizeof(batch_name_t), batch_name_cmp);
+	for(size_t k = 1; k < cnt; k++) {
+		if (strcmp(all[k].name, all[k-1].name) != 0) continue;
+		if (all[k].input == all[k-1].input) fprintf(stderr, "Output %s of %s is used twice\n", all[k].name, b->inputs[all[k].input]);
+		else fprintf(stderr, "Output %s is used by %s and %s\n", all[k].name, b->inputs[all[k-1].input], b->inputs[all[k].input]);
+		r = -1;
+	}
+	free(all);
+	return r;
+}
+
+// jobs that can run at the same time because of the hard disks, INT_MAX if not limited
+static int batch_disk_jobs(const batch_t *b)
+{
+	if (b->per_disk == 0 || b->disk_cnt == 0) return INT_MAX;
+	for(size_t i = 0; i < b->input_cnt; i++) {
+		if (b->in[i].disk_cnt == 0) return INT_MAX;
+	}
+	return b->disk_cnt * b->per_disk;
+}
+
+static void batch_free(batch_t *b)
+{
+	if (!b->in) return;
+	for(size_t i = 0; i < b->input_cnt; i++) {
+		for(int j = 0; j < OUT_CNT; j++) free(b->in[i].names[j]);
+	}
+	free(b->in);
+}
+
+static void add_input(char *name, char ***inputs, size_t *cnt, size_t *size)
+{
+	if (*cnt == *size) {
+		*size = (*size) ? *size * 2 : 64;
+		*inputs = realloc(*inputs, *size * sizeof(char*));
+		if (!*inputs) {
+			fprintf(stderr, "Failed to allocate file list\n");
+			exit(1);
+		}
+	}
+	(*inputs)[(*cnt)++] = name;
+}
+
+// add the files of a manifest, one file per line, empty lines and lines starting with # are skipped
+static int read_manifest(char *name, char ***inputs, size_t *cnt, size_t *size)
+{
+	char line[4096], *name_copy;
+	size_t len;
+	int r = 0;
+	FILE *f = (strcmp(name, "-") == 0) ? stdin : fopen(name, "r");
+	if (!f) return -1;
+	while(fgets(line, sizeof(line), f)) {
+		len = strlen(line);
+		while(len > 0 && (line[len-1] == '\n' || line[len-1] == '\r')) line[--len] = '\0';
+		if (len == 0 || line[0] == '#') continue;
+		if (!(name_copy = strdup(line))) {
+			r = -1;
+			break;
+		}
+		add_input(name_copy, inputs, cnt, size);
+	}
+	if (f != stdin) fclose(f);
+	return r;
+}
+
+/* --benchmark: compression ratio and speed of the RF codecs on a part of a
+ * capture, every codec runs in the calling thread only, so the speed is per
+ * core. The samples are loaded into memory first, the input is not timed.
+ * The resampling of misrc_capture is measured the same way. */
+
+#define BENCH_SAMPLES (1<<26)  // default, about 1.7 s at 40 MSPS
+#define BENCH_BLOCK   65536    // samples resampled at once
+
+static const double bench_rates[] = { 20000.0, 16000.0, 40000.0 / 3, 10000.0, 8000.0 };
+static const char *bench_quals[RFD_QUALITIES] = { "QQ", "LQ", "MQ", "HQ", "VHQ" };
+
+// read up to count samples from start, returns the number of samples or -1 on error
+static int64_t bench_load(const extract_settings_t *set, char *input_name, int16_t *smp, size_t count)
+{
+	size_t got = 0;
+	FILE *f;
+	if (set->in_format == FORMAT_S16) {
+		if ((f = fopen(input_name, "rb")) == NULL) return -1;
+		if (fseeko(f, set->start * 2, SEEK_SET) == 0) got = fread(smp, 2, count, f);
+		fclose(f);
+		return got;
+	}
+#if LIBFLAC_ENABLED == 1
+	if (set->in_format == FORMAT_FLAC) {
+		flac_decode_t d;
+		FLAC__StreamDecoder *decoder = FLAC__stream_decoder_new();
+		bool ok;
+		memset(&d, 0, sizeof(d));
+		d.buf = smp;
+		d.want = count;
+		if (!decoder) return -1;
+		ok = FLAC__stream_decoder_init_file(decoder, input_name, flac_decode_write, flac_decode_metadata, flac_decode_error, &d) == FLAC__STREAM_DECODER_INIT_STATUS_OK
+			&& FLAC__stream_decoder_process_until_end_of_metadata(decoder);
+		if (ok && set->start > 0) ok = FLAC__stream_decoder_seek_absolute(decoder, set->start);
+		while (ok && d.got < d.want && !d.error && FLAC__stream_decoder_get_state(decoder) != FLAC__STREAM_DECODER_END_OF_STREAM) {
+			ok = FLAC__stream_decoder_process_single(decoder);
+		}
+		FLAC__stream_decoder_delete(decoder);
+		return (ok && !d.error) ? (int64_t)d.got : -1;
+	}
+#endif
+	if (set->in_format == FORMAT_MRC) {
+		rfc_stream_t s;
+		rfc_decoder_t dec;
+		int16_t *chunk = malloc(RFC_CHUNK_SAMPLES * sizeof(int16_t));
+		size_t skip, n;
+		int r = RFC_ERR_MEMORY;
+		memset(&s, 0, sizeof(s));
+		memset(&dec, 0, sizeof(dec));
+		if ((f = fopen(input_name, "rb")) == NULL) {
+			free(chunk);
+			return -1;
+		}
+		if (chunk && ((r = rfc_stream_read(&s, f)) == 0 || r == RFC_ERR_TRUNCATED) && (r = rfc_decoder_init(&dec)) == 0) {
+			for(size_t i = rfc_find_chunk(&s, set->start); i < s.chunks && got < count; i++) {
+				if ((r = rfc_decode_chunk(&dec, &s, f, i, chunk)) != 0) break;
+				skip = (set->start + got > s.index[i].first_sample) ? set->start + got - s.index[i].first_sample : 0;
+				n = (s.index[i].samples > skip) ? s.index[i].samples - skip : 0;
+				if (n > count - got) n = count - got;
+				memcpy(&smp[got], &chunk[skip], n * sizeof(int16_t));
+				got += n;
+			}
+		}
+		rfc_decoder_free(&dec);
+		if (r != 0) fprintf(stderr, "Failed to read container %s: %s\n", input_name, rfc_strerror(r));
+		rfc_stream_free(&s);
+		fclose(f);
+		free(chunk);
+		return (r == 0) ? (int64_t)got : -1;
+	}
+	return -1;
+}
+
+static void bench_print(const char *name, size_t samples, uint64_t bytes, uint64_t enc_ns, uint64_t dec_ns)
+{
+	double mb = samples * 2 / 1e6;
+	printf("%-18s %6.1f %%  %9.1f  %8.2f", name, 100.0 * bytes / (samples * 2), mb / (enc_ns / 1e9), samples / (enc_ns / 1e9) / 40e6);
+	if (dec_ns > 0) printf("  %9.1f", mb / (dec_ns / 1e9));
+	printf("\n");
+}
+
+// speed and filter response of the built-in decimator, and the speed of libsoxr for comparison
+static void bench_resample(const int16_t *smp, int64_t n, uint32_t bits)
+{
+	int16_t *out = malloc((BENCH_BLOCK + 64) * sizeof(int16_t));
+	double passband, ripple, rejection;
+	uint64_t t, ns;
+	char name[32];
+#if LIBSOXR_ENABLED == 1
+	const unsigned long soxr_qual[RFD_QUALITIES] = { SOXR_QQ, SOXR_LQ, SOXR_MQ, SOXR_HQ, SOXR_VHQ };
+#endif
+	if (!out) return;
+	printf("\nbuilt-in decimator, passband in MHz, ripple and alias rejection in dB, speed in MB/s of the input\n\n");
+#if LIBSOXR_ENABLED == 1
+	printf("%-18s %8s  %7s  %9s  %9s  %8s  %9s\n", "resample", "passband", "ripple", "rejection", "MB/s", "realtime", "soxr MB/s");
+#else
+	printf("%-18s %8s  %7s  %9s  %9s  %8s\n", "resample", "passband", "ripple", "rejection", "MB/s", "realtime");
+#endif
+	for(size_t r = 0; r < sizeof(bench_rates) / sizeof(bench_rates[0]); r++) {
+		for(int q = 0; q < RFD_QUALITIES; q++) {
+			rfd_t d;
+			size_t len;
+			if (rfd_init(&d, 40000.0, bench_rates[r], q, 1.0, bits, false) != 0) {
+				fprintf(stderr, "Failed initializing the decimator\n");
+				continue;
+			}
+			t = time_ns(CLOCK_THREAD_CPUTIME_ID);
+			for(int64_t i = 0; i < n; i += len) {
+				len = (n - i < BENCH_BLOCK) ? (size_t)(n - i) : BENCH_BLOCK;
+				rfd_process(&d, &smp[i], len, out);
+			}
+			ns = time_ns(CLOCK_THREAD_CPUTIME_ID) - t;
+			rfd_response(&d, &passband, &ripple, &rejection);
+			rfd_free(&d);
+			snprintf(name, sizeof(name), "%.0f kHz %s", bench_rates[r], bench_quals[q]);
+			printf("%-18s %8.2f  %7.4f  %9.1f  %9.1f  %8.2f", name, passband * 40.0, ripple, rejection, n * 2 / 1e6 / (ns / 1e9), n / (ns / 1e9) / 40e6);
+#if LIBSOXR_ENABLED == 1
+			{
+				soxr_error_t err;
+				soxr_io_spec_t io_spec = soxr_io_spec(SOXR_INT16_S, SOXR_INT16_S);
+				soxr_quality_spec_t qual_spec = soxr_quality_spec(soxr_qual[q], 0);
+				soxr_t soxr = soxr_create(40000.0, bench_rates[r], 1, &err, &io_spec, &qual_spec, NULL);
+				size_t done, out_len;
+				if (soxr && err == 0) {
+					t = time_ns(CLOCK_THREAD_CPUTIME_ID);
+					for(int64_t i = 0; i < n && err == 0; i += done) {
+						const void *in = &smp[i];
+						len = (n - i < BENCH_BLOCK) ? (size_t)(n - i) : BENCH_BLOCK;
+						err = soxr_process(soxr, &in, len, &done, &out, BENCH_BLOCK, &out_len);
+					}
+					ns = time_ns(CLOCK_THREAD_CPUTIME_ID) - t;
+					printf("  %9.1f", n * 2 / 1e6 / (ns / 1e9));
+				}
+				if (soxr) soxr_delete(soxr);
+			}
+#endif
+			printf("\n");
+		}
+	}
+	free(out);
+}
+
+static int benchmark(const extract_settings_t *set, char *input_name)
+{
+	size_t count = (set->count != UINT64_MAX) ? set->count : BENCH_SAMPLES;
+	int16_t *smp = NULL, *dec_smp = NULL;
+	uint8_t *out = NULL;
+	uint32_t bits = 12;
+	uint64_t bytes, enc_ns, dec_ns, t;
+	int64_t n;
+	int ret = -EIO;
+	char name[32];
+	bool padded = true;
+
+	if ((smp = malloc(count * sizeof(int16_t))) == NULL || (dec_smp = malloc(RFC_CHUNK_SAMPLES * sizeof(int16_t))) == NULL
+		|| (out = malloc(RFC_CHUNK_MAX)) == NULL) {
+		fprintf(stderr, "Not enough memory for %zu samples\n", count);
+		ret = -ENOMEM;
+		goto end;
+	}
+	if ((n = bench_load(set, input_name, smp, count)) <= 0) {
+		fprintf(stderr, "Failed to read samples from %s\n", input_name);
+		goto end;
+	}
+	// 12 bit RF, unpadded or padded, otherwise it is treated as 16 bit
+	for(int64_t i = 0; i < n; i++) {
+		if (smp[i] < -2048 || smp[i] > 2047) bits = 16;
+		if (smp[i] & 15) padded = false;
+	}
+	if (bits == 16 && padded) {
+		for(int64_t i = 0; i < n; i++) smp[i] >>= 4;
+		bits = 12;
+	}
+	printf("%" PRId64 " samples (%u bit) of %s, one thread per codec\n", n, bits, input_name);
+	printf("size in percent and speed in MB/s of the 16 bit samples, speed relative to 40 MSPS\n\n");
+	printf("%-18s %8s  %9s  %8s  %9s\n", "codec", "size", "enc MB/s", "realtime", "dec MB/s");
+
+#if LIBFLAC_ENABLED == 1
+	{
+		// the same segments misrc_extract encodes
+		FLAC__StreamEncoder *encoder = FLAC__stream_encoder_new();
+		int32_t *buf32 = aligned_alloc(16, sizeof(int32_t)*BUFFER_SIZE);
+		flac_segment_t seg;
+		size_t len;
+		memset(&seg, 0, sizeof(seg));
+		seg.size = out_bytes(FORMAT_FLAC, BUFFER_SIZE);
+		seg.buf = malloc(seg.size);
+		seg.seek_spacing = FLAC_STITCH_SEEKSPACING;
+		for(uint32_t level = 0; level <= 8 && encoder && buf32 && seg.buf; level++) {
+			bytes = 0;
+			t = time_ns(CLOCK_THREAD_CPUTIME_ID);
+			for(int64_t i = 0; i < n; i += len) {
+				len = (n - i < BUFFER_SIZE) ? (size_t)(n - i) : (BUFFER_SIZE);
+				seg.first_sample = i;
+				seg.samples = len;
+				if (flac_segment_encode(encoder, &seg, &smp[i], buf32, level, bits, FLAC_SAMPLE_RATE) != 0) {
+					fprintf(stderr, "FLAC encoder could not process data\n");
+					break;
+				}
+				bytes += seg.len;
+			}
+			enc_ns = time_ns(CLOCK_THREAD_CPUTIME_ID) - t;
+			snprintf(name, sizeof(name), "flac level %u", level);
+			bench_print(name, n, bytes, enc_ns, 0);
+		}
+		if (encoder) FLAC__stream_encoder_delete(encoder);
+		if (buf32) aligned_free(buf32);
+		free(seg.buf);
+	}
+#endif
+
+	for(int codec = RFC_CODEC_ZSTD; codec < RFC_CODEC_CNT; codec++) {
+		rfc_encoder_t enc;
+		rfc_decoder_t dec;
+		size_t len, chunk;
+		bool ok = true;
+		if (!rfc_codec_name(codec)) continue;
+		if (rfc_encoder_init(&enc, codec, 1, 1) != 0) {
+			fprintf(stderr, "Failed initializing %s\n", rfc_codec_name(codec));
+			continue;
+		}
+		if (rfc_decoder_init(&dec) != 0) {
+			fprintf(stderr, "Failed initializing %s\n", rfc_codec_name(codec));
+			rfc_encoder_free(&enc);
+			rfc_decoder_free(&dec);
+			continue;
+		}
+		bytes = 0;
+		enc_ns = 0;
+		dec_ns = 0;
+		// every chunk is decoded and compared right after it was encoded
+		for(int64_t i = 0; i < n && ok; i += chunk) {
+			chunk = (n - i < RFC_CHUNK_SAMPLES) ? (size_t)(n - i) : RFC_CHUNK_SAMPLES;
+			t = time_ns(CLOCK_THREAD_CPUTIME_ID);
+			rfc_encode(&enc, &smp[i], chunk, i, out, &len);
+			enc_ns += time_ns(CLOCK_THREAD_CPUTIME_ID) - t;
+			t = time_ns(CLOCK_THREAD_CPUTIME_ID);
+			ok = rfc_decode(&dec, out, len, dec_smp) == 0;
+			dec_ns += time_ns(CLOCK_THREAD_CPUTIME_ID) - t;
+			ok = ok && memcmp(dec_smp, &smp[i], chunk * sizeof(int16_t)) == 0;
+			bytes += len;
+		}
+		if (!ok) fprintf(stderr, "%s: decoded samples do not match\n", rfc_codec_name(codec));
+		snprintf(name, sizeof(name), (codec == RFC_CODEC_RICE) ? "mrc %s" : "mrc %s level 1", rfc_codec_name(codec));
+		bench_print(name, n, bytes, enc_ns, dec_ns);
+		rfc_encoder_free(&enc);
+		rfc_decoder_free(&dec);
+	}
+	bench_resample(smp, n, bits);
+	ret = 0;
+end:
+	free(smp);
+	free(dec_smp);
+	free(out);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+//set pipe mode to binary in windows
+#if defined(_WIN32) || defined(_WIN64)
+	_setmode(_fileno(stdout), O_BINARY);
+	_setmode(_fileno(stdin), O_BINARY);
+#endif
+
+	int opt, r;
+	int jobs = 2, per_disk = 1;
+	extract_settings_t set = {
+		.in_format = FORMAT_RAW32,
+		.out_format = FORMAT_S16,
+		.in_mode = INPUT_AUTO,
+		.flac_level = 1,
+		.rounding_8bit = EXTRACT_8BIT_ROUND,
+		.start = 0,
+		.count = UINT64_MAX,
+		.check_md5 = true
+	};
+	struct option long_options[] = {
+		{ "start", required_argument, 0, OPT_START },
+		{ "count", required_argument, 0, OPT_COUNT },
+#if LIBFLAC_ENABLED == 1
+		{ "no-md5", no_argument, 0, OPT_NO_MD5 },
+		{ "verify", no_argument, 0, OPT_VERIFY },
+#endif
+		{ "benchmark", no_argument, 0, OPT_BENCHMARK },
+		{ "manifest", required_argument, 0, OPT_MANIFEST },
+		{ "stats", no_argument, 0, OPT_STATS },
+		{ "stats-json", required_argument, 0, OPT_STATS_JSON },
+		{ "direct-write", no_argument, 0, OPT_DIRECT_WRITE },
+		{ "pipe-zerocopy", no_argument, 0, OPT_PIPE_ZEROCOPY },
+		{ "8bit-rounding", required_argument, 0, OPT_8BIT_ROUNDING },
+		{ "jobs-per-disk", required_argument, 0, OPT_JOBS_PER_DISK },
+#if LIBURING_ENABLED == 1
+		{ "io-uring", no_argument, 0, OPT_IO_URING },
+#endif
+		{ NULL, 0, 0, 0 }
+	};
+
+	//file adress
+	char *input_name_1    = NULL;
+	char *output_names[OUT_CNT] = { NULL, NULL, NULL };
+	char *manifest = NULL;
+	char *stats_json = NULL;
+
+	// batch mode
+	batch_t batch;
+	char **inputs = NULL;
+	size_t input_cnt = 0, inputs_size = 0, manifest_cnt;
+	thrd_t thread_batch[MAX_THREADS];
+	extract_settings_t batch_set;
+	struct timespec t_start, t_stop;
+	double seconds;
+#ifndef _WIN32
+	glob_t g;
+	int glob_flags = 0;
+#endif
+
+	fprintf(stderr,
+		"MISRC extract " MIRSC_TOOLS_VERSION "\n"
+		MIRSC_TOOLS_COPYRIGHT "\n\n"
+	);
+
+	while ((opt = getopt_long(argc, argv, "i:a:b:x:psI:F:Dt:m:l:j:h", long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'i':
+			input_name_1 = optarg;
+			break;
+		case 'a':
+			output_names[OUT_A] = optarg;
+			break;
+		case 'b':
+			output_names[OUT_B] = optarg;
+			break;
+		case 'x':
+			output_names[OUT_AUX] = optarg;
+			break;
+		case 'p':
+			set.pad = true;
+			break;
+		case 's':
+			set.single = true;
+			break;
+		case 'I':
+			if (strcmp(optarg, "raw32") == 0) set.in_format = FORMAT_RAW32;
+			else if (strcmp(optarg, "raw16") == 0) set.in_format = FORMAT_RAW16;
+			else if (strcmp(optarg, "s12p") == 0) set.in_format = FORMAT_S12P;
+			else if (strcmp(optarg, "s16") == 0) set.in_format = FORMAT_S16;
+#if LIBFLAC_ENABLED == 1
+			else if (strcmp(optarg, "flac") == 0) set.in_format = FORMAT_FLAC;
+#endif
+			else if (strcmp(optarg, "mrc") == 0) set.in_format = FORMAT_MRC;
+			else usage();
+			break;
+		case 'F':
+			if (strcmp(optarg, "s16") == 0) set.out_format = FORMAT_S16;
+			else if (strcmp(optarg, "s12p") == 0) set.out_format = FORMAT_S12P;
+			else if (strcmp(optarg, "s8") == 0) set.out_format = FORMAT_S8;
+			else if (strcmp(optarg, "f32") == 0) set.out_format = FORMAT_F32;
+			else if (strcmp(optarg, "f32raw") == 0) set.out_format = FORMAT_F32R;
+#if LIBFLAC_ENABLED == 1
+			else if (strcmp(optarg, "flac") == 0) set.out_format = FORMAT_FLAC;
+#endif
+			else usage();
+			break;
+#if LIBFLAC_ENABLED == 1
+		case 'l':
+			set.flac_level = atoi(optarg);
+			if (set.flac_level > 8) usage();
+			break;
+#endif
+		case 'D':
+			set.dc_removal = true;
+			break;
+		case 't':
+			set.threads = atoi(optarg);
+			if (set.threads < 0 || set.threads > MAX_THREADS) usage();
+			break;
+		case 'm':
+			if (strcmp(optarg, "auto") == 0) set.in_mode = INPUT_AUTO;
+			else if (strcmp(optarg, "read") == 0) set.in_mode = INPUT_READ;
+			else if (strcmp(optarg, "mmap") == 0) set.in_mode = INPUT_MMAP;
+			else if (strcmp(optarg, "direct") == 0) set.in_mode = INPUT_DIRECT;
+			else usage();
+			break;
+		case 'j':
+			jobs = atoi(optarg);
+			if (jobs < 1 || jobs > MAX_THREADS) usage();
+			break;
+		case OPT_JOBS_PER_DISK:
+			per_disk = atoi(optarg);
+			if (per_disk < 0 || per_disk > MAX_THREADS) usage();
+			break;
+		case OPT_START:
+			if (parse_sample_pos(optarg, &set.start) != 0) usage();
+			break;
+		case OPT_COUNT:
+			if (parse_sample_pos(optarg, &set.count) != 0) usage();
+			break;
+#if LIBFLAC_ENABLED == 1
+		case OPT_NO_MD5:
+			set.check_md5 = false;
+			break;
+		case OPT_VERIFY:
+			set.verify = true;
+			break;
+#endif
+		case OPT_BENCHMARK:
+			set.benchmark = true;
+			break;
+		case OPT_MANIFEST:
+			manifest = optarg;
+			break;
+		case OPT_STATS:
+			set.stats = true;
+			break;
+		case OPT_STATS_JSON:
+			stats_json = optarg;
+			break;
+		case OPT_DIRECT_WRITE:
+			set.direct_write = true;
+			break;
+		case OPT_PIPE_ZEROCOPY:
+			set.pipe_zerocopy = true;
+			break;
+		case OPT_8BIT_ROUNDING:
+			if (strcmp(optarg, "truncate") == 0) set.rounding_8bit = EXTRACT_8BIT_TRUNCATE;
+			else if (strcmp(optarg, "round") == 0) set.rounding_8bit = EXTRACT_8BIT_ROUND;
+			else if (strcmp(optarg, "dither") == 0) set.rounding_8bit = EXTRACT_8BIT_DITHER;
+			else usage();
+			break;
+#if LIBURING_ENABLED == 1
+		case OPT_IO_URING:
+			set.io_uring = true;
+			break;
+#endif
+		case 'h':
+		default:
+			usage();
+			break;
+		}
+	}
+
+	// the remaining arguments are the input files of batch mode
+	if (manifest && read_manifest(manifest, &inputs, &input_cnt, &inputs_size) != 0) {
+		fprintf(stderr, "Failed to read manifest %s\n", manifest);
+		return -ENOENT;
+	}
+	manifest_cnt = input_cnt;
+	for(; optind < argc; optind++) {
+#ifndef _WIN32
+		// patterns that were quoted to avoid the argument limit of the shell
+		if (strpbrk(argv[optind], "*?[")) {
+			// all patterns go to one list, the file names are referenced until the batch is done
+			size_t first = (glob_flags) ? g.gl_pathc : 0;
+			r = glob(argv[optind], glob_flags, NULL, &g);
+			glob_flags = GLOB_APPEND;
+			if (r != 0) {
+				fprintf(stderr, "No files match %s\n", argv[optind]);
+				continue;
+			}
+			for(size_t i = first; i < g.gl_pathc; i++) add_input(g.gl_pathv[i], &inputs, &input_cnt, &inputs_size);
+			continue;
+		}
+#endif
+		add_input(argv[optind], &inputs, &input_cnt, &inputs_size);
+	}
+	if (inputs && input_name_1) usage();
+	if (inputs && input_cnt == 0) {
+		fprintf(stderr, "No input files\n");
+		return -ENOENT;
+	}
+
+	// only FLAC files can be verified
+	if (set.verify) set.in_format = FORMAT_FLAC;
+	if (set.in_format == FORMAT_RAW16) set.single = true;
+
+	if (set.benchmark) {
+		if (!input_name_1 || strcmp(input_name_1, "-") == 0 || output_names[OUT_A] != NULL || output_names[OUT_B] != NULL || output_names[OUT_AUX] != NULL
+			|| set.verify || (set.in_format != FORMAT_S16 && set.in_format != FORMAT_FLAC && set.in_format != FORMAT_MRC))
+		{
+			fprintf(stderr, "--benchmark reads a 16 bit RF, FLAC or container file (-I s16, flac or mrc) and has no output\n");
+			usage();
+		}
+		return benchmark(&set, input_name_1);
+	}
+
+	if(((input_name_1 == NULL && !inputs) || (output_names[OUT_A] == NULL && output_names[OUT_B] == NULL && output_names[OUT_AUX] == NULL && !set.verify))
+		|| (set.single == 1 && output_names[OUT_B] != NULL))
+	{
+		usage();
+	}
+
+	if (set.verify && (output_names[OUT_A] != NULL || output_names[OUT_B] != NULL || output_names[OUT_AUX] != NULL || set.start != 0 || set.count != UINT64_MAX
+		|| (input_name_1 && strcmp(input_name_1, "-") == 0)))
+	{
+		fprintf(stderr, "--verify checks whole FLAC files and has no output\n");
+		usage();
+	}
+
+	if (set.in_format == FORMAT_S12P && (set.single || set.out_format != FORMAT_S16 || output_names[OUT_A] == NULL || output_names[OUT_B] != NULL || output_names[OUT_AUX] != NULL))
+	{
+		fprintf(stderr, "Packed 12 bit input can only be unpacked to 16 bit ADC A output (-a)\n");
+		usage();
+	}
+
+	if (set.out_format == FORMAT_S12P && set.pad)
+	{
+		fprintf(stderr, "Packed 12 bit output cannot be padded\n");
+		usage();
+	}
+
+	if (set.out_format == FORMAT_S8 && (set.pad || set.single))
+	{
+		fprintf(stderr, "8 bit output cannot be padded or extracted from single channel captures\n");
+		usage();
+	}
+
+	if ((set.out_format == FORMAT_F32 || set.out_format == FORMAT_F32R) && (set.pad || set.single))
+	{
+		fprintf(stderr, "Float output cannot be padded or extracted from single channel captures\n");
+		usage();
+	}
+
+	if (set.dc_removal && set.out_format != FORMAT_F32 && set.out_format != FORMAT_F32R)
+	{
+		fprintf(stderr, "DC removal is only possible for float output\n");
+		usage();
+	}
+
+	if (set.in_format == FORMAT_S16 && (set.out_format != FORMAT_FLAC || output_names[OUT_A] == NULL || output_names[OUT_B] != NULL || output_names[OUT_AUX] != NULL))
+	{
+		fprintf(stderr, "16 bit input can only be encoded to FLAC ADC A output (-a)\n");
+		usage();
+	}
+
+	if (set.in_format == FORMAT_FLAC && !set.verify && (set.out_format != FORMAT_S16 || output_names[OUT_A] == NULL || output_names[OUT_B] != NULL || output_names[OUT_AUX] != NULL || (input_name_1 && strcmp(input_name_1, "-") == 0)))
+	{
+		fprintf(stderr, "FLAC input has to be a file and can only be decoded to 16 bit ADC A output (-a)\n");
+		usage();
+	}
+
+	if (set.in_format == FORMAT_MRC && (set.out_format != FORMAT_S16 || output_names[OUT_A] == NULL || output_names[OUT_B] != NULL || output_names[OUT_AUX] != NULL || (input_name_1 && strcmp(input_name_1, "-") == 0)))
+	{
+		fprintf(stderr, "Container input has to be a file and can only be decoded to 16 bit ADC A output (-a)\n");
+		usage();
+	}
+
+	if (set.out_format == FORMAT_FLAC && ((output_names[OUT_A] != NULL && strcmp(output_names[OUT_A], "-") == 0) || (output_names[OUT_B] != NULL && strcmp(output_names[OUT_B], "-") == 0)))
+	{
+		fprintf(stderr, "FLAC output has to be written to a file, as the header is written last\n");
+		usage();
+	}
+
+	if (set.threads == 0) {
+		// leave one core for the reader and one for the writers
+		set.threads = get_num_cores() - 2;
+		if (set.threads < 1) set.threads = 1;
+		if (set.threads > MAX_THREADS) set.threads = MAX_THREADS;
+	}
+
+	if (stats_json) {
+		set.stats_json = fopen(stats_json, "a");
+		if (!set.stats_json) {
+			fprintf(stderr, "Failed to open %s\n", stats_json);
+			return -ENOENT;
+		}
+	}
+
+	if (!inputs) {
+		r = extract_file(&set, input_name_1, output_names, NULL);
+		if (set.stats_json) fclose(set.stats_json);
+		return r;
+	}
+
+	for(int j = 0; j < OUT_CNT; j++) {
+		if (!output_names[j]) continue;
+		if (strcmp(output_names[j], "-") == 0 || (input_cnt > 1 && !strstr(output_names[j], "%n") && !strstr(output_names[j], "%f"))) {
+			fprintf(stderr, "Output names of batch mode have to contain %%n or %%f\n");
+			usage();
+		}
+	}
+
+	memset(&batch, 0, sizeof(batch));
+	batch.set = &batch_set;
+	batch.inputs = inputs;
+	batch.input_cnt = input_cnt;
+	batch.per_disk = per_disk;
+	if (batch_prepare(&batch, output_names) != 0) {
+		batch_free(&batch);
+		if (set.stats_json) fclose(set.stats_json);
+		for(size_t i = 0; i < manifest_cnt; i++) free(inputs[i]);
+		free(inputs);
+#ifndef _WIN32
+		if (glob_flags) globfree(&g);
+#endif
+		return -EINVAL;
+	}
+	// if every file uses a hard disk, no more jobs than the disks allow can run
+	if (batch_disk_jobs(&batch) < jobs) jobs = batch_disk_jobs(&batch);
+
+	// the conversion threads are shared by the jobs
+	if ((size_t)jobs > input_cnt) jobs = input_cnt;
+	batch_set = set;
+	batch_set.threads = set.threads / jobs;
+	if (batch_set.threads < 1) batch_set.threads = 1;
+	fprintf(stderr, "Batch of %zu files, %d jobs with %d conversion threads each", input_cnt, jobs, batch_set.threads);
+	if (batch.disk_cnt > 0 && per_disk > 0) fprintf(stderr, ", at most %d per hard disk (%d hard disks)", per_disk, batch.disk_cnt);
+	fprintf(stderr, "\n");
+
+	clock_gettime(CLOCK_MONOTONIC, &t_start);
+	for(int i = 0; i < jobs; i++) {
+		r = thrd_create(&thread_batch[i], batch_thread, &batch);
+		if (r != thrd_success) {
+			fprintf(stderr, "Failed to create thread\n");
+			jobs = i;
+			break;
+		}
+	}
+	for(int i = 0; i < jobs; i++) {
+		thrd_join(thread_batch[i], NULL);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t_stop);
+	seconds = (t_stop.tv_sec - t_start.tv_sec) + (t_stop.tv_nsec - t_start.tv_nsec) / 1e9;
+
+	fprintf(stderr, "%zu of %zu files extracted, %" PRIu64 " samples in %.1f s (%.1f MS/s, %.1f MB/s)\n",
+		input_cnt - batch.failed, input_cnt, (uint64_t)batch.samples, seconds, batch.samples / seconds / 1e6, batch.bytes / seconds / 1e6);
+	if (set.stats_json) fclose(set.stats_json);
+	batch_free(&batch);
+	for(size_t i = 0; i < manifest_cnt; i++) free(inputs[i]);
+	free(inputs);
+#ifndef _WIN32
+	if (glob_flags) globfree(&g);
+#endif
+
+	return (batch.failed > 0 || jobs == 0) ? -EIO : 0;
+}
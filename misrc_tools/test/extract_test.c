@@ -35,6 +35,14 @@ typedef struct {
 	uint8_t pl_cmp;
 } conv_test_t;
 
+typedef struct {
+	conv_float_function_t C;
+	conv_float_function_t S;
+	uint8_t a_cmp;
+	uint8_t b_cmp;
+	uint8_t pl_cmp;
+} conv_float_test_t;
+
 int main() {
 	FILE *rnd;
 	void *buf;
@@ -83,7 +91,38 @@ int main() {
 		/*34*/ {extract_AB_peak_32_C, extract_AB_peak_32_sse, 16, 64, 64, 1 },
 		/*35*/ {extract_A_p_peak_32_C, extract_A_p_peak_32_sse, 16, 64, 0, 1 },
 		/*36*/ {extract_B_p_peak_32_C, extract_B_p_peak_32_sse, 16, 0, 64, 1 },
-		/*37*/ {extract_AB_p_peak_32_C, extract_AB_p_peak_32_sse, 16, 64, 64, 1 }
+		/*37*/ {extract_AB_p_peak_32_C, extract_AB_p_peak_32_sse, 16, 64, 64, 1 },
+		/*38*/ {extract_A_12p_C, extract_A_12p_sse, BUFSIZE>>2, (BUFSIZE>>3)*3, 0, 0 },
+		/*39*/ {extract_B_12p_C, extract_B_12p_sse, BUFSIZE>>2, 0, (BUFSIZE>>3)*3, 0 },
+		/*40*/ {extract_AB_12p_C, extract_AB_12p_sse, BUFSIZE>>2, (BUFSIZE>>3)*3, (BUFSIZE>>3)*3, 0 },
+		/*41*/ {extract_S_12p_C, extract_S_12p_sse, BUFSIZE>>2, (BUFSIZE>>3)*3, 0, 0 },
+		/*42*/ {extract_A_peak_12p_C, extract_A_peak_12p_sse, BUFSIZE>>2, (BUFSIZE>>3)*3, 0, 1 },
+		/*43*/ {extract_B_peak_12p_C, extract_B_peak_12p_sse, BUFSIZE>>2, 0, (BUFSIZE>>3)*3, 1 },
+		/*44*/ {extract_AB_peak_12p_C, extract_AB_peak_12p_sse, BUFSIZE>>2, (BUFSIZE>>3)*3, (BUFSIZE>>3)*3, 1 },
+		/*45*/ {extract_A_8t_C, extract_A_8t_sse, BUFSIZE>>2, BUFSIZE>>2, 0, 0 },
+		/*46*/ {extract_B_8t_C, extract_B_8t_sse, BUFSIZE>>2, 0, BUFSIZE>>2, 0 },
+		/*47*/ {extract_AB_8t_C, extract_AB_8t_sse, BUFSIZE>>2, BUFSIZE>>2, BUFSIZE>>2, 0 },
+		/*48*/ {extract_A_8t_C, extract_A_8t_peak_sse, BUFSIZE>>2, BUFSIZE>>2, 0, 1 },
+		/*49*/ {extract_B_8t_C, extract_B_8t_peak_sse, BUFSIZE>>2, 0, BUFSIZE>>2, 1 },
+		/*50*/ {extract_AB_8t_C, extract_AB_8t_peak_sse, BUFSIZE>>2, BUFSIZE>>2, BUFSIZE>>2, 1 },
+		/*51*/ {extract_A_8r_C, extract_A_8r_sse, BUFSIZE>>2, BUFSIZE>>2, 0, 0 },
+		/*52*/ {extract_B_8r_C, extract_B_8r_sse, BUFSIZE>>2, 0, BUFSIZE>>2, 0 },
+		/*53*/ {extract_AB_8r_C, extract_AB_8r_sse, BUFSIZE>>2, BUFSIZE>>2, BUFSIZE>>2, 0 },
+		/*54*/ {extract_A_8r_C, extract_A_8r_peak_sse, BUFSIZE>>2, BUFSIZE>>2, 0, 1 },
+		/*55*/ {extract_B_8r_C, extract_B_8r_peak_sse, BUFSIZE>>2, 0, BUFSIZE>>2, 1 },
+		/*56*/ {extract_AB_8r_C, extract_AB_8r_peak_sse, BUFSIZE>>2, BUFSIZE>>2, BUFSIZE>>2, 1 },
+		/*57*/ {extract_A_8t_32_C, extract_A_8t_32_sse, BUFSIZE>>2, BUFSIZE, 0, 0 },
+		/*58*/ {extract_B_8t_32_C, extract_B_8t_32_sse, BUFSIZE>>2, 0, BUFSIZE, 0 },
+		/*59*/ {extract_AB_8t_32_C, extract_AB_8t_32_sse, BUFSIZE>>2, BUFSIZE, BUFSIZE, 0 },
+		/*60*/ {extract_A_8t_32_C, extract_A_8t_peak_32_sse, BUFSIZE>>2, BUFSIZE, 0, 1 },
+		/*61*/ {extract_B_8t_32_C, extract_B_8t_peak_32_sse, BUFSIZE>>2, 0, BUFSIZE, 1 },
+		/*62*/ {extract_AB_8t_32_C, extract_AB_8t_peak_32_sse, BUFSIZE>>2, BUFSIZE, BUFSIZE, 1 },
+		/*63*/ {extract_A_8r_32_C, extract_A_8r_32_sse, BUFSIZE>>2, BUFSIZE, 0, 0 },
+		/*64*/ {extract_B_8r_32_C, extract_B_8r_32_sse, BUFSIZE>>2, 0, BUFSIZE, 0 },
+		/*65*/ {extract_AB_8r_32_C, extract_AB_8r_32_sse, BUFSIZE>>2, BUFSIZE, BUFSIZE, 0 },
+		/*66*/ {extract_A_8r_32_C, extract_A_8r_peak_32_sse, BUFSIZE>>2, BUFSIZE, 0, 1 },
+		/*67*/ {extract_B_8r_32_C, extract_B_8r_peak_32_sse, BUFSIZE>>2, 0, BUFSIZE, 1 },
+		/*68*/ {extract_AB_8r_32_C, extract_AB_8r_peak_32_sse, BUFSIZE>>2, BUFSIZE, BUFSIZE, 1 }
 	};
 
 	fprintf(stderr,"Testing C and ASM extraction functions by comparison with random data.\n");
@@ -271,5 +310,88 @@ int main() {
 	}
 	fprintf(stderr, "SSE version was %.2fx faster\n", (double)(time_a)/(double)(time_b));
 
+	fprintf(stderr,"Test of C and ASM 12 bit unpacking functions with random data.\n");
+
+	time_start = clock();
+	convert_12pto16_C(buf,bufAa,BUFSIZE>>2);
+	time_end = clock();
+	time_a = time_end - time_start;
+	time_start = clock();
+	convert_12pto16_sse(buf,bufBa,BUFSIZE>>2);
+	time_end = clock();
+	time_b = time_end - time_start;
+	convert_12pto16_p_C(buf,bufAb,BUFSIZE>>2);
+	convert_12pto16_p_sse(buf,bufBb,BUFSIZE>>2);
+	{
+		int16_t *a = (int16_t*)bufAa;
+		int16_t *b = (int16_t*)bufBa;
+		int16_t *c = (int16_t*)bufAb;
+		int16_t *d = (int16_t*)bufBb;
+		fprintf(stderr,"Verify SSE version.\n");
+		for(size_t j=0; j<BUFSIZE>>2; j++) {
+			if (*a!=*b || *c!=*d) {
+				fprintf(stderr, "Incorrect Buffer B at word %i:\n", j);
+				fprintf(stderr, " %04x %04x %04x %04x\n",*a,*b,*c,*d);
+			}
+			a++;
+			b++;
+			c++;
+			d++;
+		}
+	}
+	fprintf(stderr, "SSE version was %.2fx faster\n", (double)(time_a)/(double)(time_b));
+
+	fprintf(stderr,"Test of C and ASM float extraction functions with random data.\n");
+
+	conv_float_test_t cvfs[] = {
+		/* 0*/ {extract_A_f32_C, extract_A_f32_sse, 1, 0, 0 },
+		/* 1*/ {extract_B_f32_C, extract_B_f32_sse, 0, 1, 0 },
+		/* 2*/ {extract_AB_f32_C, extract_AB_f32_sse, 1, 1, 0 },
+		/* 3*/ {extract_A_f32_C, extract_A_peak_f32_sse, 1, 0, 1 },
+		/* 4*/ {extract_B_f32_C, extract_B_peak_f32_sse, 0, 1, 1 },
+		/* 5*/ {extract_AB_f32_C, extract_AB_peak_f32_sse, 1, 1, 1 }
+	};
+
+	for(int i=0; i<sizeof(cvfs)/sizeof(cvfs[0]);i++) {
+		extract_float_state_t sta, stb;
+		fprintf(stderr,"Testing float %i...\n", i);
+		extract_float_init(&sta, true, true);
+		extract_float_init(&stb, true, true);
+		sta.dc[0] = stb.dc[0] = -0.5f;
+		sta.dc[1] = stb.dc[1] = 0.25f;
+		clipa[0] = clipa[1] = clipb[0] = clipb[1] = 0;
+		peaka[0] = peaka[1] = peakb[0] = peakb[1] = 0;
+		time_start = clock();
+		cvfs[i].C(buf,BUFSIZE>>2,clipa,bufAUXa,bufAa,bufBa,peaka,&sta);
+		time_end = clock();
+		time_a = time_end - time_start;
+		time_start = clock();
+		cvfs[i].S(buf,BUFSIZE>>2,clipb,bufAUXb,bufAb,bufBb,peakb,&stb);
+		time_end = clock();
+		time_b = time_end - time_start;
+		for(int c=0; c<2; c++) {
+			float *a = (c == 0) ? (float*)bufAa : (float*)bufBa;
+			float *b = (c == 0) ? (float*)bufAb : (float*)bufBb;
+			if (!((c == 0) ? cvfs[i].a_cmp : cvfs[i].b_cmp)) continue;
+			if(clipa[c] != clipb[c]) fprintf(stderr, "%i Incorrect Clip %c: %lu vs %lu\n", i, 'A'+c, clipa[c], clipb[c]);
+			if(sta.sum[c] != stb.sum[c]) fprintf(stderr, "%i Incorrect sum %c: %li vs %li\n", i, 'A'+c, sta.sum[c], stb.sum[c]);
+			if(cvfs[i].pl_cmp && peaka[c] != peakb[c]) fprintf(stderr, "%i Incorrect peak level %c: %u vs %u\n", i, 'A'+c, peaka[c], peakb[c]);
+			for(size_t j=0; j<BUFSIZE>>2; j++) {
+				if (a[j]!=b[j]) {
+					fprintf(stderr, "%i Incorrect Buffer %c at float %i:\n", i, 'A'+c, j);
+					fprintf(stderr, " %f %f\n",a[j],b[j]);
+				}
+			}
+		}
+		{
+			uint8_t *a = bufAUXa;
+			uint8_t *b = bufAUXb;
+			for(size_t j=0; j<BUFSIZE>>2; j++) {
+				if (a[j]!=b[j]) fprintf(stderr, "%i Incorrect AUX at byte %i: %02x %02x\n", i, j, a[j], b[j]);
+			}
+		}
+		fprintf(stderr, "%i: SSE version was %.2f times faster\n", i, (double)(time_a)/(double)(time_b));
+	}
+
 	free(buf);
 }
@@ -0,0 +1,248 @@
+/*
+* flac_fixed_test
+* Copyright (C) 2025  vrunk11, stefan_o
+*
+* This program will test the built-in FLAC encoder of misrc_capture by
+* decoding its streams with libFLAC, without libFLAC only the frame headers
+* and CRCs are checked
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "flac_fixed.h"
+#include "flac_stitch.h"
+#include "md5.h"
+#if LIBFLAC_ENABLED == 1
+#include "FLAC/stream_decoder.h"
+#endif
+
+#define BS FLAC_STITCH_BLOCKSIZE
+
+// content of each block of a stream
+enum { BLOCK_NOISE, BLOCK_CONSTANT, BLOCK_TONE, BLOCK_WALK };
+
+typedef struct {
+	uint32_t bits;
+	size_t samples;     // the last block is partial unless this is a multiple of BS
+	const char *desc;
+} fixed_test_t;
+
+typedef struct {
+	const uint8_t *buf;
+	size_t len;
+	size_t pos;
+	const int32_t *expected;
+	size_t n;
+	size_t decoded;
+	int errors;
+} decode_ctx_t;
+
+static uint32_t rnd_state = 12345;
+static uint32_t rnd(void)
+{
+	rnd_state = rnd_state * 1664525 + 1013904223;
+	return rnd_state >> 8;
+}
+
+static void fill_samples(int32_t *x, size_t n, uint32_t bits)
+{
+	int32_t max = (1 << (bits - 1)) - 1, min = -(1 << (bits - 1)), v = 0;
+	for(size_t i = 0; i < n; i++) {
+		switch((i / BS) % 4) {
+		case BLOCK_NOISE:
+			x[i] = (int32_t)(rnd() & ((1u << bits) - 1)) + min;
+			break;
+		case BLOCK_CONSTANT:
+			x[i] = max / 3;
+			break;
+		case BLOCK_TONE:
+			x[i] = (int32_t)lrint(max * 0.9 * sin(i * 0.01));
+			break;
+		default:
+			v += (int32_t)(rnd() % 9) - 4;
+			if (v > max) v = max;
+			if (v < min) v = min;
+			x[i] = v;
+			break;
+		}
+	}
+}
+
+// the frame header has to parse and both CRCs have to match
+static int check_frame(const uint8_t *frame, size_t len, uint64_t number, uint32_t samples)
+{
+	uint64_t num;
+	uint32_t blocksize;
+	bool variable;
+	if (flac_frame_header_read(frame, len, &num, &blocksize, &variable) != 0) return -1;
+	if (num != number || blocksize != samples || variable) return -1;
+	if (flac_crc16(0, frame, len - 2) != (uint16_t)((frame[len-2] << 8) | frame[len-1])) return -1;
+	return 0;
+}
+
+#if LIBFLAC_ENABLED == 1
+static FLAC__StreamDecoderReadStatus read_cb(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data)
+{
+	decode_ctx_t *d = client_data;
+	(void)decoder;
+	if (d->pos == d->len) {
+		*bytes = 0;
+		return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+	}
+	if (*bytes > d->len - d->pos) *bytes = d->len - d->pos;
+	memcpy(buffer, &d->buf[d->pos], *bytes);
+	d->pos += *bytes;
+	return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+}
+
+static FLAC__StreamDecoderWriteStatus write_cb(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 *const buffer[], void *client_data)
+{
+	decode_ctx_t *d = client_data;
+	(void)decoder;
+	for(uint32_t i = 0; i < frame->header.blocksize; i++) {
+		if (d->decoded + i >= d->n || buffer[0][i] != d->expected[d->decoded + i]) {
+			d->errors++;
+			break;
+		}
+	}
+	d->decoded += frame->header.blocksize;
+	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+static void error_cb(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data)
+{
+	decode_ctx_t *d = client_data;
+	(void)decoder;
+	fprintf(stderr, "    decoder error: %s\n", FLAC__StreamDecoderErrorStatusString[status]);
+	d->errors++;
+}
+
+// decode the stream with libFLAC, the samples and the MD5 signature have to match
+static int decode_stream(decode_ctx_t *d)
+{
+	FLAC__StreamDecoder *decoder = FLAC__stream_decoder_new();
+	FLAC__bool ok;
+	if (!decoder) return -1;
+	FLAC__stream_decoder_set_md5_checking(decoder, true);
+	if (FLAC__stream_decoder_init_stream(decoder, read_cb, NULL, NULL, NULL, NULL, write_cb, NULL, error_cb, d) != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+		FLAC__stream_decoder_delete(decoder);
+		return -1;
+	}
+	ok = FLAC__stream_decoder_process_until_end_of_stream(decoder);
+	// finish() fails if the MD5 signature does not match
+	ok &= FLAC__stream_decoder_finish(decoder);
+	FLAC__stream_decoder_delete(decoder);
+	return (ok && d->errors == 0 && d->decoded == d->n) ? 0 : -1;
+}
+#endif
+
+static int run_test(const fixed_test_t *t, flac_fixed_t *enc)
+{
+	size_t n = t->samples, frames = (n + BS - 1) / BS, frame_max = FLAC_FIXED_FRAME_MAX(t->bits), pos, bytes = (t->bits + 7) / 8;
+	int32_t *x = malloc(n * sizeof(int32_t));
+	uint8_t *out = malloc(frames * frame_max), *stream = NULL, *md5_buf = malloc(n * bytes);
+	size_t *len = malloc(frames * sizeof(size_t));
+	flac_stream_t s;
+	md5_ctx_t md5;
+	int r = -1;
+
+	if (!x || !out || !len || !md5_buf || flac_stream_init(&s, 40000, t->bits, 0) != 0) goto end;
+	fill_samples(x, n, t->bits);
+	if (flac_fixed_encode(enc, x, n, 0, out, len) != frames) goto end;
+
+	// STREAMINFO as written by misrc_capture
+	for(size_t i = 0; i < n; i++) {
+		md5_buf[i * bytes] = (uint8_t)x[i];
+		if (bytes == 2) md5_buf[i * bytes + 1] = (uint8_t)(x[i] >> 8);
+	}
+	md5_init(&md5);
+	md5_update(&md5, md5_buf, n * bytes);
+	md5_final(&md5, s.md5);
+	s.total_samples = n;
+	for(size_t i = 0; i < frames; i++) {
+		uint32_t samples = (n - i * BS < BS) ? n - i * BS : BS;
+		if (check_frame(&out[i * frame_max], len[i], i, samples) != 0) {
+			fprintf(stderr, "    frame %zu: invalid header or CRC\n", i);
+			goto end;
+		}
+		if (len[i] < s.min_framesize || s.min_framesize == 0) s.min_framesize = len[i];
+		if (len[i] > s.max_framesize) s.max_framesize = len[i];
+		s.stream_len += len[i];
+	}
+	if ((stream = malloc(flac_header_size(&s) + s.stream_len)) == NULL) goto end;
+	flac_write_header(&s, stream);
+	pos = flac_header_size(&s);
+	for(size_t i = 0; i < frames; i++) {
+		memcpy(&stream[pos], &out[i * frame_max], len[i]);
+		pos += len[i];
+	}
+#if LIBFLAC_ENABLED == 1
+	decode_ctx_t d = { stream, pos, 0, x, n, 0, 0 };
+	if (decode_stream(&d) != 0) {
+		fprintf(stderr, "    libFLAC: %zu of %zu samples decoded, %d errors\n", d.decoded, n, d.errors);
+		goto end;
+	}
+#endif
+	fprintf(stderr, "    %zu frames, %.2f bits per sample\n", frames, s.stream_len * 8.0 / n);
+	r = 0;
+end:
+	flac_stream_free(&s);
+	free(x);
+	free(out);
+	free(len);
+	free(md5_buf);
+	free(stream);
+	return r;
+}
+
+int main(void)
+{
+	const fixed_test_t tests[] = {
+		{  8, 4 * BS + 1000, "noise, constant, tone, random walk, partial block" },
+		{ 12, 4 * BS + 1000, "noise, constant, tone, random walk, partial block" },
+		{ 16, 4 * BS + 1000, "noise, constant, tone, random walk, partial block" },
+		{  8, 2 * BS + 3,    "noise, constant, 3 samples (verbatim)" },
+		{ 12, 2 * BS + 3,    "noise, constant, 3 samples (verbatim)" },
+		{ 16, 2 * BS + 3,    "noise, constant, 3 samples (verbatim)" },
+		{ 12, BS + 256,      "noise, constant block of 256 samples" },
+		{ 16, 8 * BS,        "only complete blocks" },
+	};
+	flac_fixed_t enc;
+	int fail = 0;
+
+#if LIBFLAC_ENABLED == 1
+	fprintf(stderr, "Decoding with libFLAC\n");
+#else
+	fprintf(stderr, "Built without libFLAC, only the frame headers and CRCs are checked\n");
+#endif
+	for(size_t i = 0; i < sizeof(tests)/sizeof(tests[0]); i++) {
+		fprintf(stderr, "%2u bit, %6zu samples: %s\n", tests[i].bits, tests[i].samples, tests[i].desc);
+		// several threads, like misrc_capture
+		if (flac_fixed_init(&enc, tests[i].bits, 2) != 0) {
+			fprintf(stderr, "    could not start the encoder threads\n");
+			return 1;
+		}
+		if (run_test(&tests[i], &enc) != 0) {
+			fprintf(stderr, "    FAILED\n");
+			fail = 1;
+		}
+		flac_fixed_free(&enc);
+	}
+	return fail;
+}
@@ -0,0 +1,76 @@
+/*
+* flac_md5_test
+* Copyright (C) 2025  vrunk11, stefan_o
+*
+* This program will test the MD5 signature of FLAC samples with 8 and 16 bit
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "md5.h"
+
+#define SAMPLES 10000
+
+typedef struct {
+	uint32_t bps;
+	size_t step;        // samples per md5_update_flac() call
+	const char *digest; // of the samples as stored by FLAC (bps/8 bytes each, little endian)
+} md5_test_t;
+
+int main(void)
+{
+	md5_test_t tests[] = {
+		{  8, SAMPLES, "65de44c4b5cd6e380b80b3f40641adab" },
+		{  8,     777, "65de44c4b5cd6e380b80b3f40641adab" },
+		{ 16, SAMPLES, "c4cb28094ba76275a4ee510a5ab722b0" },
+		{ 16,     777, "c4cb28094ba76275a4ee510a5ab722b0" },
+	};
+	int16_t *smp = malloc(SAMPLES * sizeof(int16_t));
+	int fail = 0;
+
+	if (!smp) {
+		fprintf(stderr, "malloc failed\n");
+		return 1;
+	}
+
+	for(size_t t = 0; t < sizeof(tests)/sizeof(tests[0]); t++) {
+		md5_ctx_t ctx;
+		uint8_t digest[16];
+		char hex[33];
+		for(size_t i = 0; i < SAMPLES; i++) {
+			if (tests[t].bps == 8) smp[i] = (int8_t)((i * 37) & 0xff);
+			else smp[i] = (int16_t)(((i * 2654435761u) >> 16) & 0xffff);
+		}
+		md5_init(&ctx);
+		for(size_t i = 0; i < SAMPLES; i += tests[t].step) {
+			md5_update_flac(&ctx, &smp[i], (SAMPLES - i < tests[t].step) ? SAMPLES - i : tests[t].step, tests[t].bps);
+		}
+		md5_final(&ctx, digest);
+		for(int i = 0; i < 16; i++) sprintf(&hex[2*i], "%02x", digest[i]);
+		if (strcmp(hex, tests[t].digest) == 0) {
+			fprintf(stderr, "%2u bit, %5zu samples per call: ok\n", tests[t].bps, tests[t].step);
+		}
+		else {
+			fprintf(stderr, "%2u bit, %5zu samples per call: got %s, expected %s\n", tests[t].bps, tests[t].step, hex, tests[t].digest);
+			fail = 1;
+		}
+	}
+
+	free(smp);
+	return fail;
+}
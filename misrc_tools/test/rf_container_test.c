@@ -0,0 +1,189 @@
+/*
+* rf_container_test
+* Copyright (C) 2025  vrunk11, stefan_o
+*
+* This program will test writing and reading the MISRC RF container with
+* every codec of this build, including files that are cut off or damaged
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "rf_container.h"
+
+// two complete chunks and a partial one
+#define SAMPLES (2 * RFC_CHUNK_SAMPLES + 300000)
+
+// how the file is written or damaged
+enum {
+	FILE_CLOSED,        // index at the end, referenced by the header
+	FILE_PIPE,          // index at the end, the header has no index (written to a pipe)
+	FILE_NOT_CLOSED,    // no index
+	FILE_TRUNCATED,     // no index, the last chunk is cut off
+	FILE_TRUNCATED_HDR, // no index, the file ends in the header of the last chunk
+	FILE_BAD_HEADER,    // index, the header of the second chunk is damaged
+	FILE_BAD_HEADER_NI, // no index, the header of the second chunk is damaged
+	FILE_BAD_PAYLOAD,   // index, a byte in the payload of the second chunk is changed
+	FILE_GARBAGE,       // no index, garbage behind the last chunk
+};
+
+typedef struct {
+	int type;
+	int read_result;    // of rfc_stream_read()
+	size_t chunks;      // in the index after reading
+	int bad_chunk;      // chunk that has to fail decoding, -1 if all decode
+	const char *desc;
+} container_test_t;
+
+static const container_test_t tests[] = {
+	{ FILE_CLOSED,        0,                 3, -1, "closed file" },
+	{ FILE_PIPE,          0,                 3, -1, "written to a pipe" },
+	{ FILE_NOT_CLOSED,    0,                 3, -1, "not closed" },
+	{ FILE_TRUNCATED,     RFC_ERR_TRUNCATED, 2, -1, "last chunk cut off" },
+	{ FILE_TRUNCATED_HDR, RFC_ERR_TRUNCATED, 2, -1, "cut off in the last chunk header" },
+	{ FILE_BAD_HEADER,    0,                 3,  1, "damaged chunk header" },
+	{ FILE_BAD_HEADER_NI, RFC_ERR_FORMAT,    0, -1, "damaged chunk header without index" },
+	{ FILE_BAD_PAYLOAD,   0,                 3,  1, "damaged payload" },
+	{ FILE_GARBAGE,       RFC_ERR_FORMAT,    0, -1, "garbage behind the chunks" },
+};
+
+// 12 bit RF like signal: a carrier with noise
+static void fill_samples(int16_t *x, size_t n)
+{
+	uint32_t r = 1;
+	for(size_t i = 0; i < n; i++) {
+		r = r * 1664525 + 1013904223;
+		x[i] = (int16_t)lrint(1500.0 * sin(i * 0.37) + (double)((r >> 20) % 64) - 32.0);
+	}
+}
+
+// write the samples as container file of the given type, returns NULL on error
+static FILE *write_file(int codec, int type, const int16_t *x, size_t n)
+{
+	rfc_encoder_t *enc = malloc(sizeof(rfc_encoder_t));
+	size_t chunks_max = (n + RFC_CHUNK_SAMPLES - 1) / RFC_CHUNK_SAMPLES;
+	uint8_t *out = malloc(chunks_max * RFC_CHUNK_MAX), header[RFC_HEADER_SIZE], *index = NULL;
+	size_t *len = malloc(chunks_max * sizeof(size_t)), chunks, keep;
+	bool with_index = (type == FILE_CLOSED || type == FILE_PIPE || type == FILE_BAD_HEADER || type == FILE_BAD_PAYLOAD);
+	rfc_stream_t s;
+	FILE *f = tmpfile();
+
+	if (!enc || !out || !len || !f || rfc_encoder_init(enc, codec, 1, 2) != 0) goto err;
+	rfc_stream_init(&s, codec, 12, 0, 40000000);
+	rfc_write_header(&s, false, header);
+	fwrite(header, 1, RFC_HEADER_SIZE, f);
+	chunks = rfc_encode(enc, x, n, 0, out, len);
+	rfc_encoder_free(enc);
+	for(size_t i = 0; i < chunks; i++) {
+		uint8_t *chunk = &out[i * RFC_CHUNK_MAX];
+		if (rfc_stream_add(&s, chunk, len[i]) != 0) goto err;
+		if (i == 1 && (type == FILE_BAD_HEADER || type == FILE_BAD_HEADER_NI)) chunk[13] ^= 0x01;
+		if (i == 1 && type == FILE_BAD_PAYLOAD) chunk[RFC_CHUNK_HEADER_SIZE + len[i] / 2] ^= 0x10;
+		keep = len[i];
+		if (i == chunks - 1 && type == FILE_TRUNCATED) keep = len[i] / 2;
+		if (i == chunks - 1 && type == FILE_TRUNCATED_HDR) keep = RFC_CHUNK_HEADER_SIZE / 2;
+		if (fwrite(chunk, 1, keep, f) != keep) goto err;
+	}
+	if (type == FILE_GARBAGE) fwrite("no index here", 1, 13, f);
+	if (with_index) {
+		if ((index = malloc(rfc_index_size(&s))) == NULL) goto err;
+		rfc_write_index(&s, index);
+		fwrite(index, 1, rfc_index_size(&s), f);
+		free(index);
+		if (type != FILE_PIPE) {
+			rfc_write_header(&s, true, header);
+			fseek(f, 0, SEEK_SET);
+			fwrite(header, 1, RFC_HEADER_SIZE, f);
+		}
+	}
+	rfc_stream_free(&s);
+	free(enc);
+	free(out);
+	free(len);
+	fflush(f);
+	return f;
+err:
+	free(enc);
+	free(out);
+	free(len);
+	if (f) fclose(f);
+	return NULL;
+}
+
+static int run_test(int codec, const container_test_t *t, const int16_t *x, int16_t *chunk)
+{
+	rfc_stream_t s;
+	rfc_decoder_t dec;
+	FILE *f = write_file(codec, t->type, x, SAMPLES);
+	int r, fail = 0;
+
+	if (!f) {
+		fprintf(stderr, "    %-36s could not write the file\n", t->desc);
+		return 1;
+	}
+	r = rfc_stream_read(&s, f);
+	if (r != t->read_result || s.chunks != t->chunks) {
+		fprintf(stderr, "    %-36s read: %s with %zu chunks, expected %s with %zu chunks\n", t->desc, rfc_strerror(r), s.chunks, rfc_strerror(t->read_result), t->chunks);
+		fail = 1;
+	}
+	if (rfc_decoder_init(&dec) != 0) fail = 1;
+	for(size_t i = 0; !fail && i < s.chunks; i++) {
+		const rfc_chunk_t *c = &s.index[i];
+		r = rfc_decode_chunk(&dec, &s, f, i, chunk);
+		if ((int)i == t->bad_chunk) {
+			if (r == 0) {
+				fprintf(stderr, "    %-36s chunk %zu was not rejected\n", t->desc, i);
+				fail = 1;
+			}
+			continue;
+		}
+		if (r != 0 || c->first_sample != i * RFC_CHUNK_SAMPLES || memcmp(chunk, &x[c->first_sample], c->samples * sizeof(int16_t)) != 0) {
+			fprintf(stderr, "    %-36s chunk %zu: %s\n", t->desc, i, (r != 0) ? rfc_strerror(r) : "samples differ");
+			fail = 1;
+		}
+	}
+	if (!fail) fprintf(stderr, "    %-36s ok\n", t->desc);
+	rfc_decoder_free(&dec);
+	rfc_stream_free(&s);
+	fclose(f);
+	return fail;
+}
+
+int main(void)
+{
+	int16_t *x = malloc(SAMPLES * sizeof(int16_t));
+	int16_t *chunk = malloc(RFC_CHUNK_SAMPLES * sizeof(int16_t));
+	int fail = 0;
+
+	if (!x || !chunk) {
+		fprintf(stderr, "malloc failed\n");
+		return 1;
+	}
+	fill_samples(x, SAMPLES);
+	for(int codec = 0; codec < RFC_CODEC_CNT; codec++) {
+		if (!rfc_codec_name(codec)) {
+			fprintf(stderr, "codec %d is not supported by this build\n", codec);
+			continue;
+		}
+		fprintf(stderr, "%s:\n", rfc_codec_name(codec));
+		for(size_t i = 0; i < sizeof(tests)/sizeof(tests[0]); i++) fail |= run_test(codec, &tests[i], x, chunk);
+	}
+	free(x);
+	free(chunk);
+	return fail;
+}
@@ -0,0 +1,179 @@
+/*
+* rf_decimate_test
+* Copyright (C) 2025  vrunk11, stefan_o
+*
+* This program will test the built-in decimator with every quality: the
+* output must not depend on how the input is split into calls, tones in the
+* passband must keep their amplitude and tones that alias into the passband
+* must be attenuated
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "rf_decimate.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define IN_RATE     40000.0
+#define SAMPLES     (1 << 19)
+#define SETTLE      4096        // output samples skipped while the filters fill
+#define AMPLITUDE   2000.0      // of the test tones, 12 bit input
+#define MAX_RIPPLE  0.5         // dB, tones in the passband
+
+static const char *quality_name[RFD_QUALITIES] = { "QQ", "LQ", "MQ", "HQ", "VHQ" };
+
+// least attenuation of tones that alias into the passband and of the computed filter
+// response, a few dB below the measured values (QQ about 48 to 54 dB, the others 70 to 78 dB)
+static const double min_rejection[RFD_QUALITIES] = { 45.0, 60.0, 70.0, 70.0, 70.0 };
+
+static const double out_rates[] = { 20000.0, 16000.0, 13333.333333333, 10000.0, 8000.0, 5000.0 };
+
+// input split into calls of these sizes, in turn
+static const size_t chunk_sizes[] = { 1, 3, 100, 4095, RFD_CHUNK, RFD_CHUNK + 1, 50000, 7 };
+
+static uint32_t rnd_state = 12345;
+static uint32_t rnd(void)
+{
+	rnd_state = rnd_state * 1664525 + 1013904223;
+	return rnd_state >> 8;
+}
+
+static void tone(int16_t *x, size_t n, double freq, double amplitude)
+{
+	for(size_t i = 0; i < n; i++) x[i] = (int16_t)lrint(amplitude * sin(2 * M_PI * freq * i + 0.3));
+}
+
+// amplitude of the given frequency (relative to the output rate) in the output
+static double tone_amplitude(const int16_t *y, size_t n, double freq)
+{
+	double c = 0, s = 0;
+	for(size_t m = SETTLE; m < n; m++) {
+		c += y[m] * cos(2 * M_PI * freq * m);
+		s += y[m] * sin(2 * M_PI * freq * m);
+	}
+	return 2 * sqrt(c * c + s * s) / (double)(n - SETTLE);
+}
+
+static size_t decimate(double out_rate, int quality, const int16_t *x, size_t n, int16_t *y)
+{
+	rfd_t d;
+	size_t ny;
+	if (rfd_init(&d, IN_RATE, out_rate, quality, 1.0, 12, false) != 0) return 0;
+	ny = rfd_process(&d, x, n, y);
+	rfd_free(&d);
+	return ny;
+}
+
+// the same input in one call, in calls of varying size and as 32 bit samples
+static int test_chunks(double out_rate, int quality, const int16_t *x, int16_t *y, int16_t *y2)
+{
+	int32_t *x32 = malloc(SAMPLES * sizeof(int32_t));
+	size_t ny = decimate(out_rate, quality, x, SAMPLES, y), ny2 = 0, len;
+	int r = -1;
+	rfd_t d;
+
+	if (!x32 || ny == 0 || rfd_init(&d, IN_RATE, out_rate, quality, 1.0, 12, false) != 0) goto end;
+	for(size_t i = 0, c = 0; i < SAMPLES; i += len, c++) {
+		len = chunk_sizes[c % (sizeof(chunk_sizes)/sizeof(chunk_sizes[0]))];
+		if (len > SAMPLES - i) len = SAMPLES - i;
+		ny2 += rfd_process(&d, &x[i], len, &y2[ny2]);
+	}
+	rfd_free(&d);
+	if (ny2 != ny || memcmp(y, y2, ny * sizeof(int16_t)) != 0) {
+		fprintf(stderr, "    %-3s output depends on the size of the calls\n", quality_name[quality]);
+		goto end;
+	}
+	for(size_t i = 0; i < SAMPLES; i++) x32[i] = x[i];
+	if (rfd_init(&d, IN_RATE, out_rate, quality, 1.0, 12, false) != 0) goto end;
+	ny2 = rfd_process_s32(&d, x32, SAMPLES, y2);
+	rfd_free(&d);
+	if (ny2 != ny || memcmp(y, y2, ny * sizeof(int16_t)) != 0) {
+		fprintf(stderr, "    %-3s output of 32 bit samples differs\n", quality_name[quality]);
+		goto end;
+	}
+	r = 0;
+end:
+	free(x32);
+	return r;
+}
+
+static int run_test(double out_rate, int quality, int16_t *x, int16_t *y, int16_t *y2)
+{
+	double ratio = out_rate / IN_RATE, passband, ripple, rejection, gain, worst_gain = 0, worst_rej = 1000;
+	size_t ny;
+	rfd_t d;
+
+	if (rfd_init(&d, IN_RATE, out_rate, quality, 1.0, 12, false) != 0) {
+		fprintf(stderr, "    %-3s could not be initialized\n", quality_name[quality]);
+		return 1;
+	}
+	rfd_response(&d, &passband, &ripple, &rejection);
+	rfd_free(&d);
+
+	// 12 bit noise with a carrier
+	for(size_t i = 0; i < SAMPLES; i++) x[i] = (int16_t)lrint(1500.0 * sin(i * 0.37) + (double)(rnd() % 1024) - 512.0);
+	if (test_chunks(out_rate, quality, x, y, y2) != 0) return 1;
+
+	// tones in the passband and the tones that alias onto them, frequencies relative to the input rate
+	for(double f = 0.1; f < 1.05; f += 0.15) {
+		double ft = f * passband, fa = ratio - ft, db;
+		tone(x, SAMPLES, ft, AMPLITUDE);
+		ny = decimate(out_rate, quality, x, SAMPLES, y);
+		gain = 20 * log10(tone_amplitude(y, ny, ft / ratio) / AMPLITUDE);
+		if (fabs(gain) > fabs(worst_gain)) worst_gain = gain;
+		tone(x, SAMPLES, fa, AMPLITUDE);
+		ny = decimate(out_rate, quality, x, SAMPLES, y);
+		db = -20 * log10(tone_amplitude(y, ny, ft / ratio) / AMPLITUDE + 1e-9);
+		if (db < worst_rej) worst_rej = db;
+	}
+	if (fabs(worst_gain) > MAX_RIPPLE || worst_rej < min_rejection[quality] || rejection < min_rejection[quality]) {
+		fprintf(stderr, "    %-3s passband gain %+.2f dB (limit %.1f), alias rejection %.1f dB, filter response %.1f dB (limit %.1f)\n", quality_name[quality], worst_gain, MAX_RIPPLE, worst_rej, rejection, min_rejection[quality]);
+		return 1;
+	}
+	fprintf(stderr, "    %-3s ok, passband gain %+.2f dB, alias rejection %.1f dB (filter response: ripple %.2f dB, rejection %.1f dB)\n", quality_name[quality], worst_gain, worst_rej, ripple, rejection);
+	return 0;
+}
+
+int main(void)
+{
+	int16_t *x = malloc(SAMPLES * sizeof(int16_t));
+	int16_t *y = malloc((SAMPLES + 64) * sizeof(int16_t));
+	int16_t *y2 = malloc((SAMPLES + 64) * sizeof(int16_t));
+	int fail = 0;
+
+	if (!x || !y || !y2) {
+		fprintf(stderr, "malloc failed\n");
+		return 1;
+	}
+	for(size_t r = 0; r < sizeof(out_rates)/sizeof(out_rates[0]); r++) {
+		fprintf(stderr, "%.0f kSPS to %.0f kSPS:\n", IN_RATE, out_rates[r]);
+		if (!rfd_supported(IN_RATE, out_rates[r])) {
+			fprintf(stderr, "    not supported\n");
+			fail = 1;
+			continue;
+		}
+		for(int q = 0; q < RFD_QUALITIES; q++) fail |= run_test(out_rates[r], q, x, y, y2);
+	}
+	free(x);
+	free(y);
+	free(y2);
+	return fail;
+}
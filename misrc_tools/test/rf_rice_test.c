@@ -0,0 +1,176 @@
+/*
+* rf_rice_test
+* Copyright (C) 2025  vrunk11, stefan_o
+*
+* This program will test the rice codec of the RF container with signals
+* that make it choose each predictor, packed and Rice coded residuals, and
+* with output buffers that are too small
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "rf_rice.h"
+
+#define SAMPLES (16 * RF_RICE_BLOCK)
+#define GUARD   64
+#define ANY     -1
+
+// signal of the test
+enum { SIG_RANDOM, SIG_ZERO, SIG_CONSTANT, SIG_WALK, SIG_TRIANGLE, SIG_CARRIER, SIG_NOISE };
+
+typedef struct {
+	int signal;
+	size_t samples;     // the last block is partial unless this is a multiple of RF_RICE_BLOCK
+	int predictor;      // expected in the first block: order 0 to 2 or 3 for LPC, ANY if not checked
+	int packed;         // expected in the first block, ANY if not checked
+	const char *desc;
+} rice_test_t;
+
+static const rice_test_t tests[] = {
+	{ SIG_RANDOM,   SAMPLES,             0, 1,   "full range random (order 0, packed)" },
+	{ SIG_ZERO,     SAMPLES,             ANY, 1, "zero (packed with 0 bits)" },
+	{ SIG_CONSTANT, SAMPLES,             ANY, ANY, "constant" },
+	{ SIG_WALK,     SAMPLES,             1, 0,   "random walk (order 1, Rice)" },
+	{ SIG_TRIANGLE, SAMPLES,             2, 0,   "triangle with noise (order 2, Rice)" },
+	{ SIG_CARRIER,  SAMPLES,             3, 0,   "carrier with noise (LPC, Rice)" },
+	{ SIG_NOISE,    SAMPLES,             0, 0,   "noise with spikes (order 0, Rice)" },
+	{ SIG_CARRIER,  3 * RF_RICE_BLOCK + 517, 3, 0, "carrier, partial block" },
+	{ SIG_RANDOM,   RF_RICE_BLOCK + 1,   0, 1,   "random, block of 1 sample" },
+	{ SIG_WALK,     5,                   ANY, ANY, "random walk, 5 samples" },
+};
+
+static uint32_t rnd_state = 12345;
+static uint32_t rnd(void)
+{
+	rnd_state = rnd_state * 1664525 + 1013904223;
+	return rnd_state >> 8;
+}
+
+static void fill_samples(int16_t *x, size_t n, int signal)
+{
+	int32_t v = 0;
+	for(size_t i = 0; i < n; i++) {
+		switch(signal) {
+		case SIG_RANDOM:
+			x[i] = (int16_t)(rnd() & 0xffff);
+			break;
+		case SIG_ZERO:
+			x[i] = 0;
+			break;
+		case SIG_CONSTANT:
+			x[i] = -1234;
+			break;
+		case SIG_WALK:
+			v += (int32_t)(rnd() % 33) - 16;
+			if (v > 32767) v = 32767;
+			if (v < -32768) v = -32768;
+			x[i] = (int16_t)v;
+			break;
+		case SIG_TRIANGLE:
+			v = (int32_t)(i % 1600);
+			x[i] = (int16_t)(((v < 800) ? v : 1600 - v) * 40 - 16000 + (int32_t)(rnd() % 3) - 1);
+			break;
+		case SIG_CARRIER:
+			x[i] = (int16_t)lrint(12000.0 * sin(i * 0.37) + 3000.0 * sin(i * 0.05) + (double)(rnd() % 16) - 8.0);
+			break;
+		default:
+			// the spikes make packing expensive
+			x[i] = (int16_t)((int32_t)(rnd() % 7) - 3 + ((i % 100 == 50) ? 2000 : 0));
+			break;
+		}
+	}
+}
+
+static int run_test(const rice_test_t *t, int16_t *x, int16_t *y, uint8_t *out, size_t cap)
+{
+	size_t n = t->samples, len;
+	int predictor, packed;
+
+	fill_samples(x, n, t->signal);
+	memset(out, 0xaa, cap + GUARD);
+	if ((len = rf_rice_encode(x, n, out, cap)) == 0) {
+		fprintf(stderr, "    %-40s did not fit\n", t->desc);
+		return 1;
+	}
+	// the header of the first block is the first byte
+	predictor = out[0] >> 6;
+	packed = (out[0] >> 5) & 1;
+	if ((t->predictor != ANY && predictor != t->predictor) || (t->packed != ANY && packed != t->packed)) {
+		fprintf(stderr, "    %-40s first block has predictor %d packed %d, expected %d %d\n", t->desc, predictor, packed, t->predictor, t->packed);
+		return 1;
+	}
+	memset(y, 0, n * sizeof(int16_t));
+	if (rf_rice_decode(out, len, y, n) != 0 || memcmp(x, y, n * sizeof(int16_t)) != 0) {
+		fprintf(stderr, "    %-40s samples differ\n", t->desc);
+		return 1;
+	}
+	// a buffer that is one byte too short must not decode
+	if (rf_rice_decode(out, len - 1, y, n) == 0 && memcmp(x, y, n * sizeof(int16_t)) == 0) {
+		fprintf(stderr, "    %-40s decoded from %zu of %zu bytes\n", t->desc, len - 1, len);
+		return 1;
+	}
+	fprintf(stderr, "    %-40s ok, %6.2f bits per sample\n", t->desc, len * 8.0 / n);
+	return 0;
+}
+
+// a too small output buffer has to be rejected without writing past its end
+static int run_cap_test(int16_t *x, uint8_t *out, size_t cap, size_t n, const char *desc)
+{
+	size_t len;
+	fill_samples(x, n, SIG_RANDOM);
+	memset(out, 0xaa, cap + GUARD);
+	len = rf_rice_encode(x, n, out, cap);
+	for(size_t i = cap; i < cap + GUARD; i++) {
+		if (out[i] != 0xaa) {
+			fprintf(stderr, "    %-40s written past the end\n", desc);
+			return 1;
+		}
+	}
+	if (len != 0) {
+		fprintf(stderr, "    %-40s returned %zu instead of 0\n", desc, len);
+		return 1;
+	}
+	fprintf(stderr, "    %-40s ok\n", desc);
+	return 0;
+}
+
+int main(void)
+{
+	size_t cap = (SAMPLES / RF_RICE_BLOCK) * RF_RICE_BLOCK_MAX;
+	int16_t *x = malloc(SAMPLES * sizeof(int16_t));
+	int16_t *y = malloc(SAMPLES * sizeof(int16_t));
+	uint8_t *out = malloc(cap + GUARD);
+	int fail = 0;
+
+	if (!x || !y || !out) {
+		fprintf(stderr, "malloc failed\n");
+		return 1;
+	}
+	fprintf(stderr, "Round trip:\n");
+	for(size_t i = 0; i < sizeof(tests)/sizeof(tests[0]); i++) fail |= run_test(&tests[i], x, y, out, cap);
+	fprintf(stderr, "Output buffer too small:\n");
+	fail |= run_cap_test(x, out, 0, 1, "no room");
+	fail |= run_cap_test(x, out, RF_RICE_BLOCK_MAX - 1, 1, "less than one block");
+	// random samples need 16 bits each, the last of 16 blocks does not fit
+	fail |= run_cap_test(x, out, SAMPLES * 2, SAMPLES, "room for the samples only");
+	free(x);
+	free(y);
+	free(out);
+	return fail;
+}